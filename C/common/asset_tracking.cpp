@@ -33,7 +33,7 @@ AssetTracker *AssetTracker::getAssetTracker()
  * @param service  		Service name
  */
 AssetTracker::AssetTracker(ManagementClient *mgtClient, string service) 
-	: m_mgtClient(mgtClient), m_service(service)
+	: m_mgtClient(mgtClient), m_service(service), m_serviceName(service)
 {
 	instance = this;
 }
@@ -50,8 +50,11 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
 		std::vector<AssetTrackingTuple*>& vec = m_mgtClient->getAssetTrackingTuples(m_service);
 		for (AssetTrackingTuple* & rec : vec)
 		{
-			assetTrackerTuplesCache.insert(rec);
+			assetTrackerTuplesCache.insert(AssetTrackingKey{InternedName(rec->m_serviceName),
+						InternedName(rec->m_pluginName), InternedName(rec->m_assetName),
+						InternedName(rec->m_eventName)});
 			//Logger::getLogger()->info("Added asset tracker tuple to cache: '%s'", rec->assetToString().c_str());
+			delete rec;
 		}
 		delete (&vec);
 	}
@@ -71,14 +74,25 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
  */
 bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)	
 {
-	AssetTrackingTuple *ptr = &tuple;
-	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(ptr);
-	if (it == assetTrackerTuplesCache.end())
-	{
-		return false;
-	}
-	else
-		return true;
+	AssetTrackingKey key{InternedName(tuple.m_serviceName), InternedName(tuple.m_pluginName),
+				InternedName(tuple.m_assetName), InternedName(tuple.m_eventName)};
+	return assetTrackerTuplesCache.find(key) != assetTrackerTuplesCache.end();
+}
+
+/**
+ * Check local cache for a tuple of this service, the names are
+ * compared as interned ids
+ *
+ * @param plugin	Plugin name
+ * @param asset		Asset name
+ * @param event		Event name
+ * @return		Returns whether tuple is present in cache
+ */
+bool AssetTracker::checkAssetTrackingCache(const InternedName& plugin, const InternedName& asset,
+					   const InternedName& event)
+{
+	AssetTrackingKey key{m_serviceName, plugin, asset, event};
+	return assetTrackerTuplesCache.find(key) != assetTrackerTuplesCache.end();
 }
 
 
@@ -89,14 +103,14 @@ bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)
  */
 void AssetTracker::addAssetTrackingTuple(AssetTrackingTuple& tuple)
 {
-	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(&tuple);
-	if (it == assetTrackerTuplesCache.end())
+	AssetTrackingKey key{InternedName(tuple.m_serviceName), InternedName(tuple.m_pluginName),
+				InternedName(tuple.m_assetName), InternedName(tuple.m_eventName)};
+	if (assetTrackerTuplesCache.find(key) == assetTrackerTuplesCache.end())
 	{
 		bool rv = m_mgtClient->addAssetTrackingTuple(tuple.m_serviceName, tuple.m_pluginName, tuple.m_assetName, tuple.m_eventName);
 		if (rv) // insert into cache only if DB operation succeeded
 		{
-			AssetTrackingTuple *ptr = new AssetTrackingTuple(tuple);
-			assetTrackerTuplesCache.insert(ptr);
+			assetTrackerTuplesCache.insert(std::move(key));
 			Logger::getLogger()->info("addAssetTrackingTuple(): Added tuple to cache: '%s'", tuple.assetToString().c_str());
 		}
 		else
@@ -0,0 +1,534 @@
+/*
+ * FogLAMP binary readings batch format.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <binary_readings.h>
+#include <timestamp_codec.h>
+#include <reading.h>
+#include <logger.h>
+#include <unordered_map>
+#include <cstdio>
+#include <sys/time.h>
+
+using namespace std;
+
+/**
+ * Append a fixed size value to the output buffer
+ */
+template <class T> static void append(string& out, T value)
+{
+	out.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * The dictionary of the asset codes or datapoint names of a batch,
+ * names are found by interned id or, if they are not interned, by
+ * the name itself
+ */
+struct Dictionary {
+	unordered_map<unsigned int, uint32_t>	ids;
+	unordered_map<string, uint32_t>		names;
+	vector<const string *>			strings;	// In index order
+};
+
+/**
+ * Look up a name in a dictionary, adding it if it is not present
+ *
+ * @param dict		The dictionary
+ * @param id		The interned id of the name to find
+ * @param name		The name to find, used if it is not interned
+ * @return		The index of the string in the dictionary
+ */
+static uint32_t lookup(Dictionary& dict, unsigned int id, const string& name)
+{
+	uint32_t index = (uint32_t)dict.strings.size();
+	if (id == INTERNER_NOT_INTERNED)
+	{
+		auto res = dict.names.insert(pair<string, uint32_t>(name, index));
+		if (!res.second)
+		{
+			return res.first->second;
+		}
+	}
+	else
+	{
+		auto res = dict.ids.insert(pair<unsigned int, uint32_t>(id, index));
+		if (!res.second)
+		{
+			return res.first->second;
+		}
+	}
+	dict.strings.push_back(&name);
+	return index;
+}
+
+/**
+ * Encode a set of readings in the binary batch format described in
+ * binary_readings.h
+ *
+ * A reading with more datapoints, or an asset code or datapoint name
+ * longer than will fit in the uint16 fields of the format can not be
+ * encoded, the readings must be sent as JSON instead.
+ *
+ * @param readings	The readings to encode
+ * @param out		Set to the encoded batch
+ * @return bool		False if the readings can not be encoded
+ */
+bool BinaryReadingsWriter::encode(const vector<Reading *>& readings, string& out)
+{
+Dictionary			assets, names;
+string				assetCol, userTsCol, tsCol, keyCol, countCol;
+string				nameCol, typeCol, intCol, floatCol, varCol;
+uint32_t			nDatapoints = 0;
+
+	for (auto reading : readings)
+	{
+		append<uint32_t>(assetCol, lookup(assets, reading->getAssetId(), reading->getAssetName()));
+
+		struct timeval tv;
+		reading->getUserTimestamp(&tv);
+		append<int64_t>(userTsCol, (int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+		reading->getTimestamp(&tv);
+		append<int64_t>(tsCol, (int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+
+		char key[READINGS_BINARY_KEY_LEN];
+		memset(key, 0, sizeof(key));
+		const string& uuid = reading->getUuid();
+		memcpy(key, uuid.c_str(), uuid.length() < sizeof(key) ? uuid.length() : sizeof(key));
+		keyCol.append(key, sizeof(key));
+
+		vector<Datapoint *>& datapoints = reading->getReadingData();
+		if (datapoints.size() > READINGS_BINARY_MAX_SHORT)
+		{
+			Logger::getLogger()->warn("Reading of asset %s has %lu datapoints, "
+					"too many for the binary readings format",
+					reading->getAssetName().c_str(), datapoints.size());
+			return false;
+		}
+		append<uint16_t>(countCol, (uint16_t)datapoints.size());
+		for (auto dp : datapoints)
+		{
+			append<uint32_t>(nameCol, lookup(names, dp->getNameId(), dp->getName()));
+			DatapointValue& value = dp->getData();
+			switch (value.getType())
+			{
+			case DatapointValue::T_INTEGER:
+				typeCol += (char)READINGS_BINARY_T_INTEGER;
+				append<int64_t>(intCol, value.toInt());
+				break;
+			case DatapointValue::T_FLOAT:
+				typeCol += (char)READINGS_BINARY_T_FLOAT;
+				append<double>(floatCol, value.toDouble());
+				break;
+			case DatapointValue::T_STRING:
+			{
+				typeCol += (char)READINGS_BINARY_T_STRING;
+				const string& str = value.toStringValue();
+				append<uint32_t>(varCol, (uint32_t)str.length());
+				varCol += str;
+				break;
+			}
+			default:
+			{
+				// Arrays and nested datapoints are sent as JSON text
+				typeCol += (char)READINGS_BINARY_T_JSON;
+				string json = value.toString();
+				append<uint32_t>(varCol, (uint32_t)json.length());
+				varCol += json;
+				break;
+			}
+			}
+			nDatapoints++;
+		}
+	}
+
+	for (auto dict : { &assets, &names })
+	{
+		for (auto str : dict->strings)
+		{
+			if (str->length() > READINGS_BINARY_MAX_SHORT)
+			{
+				Logger::getLogger()->warn("Name of %lu characters is too long "
+						"for the binary readings format", str->length());
+				return false;
+			}
+		}
+	}
+
+	out.clear();
+	out.reserve(64 + assetCol.length() + userTsCol.length() * 2 + keyCol.length()
+			+ countCol.length() + nameCol.length() + typeCol.length()
+			+ intCol.length() + floatCol.length() + varCol.length());
+	out.append(READINGS_BINARY_MAGIC, 4);
+	append<uint16_t>(out, READINGS_BINARY_VERSION);
+	append<uint16_t>(out, 0);
+	append<uint32_t>(out, (uint32_t)readings.size());
+	append<uint32_t>(out, (uint32_t)assets.strings.size());
+	append<uint32_t>(out, (uint32_t)names.strings.size());
+	append<uint32_t>(out, nDatapoints);
+	for (auto str : assets.strings)
+	{
+		append<uint16_t>(out, (uint16_t)str->length());
+		out += *str;
+	}
+	for (auto str : names.strings)
+	{
+		append<uint16_t>(out, (uint16_t)str->length());
+		out += *str;
+	}
+	out += assetCol;
+	out += userTsCol;
+	out += tsCol;
+	out += keyCol;
+	out += countCol;
+	out += nameCol;
+	out += typeCol;
+	out += intCol;
+	out += floatCol;
+	out += varCol;
+	return true;
+}
+
+
+/**
+ * Construct a reader for a batch and index the readings in it
+ *
+ * @param data		The batch
+ * @param length	The length of the batch
+ */
+BinaryReadingsReader::BinaryReadingsReader(const char *data, size_t length) :
+		m_data(data), m_length(length), m_count(0), m_valid(false)
+{
+	m_valid = parse();
+}
+
+/**
+ * Return the read_key of a reading, an empty string if there is none
+ */
+string BinaryReadingsReader::getReadKey(unsigned int i) const
+{
+	const char *key = m_data + m_keyCol + i * READINGS_BINARY_KEY_LEN;
+	if (*key == 0)
+		return string();
+	return string(key, strnlen(key, READINGS_BINARY_KEY_LEN));
+}
+
+/**
+ * Format a timestamp in microseconds as used in the JSON
+ * payload, YYYY-MM-DD HH:MM:SS.uuuuuu+00:00
+ *
+ * @param usecs	Microseconds since the epoch
+ * @param buf	Buffer of at least 40 characters
+ */
+void BinaryReadingsReader::formatTimestamp(int64_t usecs, char *buf)
+{
+	struct timeval tv;
+	tv.tv_sec = (time_t)(usecs / 1000000);
+	tv.tv_usec = (long)(usecs % 1000000);
+	if (tv.tv_usec < 0)
+	{
+		tv.tv_sec--;
+		tv.tv_usec += 1000000;
+	}
+	size_t len = TimestampCodec::format(tv, buf);
+	memcpy(buf + len, "+00:00", 7);
+}
+
+/**
+ * Append the datapoints of a reading to a string as a JSON
+ * object, this is the "reading" column of the readings table.
+ *
+ * @param i	The index of the reading
+ * @param out	The string to append to
+ */
+void BinaryReadingsReader::readingJSON(unsigned int i, string& out) const
+{
+	out += '{';
+	unsigned int first = m_dpStart[i];
+	unsigned int n = column<uint16_t>(m_dpCountCol, i);
+	for (unsigned int dp = first; dp < first + n; dp++)
+	{
+		if (dp != first)
+			out += ',';
+		appendString(out, m_names[column<uint32_t>(m_dpNameCol, dp)]);
+		out += ':';
+		appendValue(dp, out);
+	}
+	out += '}';
+}
+
+/**
+ * Return the batch as the JSON payload accepted by
+ * the readings append entry point of a storage plugin
+ */
+string BinaryReadingsReader::toJSON() const
+{
+	string out;
+	out.reserve(m_length * 2);
+	out += "{ \"readings\" : [ ";
+	char ts[40];
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		if (i)
+			out += ", ";
+		out += "{ \"asset_code\" : ";
+		appendString(out, getAssetCode(i));
+		string key = getReadKey(i);
+		if (!key.empty())
+		{
+			out += ", \"read_key\" : \"";
+			out += key;
+			out += '"';
+		}
+		formatTimestamp(getUserTs(i), ts);
+		out += ", \"user_ts\" : \"";
+		out += ts;
+		formatTimestamp(getTs(i), ts);
+		out += "\", \"ts\" : \"";
+		out += ts;
+		out += "\", \"reading\" : ";
+		readingJSON(i, out);
+		out += " }";
+	}
+	out += " ] }";
+	return out;
+}
+
+/**
+ * Check that length bytes are available at the offset
+ */
+bool BinaryReadingsReader::available(size_t offset, size_t length)
+{
+	if (offset > m_length || length > m_length - offset)
+	{
+		m_error = "Binary readings batch is truncated";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Read a dictionary of strings
+ *
+ * @param offset	The offset of the dictionary, moved past it
+ * @param count		The number of strings in the dictionary
+ * @param strings	The strings read
+ */
+bool BinaryReadingsReader::readStrings(size_t& offset, uint32_t count, vector<string>& strings)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint16_t len;
+		if (!available(offset, sizeof(len)))
+			return false;
+		memcpy(&len, m_data + offset, sizeof(len));
+		offset += sizeof(len);
+		if (!available(offset, len))
+			return false;
+		strings.push_back(string(m_data + offset, len));
+		offset += len;
+	}
+	return true;
+}
+
+/**
+ * Check the batch and index the columns and values in it
+ *
+ * @return bool	False if the batch is not valid, m_error gives the reason
+ */
+bool BinaryReadingsReader::parse()
+{
+	const size_t headerLen = 24;
+	if (!available(0, headerLen) || memcmp(m_data, READINGS_BINARY_MAGIC, 4) != 0)
+	{
+		m_error = "Payload is not a binary readings batch";
+		return false;
+	}
+	uint16_t version;
+	uint32_t nAssets, nNames, nDatapoints;
+	memcpy(&version, m_data + 4, sizeof(version));
+	if (version != READINGS_BINARY_VERSION)
+	{
+		m_error = "Unsupported binary readings batch version";
+		return false;
+	}
+	memcpy(&m_count, m_data + 8, sizeof(m_count));
+	memcpy(&nAssets, m_data + 12, sizeof(nAssets));
+	memcpy(&nNames, m_data + 16, sizeof(nNames));
+	memcpy(&nDatapoints, m_data + 20, sizeof(nDatapoints));
+
+	size_t offset = headerLen;
+	if (!readStrings(offset, nAssets, m_assets) || !readStrings(offset, nNames, m_names))
+		return false;
+
+	m_assetCol = offset;
+	m_userTsCol = m_assetCol + (size_t)m_count * sizeof(uint32_t);
+	m_tsCol = m_userTsCol + (size_t)m_count * sizeof(int64_t);
+	m_keyCol = m_tsCol + (size_t)m_count * sizeof(int64_t);
+	m_dpCountCol = m_keyCol + (size_t)m_count * READINGS_BINARY_KEY_LEN;
+	m_dpNameCol = m_dpCountCol + (size_t)m_count * sizeof(uint16_t);
+	m_dpTypeCol = m_dpNameCol + (size_t)nDatapoints * sizeof(uint32_t);
+	size_t end = m_dpTypeCol + nDatapoints;
+	if (!available(m_assetCol, end - m_assetCol))
+		return false;
+
+	// Index the start of the datapoints of each reading
+	uint32_t total = 0;
+	m_dpStart.reserve(m_count);
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		if (column<uint32_t>(m_assetCol, i) >= nAssets)
+		{
+			m_error = "Asset code index out of range";
+			return false;
+		}
+		m_dpStart.push_back(total);
+		total += column<uint16_t>(m_dpCountCol, i);
+	}
+	if (total != nDatapoints)
+	{
+		m_error = "Datapoint count mismatch in binary readings batch";
+		return false;
+	}
+
+	// Count the values of each type to locate the value columns
+	size_t nInt = 0, nFloat = 0;
+	for (uint32_t dp = 0; dp < nDatapoints; dp++)
+	{
+		if (column<uint32_t>(m_dpNameCol, dp) >= nNames)
+		{
+			m_error = "Datapoint name index out of range";
+			return false;
+		}
+		uint8_t type = (uint8_t)m_data[m_dpTypeCol + dp];
+		if (type == READINGS_BINARY_T_INTEGER)
+			nInt++;
+		else if (type == READINGS_BINARY_T_FLOAT)
+			nFloat++;
+		else if (type > READINGS_BINARY_T_JSON)
+		{
+			m_error = "Unknown datapoint type in binary readings batch";
+			return false;
+		}
+	}
+	m_intCol = end;
+	m_floatCol = m_intCol + nInt * sizeof(int64_t);
+	size_t var = m_floatCol + nFloat * sizeof(double);
+	if (!available(m_intCol, var - m_intCol))
+		return false;
+
+	// Index the position of each value in its column
+	m_valueOffset.reserve(nDatapoints);
+	size_t iIdx = 0, fIdx = 0;
+	for (uint32_t dp = 0; dp < nDatapoints; dp++)
+	{
+		uint8_t type = (uint8_t)m_data[m_dpTypeCol + dp];
+		if (type == READINGS_BINARY_T_INTEGER)
+			m_valueOffset.push_back(m_intCol + sizeof(int64_t) * iIdx++);
+		else if (type == READINGS_BINARY_T_FLOAT)
+			m_valueOffset.push_back(m_floatCol + sizeof(double) * fIdx++);
+		else
+		{
+			uint32_t len;
+			if (!available(var, sizeof(len)))
+				return false;
+			memcpy(&len, m_data + var, sizeof(len));
+			if (!available(var + sizeof(len), len))
+				return false;
+			m_valueOffset.push_back(var);
+			var += sizeof(len) + len;
+		}
+	}
+	return true;
+}
+
+/**
+ * Append a string as a quoted and escaped JSON string
+ */
+void BinaryReadingsReader::appendString(string& out, const char *str, size_t len)
+{
+	out += '"';
+	for (size_t i = 0; i < len; i++)
+	{
+		char c = str[i];
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char esc[8];
+				snprintf(esc, sizeof(esc), "\\u%04x", c);
+				out += esc;
+			}
+			else
+			{
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+/**
+ * Append the value of a datapoint formatted as it would
+ * be by DatapointValue::toString()
+ */
+void BinaryReadingsReader::appendValue(unsigned int dp, string& out) const
+{
+	char buf[64];
+	size_t offset = m_valueOffset[dp];
+	switch ((uint8_t)m_data[m_dpTypeCol + dp])
+	{
+	case READINGS_BINARY_T_INTEGER:
+	{
+		int64_t value;
+		memcpy(&value, m_data + offset, sizeof(value));
+		snprintf(buf, sizeof(buf), "%lld", (long long)value);
+		out += buf;
+		break;
+	}
+	case READINGS_BINARY_T_FLOAT:
+	{
+		double value;
+		memcpy(&value, m_data + offset, sizeof(value));
+		int n = snprintf(buf, sizeof(buf), "%.10f", value);
+		if (n <= 0 || n >= (int)sizeof(buf))
+		{
+			out += "0.0";
+			break;
+		}
+		// Remove trailing zeros but keep one digit after the point
+		while (n > 1 && buf[n - 1] == '0')
+			n--;
+		if (buf[n - 1] == '.')
+			buf[n++] = '0';
+		out.append(buf, (size_t)n);
+		break;
+	}
+	case READINGS_BINARY_T_JSON:
+	{
+		uint32_t len;
+		memcpy(&len, m_data + offset, sizeof(len));
+		out.append(m_data + offset + sizeof(len), len);
+		break;
+	}
+	case READINGS_BINARY_T_STRING:
+	default:
+	{
+		uint32_t len;
+		memcpy(&len, m_data + offset, sizeof(len));
+		appendString(out, m_data + offset + sizeof(len), len);
+		break;
+	}
+	}
+}
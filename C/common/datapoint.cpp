@@ -77,19 +77,95 @@ std::string DatapointValue::toString() const
 }
 
 /**
- * Delete the DatapointValue alongwith possibly nested Datapoint objects
+ * Copy constructor, nested datapoints are copied so that
+ * the two values do not share them
+ *
+ * @param obj	The value to copy
+ */
+DatapointValue::DatapointValue(const DatapointValue& obj)
+{
+	copy(obj);
+}
+
+/**
+ * Assignment operator
+ *
+ * @param rhs	The value to copy
+ */
+DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
+{
+	if (this != &rhs)
+	{
+		deleteNestedDPV();
+		copy(rhs);
+	}
+	return *this;
+}
+
+/**
+ * Move assignment operator, the value is taken from rhs
+ * which is left holding the integer 0
+ *
+ * @param rhs	The value to move
+ */
+DatapointValue& DatapointValue::operator=(DatapointValue&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		deleteNestedDPV();
+		m_type = rhs.m_type;
+		m_value = rhs.m_value;
+		rhs.m_type = T_INTEGER;
+		rhs.m_value.i = 0;
+	}
+	return *this;
+}
+
+/**
+ * Make this value a copy of another, any previous value
+ * must already have been released
+ *
+ * @param obj	The value to copy
+ */
+void DatapointValue::copy(const DatapointValue& obj)
+{
+	m_type = obj.m_type;
+	switch (m_type)
+	{
+	case T_STRING:
+		m_value.str = new std::string(*(obj.m_value.str));
+		break;
+	case T_FLOAT_ARRAY:
+		m_value.a = new std::vector<double>(*(obj.m_value.a));
+		break;
+	case T_DP_DICT:
+	case T_DP_LIST:
+		m_value.dpa = new std::vector<Datapoint*>();
+		m_value.dpa->reserve(obj.m_value.dpa->size());
+		for (auto it = obj.m_value.dpa->cbegin(); it != obj.m_value.dpa->cend(); ++it)
+		{
+			m_value.dpa->push_back(new Datapoint(**it));
+		}
+		break;
+	default:
+		m_value = obj.m_value;
+		break;
+	}
+}
+
+/**
+ * Delete the DatapointValue alongwith possibly nested Datapoint objects.
+ * The value is left holding the integer 0.
  */
 void DatapointValue::deleteNestedDPV()
 {
 	if (m_type == T_STRING)
 	{
 		delete m_value.str;
-		m_value.str = NULL;
 	}
 	else if (m_type == T_FLOAT_ARRAY)
 	{
 		delete m_value.a;
-		m_value.a = NULL;
 	}
 	else if (m_type == T_DP_DICT || m_type == T_DP_LIST)
 	{
@@ -101,23 +177,15 @@ void DatapointValue::deleteNestedDPV()
 		}
 		delete m_value.dpa;
 	}
+	m_type = T_INTEGER;
+	m_value.i = 0;
 }
 
 /**
- * DatapointValue class destructor
+ * DatapointValue class destructor, the value owns any
+ * nested datapoints and deletes them
  */
 DatapointValue::~DatapointValue()
 {
-	if (m_type == T_STRING)
-	{
-		delete m_value.str;
-		m_value.str = NULL;
-	}
-	if (m_type == T_FLOAT_ARRAY)
-	{
-		delete m_value.a;
-		m_value.a = NULL;
-	}
-	// For nested DPV, d'tor is always called from holding Datapoint object's destructor
+	deleteNestedDPV();
 }
-
@@ -0,0 +1,367 @@
+/*
+ * FogLAMP streamed HTTP response.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <http_stream.h>
+#include <local_http_client.h>
+#include <stdexcept>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+using namespace std;
+
+/**
+ * Create a stream for requests to a server
+ *
+ * @param hostname	The host to connect to
+ * @param port		The port to connect to
+ * @param socketPath	The Unix domain socket of the server, if on this host
+ * @param timeout	Seconds to wait for the server to send or accept data
+ */
+HttpStream::HttpStream(const string& hostname, unsigned short port, const string& socketPath,
+		       unsigned int timeout) :
+	m_hostname(hostname), m_port(port), m_socketPath(socketPath), m_timeout(timeout),
+	m_socket(-1), m_keepAlive(false), m_content(this), m_encoding(Close), m_remaining(0),
+	m_complete(false), m_chunks(false), m_pos(0), m_end(0)
+{
+}
+
+/**
+ * Destroy the stream, closing the connection
+ */
+HttpStream::~HttpStream()
+{
+	close();
+}
+
+/**
+ * Close the connection to the server
+ */
+void HttpStream::close()
+{
+	if (m_socket != -1)
+	{
+		::close(m_socket);
+		m_socket = -1;
+	}
+}
+
+/**
+ * Connect to the server, on the Unix domain socket if there is one
+ *
+ * @throws runtime_error If the server can not be reached
+ */
+void HttpStream::connect()
+{
+	string port = to_string(m_port);
+	if (!m_socketPath.empty())
+	{
+		m_socket = connectLocalSocket(m_socketPath);
+	}
+	if (m_socket == -1)
+	{
+		struct addrinfo hints, *addrs;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(m_hostname.c_str(), port.c_str(), &hints, &addrs) != 0)
+		{
+			throw runtime_error("Unable to resolve " + m_hostname);
+		}
+		for (struct addrinfo *addr = addrs; addr && m_socket == -1; addr = addr->ai_next)
+		{
+			m_socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+			if (m_socket != -1 && ::connect(m_socket, addr->ai_addr, addr->ai_addrlen) != 0)
+			{
+				close();
+			}
+		}
+		freeaddrinfo(addrs);
+	}
+	if (m_socket == -1)
+	{
+		throw runtime_error("Unable to connect to " + m_hostname + ":" + port);
+	}
+	struct timeval tv;
+	tv.tv_sec = m_timeout;
+	tv.tv_usec = 0;
+	setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * Send data on the connection
+ *
+ * @param data	The data to send
+ * @return bool	False if the data could not be sent
+ */
+bool HttpStream::send(const string& data)
+{
+	const char *ptr = data.c_str();
+	size_t left = data.length();
+	while (left > 0)
+	{
+		ssize_t n = ::send(m_socket, ptr, left, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		ptr += n;
+		left -= (size_t)n;
+	}
+	return true;
+}
+
+/**
+ * Send a request and read the headers of the response, the content
+ * may then be read from content(). The connection left open by the
+ * previous request is used if the server has not closed it.
+ *
+ * @param method	The HTTP method
+ * @param url		The URL path and query of the request
+ * @return		The HTTP status, for example "200 OK"
+ * @throws runtime_error If the server can not be reached or the
+ *			response is not HTTP
+ */
+const string& HttpStream::request(const string& method, const string& url)
+{
+	bool reused = reusable() && m_pos == m_end;
+	if (!reused)
+	{
+		close();
+	}
+	m_pos = m_end = 0;
+	m_remaining = 0;
+	m_complete = false;
+	m_chunks = false;
+	m_encoding = Close;
+	m_keepAlive = true;
+	setg(m_buffer, m_buffer, m_buffer);
+	m_content.clear();
+
+	if (!reused)
+	{
+		connect();
+	}
+
+	string header = method + " " + url + " HTTP/1.1\r\nHost: " + m_hostname + ":" + to_string(m_port)
+				+ "\r\nConnection: keep-alive\r\n\r\n";
+	string line;
+	bool sent = send(header);
+	if (reused && !(sent && readLine(line)))
+	{
+		// The server closed the connection whilst it was idle
+		close();
+		connect();
+		sent = send(header);
+		line.clear();
+	}
+	if (!sent)
+	{
+		close();
+		throw runtime_error("Unable to send request to " + m_hostname);
+	}
+
+	// Status line, "HTTP/1.1 200 OK"
+	if ((line.empty() && !readLine(line)) || line.compare(0, 5, "HTTP/") != 0 || line.find(' ') == string::npos)
+	{
+		close();
+		throw runtime_error("Invalid response from " + m_hostname);
+	}
+	m_status = line.substr(line.find(' ') + 1);
+
+	bool hasLength = false;
+	while (readLine(line) && !line.empty())
+	{
+		size_t colon = line.find(':');
+		if (colon == string::npos)
+		{
+			continue;
+		}
+		string name = line.substr(0, colon);
+		size_t start = line.find_first_not_of(' ', colon + 1);
+		string value = start == string::npos ? "" : line.substr(start);
+		if (strcasecmp(name.c_str(), "Content-Length") == 0)
+		{
+			m_remaining = strtoul(value.c_str(), NULL, 10);
+			hasLength = true;
+		}
+		else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0 &&
+			 strcasecmp(value.c_str(), "chunked") == 0)
+		{
+			m_encoding = Chunked;
+		}
+		else if (strcasecmp(name.c_str(), "Connection") == 0 &&
+			 strcasecmp(value.c_str(), "close") == 0)
+		{
+			m_keepAlive = false;
+		}
+	}
+	if (m_encoding != Chunked && hasLength)
+	{
+		m_encoding = Length;
+		m_complete = m_remaining == 0;
+	}
+	if (m_complete && !m_keepAlive)
+	{
+		close();
+	}
+	return m_status;
+}
+
+/**
+ * Read more data from the connection into the buffer, once the
+ * buffered data has been used
+ *
+ * @return bool	False if the connection has been closed
+ */
+bool HttpStream::fill()
+{
+	if (m_pos < m_end)
+	{
+		return true;
+	}
+	m_pos = m_end = 0;
+	if (m_socket == -1)
+	{
+		return false;
+	}
+	ssize_t n;
+	do {
+		n = recv(m_socket, m_buffer, HTTP_STREAM_BUFFER, 0);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0)
+	{
+		close();
+		return false;
+	}
+	m_end = n;
+	return true;
+}
+
+/**
+ * Read a line of the headers or a chunk size, without the CRLF
+ *
+ * @param line	The line read
+ * @return bool	False if the connection closed before the end of the line
+ */
+bool HttpStream::readLine(string& line)
+{
+	line.clear();
+	while (fill())
+	{
+		char *start = m_buffer + m_pos;
+		char *nl = (char *)memchr(start, '\n', m_end - m_pos);
+		if (nl)
+		{
+			line.append(start, nl - start);
+			m_pos += (nl - start) + 1;
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+			return true;
+		}
+		line.append(start, m_end - m_pos);
+		m_pos = m_end;
+	}
+	return false;
+}
+
+/**
+ * Read the size of the next chunk
+ *
+ * @return bool	False at the end of the content
+ */
+bool HttpStream::nextChunk()
+{
+	string line;
+	if (!readLine(line) || line.empty())
+	{
+		return false;
+	}
+	m_remaining = strtoul(line.c_str(), NULL, 16);
+	if (m_remaining == 0)
+	{
+		// Skip any trailers up to the final empty line
+		while (readLine(line) && !line.empty())
+			;
+		m_complete = true;
+		if (!m_keepAlive)
+		{
+			close();
+		}
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Make more of the content available to the istream, the data is
+ * used directly from the buffer the socket is read into.
+ */
+int HttpStream::underflow()
+{
+	if (m_complete)
+	{
+		return traits_type::eof();
+	}
+	if (m_encoding == Chunked && m_remaining == 0)
+	{
+		string crlf;
+		// Chunks after the first follow the CRLF that ends the last
+		if (m_chunks && !readLine(crlf))
+		{
+			return traits_type::eof();
+		}
+		m_chunks = true;
+		if (!nextChunk())
+		{
+			return traits_type::eof();
+		}
+	}
+	if (!fill())
+	{
+		if (m_encoding == Close)
+		{
+			m_complete = true;
+		}
+		return traits_type::eof();
+	}
+	size_t n = m_end - m_pos;
+	if (m_encoding != Close && n > m_remaining)
+	{
+		n = m_remaining;
+	}
+	setg(m_buffer + m_pos, m_buffer + m_pos, m_buffer + m_pos + n);
+	m_pos += n;
+	if (m_encoding != Close)
+	{
+		m_remaining -= n;
+		if (m_encoding == Length && m_remaining == 0)
+		{
+			m_complete = true;
+			if (!m_keepAlive)
+			{
+				close();
+			}
+		}
+	}
+	return traits_type::to_int_type(*gptr());
+}
@@ -13,6 +13,7 @@
 #include <vector>
 #include <sstream>
 #include <unordered_set>
+#include <string_interner.h>
 #include <management_client.h>
 
 /**
@@ -41,6 +42,20 @@ public:
 		return ( x.m_serviceName==m_serviceName && x.m_pluginName==m_pluginName && x.m_assetName==m_assetName && x.m_eventName==m_eventName);
 	}
 
+	/**
+	 * Combine the hashes of the fields rather than hashing a
+	 * concatenated copy of them
+	 */
+	size_t hash() const
+	{
+		std::hash<std::string> hasher;
+		size_t h = hasher(m_serviceName);
+		h ^= hasher(m_pluginName) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= hasher(m_assetName) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= hasher(m_eventName) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+
 	AssetTrackingTuple(const std::string& service, const std::string& plugin, 
 								 const std::string& asset, const std::string& event) :
 									m_serviceName(service), m_pluginName(plugin), 
@@ -61,7 +76,7 @@ namespace std
     {
         size_t operator()(const AssetTrackingTuple& t) const
         {
-            return (std::hash<std::string>()(t.m_serviceName + t.m_pluginName + t.m_assetName + t.m_eventName));
+            return t.hash();
         }
     };
 
@@ -70,11 +85,44 @@ namespace std
     {
         size_t operator()(AssetTrackingTuple* t) const
         {
-            return (std::hash<std::string>()(t->m_serviceName + t->m_pluginName + t->m_assetName + t->m_eventName));
+            return t->hash();
         }
     };
 }
 
+/**
+ * The names of an asset tracking tuple as held in the cache of the
+ * asset tracker, interned so that the tuples compare as integers
+ */
+struct AssetTrackingKey {
+	InternedName	service;
+	InternedName	plugin;
+	InternedName	asset;
+	InternedName	event;
+
+	bool operator==(const AssetTrackingKey& x) const
+	{
+		return x.asset == asset && x.plugin == plugin && x.event == event && x.service == service;
+	}
+};
+
+namespace std
+{
+	template <>
+	struct hash<AssetTrackingKey>
+	{
+		size_t operator()(const AssetTrackingKey& k) const
+		{
+			hash<InternedName> hasher;
+			size_t h = hasher(k.service);
+			h ^= hasher(k.plugin) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= hasher(k.asset) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= hasher(k.event) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+}
+
 class ManagementClient;
 
 /**
@@ -90,6 +138,8 @@ public:
 	static AssetTracker *getAssetTracker();
 	void	populateAssetTrackingCache(std::string plugin, std::string event);
 	bool	checkAssetTrackingCache(AssetTrackingTuple& tuple);
+	bool	checkAssetTrackingCache(const InternedName& plugin, const InternedName& asset,
+					const InternedName& event);
 	void	addAssetTrackingTuple(AssetTrackingTuple& tuple);
 	void	addAssetTrackingTuple(std::string plugin, std::string asset, std::string event);
 
@@ -97,7 +147,8 @@ private:
 	static AssetTracker	*instance;
 	ManagementClient	*m_mgtClient;
 	std::string		m_service;
-	std::unordered_set<AssetTrackingTuple*, std::hash<AssetTrackingTuple*>, AssetTrackingTuplePtrEqual>	assetTrackerTuplesCache;
+	InternedName		m_serviceName;
+	std::unordered_set<AssetTrackingKey>	assetTrackerTuplesCache;
 };
 
 #endif
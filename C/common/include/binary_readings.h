@@ -0,0 +1,157 @@
+#ifndef _BINARY_READINGS_H
+#define _BINARY_READINGS_H
+/*
+ * FogLAMP binary readings batch format.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Content type used on the /storage/reading append call to send a
+ * block of readings in the binary batch format rather than JSON.
+ */
+#define READINGS_BINARY_CONTENT_TYPE	"application/vnd.foglamp.readings"
+
+#define READINGS_BINARY_MAGIC		"FLRB"
+#define READINGS_BINARY_VERSION		1
+#define READINGS_BINARY_KEY_LEN		36	// Length of a read_key UUID
+
+/*
+ * The binary batch format. All integers are in host byte order, the
+ * format is only used between services on the same machine.
+ *
+ *	Header
+ *		char[4]		magic "FLRB"
+ *		uint16		version
+ *		uint16		flags, reserved
+ *		uint32		number of readings
+ *		uint32		number of asset codes
+ *		uint32		number of datapoint names
+ *		uint32		number of datapoints in all readings
+ *	Dictionaries, asset codes followed by datapoint names
+ *		uint16		length
+ *		char[length]	string
+ *	Reading columns, one entry per reading in each column
+ *		uint32		asset code index
+ *		int64		user_ts, microseconds since the epoch, UTC
+ *		int64		ts, microseconds since the epoch, UTC
+ *		char[36]	read_key, all zero if there is no read_key
+ *		uint16		number of datapoints in the reading
+ *	Datapoint columns, one entry per datapoint in each column
+ *		uint32		datapoint name index
+ *		uint8		value type, one of READINGS_BINARY_T_*
+ *	Value columns, the values of each type in datapoint order
+ *		int64[]		integer values
+ *		double[]	floating point values
+ *		variable	string and JSON values as uint32
+ *				length followed by the data
+ */
+#define READINGS_BINARY_T_INTEGER	0
+#define READINGS_BINARY_T_FLOAT		1
+#define READINGS_BINARY_T_STRING	2
+#define READINGS_BINARY_T_JSON		3	// JSON text of arrays and nested values
+
+#define READINGS_BINARY_MAX_SHORT	65535	// Limit of the uint16 lengths and counts
+
+class Reading;
+
+/**
+ * Encode a block of readings in the binary batch format
+ */
+class BinaryReadingsWriter {
+	public:
+		static bool	encode(const std::vector<Reading *>& readings, std::string& out);
+};
+
+/**
+ * Decode a block of readings in the binary batch format.
+ *
+ * The reader indexes the batch once when it is constructed and then
+ * gives random access to the readings in it. Storage plugins that use
+ * it resolve it from the common library linked into the storage service.
+ *
+ * The data passed in must remain valid for the life of the reader.
+ */
+class BinaryReadingsReader {
+	public:
+		BinaryReadingsReader(const char *data, size_t length);
+		bool		isValid() const { return m_valid; };
+		const std::string&
+				getError() const { return m_error; };
+		unsigned int	getCount() const { return m_count; };
+
+		/**
+		 * Return the asset code of a reading
+		 */
+		const std::string&
+				getAssetCode(unsigned int i) const
+		{
+			return m_assets[column<uint32_t>(m_assetCol, i)];
+		};
+		/**
+		 * Return the user timestamp of a reading in microseconds
+		 */
+		int64_t		getUserTs(unsigned int i) const
+		{
+			return column<int64_t>(m_userTsCol, i);
+		};
+		/**
+		 * Return the system timestamp of a reading in microseconds
+		 */
+		int64_t		getTs(unsigned int i) const
+		{
+			return column<int64_t>(m_tsCol, i);
+		};
+		std::string	getReadKey(unsigned int i) const;
+		void		readingJSON(unsigned int i, std::string& out) const;
+		std::string	toJSON() const;
+		static void	formatTimestamp(int64_t usecs, char *buf);
+
+	private:
+		template <class T> T
+				column(size_t offset, unsigned int i) const
+		{
+			T value;
+			memcpy(&value, m_data + offset + i * sizeof(T), sizeof(T));
+			return value;
+		};
+
+		bool		available(size_t offset, size_t length);
+		bool		readStrings(size_t& offset, uint32_t count, std::vector<std::string>& strings);
+		bool		parse();
+		void		appendValue(unsigned int dp, std::string& out) const;
+		static void	appendString(std::string& out, const char *str, size_t len);
+		static void	appendString(std::string& out, const std::string& str)
+		{
+			appendString(out, str.c_str(), str.length());
+		};
+
+		const char			*m_data;
+		size_t				m_length;
+		uint32_t			m_count;
+		bool				m_valid;
+		std::string			m_error;
+		std::vector<std::string>	m_assets;
+		std::vector<std::string>	m_names;
+		std::vector<uint32_t>		m_dpStart;
+		std::vector<size_t>		m_valueOffset;
+		size_t				m_assetCol;
+		size_t				m_userTsCol;
+		size_t				m_tsCol;
+		size_t				m_keyCol;
+		size_t				m_dpCountCol;
+		size_t				m_dpNameCol;
+		size_t				m_dpTypeCol;
+		size_t				m_intCol;
+		size_t				m_floatCol;
+};
+
+#endif
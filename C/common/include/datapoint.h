@@ -15,6 +15,8 @@
 #include <cfloat>
 #include <vector>
 #include <logger.h>
+#include <reading_arena.h>
+#include <string_interner.h>
 
 class Datapoint;
 /**
@@ -68,71 +70,29 @@ class DatapointValue {
 		}
 
 		/**
-		 * Copy constructor
+		 * Construct with a string, taking the string contents
 		 */
-		DatapointValue(const DatapointValue& obj)
+		DatapointValue(std::string&& value)
 		{
-			m_type = obj.m_type;
-			switch (m_type)
-			{
-			case T_STRING:
-				m_value.str = new std::string(*(obj.m_value.str));
-				break;
-			case T_FLOAT_ARRAY:
-				m_value.a = new std::vector<double>(*(obj.m_value.a));
-				break;
-			case T_DP_DICT:
-			case T_DP_LIST:
-				m_value.dpa = obj.m_value.dpa; // TODO: need to fix this, need to do nested copying in newly allocated memory
-				break;
-			default:
-				m_value = obj.m_value;
-				break;
-			}
-		}
+			m_value.str = new std::string(std::move(value));
+			m_type = T_STRING;
+		};
+
+		DatapointValue(const DatapointValue& obj);
 
 		/**
-		 * Assignment Operator
+		 * Move constructor, the value, including any nested
+		 * datapoints, is taken from obj which is left holding
+		 * the integer 0
 		 */
-		DatapointValue& operator=(const DatapointValue& rhs)
+		DatapointValue(DatapointValue&& obj) noexcept : m_value(obj.m_value), m_type(obj.m_type)
 		{
-			if (m_type == T_STRING)
-			{
-				// Remove previous value
-				delete m_value.str;
-			}
-			if (m_type == T_FLOAT_ARRAY)
-			{
-				// Remove previous value
-				delete m_value.a;
-			}
-			if (m_type == T_DP_DICT || m_type == T_DP_LIST)
-			{
-				// Remove previous value
-				delete m_value.dpa;
-			}
-
-			m_type = rhs.m_type;
-
-			switch (m_type)
-			{
-			case T_STRING:
-				m_value.str = new std::string(*(rhs.m_value.str));
-				break;
-			case T_FLOAT_ARRAY:
-				m_value.a = new std::vector<double>(*(rhs.m_value.a));
-				break;
-			case T_DP_DICT:
-			case T_DP_LIST:
-				m_value.dpa = new std::vector<Datapoint*>(*(rhs.m_value.dpa));
-				break;
-			default:
-				m_value = rhs.m_value;
-				break;
-			}
-
-			return *this;
+			obj.m_value.i = 0;
+			obj.m_type = T_INTEGER;
 		}
+
+		DatapointValue& operator=(const DatapointValue& rhs);
+		DatapointValue& operator=(DatapointValue&& rhs) noexcept;
 		
 		/**
 		 * Destructor
@@ -148,6 +108,7 @@ class DatapointValue {
 		 */
 		void setValue(long value)
 		{
+			deleteNestedDPV();
 			m_value.i = value;
 			m_type = T_INTEGER;
 		}
@@ -159,6 +120,7 @@ class DatapointValue {
 		 */
 		void setValue(double value)
 		{
+			deleteNestedDPV();
 			m_value.f = value;
 			m_type = T_FLOAT;
 		}
@@ -168,6 +130,11 @@ class DatapointValue {
 		 */
 		std::string	toString() const;
 
+		/**
+		 * Return the string value without quotes, only valid for T_STRING
+		 */
+		const std::string& toStringValue() const { return *m_value.str; };
+
 		/**
 		 * Return long value
 		 */
@@ -216,6 +183,8 @@ class DatapointValue {
 		}
 		
 	private:
+		void		copy(const DatapointValue& obj);
+
 		union data_t {
 			std::string*		str;
 			long			i;
@@ -235,13 +204,31 @@ class Datapoint {
 		/**
 		 * Construct with a data point value
 		 */
-		Datapoint(const std::string& name, DatapointValue& value) : m_name(name), m_value(value)
+		Datapoint(const std::string& name, DatapointValue& value) :
+			m_name(name), m_value(value)
 		{
 		}
 
-		~Datapoint()
+		/**
+		 * Construct with a data point value that is moved
+		 * into the datapoint rather than copied
+		 */
+		Datapoint(const std::string& name, DatapointValue&& value) :
+			m_name(name), m_value(std::move(value))
 		{
-			m_value.deleteNestedDPV();
+		}
+
+		/**
+		 * Allocate from the thread's ReadingArena if one is in scope,
+		 * changing these changes the plugin interface version
+		 */
+		static void	*operator new(size_t size)
+		{
+			return ReadingArena::allocateObject(size);
+		}
+		static void	operator delete(void *datapoint)
+		{
+			ReadingArena::releaseObject(datapoint);
 		}
 		/**
 		 * Return asset reading data point as a JSON
@@ -250,20 +237,26 @@ class Datapoint {
 		 */
 		std::string	toJSONProperty()
 		{
-			std::string rval = "\"" + m_name + "\" : ";
+			std::string rval = "\"" + getName() + "\" : ";
 			rval += m_value.toString();
 
 			return rval;
 		}
 
 		// Return get Datapoint name
-		const std::string getName() const
+		const std::string& getName() const
+		{
+			return m_name.str();
+		}
+
+		// Return the interned id of the Datapoint name, may be INTERNER_NOT_INTERNED
+		unsigned int getNameId() const
 		{
-			return m_name;
+			return m_name.id();
 		}
 
 		// Return Datapoint value
-		const DatapointValue getData() const
+		const DatapointValue& getData() const
 		{
 			return m_value;
 		}
@@ -273,7 +266,7 @@ class Datapoint {
 			return m_value;
 		}
 	private:
-		const std::string	m_name;
+		const InternedName	m_name;
 		DatapointValue		m_value;
 };
 #endif
@@ -0,0 +1,79 @@
+#ifndef _HTTP_STREAM_H
+#define _HTTP_STREAM_H
+/*
+ * FogLAMP streamed HTTP response.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <istream>
+#include <streambuf>
+
+#define HTTP_STREAM_BUFFER	65536	// Bytes read from the socket at a time
+#define HTTP_STREAM_TIMEOUT	60	// Default seconds to wait for data from the server
+
+/**
+ * An HTTP request whose response content is read from the connection
+ * as it is consumed, rather than once the whole response has arrived.
+ *
+ * Content sent with a Content-Length, with chunked transfer encoding
+ * or terminated by closing the connection is supported. The connection
+ * is kept open once a response has been read completely and is used
+ * for the next request, unless the server closes it. If a Unix domain
+ * socket is given the connection is made on it in preference to the
+ * TCP port.
+ *
+ * A read or write that waits longer than the timeout fails, the
+ * response is then incomplete.
+ */
+class HttpStream : private std::streambuf {
+	public:
+		HttpStream(const std::string& hostname, unsigned short port,
+			   const std::string& socketPath = "",
+			   unsigned int timeout = HTTP_STREAM_TIMEOUT);
+		~HttpStream();
+		const std::string&	request(const std::string& method, const std::string& url);
+		std::istream&		content() { return m_content; };
+		bool			complete() const { return m_complete; };
+		/**
+		 * Return if the connection may be used for another request
+		 */
+		bool			reusable() const { return m_socket != -1 && m_complete; };
+
+	protected:
+		int			underflow();
+
+	private:
+		HttpStream(const HttpStream&);
+		HttpStream&		operator=(const HttpStream&);
+		void			close();
+		void			connect();
+		bool			send(const std::string& data);
+		bool			fill();
+		bool			readLine(std::string& line);
+		bool			nextChunk();
+
+		enum Encoding { Length, Chunked, Close };
+
+		const std::string	m_hostname;
+		const unsigned short	m_port;
+		const std::string	m_socketPath;
+		const unsigned int	m_timeout;
+		int			m_socket;
+		bool			m_keepAlive;	// The server will keep the connection open
+		std::string		m_status;
+		std::istream		m_content;
+		Encoding		m_encoding;
+		unsigned long		m_remaining;	// Bytes left in the content or chunk
+		bool			m_complete;
+		bool			m_chunks;	// A chunk has been read
+		char			m_buffer[HTTP_STREAM_BUFFER];
+		size_t			m_pos;		// Next unread byte in m_buffer
+		size_t			m_end;		// End of the data in m_buffer
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _LATENCY_HISTOGRAM_H
+#define _LATENCY_HISTOGRAM_H
+/*
+ * FogLAMP latency histogram.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <json_provider.h>
+#include <string>
+
+#define LATENCY_BUCKETS	14	// Number of buckets, the last is unbounded
+
+/**
+ * A histogram of the time taken by a repeated operation, such as the
+ * requests to one endpoint of a service.
+ *
+ * Times are counted in fixed buckets from 100 microseconds to 1 second,
+ * along with the count, total and maximum. The histogram is not thread
+ * safe, callers must serialise access to it.
+ */
+class LatencyHistogram : public JSONProvider {
+	public:
+		LatencyHistogram();
+		void		record(unsigned long usecs);
+		unsigned long	getCount() const { return m_count; };
+		unsigned long	getMax() const { return m_max; };
+		unsigned long	getBucket(unsigned int bucket) const { return m_buckets[bucket]; };
+		static unsigned long
+				getBucketLimit(unsigned int bucket);
+		void		asJSON(std::string& json) const;
+
+	private:
+		unsigned long	m_buckets[LATENCY_BUCKETS];
+		unsigned long	m_count;
+		unsigned long	m_max;
+		double		m_total;
+};
+
+#endif
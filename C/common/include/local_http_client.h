@@ -0,0 +1,35 @@
+#ifndef _LOCAL_HTTP_CLIENT_H
+#define _LOCAL_HTTP_CLIENT_H
+/*
+ * FogLAMP HTTP client on a Unix domain socket.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <client_http.hpp>
+#include <string>
+
+/**
+ * An HTTP client that connects to a server on the same host through
+ * a Unix domain socket rather than the TCP port.
+ *
+ * If a connection can not be made on the socket the client falls
+ * back to the TCP host and port.
+ */
+class LocalHttpClient : public SimpleWeb::Client<SimpleWeb::HTTP> {
+	public:
+		LocalHttpClient(const std::string& socketPath, const std::string& hostPort);
+
+	protected:
+		std::shared_ptr<Connection>	create_connection() noexcept override;
+
+	private:
+		const std::string		m_socketPath;
+};
+
+int	connectLocalSocket(const std::string& path);
+
+#endif
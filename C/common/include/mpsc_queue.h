@@ -0,0 +1,136 @@
+#ifndef _MPSC_QUEUE_H
+#define _MPSC_QUEUE_H
+/*
+ * FogLAMP bounded multi-producer, single-consumer queue.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A bounded, lock-free queue that allows any number of threads to
+ * push items and a single thread to pop them.
+ *
+ * The queue is a ring of cells, each cell carries a sequence number
+ * that tells producers and the consumer whether the cell is free to
+ * be written or ready to be read. Producers reserve a cell with a
+ * single compare and swap on the enqueue position, the consumer
+ * needs no atomic read-modify-write operations at all.
+ *
+ * The capacity is rounded up to the next power of two.
+ */
+template <class T> class MPSCQueue {
+	public:
+		MPSCQueue(size_t capacity) : m_enqueuePos(0), m_dequeuePos(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+			m_mask = size - 1;
+			m_cells = new Cell[size];
+			for (size_t i = 0; i < size; i++)
+			{
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		};
+		~MPSCQueue()
+		{
+			delete[] m_cells;
+		};
+
+		/**
+		 * Add an item to the queue. May be called from any thread.
+		 *
+		 * @param item	The item to add
+		 * @return	False if the queue is full
+		 */
+		bool		push(const T& item)
+		{
+			Cell	*cell;
+			size_t	pos = m_enqueuePos.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				size_t seq = cell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if (diff == 0)
+				{
+					if (m_enqueuePos.compare_exchange_weak(pos, pos + 1,
+							std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			cell->data = item;
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		};
+
+		/**
+		 * Remove the item at the head of the queue. Must only
+		 * be called from the single consumer thread.
+		 *
+		 * @param item	Set to the item removed from the queue
+		 * @return	False if the queue is empty
+		 */
+		bool		pop(T& item)
+		{
+			size_t	pos = m_dequeuePos.load(std::memory_order_relaxed);
+			Cell	*cell = &m_cells[pos & m_mask];
+			size_t	seq = cell->sequence.load(std::memory_order_acquire);
+			if ((intptr_t)seq - (intptr_t)(pos + 1) < 0)
+			{
+				return false;
+			}
+			item = cell->data;
+			cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+			m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+			return true;
+		};
+
+		/**
+		 * Return the approximate number of items in the queue.
+		 * The value is exact only when no push or pop is in progress.
+		 */
+		size_t		size() const
+		{
+			size_t head = m_dequeuePos.load(std::memory_order_relaxed);
+			size_t tail = m_enqueuePos.load(std::memory_order_relaxed);
+			return tail > head ? tail - head : 0;
+		};
+		bool		empty() const { return size() == 0; };
+		size_t		capacity() const { return m_mask + 1; };
+
+	private:
+		MPSCQueue(const MPSCQueue&);
+		MPSCQueue&	operator=(const MPSCQueue&);
+
+		struct Cell {
+			std::atomic<size_t>	sequence;
+			T			data;
+		};
+
+		// Keep producer and consumer positions on separate cache lines
+		Cell				*m_cells;
+		size_t				m_mask;
+		char				m_pad0[64];
+		std::atomic<size_t>		m_enqueuePos;
+		char				m_pad1[64];
+		std::atomic<size_t>		m_dequeuePos;
+		char				m_pad2[64];
+};
+
+#endif
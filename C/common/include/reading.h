@@ -10,6 +10,7 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <datapoint.h>
+#include <string_interner.h>
 #include <string>
 #include <ctime>
 #include <vector>
@@ -34,21 +35,34 @@ class Reading {
 		Reading(const std::string& asset, std::vector<Datapoint *> values);
 		Reading(const std::string& asset, std::vector<Datapoint *> values, const std::string& ts);
 		Reading(const Reading& orig);
+		Reading(Reading&& orig) noexcept;
 
 		~Reading();
+		// Allocate from the thread's ReadingArena if one is in scope, changing
+		// these changes the plugin interface, see PLUGIN_READING_INTERFACE_MAJOR
+		static void			*operator new(size_t size) { return ReadingArena::allocateObject(size); };
+		static void			operator delete(void *reading) { ReadingArena::releaseObject(reading); };
 		void				addDatapoint(Datapoint *value);
 		Datapoint			*removeDatapoint(const std::string& name);
 		std::string			toJSON() const;
 		// Return AssetName
-		const std::string&              getAssetName() const { return m_asset; };
+		const std::string&              getAssetName() const { return m_asset.str(); };
+		// Return the interned id of the AssetName, readings of the same asset have the same id
+		// unless it is INTERNER_NOT_INTERNED
+		unsigned int			getAssetId() const { return m_asset.id(); };
+		// Return the AssetName as held by the reading, for use as a key
+		const InternedName&		getInternedAssetName() const { return m_asset; };
 		// Set AssetName
-		void				setAssetName(std::string assetName) { m_asset = assetName; };
+		void				setAssetName(const std::string& assetName)
+						{
+							m_asset = InternedName(assetName);
+						};
 		unsigned int			getDatapointCount() { return m_values.size(); };
 		void				removeAllDatapoints();
 		// Return UUID
 		const std::string&              getUuid() const { return m_uuid; };
 		// Return Reading datapoints
-		const std::vector<Datapoint *>	getReadingData() const { return m_values; };
+		const std::vector<Datapoint *>&	getReadingData() const { return m_values; };
 		// Return refrerence to Reading datapoints
 		std::vector<Datapoint *>&	getReadingData() { return m_values; };
 		unsigned long			getId() const { return m_id; };
@@ -76,9 +90,10 @@ class Reading {
 		Reading() {};
 		Reading&			operator=(Reading const&);
 		void				stringToTimestamp(const std::string& timestamp, struct timeval *ts);
+		static std::string		formatDateTime(const struct timeval& tv, readingTimeFormat dateFormat, bool addMS);
 		unsigned long			m_id;
 		bool				m_has_id;
-		std::string			m_asset;
+		InternedName			m_asset;
 		struct timeval			m_timestamp;
 		struct timeval			m_userTimestamp;
 		std::vector<Datapoint *>	m_values;
@@ -0,0 +1,78 @@
+#ifndef _READING_ARENA_H
+#define _READING_ARENA_H
+/*
+ * FogLAMP reading arena allocator.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <atomic>
+#include <cstddef>
+
+#define READING_ARENA_BLOCK_SIZE	(256 * 1024)	// Default size of an arena block
+
+/**
+ * A bump allocator for Reading and Datapoint objects.
+ *
+ * Whilst a ReadingArena::Scope is active on a thread every Reading and
+ * Datapoint created on that thread is carved from the current block of
+ * the arena rather than allocated individually from the heap. Deleting
+ * such an object runs its destructor as normal but does not free any
+ * memory, instead each block counts the objects that remain in it and
+ * the block is freed in one go once the last of them has been deleted.
+ *
+ * Objects may therefore be deleted on any thread and in any order, and
+ * may outlive the arena that created them. Objects created with no
+ * arena in scope are allocated from the heap.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+class ReadingArena {
+	public:
+		ReadingArena(size_t blockSize = READING_ARENA_BLOCK_SIZE);
+		~ReadingArena();
+		void			*allocate(size_t size);
+		unsigned long		getAllocations() const { return m_allocations; };
+		unsigned long		getBlocks() const { return m_blocks; };
+
+		static void		*allocateObject(size_t size);
+		static void		releaseObject(void *object);
+
+		/**
+		 * Make an arena the one used by the current thread
+		 * for the lifetime of the scope object
+		 */
+		class Scope {
+			public:
+				Scope(ReadingArena *arena);
+				~Scope();
+			private:
+				ReadingArena	*m_previous;
+		};
+
+	private:
+		/**
+		 * The header of a block, the objects follow it
+		 */
+		struct Block {
+			std::atomic<unsigned long>	refs;	// Objects in the block plus one for the arena
+			size_t				size;
+			size_t				used;
+		};
+		ReadingArena(const ReadingArena&);
+		ReadingArena&		operator=(const ReadingArena&);
+		void			newBlock();
+		static void		unreference(Block *block);
+
+		Block			*m_block;
+		size_t			m_blockSize;
+		unsigned long		m_allocations;
+		unsigned long		m_blocks;
+		static thread_local ReadingArena
+					*m_current;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _READING_RING_H
+#define _READING_RING_H
+/*
+ * FogLAMP shared memory readings ring.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#define READING_RING_SIZE	(4 * 1024 * 1024)	// Default bytes of batches the ring holds
+#define READING_RING_ACKS	256			// Batches that may await acknowledgement
+#define READING_RING_TIMEOUT	5000			// Milliseconds without a consumer heartbeat
+
+struct ReadingRingHeader;
+
+/**
+ * A single producer, single consumer ring of reading batches held in
+ * POSIX shared memory, used by a south service to pass readings to a
+ * storage service on the same host without copying them through a
+ * socket.
+ *
+ * The consumer, the storage service, creates the ring and the producer
+ * opens it by name. The producer writes batches and the consumer reads
+ * them in order, acknowledging each with the number of readings stored
+ * or -1 if it could not be stored.
+ *
+ * A batch is owned by the consumer once it has read it. If the consumer
+ * stops, the producer may reclaim the batches that have not been read
+ * and send them by other means, no batch is taken by both.
+ *
+ * Each end must only be used by one thread at a time.
+ */
+class ReadingRing {
+	public:
+		static ReadingRing	*create(const std::string& name, size_t size = READING_RING_SIZE);
+		static ReadingRing	*open(const std::string& name);
+		~ReadingRing();
+		const std::string&	getName() const { return m_name; };
+
+		// Producer
+		bool		write(const std::string& batch, unsigned int count, uint64_t& seq);
+		bool		completed(uint64_t seq, int64_t& result);
+		bool		consumerAlive() const;
+		void		reclaim(std::vector<std::pair<uint64_t, std::string>>& batches);
+		void		close();
+
+		// Consumer
+		bool		read(std::string& batch, unsigned int& count, uint64_t& seq,
+				     unsigned int timeout);
+		void		acknowledge(uint64_t seq, int64_t result);
+		bool		producerClosed() const;
+		bool		abandoned() const { return m_abandoned; };
+		void		heartbeat();
+		void		shutdown();
+		void		unlink();
+
+	private:
+		ReadingRing(const std::string& name, int fd, size_t mapped, bool owner);
+		ReadingRing(const ReadingRing&);
+		ReadingRing&	operator=(const ReadingRing&);
+		char		*data() const;
+		void		wake();
+
+		const std::string	m_name;
+		int			m_fd;
+		size_t			m_mapped;
+		ReadingRingHeader	*m_header;
+		bool			m_owner;	// The consumer that created the ring
+		uint64_t		m_seq;		// The last batch written or read
+		uint64_t		m_acked;	// The last batch the producer saw acknowledged
+		bool			m_abandoned;	// The producer reclaimed the batches
+};
+
+#endif
@@ -14,21 +14,27 @@
 #include <sstream>
 #include <iostream>
 #include <reading.h>
+#include <reading_arena.h>
 #include <rapidjson/document.h>
 #include <vector>
 
+class ReadingSetHandler;
+
 /**
  * Reading set class
  *
  * A specialised container for a set of readings that allows
- * creation from a JSON document.
+ * creation from a JSON document. The document is parsed as a
+ * stream of events and the readings are built as it is read,
+ * no DOM of the document is created.
  */
 class ReadingSet {
 	public:
 		ReadingSet();
 		ReadingSet(const std::string& json);
+		ReadingSet(std::istream& json);
 		ReadingSet(std::vector<Reading *>* readings);
-		~ReadingSet();
+		virtual ~ReadingSet();
 
 		unsigned long			getCount() const { return m_count; };
 		const Reading			*operator[] (const unsigned int idx) {
@@ -48,7 +54,13 @@ class ReadingSet {
 		void				removeAll();
 		void				clear();
 
+	protected:
+		void				load(const std::string& json);
+		void				load(std::istream& json);
+
 	private:
+		void				loaded(ReadingSetHandler& handler);
+
 		unsigned long			m_count;
 		ReadingSet(const ReadingSet&);
 		ReadingSet&			operator=(ReadingSet const &);
@@ -57,6 +69,20 @@ class ReadingSet {
 		unsigned long			m_last_id;    // Id of the last Reading
 };
 
+/**
+ * A reading set whose readings and datapoints are allocated from a
+ * ReadingArena rather than individually from the heap. The readings
+ * may be used, removed and deleted exactly as those of a ReadingSet.
+ */
+class ArenaReadingSet : public ReadingSet {
+	public:
+		ArenaReadingSet(const std::string& json);
+		ArenaReadingSet(std::istream& json);
+
+	private:
+		ReadingArena			m_arena;
+};
+
 /**
  * JSONReading class
  *
@@ -70,7 +96,10 @@ class JSONReading : public Reading {
 		unsigned long	getId() const { return m_id; };
 
 	private:
+		JSONReading();
                 void escapeCharacter(std::string& stringToEvaluate, std::string pattern);
+
+		friend class ReadingSetHandler;
 };
 
 class ReadingSetException : public std::exception
@@ -48,10 +48,18 @@ class ServiceRecord : public JSONProvider {
 					{
 						m_managementPort = managementPort;
 					}
+		void			setSocket(const std::string& socket)
+					{
+						m_socket = socket;
+					}
 		const std::string&	getAddress()
 					{
 						return m_address;
 					}
+		const std::string&	getSocket()
+					{
+						return m_socket;
+					}
 		unsigned short		getPort()
 					{
 						return m_port;
@@ -63,6 +71,7 @@ class ServiceRecord : public JSONProvider {
 							&& m_protocol.compare(b.m_protocol) == 0
 							&& m_address.compare(b.m_address) == 0
 							&& m_port == b.m_port
+							&& m_socket.compare(b.m_socket) == 0
 							&& m_managementPort == b.m_managementPort;
 					}
 	private:
@@ -72,6 +81,7 @@ class ServiceRecord : public JSONProvider {
 		std::string		m_address;
 		unsigned short		m_port;
 		unsigned short		m_managementPort;
+		std::string		m_socket;	// Unix domain socket of the service, if any
 };
 
 #endif
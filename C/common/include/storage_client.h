@@ -19,19 +19,51 @@
 #include <json_properties.h>
 #include <expression.h>
 #include <logger.h>
+#include <latency_histogram.h>
+#include <reading_ring.h>
+#include <http_stream.h>
+#include <json_provider.h>
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#define STORAGE_CLIENT_POOL_SIZE	4	// Default maximum connections to the storage service
+#define STORAGE_CLIENT_IDLE_TIMEOUT	60	// Default seconds before an idle connection is closed
 
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
+/**
+ * The storage service does not support waiting for readings
+ */
+class ReadingWaitUnsupported : public std::runtime_error {
+	public:
+		ReadingWaitUnsupported() :
+			std::runtime_error("Wait for readings is not supported by the storage service") {};
+};
+
 /**
  * Client for accessing the storage service
+ *
+ * Requests from all the threads of a process share a pool of persistent
+ * connections to the storage service, including those used to stream
+ * the readings of a fetch. The time taken by the requests to
+ * each endpoint is recorded in a LatencyHistogram, these and the use of
+ * the pool are returned by asJSON() so a service can report them.
+ *
+ * If the storage service listens on a Unix domain socket on this host
+ * the connections are made on the socket rather than the TCP port.
  */
-class StorageClient {
+class StorageClient : public JSONProvider {
 	public:
 		StorageClient(HttpClient *client);
-		StorageClient(const std::string& hostname, const unsigned short port);
+		StorageClient(const std::string& hostname, const unsigned short port,
+			      const std::string& socketPath = "");
 		~StorageClient();
 		ResultSet	*queryTable(const std::string& tablename, const Query& query);
 		ReadingSet	*queryTableToReadings(const std::string& tableName, const Query& query);
@@ -41,30 +73,80 @@ class StorageClient {
 		int		updateTable(const std::string& tableName, const InsertValues& values, const JSONProperties& json, const Where& where);
 		int		updateTable(const std::string& tableName, const ExpressionValues& values, const Where& where);
 		int		updateTable(const std::string& tableName, std::vector<std::pair<ExpressionValues *, Where *>>& updates);
+		void		queueUpdates(const std::string& tableName, std::vector<std::pair<ExpressionValues *, Where *>>& updates);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const ExpressionValues& expressoins, const Where& where);
 		int		deleteTable(const std::string& tableName, const Query& query);
 		bool		readingAppend(Reading& reading);
 		bool		readingAppend(const std::vector<Reading *> & readings);
+		bool		readingAppend(const std::string& payload);
+		bool		readingAppend(const std::string& payload, int& status);
+		static std::string
+				readingsPayload(const std::vector<Reading *> & readings);
 		ResultSet	*readingQuery(const Query& query);
 		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count);
+		bool		readingWait(const unsigned long after, const unsigned long timeout);
 		PurgeResult	readingPurgeByAge(unsigned long age, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeBySize(unsigned long size, unsigned long sent, bool purgeUnsent);
 		bool		registerAssetNotification(const std::string& assetName,
 							  const std::string& callbackUrl);
 		bool		unregisterAssetNotification(const std::string& assetName,
 							    const std::string& callbackUrl);
+		ReadingRing	*readingRing(const std::string& service);
+		void		setPoolSize(unsigned int size);
+		void		setIdleTimeout(unsigned int seconds);
+		std::string	latencyJSON() const;
+		void		asJSON(std::string& json) const;
 
 	private:
+		typedef std::shared_ptr<HttpClient::Response> Response;
+
 		void  		handleUnexpectedResponse(const char *operation,
 						const std::string& responseCode,
 						const std::string& payload);
-		HttpClient 	*getHttpClient(void);
+		Response	request(const std::string& method, const std::string& url,
+					const std::string& content = std::string(),
+					const SimpleWeb::CaseInsensitiveMultimap& header = SimpleWeb::CaseInsensitiveMultimap());
+		HttpClient	*acquireClient();
+		void		releaseClient(HttpClient *client);
+		HttpStream	*acquireStream();
+		void		releaseStream(HttpStream *stream);
+		void		waitForConnection(std::unique_lock<std::mutex>& lck, bool stream);
+		void		closeIdle();
+		std::string	nextSeqNum();
+		int		postReadings(const std::string& payload, const char *contentType);
+		void		sendQueuedUpdates();
 
 		std::ostringstream 			m_urlbase;
-		std::map<std::thread::id, HttpClient *> m_client_map;
-		std::map<std::thread::id, std::atomic<int>> m_seqnum_map;
+		std::string				m_hostname;
+		unsigned short				m_port;		// Zero if the client was given
+		std::string				m_socketPath;	// Empty unless on the same host
 		Logger					*m_logger;
 		pid_t		m_pid;
+		std::atomic<bool>			m_binaryAppend;
+		std::atomic<long long>			m_appendRetry;	// Steady clock ms before which appends are held back
+
+		// Pool of connections, the most recently used is at the back
+		std::deque<std::pair<HttpClient *, std::chrono::steady_clock::time_point>>
+							m_idle;
+		// Connections whose responses are streamed, in the same pool
+		std::deque<std::pair<HttpStream *, std::chrono::steady_clock::time_point>>
+							m_idleStreams;
+		unsigned int				m_clients;	// Connections idle or in use
+		unsigned int				m_poolSize;
+		std::chrono::seconds			m_idleTimeout;
+		mutable std::mutex			m_poolMutex;
+		std::condition_variable			m_poolCv;
+
+		std::map<std::string, LatencyHistogram>	m_latency;	// By endpoint
+		mutable std::mutex			m_latencyMutex;
+
+		// Updates queued by table, sent by the m_updater thread
+		std::map<std::string, std::vector<std::string>>
+							m_queuedUpdates;
+		std::thread				*m_updater;
+		bool					m_updaterRunning;
+		std::mutex				m_updateMutex;
+		std::condition_variable			m_updateCv;
 };
 
 #endif
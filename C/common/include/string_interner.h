@@ -0,0 +1,133 @@
+#ifndef _STRING_INTERNER_H
+#define _STRING_INTERNER_H
+/*
+ * FogLAMP string interner.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <climits>
+
+#define INTERNER_CHUNK_SIZE	1024	// Strings held in each chunk
+#define INTERNER_MAX_CHUNKS	64	// Limits the interner to 65536 strings
+#define INTERNER_SHARDS		16	// Independently locked parts of the string index
+#define INTERNER_NOT_INTERNED	UINT_MAX
+
+/**
+ * A process-wide table of the asset and datapoint names in use.
+ *
+ * Each distinct string is stored once and given a small integer id
+ * that never changes, so that readings can hold the id rather than
+ * a copy of the name and names can be compared as integers. The
+ * strings are never removed and remain at the same address for the
+ * life of the process, the number of strings is therefore limited.
+ * Once the limit is reached intern() returns INTERNER_NOT_INTERNED
+ * and the caller must keep its own copy of the string, InternedName
+ * does this.
+ *
+ * The index of strings is split into shards, each with its own lock,
+ * so that threads interning different names rarely wait for each
+ * other. Looking up the string for an id takes no lock.
+ */
+class StringInterner {
+	public:
+		static StringInterner	*getInstance();
+		unsigned int		intern(const std::string& str);
+		/**
+		 * Return the string with the given id, the id must
+		 * have been returned by intern()
+		 */
+		const std::string&	lookup(unsigned int id) const
+		{
+			return m_chunks[id / INTERNER_CHUNK_SIZE][id % INTERNER_CHUNK_SIZE];
+		};
+		unsigned int		size() const { return m_count; };
+
+	private:
+		/**
+		 * A part of the index from string to id
+		 */
+		struct Shard {
+			std::mutex					mutex;
+			std::unordered_map<std::string, unsigned int>	ids;
+		};
+
+		StringInterner();
+		~StringInterner();
+		StringInterner(const StringInterner&);
+		StringInterner&		operator=(const StringInterner&);
+		unsigned int		add(const std::string& str);
+
+		Shard				m_shards[INTERNER_SHARDS];
+		std::mutex			m_mutex;	// Guards the allocation of ids
+		std::string			*m_chunks[INTERNER_MAX_CHUNKS];
+		std::atomic<unsigned int>	m_count;
+		bool				m_full;
+};
+
+/**
+ * A name held as its interned id or, if the interner is full, as a
+ * copy of its own. Names that are both interned are equal if their
+ * ids are equal.
+ */
+class InternedName {
+	public:
+		InternedName() : m_id(0), m_name(NULL) {};
+		InternedName(const std::string& name);
+		InternedName(const InternedName& orig);
+		InternedName(InternedName&& orig) noexcept : m_id(orig.m_id), m_name(orig.m_name)
+		{
+			orig.m_name = NULL;
+		};
+		~InternedName() { delete m_name; };
+		InternedName&		operator=(const InternedName& rhs);
+		InternedName&		operator=(InternedName&& rhs) noexcept;
+
+		/**
+		 * Return the name
+		 */
+		const std::string&	str() const
+		{
+			return m_name ? *m_name : StringInterner::getInstance()->lookup(m_id);
+		};
+		/**
+		 * Return the interned id, INTERNER_NOT_INTERNED if the
+		 * name could not be interned
+		 */
+		unsigned int		id() const { return m_id; };
+
+		/**
+		 * Names are equal if their ids are equal, a name is only
+		 * not interned if the interner filled before it was seen
+		 */
+		bool			operator==(const InternedName& rhs) const
+		{
+			return m_id == rhs.m_id && (m_id != INTERNER_NOT_INTERNED || *m_name == *rhs.m_name);
+		};
+
+	private:
+		unsigned int		m_id;
+		std::string		*m_name;	// Set only if not interned
+};
+
+namespace std
+{
+	template <>
+	struct hash<InternedName>
+	{
+		size_t operator()(const InternedName& name) const
+		{
+			return name.id() == INTERNER_NOT_INTERNED ? hash<string>()(name.str())
+								   : hash<unsigned int>()(name.id());
+		}
+	};
+}
+
+#endif
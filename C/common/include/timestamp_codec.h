@@ -0,0 +1,35 @@
+#ifndef _TIMESTAMP_CODEC_H
+#define _TIMESTAMP_CODEC_H
+/*
+ * FogLAMP timestamp parsing and formatting.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sys/time.h>
+#include <cstddef>
+
+#define TIMESTAMP_BUFFER_LEN	40	// Enough for a formatted timestamp and a timezone suffix
+
+/**
+ * Conversion between struct timeval and the fixed format timestamps
+ * used in readings, YYYY-MM-DD HH:MM:SS.uuuuuu+HH:MM
+ *
+ * Unlike strptime/mktime and gmtime_r/strftime these do no timezone
+ * lookup, take no locks and allocate no memory. The date part of the
+ * most recent conversion is cached per thread, as the readings in a
+ * batch are almost always from the same day.
+ */
+class TimestampCodec {
+	public:
+		static bool	parse(const char *str, struct timeval *tv);
+		static size_t	format(const struct timeval& tv, char *buf,
+					char separator = ' ', bool addUsec = true);
+		static long	daysFromCivil(int year, unsigned int month, unsigned int day);
+		static void	civilFromDays(long days, int *year, unsigned int *month, unsigned int *day);
+};
+
+#endif
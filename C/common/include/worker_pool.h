@@ -0,0 +1,69 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+/*
+ * FogLAMP worker thread pool.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <json_provider.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+/**
+ * A fixed number of worker threads that run the tasks submitted to
+ * a bounded queue.
+ *
+ * When the queue is full submit() fails rather than blocking or
+ * growing the queue, the caller can then tell its own client to
+ * retry later. The pool records the depth of the queue and the time
+ * tasks spend waiting and running, these are reported by asJSON().
+ */
+class WorkerPool : public JSONProvider {
+	public:
+		WorkerPool(const std::string& name, unsigned int threads, unsigned int queueSize);
+		~WorkerPool();
+		bool			submit(const std::function<void()>& task);
+		void			stop();
+		const std::string&	getName() const { return m_name; };
+		unsigned int		getDepth() const;
+		void			asJSON(std::string& json) const;
+
+	private:
+		WorkerPool(const WorkerPool&);
+		WorkerPool&		operator=(const WorkerPool&);
+		void			worker();
+
+		class Task {
+			public:
+				Task(const std::function<void()>& run) : m_run(run),
+					m_queued(std::chrono::steady_clock::now()) {};
+				std::function<void()>			m_run;
+				std::chrono::steady_clock::time_point	m_queued;
+		};
+
+		const std::string		m_name;
+		const unsigned int		m_queueSize;
+		std::deque<Task>		m_queue;
+		std::vector<std::thread>	m_workers;
+		mutable std::mutex		m_mutex;
+		std::condition_variable		m_cv;
+		bool				m_running;
+		unsigned int			m_active;	// Tasks being run
+		unsigned int			m_maxDepth;
+		unsigned long			m_completed;
+		unsigned long			m_rejected;
+		double				m_waitTime;	// Seconds completed tasks spent queued
+		double				m_runTime;	// Seconds spent running completed tasks
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * FogLAMP latency histogram.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <latency_histogram.h>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+/**
+ * The upper limit, in microseconds, of each bucket but the last
+ */
+static const unsigned long bucketLimits[LATENCY_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000,
+	25000, 50000, 100000, 250000, 500000, 1000000
+};
+
+/**
+ * Create an empty histogram
+ */
+LatencyHistogram::LatencyHistogram() : m_count(0), m_max(0), m_total(0.0)
+{
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		m_buckets[i] = 0;
+	}
+}
+
+/**
+ * Return the upper limit of a bucket in microseconds, the last
+ * bucket has no limit and returns 0
+ *
+ * @param bucket	The bucket number
+ */
+unsigned long LatencyHistogram::getBucketLimit(unsigned int bucket)
+{
+	return bucket < LATENCY_BUCKETS - 1 ? bucketLimits[bucket] : 0;
+}
+
+/**
+ * Record the time taken by one operation
+ *
+ * @param usecs	The time taken in microseconds
+ */
+void LatencyHistogram::record(unsigned long usecs)
+{
+	unsigned int bucket = 0;
+	while (bucket < LATENCY_BUCKETS - 1 && usecs >= bucketLimits[bucket])
+	{
+		bucket++;
+	}
+	m_buckets[bucket]++;
+	m_count++;
+	m_total += usecs;
+	if (usecs > m_max)
+	{
+		m_max = usecs;
+	}
+}
+
+/**
+ * Return the histogram as a JSON object. Times are in milliseconds,
+ * each bucket is named by its upper limit.
+ */
+void LatencyHistogram::asJSON(string& json) const
+{
+ostringstream convert;
+
+	convert << fixed << setprecision(3);
+	convert << "{ \"count\" : " << m_count << ",";
+	convert << " \"average\" : " << (m_count ? m_total / m_count / 1000 : 0.0) << ",";
+	convert << " \"max\" : " << m_max / 1000.0 << ",";
+	convert << " \"buckets\" : {";
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		if (i)
+			convert << ",";
+		if (i < LATENCY_BUCKETS - 1)
+			convert << " \"<" << setprecision(1) << bucketLimits[i] / 1000.0 << "\" : ";
+		else
+			convert << " \">=" << setprecision(1) << bucketLimits[i - 1] / 1000.0 << "\" : ";
+		convert << m_buckets[i];
+	}
+	convert << " } }";
+	json = convert.str();
+}
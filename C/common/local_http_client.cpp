@@ -0,0 +1,81 @@
+/*
+ * FogLAMP HTTP client on a Unix domain socket.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <local_http_client.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+using namespace boost::asio;
+
+/**
+ * Connect to a Unix domain socket
+ *
+ * @param path	The path of the socket
+ * @return int	The connected socket or -1 if the connection failed
+ */
+int connectLocalSocket(const string& path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.length() >= sizeof(addr.sun_path))
+	{
+		return -1;
+	}
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+	{
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Create a client for a server on the same host
+ *
+ * @param socketPath	The Unix domain socket of the server
+ * @param hostPort	The host and port of the server, used if the
+ *			socket can not be connected to
+ */
+LocalHttpClient::LocalHttpClient(const string& socketPath, const string& hostPort) :
+	SimpleWeb::Client<SimpleWeb::HTTP>(hostPort), m_socketPath(socketPath)
+{
+}
+
+/**
+ * Create a connection to the server, connected on the Unix domain
+ * socket. The client connections are TCP sockets, the connected
+ * descriptor is assigned to one so that the requests are sent in the
+ * same way. If the socket can not be connected to an unconnected
+ * TCP socket is returned, which is connected to the TCP port.
+ */
+shared_ptr<LocalHttpClient::Connection> LocalHttpClient::create_connection() noexcept
+{
+	auto connection = make_shared<Connection>(handler_runner, config.timeout, *io_service);
+	int fd = connectLocalSocket(m_socketPath);
+	if (fd != -1)
+	{
+		boost::system::error_code ec;
+		connection->socket->assign(ip::tcp::v4(), fd, ec);
+		if (ec)
+		{
+			close(fd);
+		}
+	}
+	return connection;
+}
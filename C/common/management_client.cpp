@@ -215,6 +215,10 @@ string payload;
 			service.setPort(serviceRecord["service_port"].GetInt());
 			service.setProtocol(serviceRecord["protocol"].GetString());
 			service.setManagementPort(serviceRecord["management_port"].GetInt());
+			if (serviceRecord.HasMember("service_socket"))
+			{
+				service.setSocket(serviceRecord["service_socket"].GetString());
+			}
 			return true;
 		}
 	} catch (const SimpleWeb::system_error &e) {
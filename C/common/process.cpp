@@ -147,7 +147,8 @@ FogLampProcess::FogLampProcess(int argc, char** argv) :
 	}
 
 	if (!(m_storage = new StorageClient(storageInfo.getAddress(),
-					    storageInfo.getPort())))
+					    storageInfo.getPort(),
+					    storageInfo.getSocket())))
 	{
 		string errMsg("Unable to connect to storage service at ");
 		errMsg.append(storageInfo.getAddress());
@@ -8,6 +8,7 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <reading.h>
+#include <timestamp_codec.h>
 #include <ctime>
 #include <string>
 #include <sstream>
@@ -111,6 +112,18 @@ Reading::Reading(const Reading& orig) : m_asset(orig.m_asset),
 	}
 }
 
+/**
+ * Reading move constructor, the datapoints are taken from
+ * the original reading rather than copied
+ */
+Reading::Reading(Reading&& orig) noexcept : m_id(orig.m_id), m_has_id(orig.m_has_id),
+	m_asset(std::move(orig.m_asset)), m_timestamp(orig.m_timestamp),
+	m_userTimestamp(orig.m_userTimestamp),
+	m_values(std::move(orig.m_values)), m_uuid(std::move(orig.m_uuid))
+{
+	orig.m_values.clear();
+}
+
 /**
  * Destructor for Reading class
  */
@@ -173,19 +186,22 @@ string Reading::toJSON() const
 ostringstream convert;
 
 	convert << "{ \"asset_code\" : \"";
-	convert << m_asset;
+	convert << getAssetName();
 	convert << "\", \"read_key\" : \"";
 	convert << m_uuid;
 	convert << "\", \"user_ts\" : \"";
 
 	// Add date_time with microseconds + timezone UTC:
 	// YYYY-MM-DD HH24:MM:SS.MS+00:00
-	convert << getAssetDateUserTime(FMT_DEFAULT) << "+00:00";
+	char date_time[TIMESTAMP_BUFFER_LEN];
+	TimestampCodec::format(m_userTimestamp, date_time);
+	convert << date_time << "+00:00";
 	convert << "\", \"ts\" : \"";
 
 	// Add date_time with microseconds + timezone UTC:
 	// YYYY-MM-DD HH24:MM:SS.MS+00:00
-	convert << getAssetDateTime(FMT_DEFAULT) << "+00:00";
+	TimestampCodec::format(m_timestamp, date_time);
+	convert << date_time << "+00:00";
 
 	// Add values
 	convert << "\", \"reading\" : { ";
@@ -208,43 +224,7 @@ ostringstream convert;
  */
 const string Reading::getAssetDateTime(readingTimeFormat dateFormat, bool addMS) const
 {
-char date_time[DATE_TIME_BUFFER_LEN];
-char micro_s[10];
-ostringstream assetTime;
-
-        // Populate tm structure
-        struct tm timeinfo;
-	gmtime_r(&m_timestamp.tv_sec, &timeinfo);
-
-        /**
-         * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS+00:00
-         * this is same as Python3:
-         * datetime.datetime.now(tz=datetime.timezone.utc)
-         */
-
-        // Create datetime with seconds
-        std::strftime(date_time, sizeof(date_time),
-		      m_dateTypes[dateFormat].c_str(),
-                      &timeinfo);
-
-	if (dateFormat != FMT_ISO8601 && addMS)
-	{
-		// Add microseconds
-		snprintf(micro_s,
-			 sizeof(micro_s),
-			 ".%06lu",
-			 m_timestamp.tv_usec);
-
-		// Add date_time + microseconds
-		assetTime << date_time << micro_s;
-
-		return assetTime.str();
-	}
-	else
-	{
-		return string(date_time);
-	}
-
+	return formatDateTime(m_timestamp, dateFormat, addMS);
 }
 
 /**
@@ -254,43 +234,38 @@ ostringstream assetTime;
  */
 const string Reading::getAssetDateUserTime(readingTimeFormat dateFormat, bool addMS) const
 {
-char date_time[DATE_TIME_BUFFER_LEN];
-char micro_s[10];
-ostringstream assetTime;
-
-        // Populate tm structure with UTC time
-        struct tm timeinfo;
-	gmtime_r(&m_userTimestamp.tv_sec, &timeinfo);
-
-        /**
-         * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS+00:00
-         * this is same as Python3:
-         * datetime.datetime.now(tz=datetime.timezone.utc)
-         */
-
-        // Create datetime with seconds
-        std::strftime(date_time, sizeof(date_time),
-		      m_dateTypes[dateFormat].c_str(),
-                      &timeinfo);
+	return formatDateTime(m_userTimestamp, dateFormat, addMS);
+}
 
-	if (dateFormat != FMT_ISO8601 && addMS)
+/**
+ * Format a UTC time in one of the formats in m_dateTypes
+ *
+ * @param tv		The time to format
+ * @param dateFormat	The format to use
+ * @param addMS		Add the microseconds, ignored for FMT_ISO8601
+ * @return		The formatted datetime string
+ */
+string Reading::formatDateTime(const struct timeval& tv, readingTimeFormat dateFormat, bool addMS)
+{
+char	date_time[TIMESTAMP_BUFFER_LEN];
+
+	/**
+	 * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS
+	 * this is same as Python3:
+	 * datetime.datetime.now(tz=datetime.timezone.utc)
+	 */
+	switch (dateFormat)
 	{
-		// Add microseconds
-		snprintf(micro_s,
-			 sizeof(micro_s),
-			 ".%06lu",
-			 m_userTimestamp.tv_usec);
-
-		// Add date_time + microseconds
-		assetTime << date_time << micro_s;
-
-		return assetTime.str();
-	}
-	else
+	case FMT_STANDARD:
+		return string(date_time, TimestampCodec::format(tv, date_time, 'T', addMS));
+	case FMT_ISO8601:
 	{
-		return string(date_time);
+		size_t len = TimestampCodec::format(tv, date_time, ' ', false);
+		return string(date_time, len).append(" +0000");
+	}
+	default:
+		return string(date_time, TimestampCodec::format(tv, date_time, ' ', addMS));
 	}
-
 }
 
 /**
@@ -330,6 +305,12 @@ void Reading::setUserTimestamp(const string& timestamp)
  */
 void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
 {
+	if (TimestampCodec::parse(timestamp.c_str(), ts))
+	{
+		return;
+	}
+
+	// Not in the fixed format, fall back to strptime
 	struct tm tm;
 	memset(&tm, 0, sizeof(struct tm));
 	strptime(timestamp.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
@@ -0,0 +1,168 @@
+/*
+ * FogLAMP reading arena allocator.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_arena.h>
+#include <stdlib.h>
+#include <new>
+
+/*
+ * Every object is preceded by a header that holds the block it was
+ * allocated from, or NULL if it was allocated from the heap. The
+ * header also keeps the objects aligned on 16 byte boundaries.
+ */
+#define OBJECT_HEADER	16
+#define ALIGN(x)	(((x) + 15) & ~((size_t)15))
+
+thread_local ReadingArena *ReadingArena::m_current = NULL;
+
+/**
+ * Construct an arena, no memory is allocated until the
+ * first object is created
+ *
+ * @param blockSize	The size of the blocks to allocate
+ */
+ReadingArena::ReadingArena(size_t blockSize) : m_block(NULL),
+	m_blockSize(blockSize), m_allocations(0), m_blocks(0)
+{
+}
+
+/**
+ * Destroy the arena. The current block is freed now only if
+ * there are no objects left in it.
+ */
+ReadingArena::~ReadingArena()
+{
+	if (m_block)
+	{
+		unreference(m_block);
+	}
+}
+
+/**
+ * Allocate an object from the arena
+ *
+ * @param size	The size of the object
+ * @return void*	The memory for the object
+ */
+void *ReadingArena::allocate(size_t size)
+{
+	size_t length = OBJECT_HEADER + ALIGN(size);
+	if (length > m_blockSize / 4)
+	{
+		// Large objects are not worth placing in a block
+		void *object = malloc(OBJECT_HEADER + size);
+		if (!object)
+			throw std::bad_alloc();
+		*(Block **)object = NULL;
+		return (char *)object + OBJECT_HEADER;
+	}
+	if (!m_block || m_block->used + length > m_block->size)
+	{
+		newBlock();
+	}
+	char *object = (char *)m_block + m_block->used;
+	m_block->used += length;
+	m_block->refs.fetch_add(1);
+	*(Block **)object = m_block;
+	m_allocations++;
+	return object + OBJECT_HEADER;
+}
+
+/**
+ * Replace the current block with a new one
+ */
+void ReadingArena::newBlock()
+{
+	Block *block = (Block *)malloc(m_blockSize);
+	if (!block)
+		throw std::bad_alloc();
+	new (&block->refs) std::atomic<unsigned long>(1);
+	block->size = m_blockSize;
+	block->used = ALIGN(sizeof(Block));
+	if (m_block)
+	{
+		unreference(m_block);
+	}
+	m_block = block;
+	m_blocks++;
+}
+
+/**
+ * Remove a reference to a block, freeing it if it was the last
+ *
+ * @param block	The block to unreference
+ */
+void ReadingArena::unreference(Block *block)
+{
+	if (block->refs.fetch_sub(1) == 1)
+	{
+		free(block);
+	}
+}
+
+/**
+ * Allocate an object from the arena in scope on this thread or
+ * from the heap if there is none.
+ *
+ * @param size	The size of the object
+ * @return void*	The memory for the object
+ */
+void *ReadingArena::allocateObject(size_t size)
+{
+	if (m_current)
+	{
+		return m_current->allocate(size);
+	}
+	void *object = malloc(OBJECT_HEADER + size);
+	if (!object)
+		throw std::bad_alloc();
+	*(Block **)object = NULL;
+	return (char *)object + OBJECT_HEADER;
+}
+
+/**
+ * Release an object allocated by allocateObject
+ *
+ * @param object	The object to release
+ */
+void ReadingArena::releaseObject(void *object)
+{
+	if (!object)
+	{
+		return;
+	}
+	char *header = (char *)object - OBJECT_HEADER;
+	Block *block = *(Block **)header;
+	if (block)
+	{
+		unreference(block);
+	}
+	else
+	{
+		free(header);
+	}
+}
+
+/**
+ * Make the arena the one used by this thread
+ *
+ * @param arena	The arena to use
+ */
+ReadingArena::Scope::Scope(ReadingArena *arena) : m_previous(m_current)
+{
+	m_current = arena;
+}
+
+/**
+ * Restore the arena that was in use before the scope
+ */
+ReadingArena::Scope::~Scope()
+{
+	m_current = m_previous;
+}
@@ -0,0 +1,429 @@
+/*
+ * FogLAMP shared memory readings ring.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring.h>
+#include <atomic>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+using namespace std;
+
+#define RING_MAGIC		0x464c5252	// "FLRR"
+#define RING_VERSION		1
+#define RING_ALIGN		16		// Alignment of the records in the ring
+#define RING_PADDING		0xffffffff	// Length of a record that skips to the start
+#define RING_PRODUCER_CLOSED	0x01
+#define RING_CONSUMER_CLOSED	0x02
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The ring requires lock-free 64 bit atomics");
+
+/**
+ * The header of each batch in the ring, the batch follows it
+ */
+typedef struct {
+	uint32_t	length;		// Length of the batch or RING_PADDING
+	uint32_t	count;		// Readings in the batch
+	uint64_t	seq;		// Sequence number of the batch, from 1
+} RingRecord;
+
+/**
+ * The acknowledgement of a batch by the consumer
+ */
+typedef struct {
+	std::atomic<uint64_t>	seq;
+	std::atomic<int64_t>	result;		// Readings stored, or -1
+} RingAck;
+
+/**
+ * The control block at the start of the shared memory, followed by
+ * the ring itself. Positions are byte offsets that only increase, the
+ * offset in the ring is the position modulo the size.
+ */
+struct ReadingRingHeader {
+	std::atomic<uint32_t>	magic;
+	uint32_t		version;
+	uint64_t		size;		// Bytes in the ring
+	alignas(64) std::atomic<uint64_t>
+				head;		// Written by the producer
+	alignas(64) std::atomic<uint64_t>
+				tail;		// Advanced by the consumer or on reclaim
+	std::atomic<uint32_t>	writes;		// Futex the consumer waits on
+	std::atomic<uint32_t>	state;
+	std::atomic<uint64_t>	heartbeat;	// Consumer CLOCK_MONOTONIC milliseconds
+	RingAck			acks[READING_RING_ACKS];
+};
+
+static const size_t dataOffset = (sizeof(ReadingRingHeader) + 63) & ~(size_t)63;
+
+/**
+ * Return the space a batch takes in the ring
+ */
+static inline uint64_t recordSize(uint64_t length)
+{
+	return (sizeof(RingRecord) + length + RING_ALIGN - 1) & ~(uint64_t)(RING_ALIGN - 1);
+}
+
+/**
+ * Return the monotonic clock in milliseconds, which is the same for
+ * all processes on the host
+ */
+static uint64_t monotonicMillis()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Create a ring, called by the consumer. Any ring left with the same
+ * name by a previous consumer is replaced.
+ *
+ * @param name	The POSIX shared memory name, starting with /
+ * @param size	The bytes of batches the ring holds
+ * @return	The ring or NULL if it could not be created
+ */
+ReadingRing *ReadingRing::create(const string& name, size_t size)
+{
+	size = (size + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1);
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+	if (fd == -1 && errno == EEXIST)
+	{
+		shm_unlink(name.c_str());
+		fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+	}
+	if (fd == -1)
+	{
+		return NULL;
+	}
+	if (ftruncate(fd, dataOffset + size) != 0)
+	{
+		::close(fd);
+		shm_unlink(name.c_str());
+		return NULL;
+	}
+	ReadingRing *ring = new ReadingRing(name, fd, dataOffset + size, true);
+	if (!ring->m_header)
+	{
+		delete ring;
+		return NULL;
+	}
+	// The memory is zero filled, the magic is set once the rest is valid
+	ring->m_header->version = RING_VERSION;
+	ring->m_header->size = size;
+	ring->m_header->heartbeat.store(monotonicMillis());
+	ring->m_header->magic.store(RING_MAGIC, memory_order_release);
+	return ring;
+}
+
+/**
+ * Open a ring created by the consumer, called by the producer
+ *
+ * @param name	The POSIX shared memory name of the ring
+ * @return	The ring or NULL if it could not be opened
+ */
+ReadingRing *ReadingRing::open(const string& name)
+{
+	int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+	if (fd == -1)
+	{
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size <= dataOffset)
+	{
+		::close(fd);
+		return NULL;
+	}
+	ReadingRing *ring = new ReadingRing(name, fd, st.st_size, false);
+	if (!ring->m_header
+		|| ring->m_header->magic.load(memory_order_acquire) != RING_MAGIC
+		|| ring->m_header->version != RING_VERSION
+		|| ring->m_header->size != st.st_size - dataOffset)
+	{
+		delete ring;
+		return NULL;
+	}
+	return ring;
+}
+
+/**
+ * Map the shared memory of a ring
+ */
+ReadingRing::ReadingRing(const string& name, int fd, size_t mapped, bool owner) :
+	m_name(name), m_fd(fd), m_mapped(mapped), m_owner(owner),
+	m_seq(0), m_acked(0), m_abandoned(false)
+{
+	void *addr = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	m_header = addr == MAP_FAILED ? NULL : (ReadingRingHeader *)addr;
+}
+
+/**
+ * Unmap the ring, the consumer also removes its name
+ */
+ReadingRing::~ReadingRing()
+{
+	if (m_header)
+	{
+		munmap(m_header, m_mapped);
+	}
+	::close(m_fd);
+	unlink();
+}
+
+/**
+ * Return the start of the ring
+ */
+char *ReadingRing::data() const
+{
+	return (char *)m_header + dataOffset;
+}
+
+/**
+ * Wake the consumer if it is waiting for a batch
+ */
+void ReadingRing::wake()
+{
+	m_header->writes.fetch_add(1, memory_order_release);
+	syscall(SYS_futex, &m_header->writes, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/**
+ * Write a batch to the ring
+ *
+ * @param batch	The encoded batch of readings
+ * @param count	The number of readings in the batch
+ * @param seq	Set to the sequence number of the batch
+ * @return	False if there is no room for the batch or too many
+ *		batches await acknowledgement
+ */
+bool ReadingRing::write(const string& batch, unsigned int count, uint64_t& seq)
+{
+	uint64_t size = m_header->size;
+	uint64_t need = recordSize(batch.length());
+	if (need > size / 2 || batch.length() >= RING_PADDING)
+	{
+		return false;
+	}
+	if (m_seq + 1 > m_acked + READING_RING_ACKS)
+	{
+		return false;
+	}
+	uint64_t head = m_header->head.load(memory_order_relaxed);
+	uint64_t tail = m_header->tail.load(memory_order_acquire);
+	uint64_t offset = head % size;
+	// A batch is never split, skip the end of the ring if it does not fit
+	uint64_t skip = size - offset < need ? size - offset : 0;
+	if (head + skip + need - tail > size)
+	{
+		return false;
+	}
+	if (skip)
+	{
+		RingRecord *padding = (RingRecord *)(data() + offset);
+		padding->length = RING_PADDING;
+		padding->count = 0;
+		padding->seq = 0;
+		offset = 0;
+	}
+	RingRecord *record = (RingRecord *)(data() + offset);
+	record->length = batch.length();
+	record->count = count;
+	record->seq = ++m_seq;
+	memcpy(record + 1, batch.data(), batch.length());
+	m_header->head.store(head + skip + need, memory_order_release);
+	wake();
+	seq = m_seq;
+	return true;
+}
+
+/**
+ * Check if the consumer has acknowledged a batch. Batches must be
+ * checked in the order they were written.
+ *
+ * @param seq		The sequence number of the batch
+ * @param result	Set to the readings stored, or -1 if they were not
+ * @return		True if the batch has been acknowledged
+ */
+bool ReadingRing::completed(uint64_t seq, int64_t& result)
+{
+	RingAck& ack = m_header->acks[seq % READING_RING_ACKS];
+	if (ack.seq.load(memory_order_acquire) != seq)
+	{
+		return false;
+	}
+	result = ack.result.load(memory_order_relaxed);
+	if (seq > m_acked)
+	{
+		m_acked = seq;
+	}
+	return true;
+}
+
+/**
+ * Return if the consumer is still reading the ring
+ */
+bool ReadingRing::consumerAlive() const
+{
+	return (m_header->state.load() & RING_CONSUMER_CLOSED) == 0
+		&& monotonicMillis() - m_header->heartbeat.load() < READING_RING_TIMEOUT;
+}
+
+/**
+ * Take back the batches the consumer has not read, in order. The
+ * consumer will not read them, the producer should stop using the ring.
+ *
+ * @param batches	The sequence number and contents of each batch
+ */
+void ReadingRing::reclaim(vector<pair<uint64_t, string>>& batches)
+{
+	uint64_t size = m_header->size;
+	uint64_t head = m_header->head.load(memory_order_relaxed);
+	uint64_t tail = m_header->tail.load(memory_order_acquire);
+	do {
+		batches.clear();
+		for (uint64_t pos = tail; pos < head; )
+		{
+			uint64_t offset = pos % size;
+			RingRecord *record = (RingRecord *)(data() + offset);
+			if (record->length == RING_PADDING)
+			{
+				pos += size - offset;
+				continue;
+			}
+			batches.push_back(make_pair(record->seq, string((char *)(record + 1), record->length)));
+			pos += recordSize(record->length);
+		}
+		// Fails, and reloads tail, if the consumer read a batch meanwhile
+	} while (!m_header->tail.compare_exchange_strong(tail, head));
+}
+
+/**
+ * Tell the consumer that no more batches will be written
+ */
+void ReadingRing::close()
+{
+	m_header->state.fetch_or(RING_PRODUCER_CLOSED);
+	wake();
+}
+
+/**
+ * Read the next batch from the ring, waiting for one to be written
+ *
+ * @param batch		Set to the encoded batch of readings
+ * @param count		Set to the number of readings in the batch
+ * @param seq		Set to the sequence number of the batch
+ * @param timeout	Milliseconds to wait for a batch
+ * @return		False if there is no batch or the producer has
+ *			reclaimed the batches
+ */
+bool ReadingRing::read(string& batch, unsigned int& count, uint64_t& seq, unsigned int timeout)
+{
+	uint64_t size = m_header->size;
+	while (!m_abandoned)
+	{
+		uint32_t writes = m_header->writes.load(memory_order_acquire);
+		uint64_t tail = m_header->tail.load(memory_order_acquire);
+		uint64_t head = m_header->head.load(memory_order_acquire);
+		if (tail == head)
+		{
+			if (timeout == 0 || producerClosed())
+			{
+				return false;
+			}
+			struct timespec ts = { (time_t)(timeout / 1000), (long)(timeout % 1000) * 1000000 };
+			syscall(SYS_futex, &m_header->writes, FUTEX_WAIT, writes, &ts, NULL, 0);
+			timeout = 0;
+			continue;
+		}
+		uint64_t offset = tail % size;
+		RingRecord *record = (RingRecord *)(data() + offset);
+		uint64_t next;
+		if (record->length == RING_PADDING)
+		{
+			next = tail + size - offset;
+			if (!m_header->tail.compare_exchange_strong(tail, next))
+			{
+				m_abandoned = true;
+			}
+			continue;
+		}
+		// Copy the batch before the space is released to the producer
+		batch.assign((char *)(record + 1), record->length);
+		count = record->count;
+		seq = record->seq;
+		next = tail + recordSize(record->length);
+		if (!m_header->tail.compare_exchange_strong(tail, next))
+		{
+			// The producer reclaimed the batch
+			m_abandoned = true;
+			return false;
+		}
+		m_seq = seq;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Acknowledge a batch that has been read
+ *
+ * @param seq		The sequence number of the batch
+ * @param result	The readings stored, or -1 if they were not
+ */
+void ReadingRing::acknowledge(uint64_t seq, int64_t result)
+{
+	RingAck& ack = m_header->acks[seq % READING_RING_ACKS];
+	ack.result.store(result, memory_order_relaxed);
+	ack.seq.store(seq, memory_order_release);
+}
+
+/**
+ * Return if the producer has closed the ring
+ */
+bool ReadingRing::producerClosed() const
+{
+	return (m_header->state.load() & RING_PRODUCER_CLOSED) != 0;
+}
+
+/**
+ * Record that the consumer is still reading the ring, it must be
+ * called more often than READING_RING_TIMEOUT
+ */
+void ReadingRing::heartbeat()
+{
+	m_header->heartbeat.store(monotonicMillis());
+}
+
+/**
+ * Tell the producer that the consumer will read no more batches
+ */
+void ReadingRing::shutdown()
+{
+	m_header->state.fetch_or(RING_CONSUMER_CLOSED);
+}
+
+/**
+ * Remove the name of the ring, the memory is freed once both ends
+ * have unmapped it. Only the consumer that created the ring does so.
+ */
+void ReadingRing::unlink()
+{
+	if (m_owner)
+	{
+		shm_unlink(m_name.c_str());
+		m_owner = false;
+	}
+}
@@ -10,6 +10,8 @@
 #include <reading_set.h>
 #include <string>
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <timestamp_codec.h>
 #include <sstream>
 #include <iostream>
 #include <time.h>
@@ -61,27 +63,614 @@ ReadingSet::ReadingSet(vector<Reading *>* readings)
  */
 ReadingSet::ReadingSet(const std::string& json)
 {
-	unsigned long rows = 0;
-	Document doc;
-	doc.Parse(json.c_str());
-	if (doc.HasParseError())
+	load(json);
+}
+
+/**
+ * Construct a reading set from a stream of the JSON document
+ * returned from the FogLAMP storage service, for example the
+ * content of an HTTP response.
+ *
+ * @param json	The stream from which the JSON document is read
+ */
+ReadingSet::ReadingSet(std::istream& json)
+{
+	load(json);
+}
+
+/**
+ * Construct a reading set from a JSON document with the readings
+ * and their datapoints allocated from an arena.
+ *
+ * @param json	The JSON document (as string) with readings data
+ */
+ArenaReadingSet::ArenaReadingSet(const std::string& json) : ReadingSet()
+{
+	ReadingArena::Scope scope(&m_arena);
+	load(json);
+}
+
+/**
+ * Construct a reading set from a stream of a JSON document with
+ * the readings and their datapoints allocated from an arena.
+ *
+ * @param json	The stream from which the JSON document is read
+ */
+ArenaReadingSet::ArenaReadingSet(std::istream& json) : ReadingSet()
+{
+	ReadingArena::Scope scope(&m_arena);
+	load(json);
+}
+
+#define STREAM_CHUNK	65536	// Bytes read from the stream at a time
+
+/**
+ * A rapidjson stream that reads an istream in chunks, rather than a
+ * character at a time through the istream as rapidjson's
+ * IStreamWrapper does.
+ */
+class ChunkedStream {
+	public:
+		typedef char Ch;
+		ChunkedStream(std::streambuf *buf) : m_buf(buf), m_current(m_chunk),
+			m_end(m_chunk), m_count(0), m_eof(false)
+		{
+			fill();
+		};
+		Ch	Peek() const { return *m_current; };
+		Ch	Take()
+		{
+			Ch c = *m_current;
+			if (++m_current == m_end)
+			{
+				fill();
+			}
+			return c;
+		};
+		size_t	Tell() const { return m_count + (m_current - m_chunk); };
+		Ch	*PutBegin() { return 0; };
+		void	Put(Ch) {};
+		void	Flush() {};
+		size_t	PutEnd(Ch *) { return 0; };
+	private:
+		/**
+		 * Read the next chunk, at the end of the stream the
+		 * chunk is a single NUL character
+		 */
+		void	fill()
+		{
+			m_count += m_end - m_chunk;
+			std::streamsize n = m_eof ? 0 : m_buf->sgetn(m_chunk, STREAM_CHUNK);
+			if (n <= 0)
+			{
+				m_eof = true;
+				m_chunk[0] = 0;
+				n = 1;
+			}
+			m_current = m_chunk;
+			m_end = m_chunk + n;
+		};
+		std::streambuf	*m_buf;
+		char		m_chunk[STREAM_CHUNK];
+		char		*m_current;
+		char		*m_end;
+		size_t		m_count;
+		bool		m_eof;
+};
+
+/**
+ * A rapidjson SAX handler that builds the readings of the JSON
+ * document returned by a readings fetch, table query or notification
+ * as the document is parsed. The document is never held as a DOM.
+ *
+ * The readings built are the same as those built by JSONReading
+ * from the members of the "rows" or "readings" array.
+ */
+class ReadingSetHandler : public BaseReaderHandler<UTF8<>, ReadingSetHandler> {
+	public:
+		ReadingSetHandler() : m_count(0), m_hasCount(false), m_hasRows(false),
+			m_hasReadings(false), m_lastId(0), m_state(DOCUMENT), m_skipReturn(DOCUMENT),
+			m_skipDepth(0), m_topKey(K_OTHER), m_rowKey(K_OTHER), m_reading(NULL),
+			m_value(0L), m_invalidValue(0L)
+		{
+		};
+		~ReadingSetHandler()
+		{
+			delete m_reading;
+			for (auto reading : m_readings)
+			{
+				delete reading;
+			}
+		};
+
+		bool	StartObject();
+		bool	EndObject(SizeType);
+		bool	StartArray();
+		bool	EndArray(SizeType);
+		bool	Key(const char *str, SizeType length, bool);
+		bool	String(const char *str, SizeType length, bool);
+		bool	Int(int i) { return integer(i); };
+		bool	Uint(unsigned u) { return integer(u); };
+		bool	Int64(int64_t i) { return integer(i); };
+		bool	Uint64(uint64_t u) { return integer(u); };
+		bool	Double(double d);
+		// Null and Bool values
+		bool	Default();
+
+		const std::string&	getError() const { return m_error; };
+
+		std::vector<Reading *>	m_readings;
+		unsigned long		m_count;
+		bool			m_hasCount;
+		bool			m_hasRows;
+		bool			m_hasReadings;
+		unsigned long		m_lastId;
+
+	private:
+		enum State { DOCUMENT, TOP, TOP_VALUE, ROWS, ROW, ROW_VALUE, READING, READING_VALUE, SKIP, DONE };
+		enum Member { K_COUNT, K_ROWS, K_READINGS, K_ID, K_ASSET_CODE, K_READ_KEY,
+				K_USER_TS, K_TS, K_READING, K_VALUE, K_OTHER };
+
+		bool	integer(long value);
+		bool	skip(State returnTo);
+		bool	error(const std::string& message);
+		void	endRow();
+		void	setTimestamp(const char *str, SizeType length, struct timeval *tv);
+
+		State		m_state;
+		State		m_skipReturn;
+		int		m_skipDepth;
+		Member		m_topKey;
+		Member		m_rowKey;
+		std::string	m_error;
+		// The reading being built and what has been seen of it
+		JSONReading	*m_reading;
+		std::string	m_name;
+		bool		m_hasTs;
+		bool		m_hasValue;
+		DatapointValue	m_value;
+		// A "reading" that is not an object
+		enum { VALID, INVALID_STRING, INVALID_NUMBER, INVALID_OTHER }
+				m_invalid;
+		DatapointValue	m_invalidValue;
+		std::string	m_invalidString;
+};
+
+/**
+ * Skip over an object or array value that is not used
+ */
+bool ReadingSetHandler::skip(State returnTo)
+{
+	m_skipReturn = returnTo;
+	m_skipDepth = 1;
+	m_state = SKIP;
+	return true;
+}
+
+bool ReadingSetHandler::error(const string& message)
+{
+	m_error = message;
+	return false;
+}
+
+bool ReadingSetHandler::StartObject()
+{
+	switch (m_state)
+	{
+	case DOCUMENT:
+		m_state = TOP;
+		return true;
+	case TOP_VALUE:
+		if (m_topKey == K_ROWS || m_topKey == K_READINGS)
+			return error("Expected array of rows in result set");
+		return skip(TOP);
+	case ROWS:
+		m_reading = new JSONReading();
+		m_hasTs = false;
+		m_hasValue = false;
+		m_invalid = VALID;
+		m_state = ROW;
+		return true;
+	case ROW_VALUE:
+		if (m_rowKey == K_READING)
+		{
+			m_state = READING;
+			return true;
+		}
+		return skip(ROW);
+	case READING_VALUE:
+		return error("Cannot handle unsupported type of reading element '" + m_name + "'");
+	case SKIP:
+		m_skipDepth++;
+		return true;
+	case ROW:
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+bool ReadingSetHandler::EndObject(SizeType)
+{
+	switch (m_state)
+	{
+	case TOP:
+		m_state = DONE;
+		return true;
+	case ROW:
+		endRow();
+		m_state = ROWS;
+		return true;
+	case READING:
+		m_state = ROW;
+		return true;
+	case SKIP:
+		if (--m_skipDepth == 0)
+			m_state = m_skipReturn;
+		return true;
+	default:
+		return error("Unexpected end of object");
+	}
+}
+
+bool ReadingSetHandler::StartArray()
+{
+	switch (m_state)
+	{
+	case TOP_VALUE:
+		if (m_topKey == K_ROWS || m_topKey == K_READINGS)
+		{
+			if (m_topKey == K_ROWS)
+			{
+				// The rows are used in preference to the readings
+				for (auto reading : m_readings)
+				{
+					delete reading;
+				}
+				m_readings.clear();
+				m_hasRows = true;
+			}
+			else
+			{
+				m_hasReadings = true;
+			}
+			m_state = ROWS;
+			return true;
+		}
+		return skip(TOP);
+	case ROW_VALUE:
+		// A reading that is not an object is invalid
+		if (m_rowKey == K_READING)
+			m_invalid = INVALID_OTHER;
+		return skip(ROW);
+	case READING_VALUE:
+		return error("Cannot handle unsupported type of reading element '" + m_name + "'");
+	case SKIP:
+		m_skipDepth++;
+		return true;
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+bool ReadingSetHandler::EndArray(SizeType)
+{
+	switch (m_state)
+	{
+	case ROWS:
+		m_state = TOP;
+		return true;
+	case SKIP:
+		if (--m_skipDepth == 0)
+			m_state = m_skipReturn;
+		return true;
+	default:
+		return error("Unexpected end of array");
+	}
+}
+
+bool ReadingSetHandler::Key(const char *str, SizeType length, bool)
+{
+	switch (m_state)
+	{
+	case TOP:
+		if (strcmp(str, "count") == 0)
+			m_topKey = K_COUNT;
+		else if (strcmp(str, "rows") == 0)
+			m_topKey = m_hasRows ? K_OTHER : K_ROWS;
+		else if (strcmp(str, "readings") == 0)
+			m_topKey = (m_hasRows || m_hasReadings) ? K_OTHER : K_READINGS;
+		else
+			m_topKey = K_OTHER;
+		m_state = TOP_VALUE;
+		return true;
+	case ROW:
+		if (strcmp(str, "id") == 0)
+			m_rowKey = K_ID;
+		else if (strcmp(str, "asset_code") == 0)
+			m_rowKey = K_ASSET_CODE;
+		else if (strcmp(str, "read_key") == 0)
+			m_rowKey = K_READ_KEY;
+		else if (strcmp(str, "user_ts") == 0)
+			m_rowKey = K_USER_TS;
+		else if (strcmp(str, "ts") == 0)
+			m_rowKey = K_TS;
+		else if (strcmp(str, "reading") == 0)
+			m_rowKey = K_READING;
+		else if (strcmp(str, "value") == 0)
+			m_rowKey = K_VALUE;
+		else
+			m_rowKey = K_OTHER;
+		m_state = ROW_VALUE;
+		return true;
+	case READING:
+		m_name.assign(str, length);
+		m_state = READING_VALUE;
+		return true;
+	case SKIP:
+		return true;
+	default:
+		return error("Unexpected member name");
+	}
+}
+
+/**
+ * Set a timestamp of the reading being built
+ */
+void ReadingSetHandler::setTimestamp(const char *str, SizeType length, struct timeval *tv)
+{
+	if (!TimestampCodec::parse(str, tv))
+	{
+		m_reading->stringToTimestamp(string(str, length), tv);
+	}
+}
+
+bool ReadingSetHandler::String(const char *str, SizeType length, bool)
+{
+	switch (m_state)
+	{
+	case ROW_VALUE:
+		switch (m_rowKey)
+		{
+		case K_ASSET_CODE:
+			m_reading->setAssetName(string(str, length));
+			break;
+		case K_READ_KEY:
+			m_reading->m_uuid.assign(str, length);
+			break;
+		case K_USER_TS:
+			setTimestamp(str, length, &m_reading->m_userTimestamp);
+			break;
+		case K_TS:
+			setTimestamp(str, length, &m_reading->m_timestamp);
+			m_hasTs = true;
+			break;
+		case K_READING:
+			m_invalid = INVALID_STRING;
+			m_invalidString.assign(str, length);
+			break;
+		default:
+			break;
+		}
+		m_state = ROW;
+		return true;
+	case READING_VALUE:
+		m_reading->addDatapoint(new Datapoint(m_name, DatapointValue(string(str, length))));
+		m_state = READING;
+		return true;
+	case TOP_VALUE:
+		m_state = TOP;
+		return true;
+	case SKIP:
+		return true;
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+bool ReadingSetHandler::integer(long value)
+{
+	switch (m_state)
+	{
+	case TOP_VALUE:
+		if (m_topKey == K_COUNT)
+		{
+			m_count = (unsigned long)value;
+			m_hasCount = true;
+		}
+		m_state = TOP;
+		return true;
+	case ROW_VALUE:
+		switch (m_rowKey)
+		{
+		case K_ID:
+			m_reading->m_id = (unsigned long)value;
+			m_reading->m_has_id = true;
+			break;
+		case K_VALUE:
+			m_hasValue = true;
+			m_value = DatapointValue(value);
+			break;
+		case K_READING:
+			m_invalid = INVALID_NUMBER;
+			m_invalidValue = DatapointValue(value);
+			break;
+		default:
+			break;
+		}
+		m_state = ROW;
+		return true;
+	case READING_VALUE:
+		m_reading->addDatapoint(new Datapoint(m_name, DatapointValue(value)));
+		m_state = READING;
+		return true;
+	case SKIP:
+		return true;
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+bool ReadingSetHandler::Double(double value)
+{
+	switch (m_state)
+	{
+	case TOP_VALUE:
+		m_state = TOP;
+		return true;
+	case ROW_VALUE:
+		if (m_rowKey == K_VALUE)
+		{
+			m_hasValue = true;
+			m_value = DatapointValue(value);
+		}
+		else if (m_rowKey == K_READING)
+		{
+			m_invalid = INVALID_NUMBER;
+			m_invalidValue = DatapointValue(value);
+		}
+		m_state = ROW;
+		return true;
+	case READING_VALUE:
+		m_reading->addDatapoint(new Datapoint(m_name, DatapointValue(value)));
+		m_state = READING;
+		return true;
+	case SKIP:
+		return true;
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+bool ReadingSetHandler::Default()
+{
+	switch (m_state)
+	{
+	case TOP_VALUE:
+		m_state = TOP;
+		return true;
+	case ROW_VALUE:
+		if (m_rowKey == K_READING)
+		{
+			m_invalid = INVALID_OTHER;
+		}
+		m_state = ROW;
+		return true;
+	case READING_VALUE:
+		return error("Cannot handle unsupported type of reading element '" + m_name + "'");
+	case SKIP:
+		return true;
+	default:
+		return error("Expected reading to be an object");
+	}
+}
+
+/**
+ * Complete the reading being built at the end of its object
+ */
+void ReadingSetHandler::endRow()
+{
+	JSONReading *reading = m_reading;
+	m_reading = NULL;
+	if (!m_hasTs)
+	{
+		reading->m_timestamp = reading->m_userTimestamp;
+	}
+	if (m_hasValue)
+	{
+		// A numeric "value" replaces the "reading" object
+		reading->removeAllDatapoints();
+		reading->addDatapoint(new Datapoint("value", std::move(m_value)));
+	}
+	else if (m_invalid != VALID)
+	{
+		/*
+		 * The reading was not an object, the asset name ASSET_NAME_INVALID_READING
+		 * will be created in the PI-Server containing the invalid asset_name/values.
+		 */
+		reading->removeAllDatapoints();
+		if (m_invalid == INVALID_STRING)
+		{
+			string escaped = m_invalidString;
+			for (const string &item : JSON_characters_to_be_escaped)
+			{
+				reading->escapeCharacter(escaped, item);
+			}
+			Logger::getLogger()->error(
+				"Invalid reading: Asset name |%s| reading value |%s| converted value |%s|",
+				reading->getAssetName().c_str(),
+				m_invalidString.c_str(),
+				escaped.c_str());
+			reading->addDatapoint(new Datapoint(reading->getAssetName(), DatapointValue(escaped)));
+		}
+		else if (m_invalid == INVALID_NUMBER)
+		{
+			reading->addDatapoint(new Datapoint(reading->getAssetName(), std::move(m_invalidValue)));
+		}
+		reading->setAssetName(string(ASSET_NAME_INVALID_READING) + string("_") + reading->getAssetName());
+	}
+	m_lastId = reading->m_has_id ? reading->m_id : 0;
+	m_readings.push_back(reading);
+}
+
+/**
+ * Populate the reading set from a JSON document returned from
+ * the FogLAMP storage service query or notification.
+ *
+ * @param json	The JSON document (as string) with readings data
+ */
+void ReadingSet::load(const std::string& json)
+{
+	ReadingSetHandler handler;
+	Reader reader;
+	StringStream stream(json.c_str());
+	if (!reader.Parse(stream, handler))
 	{
+		if (!handler.getError().empty())
+			throw new ReadingSetException(handler.getError().c_str());
 		throw new ReadingSetException("Unable to parse results json document");
 	}
-	// Check we have "count" and "rows"
-	bool docHasRows =  doc.HasMember("rows"); // Query
-	bool docHasReadings =  doc.HasMember("readings"); // Notification
+	loaded(handler);
+}
+
+/**
+ * Populate the reading set from a stream of the JSON document
+ * returned from the FogLAMP storage service
+ *
+ * @param json	The stream from which the JSON document is read
+ */
+void ReadingSet::load(std::istream& json)
+{
+	ReadingSetHandler handler;
+	Reader reader;
+	ChunkedStream *stream = new ChunkedStream(json.rdbuf());
+	bool parsed = reader.Parse(*stream, handler);
+	delete stream;
+	if (!parsed)
+	{
+		if (!handler.getError().empty())
+			throw new ReadingSetException(handler.getError().c_str());
+		throw new ReadingSetException("Unable to parse results json document");
+	}
+	loaded(handler);
+}
 
+/**
+ * Take the readings built by a handler that has parsed a document
+ *
+ * @param handler	The handler used to parse the document
+ */
+void ReadingSet::loaded(ReadingSetHandler& handler)
+{
 	// Check we have "rows" or "readings"
-	if (!docHasRows && !docHasReadings)
+	if (!handler.m_hasRows && !handler.m_hasReadings)
 	{
 		throw new ReadingSetException("Missing readings or rows array");
 	}
 
 	// Check we have "count" and "rows"
-	if (doc.HasMember("count") && docHasRows)
+	if (handler.m_hasCount && handler.m_hasRows)
 	{
-		m_count = doc["count"].GetUint();
+		m_count = handler.m_count;
 		// No readings
 		if (!m_count)
 		{
@@ -96,43 +685,15 @@ ReadingSet::ReadingSet(const std::string& json)
 		m_last_id = 0;
 	}
 
-	// Get "rows" or "readings" data
-	const Value& readings = docHasRows ? doc["rows"] : doc["readings"];
-	if (readings.IsArray())
-	{
-		unsigned long id = 0;
-		// Process every rows and create the result set
-		for (auto& reading : readings.GetArray())
-		{
-			if (!reading.IsObject())
-			{
-				throw new ReadingSetException("Expected reading to be an object");
-			}
-			JSONReading *value = new JSONReading(reading);
-			m_readings.push_back(value);
-
-			// Get the Reading Id
-			id = value->getId();
-
-			// We don't have count informations with "readings"
-			if (docHasReadings)
-			{
-				rows++;
-			}
+	m_readings.insert(m_readings.end(), handler.m_readings.begin(), handler.m_readings.end());
+	handler.m_readings.clear();
+	// Set the last id
+	m_last_id = handler.m_lastId;
 
-		}
-		// Set the last id
-		m_last_id = id;
-
-		// Set count informations with "readings"
-		if (docHasReadings)
-		{
-			m_count = rows;
-		}
-	}
-	else
+	// Set count informations with "readings"
+	if (handler.m_hasReadings)
 	{
-		throw new ReadingSetException("Expected array of rows in result set");
+		m_count = m_readings.size();
 	}
 }
 
@@ -225,7 +786,7 @@ JSONReading::JSONReading(const Value& json)
 	{
 		m_has_id = false;
 	}
-	m_asset = json["asset_code"].GetString();
+	setAssetName(json["asset_code"].GetString());
 	stringToTimestamp(json["user_ts"].GetString(), &m_userTimestamp);
 	if (json.HasMember("ts"))
 	{
@@ -357,12 +918,12 @@ JSONReading::JSONReading(const Value& json)
 
 				Logger::getLogger()->error(
 					"Invalid reading: Asset name |%s| reading value |%s| converted value |%s|",
-					m_asset.c_str(),
+					getAssetName().c_str(),
 					json["reading"].GetString(),
 					tmp_reading1.c_str());
 
 				DatapointValue value(tmp_reading1);
-				this->addDatapoint(new Datapoint(m_asset, value));
+				this->addDatapoint(new Datapoint(getAssetName(), value));
 
 			} else if (json["reading"].IsInt() ||
 				   json["reading"].IsUint() ||
@@ -377,21 +938,34 @@ JSONReading::JSONReading(const Value& json)
 				} else {
 					value = new DatapointValue((long) json["reading"].GetInt64());
 				}
-				this->addDatapoint(new Datapoint(m_asset, *value));
+				this->addDatapoint(new Datapoint(getAssetName(), *value));
 				delete value;
 
 			} else if (json["reading"].IsDouble())
 			{
 				DatapointValue value(json["reading"].GetDouble());
-				this->addDatapoint(new Datapoint(m_asset, value));
+				this->addDatapoint(new Datapoint(getAssetName(), value));
 
 			}
 
-			m_asset = string(ASSET_NAME_INVALID_READING) + string("_") + m_asset.c_str();
+			setAssetName(string(ASSET_NAME_INVALID_READING) + string("_") + getAssetName());
 		}
 	}
 }
 
+/**
+ * Construct an empty reading, used by ReadingSetHandler to build a
+ * reading as a JSON document is parsed
+ */
+JSONReading::JSONReading()
+{
+	m_id = 0;
+	m_has_id = false;
+	m_timestamp.tv_sec = 0;
+	m_timestamp.tv_usec = 0;
+	m_userTimestamp = m_timestamp;
+}
+
 /**
  * Escapes a character in a string to be properly handled as JSON
  *
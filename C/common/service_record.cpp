@@ -72,6 +72,10 @@ ostringstream convert;
 	{
 		convert << ",\"service_port\" : " << m_port << " ";
 	}
+	if (!m_socket.empty())
+	{
+		convert << ",\"service_socket\" : \"" << m_socket << "\" ";
+	}
 	convert << "}";
 
 	json = convert.str();
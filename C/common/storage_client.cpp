@@ -8,6 +8,10 @@
  * Author: Mark Riddoch
  */
 #include <storage_client.h>
+#include <binary_readings.h>
+#include <http_stream.h>
+#include <local_http_client.h>
+#include <json_utils.h>
 #include <reading.h>
 #include <reading_set.h>
 #include <rapidjson/document.h>
@@ -18,82 +22,337 @@
 #include <iostream>
 #include <thread>
 #include <map>
+#include <sys/stat.h>
 
 using namespace std;
 using namespace rapidjson;
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
-// handles m_client_map access
-std::mutex sto_mtx_client_map;
+#define MAX_QUEUED_UPDATES	1000	// Queued updates kept for a table while the service is unavailable
+#define UPDATE_RETRY_INTERVAL	1	// Seconds between attempts to send queued updates
 
 /**
  * Storage Client constructor
+ *
+ * @param hostname	The host of the storage service
+ * @param port		The port of the storage service
+ * @param socketPath	The Unix domain socket of the storage service, used
+ *			if it exists on this host
  */
-StorageClient::StorageClient(const string& hostname, const unsigned short port)
+StorageClient::StorageClient(const string& hostname, const unsigned short port, const string& socketPath) :
+	m_hostname(hostname), m_port(port), m_binaryAppend(false), m_appendRetry(0), m_clients(0),
+	m_poolSize(STORAGE_CLIENT_POOL_SIZE), m_idleTimeout(STORAGE_CLIENT_IDLE_TIMEOUT),
+	m_updater(NULL), m_updaterRunning(false)
 {
 	m_pid = getpid();
 	m_logger = Logger::getLogger();
 	m_urlbase << hostname << ":" << port;
+
+	struct stat st;
+	if (!socketPath.empty() && stat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+	{
+		m_socketPath = socketPath;
+		m_logger->info("Using Unix domain socket %s to connect to the storage service",
+				socketPath.c_str());
+	}
 }
 
 /**
  * Storage Client constructor
- * stores the provided HttpClient into the map
+ *
+ * The client given is the only connection in the pool, requests
+ * from all threads will use it in turn.
+ *
+ * @param client	The HTTP client to use
  */
-StorageClient::StorageClient(HttpClient *client) {
+StorageClient::StorageClient(HttpClient *client) : m_port(0), m_binaryAppend(false), m_appendRetry(0), m_clients(1),
+	m_poolSize(1), m_idleTimeout(STORAGE_CLIENT_IDLE_TIMEOUT), m_updater(NULL), m_updaterRunning(false)
+{
+	m_pid = getpid();
+	m_logger = Logger::getLogger();
+	m_idle.push_back(make_pair(client, chrono::steady_clock::now()));
+}
 
-	std::thread::id thread_id = std::this_thread::get_id();
+/**
+ * Destructor for storage client, queued updates are sent
+ * before the connections are closed
+ */
+StorageClient::~StorageClient()
+{
+	if (m_updater)
+	{
+		{
+			lock_guard<mutex> guard(m_updateMutex);
+			m_updaterRunning = false;
+		}
+		m_updateCv.notify_all();
+		m_updater->join();
+		delete m_updater;
+	}
+	for (auto& idle : m_idle)
+	{
+		delete idle.first;
+	}
+	for (auto& idle : m_idleStreams)
+	{
+		delete idle.first;
+	}
+}
 
-	sto_mtx_client_map.lock();
-	m_client_map[thread_id] = client;
-	sto_mtx_client_map.unlock();
+/**
+ * Set the maximum number of connections to the storage service
+ *
+ * @param size	The maximum number of connections
+ */
+void StorageClient::setPoolSize(unsigned int size)
+{
+	// A client given to the constructor can not be added to
+	if (m_port && size > 0)
+	{
+		lock_guard<mutex> guard(m_poolMutex);
+		m_poolSize = size;
+	}
+	m_poolCv.notify_all();
 }
 
+/**
+ * Set the time after which an idle connection to the storage
+ * service is closed
+ *
+ * @param seconds	The idle timeout
+ */
+void StorageClient::setIdleTimeout(unsigned int seconds)
+{
+	lock_guard<mutex> guard(m_poolMutex);
+	m_idleTimeout = chrono::seconds(seconds);
+}
 
 /**
- * Destructor for storage client
+ * Take a connection from the pool, creating one if none are idle
+ * and the pool is not full, otherwise waiting for one to be released
  */
-StorageClient::~StorageClient()
+HttpClient *StorageClient::acquireClient()
 {
-	std::map<std::thread::id, HttpClient *>::iterator item;
+	unique_lock<mutex> lck(m_poolMutex);
+	closeIdle();
+	waitForConnection(lck, false);
+	if (!m_idle.empty())
+	{
+		HttpClient *client = m_idle.back().first;
+		m_idle.pop_back();
+		return client;
+	}
+	m_clients++;
+	lck.unlock();
+	if (!m_socketPath.empty())
+	{
+		return new LocalHttpClient(m_socketPath, m_urlbase.str());
+	}
+	return new HttpClient(m_urlbase.str());
+}
 
-	// Deletes all the HttpClient objects created in the map
-	for (item  = m_client_map.begin() ; item  != m_client_map.end() ; ++item)
+/**
+ * Return a connection to the pool
+ *
+ * @param client	The connection to return
+ */
+void StorageClient::releaseClient(HttpClient *client)
+{
 	{
-		delete item->second;
+		lock_guard<mutex> guard(m_poolMutex);
+		m_idle.push_back(make_pair(client, chrono::steady_clock::now()));
+		closeIdle();
 	}
+	m_poolCv.notify_one();
 }
 
 /**
- * Creates a HttpClient object for each thread
- * it stores/retrieves the reference to the HttpClient and the associated thread id in a map
+ * Wait until there is an idle connection of the kind wanted or a new
+ * one may be made. An idle connection of the other kind is closed to
+ * make room if the pool is full. The pool mutex must be held by the
+ * caller.
+ *
+ * @param lck		The lock on the pool mutex
+ * @param stream	True if a streamed connection is wanted
  */
-HttpClient *StorageClient::getHttpClient(void) {
+void StorageClient::waitForConnection(unique_lock<mutex>& lck, bool stream)
+{
+	while ((stream ? m_idleStreams.empty() : m_idle.empty()) && m_clients >= m_poolSize)
+	{
+		if (stream && !m_idle.empty() && m_port)
+		{
+			delete m_idle.front().first;
+			m_idle.pop_front();
+			m_clients--;
+		}
+		else if (!stream && !m_idleStreams.empty())
+		{
+			delete m_idleStreams.front().first;
+			m_idleStreams.pop_front();
+			m_clients--;
+		}
+		else
+		{
+			m_poolCv.wait(lck);
+		}
+	}
+}
 
-	std::map<std::thread::id, HttpClient *>::iterator item;
-	HttpClient *client;
+/**
+ * Take a connection to stream a response from the pool, creating
+ * one if none are idle and the pool is not full
+ */
+HttpStream *StorageClient::acquireStream()
+{
+	unique_lock<mutex> lck(m_poolMutex);
+	closeIdle();
+	waitForConnection(lck, true);
+	if (!m_idleStreams.empty())
+	{
+		HttpStream *stream = m_idleStreams.back().first;
+		m_idleStreams.pop_back();
+		return stream;
+	}
+	m_clients++;
+	lck.unlock();
+	return new HttpStream(m_hostname, m_port, m_socketPath);
+}
 
-	std::thread::id thread_id = std::this_thread::get_id();
+/**
+ * Return a streamed connection to the pool, it is closed if the
+ * response was not read completely or the server closed it
+ *
+ * @param stream	The connection to return
+ */
+void StorageClient::releaseStream(HttpStream *stream)
+{
+	{
+		lock_guard<mutex> guard(m_poolMutex);
+		if (stream->reusable())
+		{
+			m_idleStreams.push_back(make_pair(stream, chrono::steady_clock::now()));
+		}
+		else
+		{
+			delete stream;
+			m_clients--;
+		}
+		closeIdle();
+	}
+	m_poolCv.notify_one();
+}
 
-	sto_mtx_client_map.lock();
-	item = m_client_map.find(thread_id);
+/**
+ * Close the connections that have been idle for longer than the
+ * idle timeout, or that exceed the pool size. The pool mutex must
+ * be held by the caller.
+ */
+void StorageClient::closeIdle()
+{
+	// A client given to the constructor can not be replaced
+	if (m_port == 0)
+	{
+		return;
+	}
+	auto expired = chrono::steady_clock::now() - m_idleTimeout;
+	while (!m_idle.empty() && (m_idle.front().second < expired || m_clients > m_poolSize))
+	{
+		delete m_idle.front().first;
+		m_idle.pop_front();
+		m_clients--;
+	}
+	while (!m_idleStreams.empty() && (m_idleStreams.front().second < expired || m_clients > m_poolSize))
+	{
+		delete m_idleStreams.front().first;
+		m_idleStreams.pop_front();
+		m_clients--;
+	}
+}
+
+/**
+ * Send a request to the storage service on a pooled connection and
+ * record the time it takes against the endpoint, the URL without
+ * any query parameters.
+ *
+ * @param method	The HTTP method
+ * @param url		The URL of the request
+ * @param content	The content of the request
+ * @param header	Additional headers for the request
+ * @return		The response, which holds all of the content
+ */
+StorageClient::Response StorageClient::request(const string& method, const string& url,
+					       const string& content,
+					       const SimpleWeb::CaseInsensitiveMultimap& header)
+{
+	HttpClient *client = acquireClient();
+	auto start = chrono::steady_clock::now();
+	Response res;
+	try {
+		res = client->request(method, url, content, header);
+	} catch (...) {
+		releaseClient(client);
+		throw;
+	}
+	auto usecs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	releaseClient(client);
 
-	if (item  == m_client_map.end() ) {
+	string endpoint = method + " " + url.substr(0, url.find('?'));
+	lock_guard<mutex> guard(m_latencyMutex);
+	m_latency[endpoint].record(usecs);
+	return res;
+}
 
-		// Adding a new HttpClient
-		client = new HttpClient(m_urlbase.str());
-		m_client_map[thread_id] = client;
-		m_seqnum_map[thread_id].store(0);
-		std::ostringstream ss;
-		ss << std::this_thread::get_id();
+/**
+ * Return the latency histograms of the requests made to each
+ * endpoint of the storage service as a JSON document
+ */
+string StorageClient::latencyJSON() const
+{
+	lock_guard<mutex> guard(m_latencyMutex);
+	string json = "{";
+	for (auto& endpoint : m_latency)
+	{
+		string histogram;
+		endpoint.second.asJSON(histogram);
+		if (json.length() > 1)
+			json += ",";
+		json += " \"" + endpoint.first + "\" : " + histogram;
 	}
-	else
+	json += " }";
+	return json;
+}
+
+/**
+ * Return the use of the connection pool and the latency of the
+ * requests to each endpoint as JSON
+ *
+ * @param json	The JSON document
+ */
+void StorageClient::asJSON(string& json) const
+{
+	ostringstream convert;
 	{
-		client = item->second;
+		lock_guard<mutex> guard(m_poolMutex);
+		convert << "{ \"connections\" : " << m_clients << ",";
+		convert << " \"idleConnections\" : " << m_idle.size() + m_idleStreams.size() << ",";
+		convert << " \"poolSize\" : " << m_poolSize << ",";
+		convert << " \"idleTimeout\" : " << m_idleTimeout.count() << ",";
 	}
-	sto_mtx_client_map.unlock();
+	convert << " \"latency\" : " << latencyJSON() << " }";
+	json = convert.str();
+}
 
-	return (client);
+/**
+ * Return the value of the SeqNum header for the next request of the
+ * calling thread. The storage service ignores a request with a SeqNum
+ * no greater than the last it saw from the same process and thread.
+ */
+string StorageClient::nextSeqNum()
+{
+	static thread_local unsigned long seqNum = 0;
+	ostringstream ss;
+	ss << m_pid << "#" << this_thread::get_id() << "_" << ++seqNum;
+	return ss.str();
 }
 
 /**
@@ -107,7 +366,7 @@ bool StorageClient::readingAppend(Reading& reading)
 		convert << "{ \"readings\" : [ ";
 		convert << reading.toJSON();
 		convert << " ] }";
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str());
+		auto res = this->request("POST", "/storage/reading", convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			return true;
@@ -124,45 +383,141 @@ bool StorageClient::readingAppend(Reading& reading)
 
 /**
  * Append multiple readings
+ *
+ * The readings are sent in the binary batch format if the storage
+ * service has advertised that it accepts it, otherwise as JSON.
+ * They are only resent as JSON if the storage service refuses the
+ * binary format, any other failure is returned to the caller.
  */
 bool StorageClient::readingAppend(const vector<Reading *>& readings)
 {
-	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
-	try {
-		std::thread::id thread_id = std::this_thread::get_id();
-		ostringstream ss;
-		sto_mtx_client_map.lock();
-		m_seqnum_map[thread_id].fetch_add(1);
-		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
-		sto_mtx_client_map.unlock();
+	string batch;
+	if (m_binaryAppend && BinaryReadingsWriter::encode(readings, batch))
+	{
+		int status = postReadings(batch, READINGS_BINARY_CONTENT_TYPE);
+		if (status != 415)
+		{
+			return status == 200;
+		}
+		// The storage service no longer accepts the binary format, resend as JSON
+	}
+	return readingAppend(readingsPayload(readings));
+}
 
-		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+/**
+ * Return the JSON payload used to append a block of readings
+ *
+ * @param readings	The readings to append
+ * @return string	The payload for the append request
+ */
+string StorageClient::readingsPayload(const vector<Reading *>& readings)
+{
+	ostringstream convert;
+	convert << "{ \"readings\" : [ ";
+	for (vector<Reading *>::const_iterator it = readings.cbegin();
+					 it != readings.cend(); ++it)
+	{
+		if (it != readings.cbegin())
+		{
+			convert << ", ";
+		}
+		convert << (*it)->toJSON();
+	}
+	convert << " ] }";
+	return convert.str();
+}
 
-		ostringstream convert;
-		convert << "{ \"readings\" : [ ";
-		for (vector<Reading *>::const_iterator it = readings.cbegin();
-						 it != readings.cend(); ++it)
+/**
+ * Append a block of readings that has already been formatted
+ * by readingsPayload
+ *
+ * @param payload	The readings payload
+ */
+bool StorageClient::readingAppend(const string& payload)
+{
+	return postReadings(payload, NULL) == 200;
+}
+
+/**
+ * Append a block of readings that has already been formatted
+ * by readingsPayload and return the HTTP status of the request,
+ * so that the caller can tell a request the storage service will
+ * never accept from one that may be retried.
+ *
+ * @param payload	The readings payload
+ * @param status	Set to the HTTP status, 0 if the request could not be sent
+ * @return bool		True if the readings were appended
+ */
+bool StorageClient::readingAppend(const string& payload, int& status)
+{
+	status = postReadings(payload, NULL);
+	return status == 200;
+}
+
+/**
+ * Send a block of readings to the storage service. A successful
+ * response tells us if the service will accept the binary batch
+ * format in subsequent requests.
+ *
+ * If the storage service is too busy to take the readings it asks
+ * for them to be sent again after a delay, no readings are sent
+ * until that delay has passed.
+ *
+ * @param payload	The readings payload
+ * @param contentType	The content type of the payload, NULL for JSON
+ * @return int		The HTTP status of the response, 0 if there was none
+ */
+int StorageClient::postReadings(const string& payload, const char *contentType)
+{
+	auto now = chrono::steady_clock::now().time_since_epoch();
+	if (chrono::duration_cast<chrono::milliseconds>(now).count() < m_appendRetry)
+	{
+		return 503;
+	}
+	try {
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", nextSeqNum()}};
+		if (contentType)
 		{
-			if (it != readings.cbegin())
-			{
-				convert << ", ";
-			}
-			convert << (*it)->toJSON();
+			headers.emplace("Content-Type", contentType);
 		}
-		convert << " ] }";
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str(), headers);
-		if (res->status_code.compare("200 OK") == 0)
+
+		auto res = this->request("POST", "/storage/reading", payload, headers);
+		int status = atoi(res->status_code.c_str());
+		if (status == 200)
 		{
-			return true;
+			auto accept = res->header.find("Accept");
+			m_binaryAppend = accept != res->header.end() &&
+				accept->second.find(READINGS_BINARY_CONTENT_TYPE) != string::npos;
+			return status;
+		}
+		if (contentType && status == 415)
+		{
+			m_logger->warn("The storage service does not accept binary readings, reverting to JSON");
+			m_binaryAppend = false;
+			return status;
+		}
+		if (status == 503)
+		{
+			auto retry = res->header.find("Retry-After");
+			if (retry != res->header.end())
+			{
+				long delay = strtol(retry->second.c_str(), NULL, 10);
+				m_appendRetry = chrono::duration_cast<chrono::milliseconds>(
+						chrono::steady_clock::now().time_since_epoch()).count()
+						+ delay * 1000;
+				m_logger->warn("The storage service is busy, readings will not be sent "
+						"for %ld seconds", delay);
+				return status;
+			}
 		}
 		ostringstream resultPayload;
 		resultPayload << res->content.rdbuf();
 		handleUnexpectedResponse("Append readings", res->status_code, resultPayload.str());
-		return false;
+		return status;
 	} catch (exception& ex) {
 		m_logger->error("Failed to append reading: %s", ex.what());
 	}
-	return false;
+	return 0;
 }
 
 /**
@@ -177,7 +532,7 @@ ResultSet *StorageClient::readingQuery(const Query& query)
 		ostringstream convert;
 
 		convert << query.toJSON();
-		auto res = this->getHttpClient()->request("PUT", "/storage/reading/query", convert.str());
+		auto res = this->request("PUT", "/storage/reading/query", convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -203,6 +558,9 @@ ResultSet *StorageClient::readingQuery(const Query& query)
  * Retrieve a set of readings for sending on the northbound
  * interface of FogLAMP
  *
+ * The readings are built as the response is read from the storage
+ * service, which sends them as they are read from the plugin.
+ *
  * @param readingId	The ID of the reading which should be the first one to send
  * @param count		Maximum number if readings to return
  * @return ReadingSet	The set of readings
@@ -215,12 +573,53 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 		snprintf(url, sizeof(url), "/storage/reading?id=%ld&count=%ld",
 				readingId, count);
 
-		auto res = this->getHttpClient()->request("GET", url);
-		if (res->status_code.compare("200 OK") == 0)
+		if (m_port)
 		{
+			// Build the readings as the response arrives
+			HttpStream *stream = acquireStream();
+			auto start = chrono::steady_clock::now();
+			ReadingSet *result = NULL;
+			string status;
 			ostringstream resultPayload;
-			resultPayload << res->content.rdbuf();
-			ReadingSet *result = new ReadingSet(resultPayload.str().c_str());
+			try {
+				status = stream->request("GET", url);
+				if (status.compare("200 OK") == 0)
+				{
+					result = new ArenaReadingSet(stream->content());
+				}
+				else
+				{
+					resultPayload << stream->content().rdbuf();
+				}
+			} catch (...) {
+				releaseStream(stream);
+				throw;
+			}
+			bool complete = stream->complete();
+			releaseStream(stream);
+			{
+				auto usecs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+				lock_guard<mutex> guard(m_latencyMutex);
+				m_latency["GET /storage/reading"].record(usecs);
+			}
+			if (result && !complete)
+			{
+				delete result;
+				throw runtime_error("Incomplete response");
+			}
+			if (result)
+			{
+				return result;
+			}
+			handleUnexpectedResponse("Fetch readings", status, resultPayload.str());
+			return 0;
+		}
+
+		auto res = this->request("GET", url);
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			// Build the readings directly from the response content
+			ReadingSet *result = new ArenaReadingSet(res->content);
 			return result;
 		}
 		ostringstream resultPayload;
@@ -237,6 +636,51 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 	return 0;
 }
 
+/**
+ * Wait for readings to be appended after a given reading id. The
+ * storage service holds the request until readings are appended or
+ * the timeout expires, so that the caller does not poll with fetches.
+ *
+ * @param after		The id of the last reading the caller has
+ * @param timeout	Milliseconds to wait for readings
+ * @return bool		True if readings may be available after the id
+ * @throws ReadingWaitUnsupported If the storage service does not support the wait
+ * @throws runtime_error If the wait failed, the storage service may be
+ *			too busy to hold it
+ */
+bool StorageClient::readingWait(const unsigned long after, const unsigned long timeout)
+{
+	try {
+		char url[256];
+		snprintf(url, sizeof(url), "/storage/reading/wait?after=%lu&timeout=%lu",
+				after, timeout);
+		auto res = this->request("GET", url);
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			Document doc;
+			doc.Parse(resultPayload.str().c_str());
+			if (!doc.HasParseError() && doc.IsObject() &&
+			    doc.HasMember("available") && doc["available"].IsBool())
+			{
+				return doc["available"].GetBool();
+			}
+		}
+		if (res->status_code.compare(0, 3, "404") == 0)
+		{
+			throw ReadingWaitUnsupported();
+		}
+		handleUnexpectedResponse("Wait for readings", res->status_code, resultPayload.str());
+	} catch (ReadingWaitUnsupported&) {
+		throw;
+	} catch (exception& ex) {
+		m_logger->error("Failed to wait for readings: %s", ex.what());
+		throw;
+	}
+	throw runtime_error("Failed to wait for readings");
+}
+
 /**
  * Purge the readings by age
  *
@@ -251,7 +695,7 @@ PurgeResult StorageClient::readingPurgeByAge(unsigned long age, unsigned long se
 		char url[256];
 		snprintf(url, sizeof(url), "/storage/reading/purge?age=%ld&sent=%ld&flags=%s",
 				age, sent, purgeUnsent ? "purge" : "retain");
-		auto res = this->getHttpClient()->request("PUT", url);
+		auto res = this->request("PUT", url);
 		ostringstream resultPayload;
 		resultPayload << res->content.rdbuf();
 		if (res->status_code.compare("200 OK") == 0)
@@ -284,7 +728,7 @@ PurgeResult StorageClient::readingPurgeBySize(unsigned long size, unsigned long
 		char url[256];
 		snprintf(url, sizeof(url), "/storage/reading/purge?size=%ld&sent=%ld&flags=%s",
 				size, sent, purgeUnsent ? "purge" : "retain");
-		auto res = this->getHttpClient()->request("PUT", url);
+		auto res = this->request("PUT", url);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -317,7 +761,7 @@ ResultSet *StorageClient::queryTable(const std::string& tableName, const Query&
 		convert << query.toJSON();
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s/query", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str());
+		auto res = this->request("PUT", url, convert.str());
 		ostringstream resultPayload;
 		resultPayload << res->content.rdbuf();
 		if (res->status_code.compare("200 OK") == 0)
@@ -355,15 +799,15 @@ ReadingSet* StorageClient::queryTableToReadings(const std::string& tableName,
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s/query", tableName.c_str());
 
-		auto res = this->getHttpClient()->request("PUT", url, convert.str());
-		ostringstream resultPayload;
-		resultPayload << res->content.rdbuf();
-
+		auto res = this->request("PUT", url, convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
-			ReadingSet* result = new ReadingSet(resultPayload.str().c_str());
+			// Build the readings directly from the response content
+			ReadingSet* result = new ArenaReadingSet(res->content);
 			return result;
 		}
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
 		handleUnexpectedResponse("Query table", res->status_code, resultPayload.str());
 	} catch (exception& ex) {
 		m_logger->error("Failed to query table %s: %s", tableName.c_str(), ex.what());
@@ -391,7 +835,7 @@ int StorageClient::insertTable(const string& tableName, const InsertValues& valu
 		convert << values.toJSON();
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("POST", url, convert.str());
+		auto res = this->request("POST", url, convert.str());
 		ostringstream resultPayload;
 		resultPayload << res->content.rdbuf();
 		if (res->status_code.compare("200 OK") == 0 || res->status_code.compare("201 Created") == 0)
@@ -432,16 +876,8 @@ int StorageClient::insertTable(const string& tableName, const InsertValues& valu
  */
 int StorageClient::updateTable(const string& tableName, const InsertValues& values, const Where& where)
 {
-	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
-		std::thread::id thread_id = std::this_thread::get_id();
-		ostringstream ss;
-		sto_mtx_client_map.lock();
-		m_seqnum_map[thread_id].fetch_add(1);
-		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
-		sto_mtx_client_map.unlock();
-
-		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", nextSeqNum()}};
 
 		ostringstream convert;
 
@@ -455,7 +891,7 @@ int StorageClient::updateTable(const string& tableName, const InsertValues& valu
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str(), headers);
+		auto res = this->request("PUT", url, convert.str(), headers);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -497,16 +933,8 @@ int StorageClient::updateTable(const string& tableName, const InsertValues& valu
  */
 int StorageClient::updateTable(const string& tableName, const ExpressionValues& values, const Where& where)
 {
-	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
-		std::thread::id thread_id = std::this_thread::get_id();
-		ostringstream ss;
-		sto_mtx_client_map.lock();
-		m_seqnum_map[thread_id].fetch_add(1);
-		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
-		sto_mtx_client_map.unlock();
-
-		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", nextSeqNum()}};
 		
 		ostringstream convert;
 
@@ -520,7 +948,7 @@ int StorageClient::updateTable(const string& tableName, const ExpressionValues&
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str(), headers);
+		auto res = this->request("PUT", url, convert.str(), headers);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -561,16 +989,8 @@ int StorageClient::updateTable(const string& tableName, const ExpressionValues&
  */
 int StorageClient::updateTable(const string& tableName, vector<pair<ExpressionValues *, Where *>>& updates)
 {
-	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
-		std::thread::id thread_id = std::this_thread::get_id();
-		ostringstream ss;
-		sto_mtx_client_map.lock();
-		m_seqnum_map[thread_id].fetch_add(1);
-		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
-		sto_mtx_client_map.unlock();
-
-		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", nextSeqNum()}};
 		
 		ostringstream convert;
 		convert << "{ \"updates\" : [ ";
@@ -591,7 +1011,7 @@ int StorageClient::updateTable(const string& tableName, vector<pair<ExpressionVa
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str(), headers);
+		auto res = this->request("PUT", url, convert.str(), headers);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -624,6 +1044,135 @@ int StorageClient::updateTable(const string& tableName, vector<pair<ExpressionVa
 }
 
 
+/**
+ * Queue updates to an arbitrary table to be sent to the storage service
+ * by a background thread, for updates such as statistics where the
+ * caller does not need to wait for the result.
+ *
+ * Updates queued while a previous request is being sent are combined
+ * into a single request for each table. Updates that fail are kept
+ * and sent again, in order, with the next updates.
+ *
+ * @param tableName	The name of the table to update
+ * @param updates	The expressions and condition pairs to update in the table,
+ *			these remain owned by the caller
+ */
+void StorageClient::queueUpdates(const string& tableName, vector<pair<ExpressionValues *, Where *>>& updates)
+{
+	if (updates.empty())
+	{
+		return;
+	}
+	vector<string> queued;
+	for (auto& update : updates)
+	{
+		queued.push_back("{ \"where\" : " + update.second->toJSON()
+				+ ", \"expressions\" : " + update.first->toJSON() + " }");
+	}
+
+	{
+		lock_guard<mutex> guard(m_updateMutex);
+		vector<string>& pending = m_queuedUpdates[tableName];
+		pending.insert(pending.end(), queued.begin(), queued.end());
+		if (pending.size() > MAX_QUEUED_UPDATES)
+		{
+			m_logger->error("Too many updates queued for table %s, discarding %d",
+					tableName.c_str(), pending.size() - MAX_QUEUED_UPDATES);
+			pending.erase(pending.begin(), pending.end() - MAX_QUEUED_UPDATES);
+		}
+		if (!m_updater)
+		{
+			m_updaterRunning = true;
+			m_updater = new thread(&StorageClient::sendQueuedUpdates, this);
+		}
+	}
+	m_updateCv.notify_one();
+}
+
+/**
+ * The thread that sends the queued updates until the client is
+ * destroyed, the last updates are sent before it exits
+ */
+void StorageClient::sendQueuedUpdates()
+{
+	unique_lock<mutex> lck(m_updateMutex);
+	while (true)
+	{
+		while (m_updaterRunning && m_queuedUpdates.empty())
+		{
+			m_updateCv.wait(lck);
+		}
+		if (m_queuedUpdates.empty())
+		{
+			break;
+		}
+		map<string, vector<string>> sending;
+		sending.swap(m_queuedUpdates);
+		lck.unlock();
+
+		map<string, vector<string>> failed;
+		for (auto& table : sending)
+		{
+			string payload = "{ \"updates\" : [ ";
+			for (auto it = table.second.cbegin(); it != table.second.cend(); ++it)
+			{
+				if (it != table.second.cbegin())
+				{
+					payload += ", ";
+				}
+				payload += *it;
+			}
+			payload += " ] }";
+
+			bool sent = false;
+			try {
+				SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", nextSeqNum()}};
+				auto res = this->request("PUT", "/storage/table/" + table.first, payload, headers);
+				ostringstream resultPayload;
+				resultPayload << res->content.rdbuf();
+				if (res->status_code.compare("200 OK") == 0)
+				{
+					Document doc;
+					doc.Parse(resultPayload.str().c_str());
+					sent = !doc.HasParseError() && !doc.HasMember("message");
+				}
+				if (!sent)
+				{
+					handleUnexpectedResponse("Update table", res->status_code, resultPayload.str());
+				}
+			} catch (exception& ex) {
+				m_logger->error("Failed to update table %s: %s", table.first.c_str(), ex.what());
+			}
+			if (!sent)
+			{
+				failed[table.first].swap(table.second);
+			}
+		}
+
+		lck.lock();
+		if (!failed.empty())
+		{
+			// Put the failed updates before any queued since
+			for (auto& table : failed)
+			{
+				vector<string>& pending = m_queuedUpdates[table.first];
+				pending.insert(pending.begin(), table.second.begin(), table.second.end());
+			}
+			if (!m_updaterRunning)
+			{
+				break;
+			}
+			m_updateCv.wait_for(lck, chrono::seconds(UPDATE_RETRY_INTERVAL));
+		}
+	}
+	for (auto& table : m_queuedUpdates)
+	{
+		m_logger->error("Unable to send %d queued updates for table %s",
+				table.second.size(), table.first.c_str());
+	}
+}
+
+
 /**
  * Update data into an arbitrary table
  *
@@ -650,7 +1199,7 @@ int StorageClient::updateTable(const string& tableName, const InsertValues& valu
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str());
+		auto res = this->request("PUT", url, convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -705,7 +1254,7 @@ int StorageClient::updateTable(const string& tableName, const JSONProperties& va
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str());
+		auto res = this->request("PUT", url, convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -763,7 +1312,7 @@ int StorageClient::updateTable(const string& tableName, const InsertValues& valu
 		
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("PUT", url, convert.str());
+		auto res = this->request("PUT", url, convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -810,7 +1359,7 @@ int StorageClient::deleteTable(const std::string& tableName, const Query& query)
 		convert << query.toJSON();
 		char url[128];
 		snprintf(url, sizeof(url), "/storage/table/%s", tableName.c_str());
-		auto res = this->getHttpClient()->request("DELETE", url, convert.str());
+		auto res = this->request("DELETE", url, convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
@@ -889,7 +1438,7 @@ bool StorageClient::registerAssetNotification(const string& assetName,
 		convert << "{ \"url\" : \"";
 		convert << callbackUrl;
 		convert << "\" }";
-		auto res = this->getHttpClient()->request("POST",
+		auto res = this->request("POST",
 							  "/storage/reading/interest/" + assetName,
 							  convert.str());
 		if (res->status_code.compare("200 OK") == 0)
@@ -912,6 +1461,51 @@ bool StorageClient::registerAssetNotification(const string& assetName,
 	return false;
 }
 
+/**
+ * Ask the storage service for a shared memory ring to pass readings
+ * through rather than append requests. A ring is only requested if the
+ * storage service is on this host, which its Unix domain socket shows.
+ *
+ * @param service	The name of the south service
+ * @return		The ring, owned by the caller, or NULL if there is none
+ */
+ReadingRing *StorageClient::readingRing(const string& service)
+{
+	if (m_socketPath.empty())
+	{
+		return NULL;
+	}
+	try {
+		string payload = "{ \"service\" : \"" + JSONescape(service) + "\" }";
+		auto res = this->request("POST", "/storage/reading/ring", payload);
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") != 0)
+		{
+			// Older storage services and those with rings disabled
+			m_logger->info("The storage service did not create a shared memory ring: %s",
+					res->status_code.c_str());
+			return NULL;
+		}
+		Document doc;
+		doc.Parse(resultPayload.str().c_str());
+		if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("ring") || !doc["ring"].IsString())
+		{
+			handleUnexpectedResponse("Create reading ring", res->status_code, resultPayload.str());
+			return NULL;
+		}
+		ReadingRing *ring = ReadingRing::open(doc["ring"].GetString());
+		if (!ring)
+		{
+			m_logger->warn("Unable to open shared memory ring %s", doc["ring"].GetString());
+		}
+		return ring;
+	} catch (exception& ex) {
+		m_logger->error("Failed to create reading ring: %s", ex.what());
+	}
+	return NULL;
+}
+
 /**
  * Unregister interest for a Reading asset name
  *
@@ -930,7 +1524,7 @@ bool StorageClient::unregisterAssetNotification(const string& assetName,
 		convert << "{ \"url\" : \"";
 		convert << callbackUrl;
 		convert << "\" }";
-		auto res = this->getHttpClient()->request("DELETE",
+		auto res = this->request("DELETE",
 							  "/storage/reading/interest/" + assetName,
 							  convert.str());
 		if (res->status_code.compare("200 OK") == 0)
@@ -0,0 +1,156 @@
+/*
+ * FogLAMP string interner.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string_interner.h>
+#include <logger.h>
+
+using namespace std;
+
+/**
+ * Return the process-wide string interner. The interner is never
+ * destroyed so that names remain valid during process exit.
+ */
+StringInterner *StringInterner::getInstance()
+{
+	static StringInterner *instance = new StringInterner();
+	return instance;
+}
+
+/**
+ * Construct the interner, the empty string always has the id 0
+ */
+StringInterner::StringInterner() : m_count(0), m_full(false)
+{
+	for (int i = 0; i < INTERNER_MAX_CHUNKS; i++)
+	{
+		m_chunks[i] = NULL;
+	}
+	intern(string());
+}
+
+/**
+ * Destroy the interner
+ */
+StringInterner::~StringInterner()
+{
+	for (int i = 0; i < INTERNER_MAX_CHUNKS; i++)
+	{
+		delete[] m_chunks[i];
+	}
+}
+
+/**
+ * Return the id of a string, adding the string to the interner
+ * if it has not been seen before
+ *
+ * @param str	The string to intern
+ * @return	The id of the string or INTERNER_NOT_INTERNED if
+ *		the interner is full
+ */
+unsigned int StringInterner::intern(const string& str)
+{
+	Shard& shard = m_shards[hash<string>()(str) % INTERNER_SHARDS];
+	lock_guard<mutex> guard(shard.mutex);
+	auto it = shard.ids.find(str);
+	if (it != shard.ids.end())
+	{
+		return it->second;
+	}
+	unsigned int id = add(str);
+	if (id != INTERNER_NOT_INTERNED)
+	{
+		shard.ids.insert(pair<string, unsigned int>(str, id));
+	}
+	return id;
+}
+
+/**
+ * Store a new string and allocate its id, called with the lock
+ * of the shard for the string held
+ *
+ * @param str	The string to store
+ * @return	The id of the string or INTERNER_NOT_INTERNED if
+ *		the interner is full
+ */
+unsigned int StringInterner::add(const string& str)
+{
+	lock_guard<mutex> guard(m_mutex);
+	unsigned int id = m_count;
+	unsigned int chunk = id / INTERNER_CHUNK_SIZE;
+	if (chunk >= INTERNER_MAX_CHUNKS)
+	{
+		if (!m_full)
+		{
+			Logger::getLogger()->warn("More than %d distinct asset and datapoint names, "
+					"further names are not interned",
+					INTERNER_MAX_CHUNKS * INTERNER_CHUNK_SIZE);
+			m_full = true;
+		}
+		return INTERNER_NOT_INTERNED;
+	}
+	if (!m_chunks[chunk])
+	{
+		m_chunks[chunk] = new string[INTERNER_CHUNK_SIZE];
+	}
+	m_chunks[chunk][id % INTERNER_CHUNK_SIZE] = str;
+	// Publish the string before the id can be used by another thread
+	m_count.store(id + 1);
+	return id;
+}
+
+/**
+ * Construct a name, interning it if the interner has room
+ *
+ * @param name	The name
+ */
+InternedName::InternedName(const string& name) :
+	m_id(StringInterner::getInstance()->intern(name)), m_name(NULL)
+{
+	if (m_id == INTERNER_NOT_INTERNED)
+	{
+		m_name = new string(name);
+	}
+}
+
+/**
+ * Copy constructor, a name that is not interned is copied
+ */
+InternedName::InternedName(const InternedName& orig) : m_id(orig.m_id),
+	m_name(orig.m_name ? new string(*orig.m_name) : NULL)
+{
+}
+
+/**
+ * Assignment operator
+ */
+InternedName& InternedName::operator=(const InternedName& rhs)
+{
+	if (this != &rhs)
+	{
+		delete m_name;
+		m_id = rhs.m_id;
+		m_name = rhs.m_name ? new string(*rhs.m_name) : NULL;
+	}
+	return *this;
+}
+
+/**
+ * Move assignment operator
+ */
+InternedName& InternedName::operator=(InternedName&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		delete m_name;
+		m_id = rhs.m_id;
+		m_name = rhs.m_name;
+		rhs.m_name = NULL;
+	}
+	return *this;
+}
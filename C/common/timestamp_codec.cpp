@@ -0,0 +1,242 @@
+/*
+ * FogLAMP timestamp parsing and formatting.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <timestamp_codec.h>
+#include <cstdio>
+#include <cstring>
+
+#define SECS_PER_DAY	86400
+
+/*
+ * The date most recently parsed and formatted on this thread
+ */
+static thread_local unsigned int	parsedDate = 0;
+static thread_local long		parsedDays = 0;
+static thread_local long		formattedDays = -1;
+static thread_local char		formattedDate[10];
+
+static inline bool isDigit(char c)
+{
+	return (unsigned char)(c - '0') <= 9;
+}
+
+/**
+ * Read a fixed number of digits
+ *
+ * @param p		The characters to read
+ * @param n		The number of digits
+ * @param value		The value read
+ * @return bool		False if there are fewer than n digits
+ */
+static inline bool readDigits(const char *p, int n, unsigned int *value)
+{
+	unsigned int v = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (!isDigit(p[i]))
+			return false;
+		v = v * 10 + (p[i] - '0');
+	}
+	*value = v;
+	return true;
+}
+
+static inline void writeDigits(char *p, int n, unsigned int value)
+{
+	for (int i = n - 1; i >= 0; i--)
+	{
+		p[i] = '0' + value % 10;
+		value /= 10;
+	}
+}
+
+/**
+ * Return the number of days since 1970-01-01 of a date in the
+ * proleptic Gregorian calendar. Days beyond the end of the month
+ * carry into the next month, as mktime does.
+ *
+ * @param year	The year
+ * @param month	The month, 1 to 12
+ * @param day	The day of the month
+ */
+long TimestampCodec::daysFromCivil(int year, unsigned int month, unsigned int day)
+{
+	year -= month <= 2;
+	const long era = (year >= 0 ? year : year - 399) / 400;
+	const unsigned int yoe = (unsigned int)(year - era * 400);
+	const unsigned int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (long)doe - 719468;
+}
+
+/**
+ * Return the date of a number of days since 1970-01-01
+ *
+ * @param days	The number of days since the epoch
+ * @param year	The year
+ * @param month	The month, 1 to 12
+ * @param day	The day of the month
+ */
+void TimestampCodec::civilFromDays(long days, int *year, unsigned int *month, unsigned int *day)
+{
+	days += 719468;
+	const long era = (days >= 0 ? days : days - 146096) / 146097;
+	const unsigned int doe = (unsigned int)(days - era * 146097);
+	const unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	const unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	const unsigned int mp = (5 * doy + 2) / 153;
+	*day = doy - (153 * mp + 2) / 5 + 1;
+	*month = mp < 10 ? mp + 3 : mp - 9;
+	*year = (int)(yoe + era * 400) + (*month <= 2);
+}
+
+/**
+ * Parse a timestamp of the form YYYY-MM-DD HH:MM:SS[.ffffff][tz]
+ * where the separator may also be 'T' and the optional timezone
+ * is Z or +/-H[H][[:]MM]. The result is in UTC.
+ *
+ * @param str	The timestamp to parse
+ * @param tv	The timeval to populate
+ * @return bool	False if the string is not in this form, tv is unchanged
+ */
+bool TimestampCodec::parse(const char *str, struct timeval *tv)
+{
+unsigned int	year, month, day, hour, min, sec;
+
+	if (!readDigits(str, 4, &year) || str[4] != '-'
+			|| !readDigits(str + 5, 2, &month) || str[7] != '-'
+			|| !readDigits(str + 8, 2, &day) || (str[10] != ' ' && str[10] != 'T')
+			|| !readDigits(str + 11, 2, &hour) || str[13] != ':'
+			|| !readDigits(str + 14, 2, &min) || str[16] != ':'
+			|| !readDigits(str + 17, 2, &sec))
+	{
+		return false;
+	}
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60)
+	{
+		return false;
+	}
+
+	const char *p = str + 19;
+	long usec = 0;
+	if (*p == '.')
+	{
+		p++;
+		int digits = 0;
+		while (isDigit(*p))
+		{
+			if (digits < 6)
+			{
+				usec = usec * 10 + (*p - '0');
+				digits++;
+			}
+			p++;
+		}
+		if (digits == 0)
+			return false;
+		while (digits++ < 6)
+			usec *= 10;
+	}
+
+	long offset = 0;
+	while (*p == ' ')
+		p++;
+	if (*p == 'Z')
+	{
+		p++;
+	}
+	else if (*p == '+' || *p == '-')
+	{
+		int sign = (*p == '+' ? -1 : 1);
+		unsigned int h, m = 0;
+		p++;
+		if (readDigits(p, 2, &h))
+			p += 2;
+		else if (readDigits(p, 1, &h))
+			p++;
+		else
+			return false;
+		if (*p == ':')
+			p++;
+		if (readDigits(p, 2, &m))
+			p += 2;
+		offset = sign * (long)(3600 * h + 60 * m);
+	}
+	while (*p == ' ')
+		p++;
+	if (*p)
+	{
+		return false;
+	}
+
+	unsigned int date = (year << 9) | (month << 5) | day;
+	if (date != parsedDate)
+	{
+		parsedDays = daysFromCivil(year, month, day);
+		parsedDate = date;
+	}
+	tv->tv_sec = (time_t)(parsedDays * SECS_PER_DAY + hour * 3600 + min * 60 + sec + offset);
+	tv->tv_usec = usec;
+	return true;
+}
+
+/**
+ * Format a UTC timestamp as YYYY-MM-DD HH:MM:SS.uuuuuu
+ *
+ * @param tv		The timestamp
+ * @param buf		A buffer of at least TIMESTAMP_BUFFER_LEN characters
+ * @param separator	The separator between the date and the time
+ * @param addUsec	Add the microseconds
+ * @return size_t	The length of the string written to buf
+ */
+size_t TimestampCodec::format(const struct timeval& tv, char *buf, char separator, bool addUsec)
+{
+	long secs = (long)tv.tv_sec;
+	long days = secs / SECS_PER_DAY;
+	long rem = secs % SECS_PER_DAY;
+	if (rem < 0)
+	{
+		rem += SECS_PER_DAY;
+		days--;
+	}
+	if (days != formattedDays)
+	{
+		int year;
+		unsigned int month, day;
+		civilFromDays(days, &year, &month, &day);
+		if (year < 0 || year > 9999)
+		{
+			return snprintf(buf, TIMESTAMP_BUFFER_LEN, addUsec ? "%d-%02u-%02u%c%02ld:%02ld:%02ld.%06ld"
+						: "%d-%02u-%02u%c%02ld:%02ld:%02ld", year, month, day, separator,
+					rem / 3600, (rem / 60) % 60, rem % 60, (long)tv.tv_usec);
+		}
+		writeDigits(formattedDate, 4, year);
+		formattedDate[4] = '-';
+		writeDigits(formattedDate + 5, 2, month);
+		formattedDate[7] = '-';
+		writeDigits(formattedDate + 8, 2, day);
+		formattedDays = days;
+	}
+	memcpy(buf, formattedDate, 10);
+	buf[10] = separator;
+	writeDigits(buf + 11, 2, rem / 3600);
+	buf[13] = ':';
+	writeDigits(buf + 14, 2, (rem / 60) % 60);
+	buf[16] = ':';
+	writeDigits(buf + 17, 2, rem % 60);
+	if (!addUsec)
+	{
+		buf[19] = 0;
+		return 19;
+	}
+	buf[19] = '.';
+	writeDigits(buf + 20, 6, tv.tv_usec);
+	buf[26] = 0;
+	return 26;
+}
@@ -0,0 +1,160 @@
+/*
+ * FogLAMP worker thread pool.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <worker_pool.h>
+#include <logger.h>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+/**
+ * Create a pool and start its threads
+ *
+ * @param name		The name of the pool, used in the statistics
+ * @param threads	The number of worker threads, at least one is started
+ * @param queueSize	The number of tasks that may wait for a thread
+ */
+WorkerPool::WorkerPool(const string& name, unsigned int threads, unsigned int queueSize) :
+	m_name(name), m_queueSize(queueSize), m_running(true), m_active(0),
+	m_maxDepth(0), m_completed(0), m_rejected(0), m_waitTime(0.0), m_runTime(0.0)
+{
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		m_workers.push_back(thread(&WorkerPool::worker, this));
+	}
+}
+
+/**
+ * Destroy the pool, tasks already queued are run first
+ */
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+/**
+ * Stop accepting tasks and wait for the worker threads to run the
+ * tasks that are queued and exit
+ */
+void WorkerPool::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_running = false;
+	}
+	m_cv.notify_all();
+	for (auto& worker : m_workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+/**
+ * Queue a task to be run by one of the worker threads
+ *
+ * @param task	The task to run
+ * @return bool	False if the queue is full or the pool is stopped
+ */
+bool WorkerPool::submit(const function<void()>& task)
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running || m_queue.size() >= m_queueSize)
+		{
+			m_rejected++;
+			return false;
+		}
+		m_queue.emplace_back(task);
+		if (m_queue.size() > m_maxDepth)
+		{
+			m_maxDepth = m_queue.size();
+		}
+	}
+	m_cv.notify_one();
+	return true;
+}
+
+/**
+ * Return the number of tasks waiting for a thread
+ */
+unsigned int WorkerPool::getDepth() const
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_queue.size();
+}
+
+/**
+ * The worker thread, runs tasks from the queue until the pool
+ * is stopped and the queue is empty
+ */
+void WorkerPool::worker()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		while (m_running && m_queue.empty())
+		{
+			m_cv.wait(lck);
+		}
+		if (m_queue.empty())
+		{
+			return;
+		}
+		Task task = std::move(m_queue.front());
+		m_queue.pop_front();
+		m_active++;
+		lck.unlock();
+
+		auto start = chrono::steady_clock::now();
+		try {
+			task.m_run();
+		} catch (exception& ex) {
+			Logger::getLogger()->error("Worker pool %s: task failed, %s", m_name.c_str(), ex.what());
+		} catch (...) {
+			Logger::getLogger()->error("Worker pool %s: task failed", m_name.c_str());
+		}
+		auto end = chrono::steady_clock::now();
+
+		lck.lock();
+		m_active--;
+		m_completed++;
+		m_waitTime += chrono::duration<double>(start - task.m_queued).count();
+		m_runTime += chrono::duration<double>(end - start).count();
+	}
+}
+
+/**
+ * Return the statistics of the pool as a JSON object. Times are
+ * the averages for completed tasks in milliseconds.
+ */
+void WorkerPool::asJSON(string& json) const
+{
+ostringstream convert;
+
+	lock_guard<mutex> guard(m_mutex);
+	convert << "{ \"threads\" : " << m_workers.size() << ",";
+	convert << " \"queueSize\" : " << m_queueSize << ",";
+	convert << " \"depth\" : " << m_queue.size() << ",";
+	convert << " \"maxDepth\" : " << m_maxDepth << ",";
+	convert << " \"active\" : " << m_active << ",";
+	convert << " \"completed\" : " << m_completed << ",";
+	convert << " \"rejected\" : " << m_rejected << ",";
+	convert << fixed << setprecision(3);
+	convert << " \"averageWait\" : " << (m_completed ? m_waitTime * 1000 / m_completed : 0.0) << ",";
+	convert << " \"averageRun\" : " << (m_completed ? m_runTime * 1000 / m_completed : 0.0) << " }";
+	json = convert.str();
+}
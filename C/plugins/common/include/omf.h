@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <exception>
 #include <reading.h>
 #include <http_sender.h>
 #include <zlib.h>
@@ -21,6 +22,7 @@
 #define OMF_TYPE_STRING  "string"
 #define OMF_TYPE_INTEGER "integer"
 #define OMF_TYPE_FLOAT   "number"
+#define OMF_MIN_DATA_READINGS 100	// Fewest readings worth a data message of their own
 
 /**
  * Per asset dataTypes
@@ -36,6 +38,26 @@ class OMFDataTypes
                 std::string types;
 };
 
+/**
+ * The readings of a block acknowledged by the server
+ *
+ * The data of a block may be sent as several messages over parallel
+ * connections, if some of them fail the caller sends the whole block
+ * again and the readings of the messages already acknowledged, wherever
+ * they are in the block, are not sent twice.
+ * firstId and count identify the block, acknowledged has an entry for
+ * each of its readings, set once the server has accepted it.
+ * The object is kept by the caller between calls to sendToServer
+ */
+class OMFAcknowledged
+{
+        public:
+                OMFAcknowledged() : firstId(0), count(0) {};
+                unsigned long firstId;
+                size_t count;
+                std::vector<bool> acknowledged;
+};
+
 /**
  * The OMF class.
  */
@@ -119,6 +141,19 @@ class OMF
 			m_staticData = staticData;
 		};
 
+		// Set the senders used in parallel for the data messages,
+		// types and containers are always sent with the main sender
+		void setDataSenders(std::vector<HttpSender *>& senders)
+		{
+			m_dataSenders = senders;
+		};
+
+		// Set the state of the block partially acknowledged
+		void setAcknowledged(OMFAcknowledged *acknowledged)
+		{
+			m_acknowledged = acknowledged;
+		};
+
 	private:
 		/**
 		 * Builds the HTTP header to send
@@ -192,6 +227,12 @@ class OMF
 		// Remove cached data types enttry for given asset name
 		void clearCreatedTypes(const std::string& key);
 
+		// Check the result of sending a data message
+		bool dataMessageSent(HttpSender& sender,
+				     int res,
+				     std::exception_ptr error,
+				     const std::string& json_not_compressed);
+
 	private:
 		const std::string	m_path;
 		long			m_typeId;
@@ -228,6 +269,12 @@ class OMF
 		std::vector<std::pair<std::string, std::string>>
 			*m_staticData;
 
+		// Senders for the data messages, m_sender if empty
+		std::vector<HttpSender *>
+					m_dataSenders;
+		// The acknowledged part of the last block not sent
+		OMFAcknowledged		*m_acknowledged;
+
 };
 
 /**
@@ -239,8 +286,48 @@ class OMFData
 	public:
 		OMFData(const Reading& reading, const long typeId);
 		const std::string& OMFdataVal() const;
+		static void write(const Reading& reading,
+				  const long typeId,
+				  std::string& out);
 	private:
 		std::string	m_value;
 };
 
+#define OMF_WRITER_BUFFER 16384	// Bytes of JSON text compressed at a time
+
+/**
+ * The OMFDataWriter class.
+ *
+ * Builds the payload of an OMF data message one reading at a time.
+ * With compression the JSON text is written into a small buffer
+ * that is passed to a gzip deflate stream each time it fills, so
+ * that the whole uncompressed message is never held in memory.
+ * A copy of the uncompressed text is kept only if asked for, by
+ * default log messages get a description of the payload instead.
+ */
+class OMFDataWriter
+{
+	public:
+		OMFDataWriter(bool compression, bool keepText = false,
+			      int compressionlevel = Z_DEFAULT_COMPRESSION);
+		~OMFDataWriter();
+		void			append(const Reading& reading, const long typeId);
+		const std::string&	finish();
+		const std::string&	logText() const;
+		size_t			readings() const { return m_readings; };
+		size_t			length() const { return m_length; };
+	private:
+		void			written(size_t start);
+		void			deflateBuffer(int flush);
+	private:
+		bool			m_compression;
+		bool			m_keepText;
+		z_stream		m_zs;
+		std::string		m_buffer;	// Text not yet compressed
+		std::string		m_payload;	// The message payload
+		std::string		m_text;		// Uncompressed copy, or description, of the payload
+		size_t			m_readings;
+		size_t			m_length;	// Bytes of uncompressed text
+};
+
 #endif
@@ -14,6 +14,8 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <thread>
+#include <memory>
 #include <omf.h>
 #include <logger.h>
 #include <zlib.h>
@@ -27,13 +29,35 @@ using namespace rapidjson;
  */
 OMFData::OMFData(const Reading& reading, const long typeId)
 {
-	// Convert reading data into the OMF JSON string
-	m_value.append("{\"containerid\": \"" + to_string(typeId) + "measurement_");
-	m_value.append(reading.getAssetName() + "\", \"values\": [{");
+	OMFData::write(reading, typeId, m_value);
+}
 
+/**
+ * Return the (reference) JSON data in m_value
+ */
+const string& OMFData::OMFdataVal() const
+{
+	return m_value;
+}
+
+/**
+ * Append the OMF JSON data of a reading to a string
+ *
+ * @param reading	The reading to convert
+ * @param typeId	The type-id of the reading asset
+ * @param out		The string the JSON data is appended to
+ */
+void OMFData::write(const Reading& reading, const long typeId, string& out)
+{
+	// Convert reading data into the OMF JSON string
+	out.append("{\"containerid\": \"");
+	out.append(to_string(typeId));
+	out.append("measurement_");
+	out.append(reading.getAssetName());
+	out.append("\", \"values\": [{");
 
 	// Get reading data
-	const vector<Datapoint*> data = reading.getReadingData();
+	const vector<Datapoint*>& data = reading.getReadingData();
 
 	/**
 	 * This loop creates:
@@ -42,22 +66,173 @@ OMFData::OMFData(const Reading& reading, const long typeId)
 	for (vector<Datapoint*>::const_iterator it = data.begin(); it != data.end(); ++it)
 	{
 		// Add datapoint Name
-		m_value.append("\"" + (*it)->getName() + "\": " + (*it)->getData().toString());
-		m_value.append(", ");
+		out.append("\"");
+		out.append((*it)->getName());
+		out.append("\": ");
+		out.append((*it)->getData().toString());
+		out.append(", ");
 	}
 
 	// Append Z to getAssetDateTime(FMT_STANDARD)
-	m_value.append("\"Time\": \"" + reading.getAssetDateUserTime(Reading::FMT_STANDARD) + "Z" + "\"");
+	out.append("\"Time\": \"");
+	out.append(reading.getAssetDateUserTime(Reading::FMT_STANDARD));
+	out.append("Z\"");
 
-	m_value.append("}]}");
+	out.append("}]}");
 }
 
 /**
- * Return the (reference) JSON data in m_value
+ * OMFDataWriter constructor, starts the JSON array of the data message
+ *
+ * @param compression		Whether to gzip the payload
+ * @param keepText		Keep a copy of the uncompressed payload
+ * @param compressionlevel	zlib/gzip Compression level
  */
-const string& OMFData::OMFdataVal() const
+OMFDataWriter::OMFDataWriter(bool compression,
+			     bool keepText,
+			     int compressionlevel) :
+			     m_compression(compression),
+			     m_keepText(keepText),
+			     m_readings(0),
+			     m_length(0)
 {
-	return m_value;
+	const int windowBits = 15;
+	const int GZIP_ENCODING = 16;
+
+	memset(&m_zs, 0, sizeof(m_zs));
+	if (m_compression &&
+	    deflateInit2(&m_zs, compressionlevel, Z_DEFLATED,
+			 windowBits | GZIP_ENCODING, 8,
+			 Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw(std::runtime_error("deflateInit failed while compressing."));
+	}
+
+	string& out = m_compression ? m_buffer : m_payload;
+	size_t start = out.size();
+	out.append("[");
+	written(start);
+}
+
+/**
+ * OMFDataWriter destructor
+ */
+OMFDataWriter::~OMFDataWriter()
+{
+	if (m_compression)
+	{
+		deflateEnd(&m_zs);
+	}
+}
+
+/**
+ * Add the OMF JSON data of a reading to the message
+ *
+ * @param reading	The reading to add
+ * @param typeId	The type-id of the reading asset
+ */
+void OMFDataWriter::append(const Reading& reading, const long typeId)
+{
+	string& out = m_compression ? m_buffer : m_payload;
+	size_t start = out.size();
+	if (m_readings)
+	{
+		out.append(", ");
+	}
+	OMFData::write(reading, typeId, out);
+	m_readings++;
+	written(start);
+}
+
+/**
+ * Close the JSON array and return the payload of the message.
+ * It is called once, after all the readings have been added.
+ *
+ * @return	The payload, gzip compressed if compression is set
+ */
+const string& OMFDataWriter::finish()
+{
+	string& out = m_compression ? m_buffer : m_payload;
+	size_t start = out.size();
+	out.append("]");
+	written(start);
+	if (m_compression)
+	{
+		deflateBuffer(Z_FINISH);
+		if (!m_keepText)
+		{
+			m_text = "<" + to_string(m_readings) + " readings, " +
+				 to_string(m_length) + " bytes compressed>";
+		}
+	}
+	return m_payload;
+}
+
+/**
+ * Return the uncompressed payload for log messages, or a
+ * description of it if the copy has not been kept.
+ * It is called after finish().
+ */
+const string& OMFDataWriter::logText() const
+{
+	return m_compression ? m_text : m_payload;
+}
+
+/**
+ * Account for the text written from a given offset of the
+ * output, and compress the buffer if it is full
+ *
+ * @param start		The offset the text was written from
+ */
+void OMFDataWriter::written(size_t start)
+{
+	string& out = m_compression ? m_buffer : m_payload;
+	m_length += out.size() - start;
+	if (m_compression)
+	{
+		if (m_keepText)
+		{
+			m_text.append(out, start, string::npos);
+		}
+		if (m_buffer.size() >= OMF_WRITER_BUFFER)
+		{
+			deflateBuffer(Z_NO_FLUSH);
+		}
+	}
+}
+
+/**
+ * Pass the buffered text to the deflate stream and append
+ * the compressed bytes to the payload
+ *
+ * @param flush		Z_NO_FLUSH, or Z_FINISH to end the stream
+ */
+void OMFDataWriter::deflateBuffer(int flush)
+{
+	m_zs.next_in = (Bytef *)m_buffer.data();
+	m_zs.avail_in = m_buffer.size();
+
+	int ret;
+	char outbuffer[OMF_WRITER_BUFFER];
+
+	// retrieve the compressed bytes blockwise
+	do {
+		m_zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
+		m_zs.avail_out = sizeof(outbuffer);
+
+		ret = deflate(&m_zs, flush);
+
+		m_payload.append(outbuffer, sizeof(outbuffer) - m_zs.avail_out);
+	} while (m_zs.avail_out == 0);
+
+	m_buffer.clear();
+
+	if (ret == Z_STREAM_ERROR || (flush == Z_FINISH && ret != Z_STREAM_END))
+	{
+		std::ostringstream oss;
+		oss << "Exception during zlib compression: (" << ret << ") " << (m_zs.msg ? m_zs.msg : "");
+		throw(std::runtime_error(oss.str()));
+	}
 }
 
 /**
@@ -75,6 +250,7 @@ OMF::OMF(HttpSender& sender,
 	m_lastError = false;
 	m_changeTypeId = false;
 	m_OMFDataTypes = NULL;
+	m_acknowledged = NULL;
 }
 
 /**
@@ -98,6 +274,7 @@ OMF::OMF(HttpSender& sender,
 
 	m_lastError = false;
 	m_changeTypeId = false;
+	m_acknowledged = NULL;
 }
 
 // Destructor
@@ -392,6 +569,13 @@ bool OMF::sendDataTypes(const Reading& row)
 /**
  * Send all the readings to the PI Server
  *
+ * The data types are sent first, with the main sender, then the
+ * readings are split into data messages sent in parallel, one for
+ * each data sender. The block is sent only when every data message
+ * has been acknowledged, otherwise the readings of the messages that
+ * have been acknowledged are recorded so that they are skipped when
+ * the caller sends the block again.
+ *
  * @param readings            A vector of readings data pointers
  * @param skipSendDataTypes   Send datatypes only once (default is true)
  * @return                    != on success, 0 otherwise
@@ -406,89 +590,147 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	// creation of OMF data types
 	OMF::setMapObjectTypes(readings, superSetDataPoints);
 
+	// Readings of the block already acknowledged
+	const vector<bool> *acknowledged = NULL;
+	if (m_acknowledged &&
+	    !readings.empty() &&
+	    m_acknowledged->firstId == readings.front()->getId() &&
+	    m_acknowledged->count == readings.size() &&
+	    m_acknowledged->acknowledged.size() == readings.size())
+	{
+		acknowledged = &m_acknowledged->acknowledged;
+	}
+
+	// The readings still to send, in the order of the block
+	vector<size_t> pending;
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		if (!acknowledged || !(*acknowledged)[i])
+		{
+			pending.push_back(i);
+		}
+	}
+
+	// Split the readings still to send into one data message per sender,
+	// avoiding messages too small to be worth a connection
+	vector<HttpSender *> senders(m_dataSenders);
+	if (senders.empty())
+	{
+		senders.push_back(&m_sender);
+	}
+	size_t remaining = pending.size();
+	size_t messages = (remaining + OMF_MIN_DATA_READINGS - 1) / OMF_MIN_DATA_READINGS;
+	if (messages > senders.size())
+	{
+		messages = senders.size();
+	}
+	if (messages == 0)
+	{
+		messages = 1;
+	}
+	size_t messageSize = (remaining + messages - 1) / messages;
+	if (messageSize == 0)
+	{
+		messageSize = 1;
+	}
+
 	/*
 	 * Iterate over readings:
 	 * - Send/cache Types
 	 * - transform a reading to OMF format
-	 * - add OMF data to new vector
+	 * - add OMF data to the data message of the reading
 	 */
 
-	// Used for logging
-	string json_not_compressed;
+	// The payload of each data message, written without a copy
+	// of the uncompressed text
+	vector<unique_ptr<OMFDataWriter>> json;
+	try
+	{
+		for (size_t i = 0; i < messages; i++)
+		{
+			json.push_back(unique_ptr<OMFDataWriter>(new OMFDataWriter(compression)));
+		}
 
-	ostringstream jsonData;
-	jsonData << "[";
+		// Fetch Reading* data
+		size_t position = 0;	// Of the reading among those still to send
+		for (vector<Reading *>::const_iterator elem = readings.begin();
+							    elem != readings.end();
+							    ++elem)
+		{
+			bool sendDataTypes;
 
-	// Fetch Reading* data
-	for (vector<Reading *>::const_iterator elem = readings.begin();
-						    elem != readings.end();
-						    ++elem)
-	{
-		bool sendDataTypes;
+			// Create the key for dataTypes sending once
+			long typeId = OMF::getAssetTypeId((**elem).getAssetName());
+			string key((**elem).getAssetName());
 
-		// Create the key for dataTypes sending once
-		long typeId = OMF::getAssetTypeId((**elem).getAssetName());
-		string key((**elem).getAssetName());
+			sendDataTypes = (m_lastError == false && skipSentDataTypes == true) ?
+					 // Send if not already sent
+					 !OMF::getCreatedTypes(key) :
+					 // Always send types
+					 true;
 
-		sendDataTypes = (m_lastError == false && skipSentDataTypes == true) ?
-				 // Send if not already sent
-				 !OMF::getCreatedTypes(key) :
-				 // Always send types
-				 true;
+			Reading* datatypeStructure = NULL;
+			if (sendDataTypes)
+			{
+				// Get the supersetDataPoints for current assetName
+				auto it = superSetDataPoints.find((**elem).getAssetName());
+				if (it != superSetDataPoints.end())
+				{
+					datatypeStructure = (*it).second;
+				}
+			}
 
-		Reading* datatypeStructure = NULL;
-		if (sendDataTypes)
-		{
-			// Get the supersetDataPoints for current assetName
-			auto it = superSetDataPoints.find((**elem).getAssetName());
-			if (it != superSetDataPoints.end())
+			// Check first we have supersetDataPoints for the current reading
+			if ((sendDataTypes && datatypeStructure == NULL) ||
+			    // Handle the data types of the current reading
+			    (sendDataTypes &&
+			    // Send data type
+			    !OMF::handleDataTypes(*datatypeStructure, skipSentDataTypes) &&
+			    // Data type not sent: 
+			    (!m_changeTypeId ||
+			     // Increment type-id and re-send data types
+			     !OMF::handleTypeErrors(*datatypeStructure))))
 			{
-				datatypeStructure = (*it).second;
+				// Remove all assets supersetDataPoints
+				OMF::unsetMapObjectTypes(superSetDataPoints);
+
+				// Failure
+				m_lastError = true;
+				return 0;
 			}
-		}
 
-		// Check first we have supersetDataPoints for the current reading
-		if ((sendDataTypes && datatypeStructure == NULL) ||
-		    // Handle the data types of the current reading
-		    (sendDataTypes &&
-		    // Send data type
-		    !OMF::handleDataTypes(*datatypeStructure, skipSentDataTypes) &&
-		    // Data type not sent: 
-		    (!m_changeTypeId ||
-		     // Increment type-id and re-send data types
-		     !OMF::handleTypeErrors(*datatypeStructure))))
-		{
-			// Remove all assets supersetDataPoints
-			OMF::unsetMapObjectTypes(superSetDataPoints);
+			if (acknowledged && (*acknowledged)[elem - readings.begin()])
+			{
+				// Already acknowledged
+				continue;
+			}
 
-			// Failure
-			m_lastError = true;
-			return 0;
+			// Add into the data message the OMF transformed Reading data
+			json[position++ / messageSize]->append(**elem, typeId);
 		}
+	}
+	catch (const std::exception& e)
+	{
+		// Remove all assets supersetDataPoints
+		OMF::unsetMapObjectTypes(superSetDataPoints);
 
-		// Add into JSON string the OMF transformed Reading data
-		jsonData << OMFData(**elem, typeId).OMFdataVal() <<
-			    (elem < (readings.end() - 1 ) ? ", " : "");
+		Logger::getLogger()->error("Writing JSON readings - error: |%s| - HostPort |%s| - path |%s|",
+					   e.what(),
+					   m_sender.getHostPort().c_str(),
+					   m_path.c_str());
+		// Failure
+		m_lastError = true;
+		return 0;
 	}
 
 	// Remove all assets supersetDataPoints
 	OMF::unsetMapObjectTypes(superSetDataPoints);
 
-	jsonData << "]";
-
-	string json = jsonData.str();
-	json_not_compressed = json;
-
-	if (compression)
-	{
-		json = compress_string(json);
-	}
-
 	/**
-	 * Types messages sent, now transform each reading to OMF format.
+	 * Types messages sent, now send the data messages.
 	 *
-	 * After formatting the new vector of data can be sent
-	 * with one message only
+	 * Each data message is completed and sent with its own sender,
+	 * the first one in this thread, the others in threads of their own
 	 */
 
 	// Create header for Readings data
@@ -496,31 +738,122 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	if (compression)
 		readingData.push_back(pair<string, string>("compression", "gzip"));
 
-	// Build an HTTPS POST with 'readingData headers
-	// and 'allReadings' JSON payload
-	// Then get HTTPS POST ret code and return 0 to client on error
+	// Build the HTTPS POSTs with 'readingData headers
+	// and the JSON payloads, then get the HTTPS POST ret codes
+	vector<int> results(messages, 0);
+	vector<exception_ptr> errors(messages);
+	auto sendData = [&](size_t i)
+	{
+		try
+		{
+			results[i] = senders[i]->sendRequest("POST",
+							     m_path,
+							     readingData,
+							     json[i]->finish());
+		}
+		catch (...)
+		{
+			errors[i] = current_exception();
+		}
+	};
+	vector<thread> threads;
+	for (size_t i = 1; i < messages; i++)
+	{
+		threads.push_back(thread(sendData, i));
+	}
+	sendData(0);
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+
+	// Check every message, a failed one does not hold back the others
+	vector<bool> messageSent(messages);
+	bool allSent = true;
+	for (size_t i = 0; i < messages; i++)
+	{
+		messageSent[i] = OMF::dataMessageSent(*senders[i],
+						      results[i],
+						      errors[i],
+						      json[i]->logText());
+		allSent = allSent && messageSent[i];
+	}
+
+	if (!allSent)
+	{
+		if (m_acknowledged && !readings.empty())
+		{
+			// Record the readings of the acknowledged messages
+			if (!acknowledged)
+			{
+				m_acknowledged->firstId = readings.front()->getId();
+				m_acknowledged->count = readings.size();
+				m_acknowledged->acknowledged.assign(readings.size(), false);
+			}
+			for (size_t i = 0; i < messages; i++)
+			{
+				for (size_t p = i * messageSize;
+				     messageSent[i] && p < min((i + 1) * messageSize, remaining);
+				     p++)
+				{
+					m_acknowledged->acknowledged[pending[p]] = true;
+				}
+			}
+		}
+		// Failure
+		m_lastError = true;
+		return 0;
+	}
+
+	if (m_acknowledged)
+	{
+		m_acknowledged->count = 0;
+		m_acknowledged->acknowledged.clear();
+	}
+
+	// Reset error indicator
+	m_lastError = false;
+
+	// Return number of sent readings to the caller
+	return readings.size();
+}
+
+/**
+ * Check the result of sending a data message
+ *
+ * Data type errors the server reports for some assets are
+ * considered not blocking: the readings are skipped and the
+ * data types of the assets are sent again with the next block.
+ *
+ * @param sender		The sender used for the message
+ * @param res			The HTTP code returned by the sender
+ * @param error			The exception raised by the sender, if any
+ * @param json_not_compressed	The JSON payload, for logging
+ * @return			True if the message has been acknowledged
+ *				or it has a not blocking error
+ */
+bool OMF::dataMessageSent(HttpSender& sender,
+			  int res,
+			  exception_ptr error,
+			  const string& json_not_compressed)
+{
 	try
 	{
-		int res = m_sender.sendRequest("POST",
-					       m_path,
-					       readingData,
-					       json);
+		if (error)
+		{
+			rethrow_exception(error);
+		}
 		if (res != 200 && res != 202 && res != 204)
 		{
 			Logger::getLogger()->error("Sending JSON readings, "
 						   "- error: HTTP code |%d| - HostPort |%s| - path |%s| - OMF message |%s|",
 						   res,
-						   m_sender.getHostPort().c_str(),
+						   sender.getHostPort().c_str(),
 						   m_path.c_str(),
 						   json_not_compressed.c_str() );
-			m_lastError = true;
-			return 0;
+			return false;
 		}
-		// Reset error indicator
-		m_lastError = false;
-
-		// Return number of sent readings to the caller
-		return readings.size();
+		return true;
 	}
 	// Exception raised fof HTTP 400 Bad Request
 	catch (const BadRequest& e)
@@ -537,7 +870,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			Logger::getLogger()->warn("Sending JSON readings, "
 						  "not blocking issue: |%s| - HostPort |%s| - path |%s| - OMF message |%s|",
 						  e.what(),
-						  m_sender.getHostPort().c_str(),
+						  sender.getHostPort().c_str(),
 						  m_path.c_str(),
 						  json_not_compressed.c_str() );
 
@@ -559,7 +892,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 							  "|%s| - HostPort |%s| - path |%s| - OMF message |%s|",
 							  m_typeId,
 							  e.what(),
-							  m_sender.getHostPort().c_str(),
+							  sender.getHostPort().c_str(),
 							  m_path.c_str(),
 							  json_not_compressed.c_str());
 			}
@@ -576,40 +909,33 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 							  "- HostPort |%s| - path |%s| - OMF message |%s|",
 							  assetName.c_str(),
 							  OMF::getAssetTypeId(assetName),
-							  m_sender.getHostPort().c_str(),
+							  sender.getHostPort().c_str(),
 							  m_path.c_str(),
 							  json_not_compressed.c_str());
                         }
 
-			// Reset error indicator
-			m_lastError = false;
-
-			// It returns size instead of 0 as the rows in the block should be skipped in case of an error
-			// as it is considered a not blocking ones.
-			return readings.size();
+			// The readings in the message are skipped in case of an error
+			// considered a not blocking one.
+			return true;
 		}
 		else
 		{
 			Logger::getLogger()->error("Sending JSON data error: |%s| - HostPort |%s| - path |%s| - OMF message |%s|",
 			                           e.what(),
-			                           m_sender.getHostPort().c_str(),
+			                           sender.getHostPort().c_str(),
 			                           m_path.c_str(),
 			                           json_not_compressed.c_str());
 		}
-		// Failure
-		m_lastError = true;
-		return 0;
+		return false;
 	}
 	catch (const std::exception& e)
 	{
 		Logger::getLogger()->error("Sending JSON data error: |%s| - HostPort |%s| - path |%s| - OMF message |%s|",
 					   e.what(),
-					   m_sender.getHostPort().c_str(),
+					   sender.getHostPort().c_str(),
 					   m_path.c_str(),
 					   json_not_compressed.c_str() );
-		// Failure
-		m_lastError = true;
-		return 0;
+		return false;
 	}
 }
 
@@ -63,6 +63,11 @@ using namespace rapidjson;
 				"\"description\": \"Max number of retries for the communication with the OMF PI Connector Relay\", " \
 				"\"type\": \"integer\", \"default\": \"3\", " \
 				"\"order\": \"10\", \"displayName\": \"Maximum Retry\" }, " \
+			"\"OMFConnections\": { " \
+				"\"description\": \"Number of connections used in parallel to send the readings " \
+				"to the OMF PI Connector Relay\", " \
+				"\"type\": \"integer\", \"default\": \"4\", " \
+				"\"order\": \"11\", \"displayName\": \"Parallel Connections\" }, " \
 			"\"OMFHttpTimeout\": { " \
 				"\"description\": \"Timeout in seconds for the HTTP operations with the OMF PI Connector Relay\", " \
 				"\"type\": \"integer\", \"default\": \"10\", " \
@@ -114,6 +119,10 @@ using namespace rapidjson;
 typedef struct
 {
 	SimpleHttps	*sender;	// HTTPS connection
+	vector<HttpSender *>
+			dataSenders;	// HTTPS connections for the data messages
+	unsigned int	connections;	// Number of data connections
+	OMFAcknowledged	acknowledged;	// Acknowledged part of the last block
 	OMF 		*omf;		// OMF data protocol
 	bool		compression;	// whether to compress readings' data
 	string		hostAndPort;	// hostname:port for SimpleHttps
@@ -138,6 +147,8 @@ typedef struct
 string saveSentDataTypes(CONNECTOR_INFO* connInfo);
 void loadSentDataTypes(CONNECTOR_INFO* connInfo, Document& JSONData);
 long getMaxTypeId(CONNECTOR_INFO* connInfo);
+void setConnectorConfig(CONNECTOR_INFO* connInfo, const ConfigCategory* configData);
+void deleteSenders(CONNECTOR_INFO* connInfo);
 
 /**
  * Return the information about this plugin
@@ -155,7 +166,7 @@ static PLUGIN_INFORMATION info = {
 	"1.0.0",			// Version
 	SP_PERSIST_DATA,		// Flags
 	PLUGIN_TYPE_NORTH,		// Type
-	"1.0.0",			// Interface version
+	"2.0.0",			// Interface version
 	PLUGIN_DEFAULT_CONFIG_INFO      // Configuration
 };
 
@@ -174,97 +185,12 @@ PLUGIN_INFORMATION *plugin_info()
  */
 PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 {
-	/**
-	 * Handle the PI Server parameters here
-	 */
-	string url = configData->getValue("URL");
-
-	unsigned int retrySleepTime = atoi(configData->getValue("OMFRetrySleepTime").c_str());
-	unsigned int maxRetry = atoi(configData->getValue("OMFMaxRetry").c_str());
-	unsigned int timeout = atoi(configData->getValue("OMFHttpTimeout").c_str());
-
-	string producerToken = configData->getValue("producerToken");
-
-	string formatNumber = configData->getValue("formatNumber");
-	string formatInteger = configData->getValue("formatInteger");
-
-	
-
-	/**
-	 * Extract host, port, path from URL
-	 */
-	size_t findProtocol = url.find_first_of(":");
-	string protocol = url.substr(0,findProtocol);
-
-	string tmpUrl = url.substr(findProtocol + 3);
-	size_t findPort = tmpUrl.find_first_of(":");
-	string hostName = tmpUrl.substr(0, findPort);
-
-	size_t findPath = tmpUrl.find_first_of("/");
-	string port = tmpUrl.substr(findPort + 1 , findPath - findPort -1);
-	string path = tmpUrl.substr(findPath);
-
-	string hostAndPort(hostName + ":" + port);	
-
 	// Allocate connector struct
 	CONNECTOR_INFO* connInfo = new CONNECTOR_INFO;
-	// Set configuration felds
-	connInfo->hostAndPort = hostAndPort;
-	connInfo->path = path;
-	connInfo->retrySleepTime = retrySleepTime;
-	connInfo->maxRetry = maxRetry;
-	connInfo->timeout = timeout;
+	connInfo->sender = NULL;
 	connInfo->typeId = TYPE_ID_DEFAULT;
-	connInfo->producerToken = producerToken;
-	connInfo->formatNumber = formatNumber;
-	connInfo->formatInteger = formatInteger;
-
-	// Use compression ?
-	string compr = configData->getValue("compression");
-	if (compr == "True" || compr == "true" || compr == "TRUE")
-		connInfo->compression = true;
-	else
-		connInfo->compression = false;
-
-	// Set the list of errors considered not blocking in the communication
-	// with the PI Server
-	JSONStringToVectorString(connInfo->notBlockingErrors ,
-	                         configData->getValue("notBlockingErrors"),
-	                         std::string("errors400"));
-	/**
-	 * Add static data
-	 * Split the string up into each pair
-	 */
-	string staticData = configData->getValue("StaticData");
-	size_t pos = 0;
-	size_t start = 0;
-	do {
-		pos = staticData.find(",", start);
-		string item = staticData.substr(start, pos);
-		start = pos + 1;
-		size_t pos2 = 0;
-		if ((pos2 = item.find(":")) != string::npos)
-		{
-			string name = item.substr(0, pos2);
-			while (name[0] == ' ')
-				name = name.substr(1);
-			string value = item.substr(pos2 + 1);
-			while (value[0] == ' ')
-				value = value.substr(1);
-			pair<string, string> sData = make_pair(name, value);
-			connInfo->staticData.push_back(sData);
-		}
-	} while (pos != string::npos);
-
-#if VERBOSE_LOG
-	// Log plugin configuration
-	Logger::getLogger()->info("%s plugin configured: URL=%s, "
-				  "producerToken=%s, compression=%s",
-				  PLUGIN_NAME,
-				  url.c_str(),
-				  producerToken.c_str(),
-				  connInfo->compression ? "True" : "False");
-#endif
+	// Set configuration felds
+	setConnectorConfig(connInfo, configData);
 
 	return (PLUGIN_HANDLE)connInfo;
 }
@@ -330,6 +256,37 @@ void plugin_start(const PLUGIN_HANDLE handle,
 	}
 }
 
+/**
+ * Reconfigure the plugin
+ *
+ * The HTTPS handlers are deleted, the next send creates them
+ * for the new destination and connection settings. The readings
+ * of a block acknowledged by the previous destination are only
+ * kept if the destination has not changed.
+ *
+ * @param handle	The plugin handle
+ * @param newConfig	The new configuration of the plugin
+ */
+void plugin_reconfigure(PLUGIN_HANDLE* handle, const string& newConfig)
+{
+	CONNECTOR_INFO* connInfo = (CONNECTOR_INFO *)*handle;
+	ConfigCategory config("new", newConfig);
+
+	string hostAndPort(connInfo->hostAndPort);
+	string path(connInfo->path);
+	setConnectorConfig(connInfo, &config);
+	deleteSenders(connInfo);
+
+	if (hostAndPort.compare(connInfo->hostAndPort) || path.compare(connInfo->path))
+	{
+		connInfo->acknowledged = OMFAcknowledged();
+		Logger::getLogger()->info("%s plugin: sending to %s%s",
+					  PLUGIN_NAME,
+					  connInfo->hostAndPort.c_str(),
+					  connInfo->path.c_str());
+	}
+}
+
 /**
  * Send Readings data to historian server
  */
@@ -339,15 +296,31 @@ uint32_t plugin_send(const PLUGIN_HANDLE handle,
 	CONNECTOR_INFO* connInfo = (CONNECTOR_INFO *)handle;
         
 	/**
-	 * Allocate the HTTPS handler for "Hostname : port"
+	 * Allocate the HTTPS handlers for "Hostname : port"
 	 * connect_timeout and request_timeout.
 	 * Default is no timeout at all
+	 *
+	 * The handlers are kept until the plugin is shut down
+	 * so that the connections are reused for each block.
+	 * The first one also sends the types and containers.
 	 */
-	connInfo->sender = new SimpleHttps(connInfo->hostAndPort,
-					   connInfo->timeout,
-					   connInfo->timeout,
-					   connInfo->retrySleepTime,
-					   connInfo->maxRetry);
+	if (!connInfo->sender)
+	{
+		connInfo->sender = new SimpleHttps(connInfo->hostAndPort,
+						   connInfo->timeout,
+						   connInfo->timeout,
+						   connInfo->retrySleepTime,
+						   connInfo->maxRetry);
+		connInfo->dataSenders.push_back(connInfo->sender);
+		for (unsigned int i = 1; i < connInfo->connections; i++)
+		{
+			connInfo->dataSenders.push_back(new SimpleHttps(connInfo->hostAndPort,
+									connInfo->timeout,
+									connInfo->timeout,
+									connInfo->retrySleepTime,
+									connInfo->maxRetry));
+		}
+	}
 
 	// Allocate the PI Server data protocol
 	connInfo->omf = new OMF(*connInfo->sender,
@@ -363,6 +336,8 @@ uint32_t plugin_send(const PLUGIN_HANDLE handle,
 
 	connInfo->omf->setStaticData(&connInfo->staticData);
 	connInfo->omf->setNotBlockingErrors(connInfo->notBlockingErrors);
+	connInfo->omf->setDataSenders(connInfo->dataSenders);
+	connInfo->omf->setAcknowledged(&connInfo->acknowledged);
 
 	// Send data
 	uint32_t ret = connInfo->omf->sendToServer(readings,
@@ -380,7 +355,6 @@ uint32_t plugin_send(const PLUGIN_HANDLE handle,
 					  connInfo->typeId);
 	}
 	// Delete objects
-	delete connInfo->sender;
 	delete connInfo->omf;
 
 	// Return sent data ret code
@@ -427,6 +401,9 @@ string plugin_shutdown(PLUGIN_HANDLE handle)
 				   PLUGIN_NAME,
 				   saveData.str().c_str());
 
+	// Delete the HTTPS handlers
+	deleteSenders(connInfo);
+
 	// Delete plugin handle
 	delete connInfo;
 
@@ -437,6 +414,133 @@ string plugin_shutdown(PLUGIN_HANDLE handle)
 // End of extern "C"
 };
 
+/**
+ * Set the fields of the CONNECTOR_INFO data structure from the
+ * configuration of the plugin
+ *
+ * @param connInfo	The CONNECTOR_INFO data structure
+ * @param configData	The configuration of the plugin
+ */
+void setConnectorConfig(CONNECTOR_INFO* connInfo, const ConfigCategory* configData)
+{
+	/**
+	 * Handle the PI Server parameters here
+	 */
+	connInfo->notBlockingErrors.clear();
+	connInfo->staticData.clear();
+
+	string url = configData->getValue("URL");
+
+	unsigned int retrySleepTime = atoi(configData->getValue("OMFRetrySleepTime").c_str());
+	unsigned int maxRetry = atoi(configData->getValue("OMFMaxRetry").c_str());
+	unsigned int timeout = atoi(configData->getValue("OMFHttpTimeout").c_str());
+	unsigned int connections = 1;
+	if (configData->itemExists("OMFConnections"))
+	{
+		connections = atoi(configData->getValue("OMFConnections").c_str());
+		if (connections < 1)
+		{
+			connections = 1;
+		}
+	}
+
+	string producerToken = configData->getValue("producerToken");
+
+	string formatNumber = configData->getValue("formatNumber");
+	string formatInteger = configData->getValue("formatInteger");
+
+	
+
+	/**
+	 * Extract host, port, path from URL
+	 */
+	size_t findProtocol = url.find_first_of(":");
+	string protocol = url.substr(0,findProtocol);
+
+	string tmpUrl = url.substr(findProtocol + 3);
+	size_t findPort = tmpUrl.find_first_of(":");
+	string hostName = tmpUrl.substr(0, findPort);
+
+	size_t findPath = tmpUrl.find_first_of("/");
+	string port = tmpUrl.substr(findPort + 1 , findPath - findPort -1);
+	string path = tmpUrl.substr(findPath);
+
+	string hostAndPort(hostName + ":" + port);	
+
+	// Set configuration felds
+	connInfo->hostAndPort = hostAndPort;
+	connInfo->path = path;
+	connInfo->retrySleepTime = retrySleepTime;
+	connInfo->maxRetry = maxRetry;
+	connInfo->timeout = timeout;
+	connInfo->connections = connections;
+	connInfo->producerToken = producerToken;
+	connInfo->formatNumber = formatNumber;
+	connInfo->formatInteger = formatInteger;
+
+	// Use compression ?
+	string compr = configData->getValue("compression");
+	if (compr == "True" || compr == "true" || compr == "TRUE")
+		connInfo->compression = true;
+	else
+		connInfo->compression = false;
+
+	// Set the list of errors considered not blocking in the communication
+	// with the PI Server
+	JSONStringToVectorString(connInfo->notBlockingErrors ,
+	                         configData->getValue("notBlockingErrors"),
+	                         std::string("errors400"));
+	/**
+	 * Add static data
+	 * Split the string up into each pair
+	 */
+	string staticData = configData->getValue("StaticData");
+	size_t pos = 0;
+	size_t start = 0;
+	do {
+		pos = staticData.find(",", start);
+		string item = staticData.substr(start, pos);
+		start = pos + 1;
+		size_t pos2 = 0;
+		if ((pos2 = item.find(":")) != string::npos)
+		{
+			string name = item.substr(0, pos2);
+			while (name[0] == ' ')
+				name = name.substr(1);
+			string value = item.substr(pos2 + 1);
+			while (value[0] == ' ')
+				value = value.substr(1);
+			pair<string, string> sData = make_pair(name, value);
+			connInfo->staticData.push_back(sData);
+		}
+	} while (pos != string::npos);
+
+#if VERBOSE_LOG
+	// Log plugin configuration
+	Logger::getLogger()->info("%s plugin configured: URL=%s, "
+				  "producerToken=%s, compression=%s",
+				  PLUGIN_NAME,
+				  url.c_str(),
+				  producerToken.c_str(),
+				  connInfo->compression ? "True" : "False");
+#endif
+}
+
+/**
+ * Delete the HTTPS handlers, they are created again by the next send
+ *
+ * @param connInfo	The CONNECTOR_INFO data structure
+ */
+void deleteSenders(CONNECTOR_INFO* connInfo)
+{
+	for (auto sender : connInfo->dataSenders)
+	{
+		delete sender;
+	}
+	connInfo->dataSenders.clear();
+	connInfo->sender = NULL;
+}
+
 /**
  * Return a JSON string with the dataTypes to save in plugion_data
  *
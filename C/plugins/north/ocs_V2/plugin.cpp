@@ -139,7 +139,7 @@ static PLUGIN_INFORMATION info = {
 	"1.0.0",			// Version
 	SP_PERSIST_DATA,		// Flags
 	PLUGIN_TYPE_NORTH,		// Type
-	"1.0.0",			// Interface version
+	"2.0.0",			// Interface version
 	PLUGIN_DEFAULT_CONFIG_INFO      // Configuration
 };
 
@@ -10,6 +10,7 @@
 #include <connection.h>
 #include <connection_manager.h>
 #include <sql_buffer.h>
+#include <readings_partitions.h>
 #include <iostream>
 #include <libpq-fe.h>
 #include "rapidjson/document.h"
@@ -36,6 +37,9 @@ static time_t connectErrorTime = 0;
 // Format timestamp having microseconds
 #define F_DATEH24_US    	"YYYY-MM-DD HH24:MI:SS.US"
 
+// Number of bytes of readings sent in each COPY data message
+#define READINGS_COPY_BLOCK	65536
+
 const vector<string>  pg_column_reserved_words = {
 	"user"
 };
@@ -1182,14 +1186,13 @@ bool Connection::formatDate(char *formatted_date, size_t buffer_size, const char
 
 
 /**
- * Append a set of readings to the readings table
+ * Append a set of readings to the readings table. The readings are
+ * streamed to the database with COPY, if that is not possible or
+ * fails the readings are added with an INSERT statement instead.
  */
 int Connection::appendReadings(const char *readings)
 {
 Document 	doc;
-SQLBuffer	sql;
-int		row = 0;
-bool 		add_row = false;
 
 	ParseResult ok = doc.Parse(readings);
 	if (!ok)
@@ -1198,8 +1201,6 @@ bool 		add_row = false;
 		return -1;
 	}
 
-	sql.append("INSERT INTO foglamp.readings ( user_ts, asset_code, read_key, reading ) VALUES ");
-
 	if (!doc.HasMember("readings"))
 	{
 		raiseError("appendReadings", "Payload is missing a readings array");
@@ -1219,8 +1220,162 @@ bool 		add_row = false;
 					"Each reading in the readings array must be an object");
 			return -1;
 		}
-		add_row = true;
+	}
+
+	ReadingsPartitions *partitions = ReadingsPartitions::getInstance();
+	if (partitions)
+	{
+		// Create the partitions the coming readings will be held in
+		partitions->maintain(this);
+	}
+	int rows = copyReadings(rdings);
+	if (rows == -1)
+	{
+		rows = insertReadings(rdings);
+	}
+	return rows;
+}
+
+/**
+ * Append a value to a COPY text format row, escaping the characters
+ * that have a meaning in the COPY format.
+ *
+ * @param row	The row to append to
+ * @param value	The column value
+ */
+static void copyValue(string& row, const char *value)
+{
+	for (const char *p = value; *p; p++)
+	{
+		switch (*p)
+		{
+		case '\\': row += "\\\\"; break;
+		case '\t': row += "\\t"; break;
+		case '\n': row += "\\n"; break;
+		case '\r': row += "\\r"; break;
+		default: row += *p; break;
+		}
+	}
+}
+
+/**
+ * Stream a set of readings into the readings table using COPY in text
+ * format. Rows are sent in blocks of READINGS_COPY_BLOCK bytes as the
+ * readings are converted.
+ *
+ * COPY can not evaluate a function passed as the user_ts, if there are
+ * such readings the INSERT path must be used.
+ *
+ * @param readings	The array of readings to append
+ * @return int		The number of readings added or -1 if the COPY failed
+ */
+int Connection::copyReadings(const Value& readings)
+{
+static const regex function("[a-zA-Z][a-zA-Z0-9_]*\\(.*\\)");
+string	block;
+
+	for (Value::ConstValueIterator itr = readings.Begin(); itr != readings.End(); ++itr)
+	{
+		if (regex_match((*itr)["user_ts"].GetString(), function))
+		{
+			return -1;
+		}
+	}
+
+	const char *query = "COPY foglamp.readings ( user_ts, asset_code, read_key, reading ) FROM STDIN;";
+	logSQL("ReadingsCopy", query);
+	PGresult *res = PQexec(dbConnection, query);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+	{
+		Logger::getLogger()->warn("Unable to COPY readings, using INSERT: %s",
+				PQerrorMessage(dbConnection));
+		PQclear(res);
+		return -1;
+	}
+	PQclear(res);
+
+	bool failed = false;
+	block.reserve(READINGS_COPY_BLOCK + 1024);
+	for (Value::ConstValueIterator itr = readings.Begin(); itr != readings.End() && !failed; ++itr)
+	{
+		const char *str = (*itr)["user_ts"].GetString();
+		char formatted_date[LEN_BUFFER_DATE] = {0};
+		if (! formatDate(formatted_date, sizeof(formatted_date), str) )
+		{
+			raiseError("appendReadings", "Invalid date |%s|", str);
+			continue;
+		}
+		copyValue(block, formatted_date);
+		block += '\t';
+		copyValue(block, (*itr)["asset_code"].GetString());
+		block += '\t';
+
+		// Python code is passing the string None when here is no read_key in the payload
+		if (itr->HasMember("read_key") && strcmp((*itr)["read_key"].GetString(), "None") != 0)
+		{
+			copyValue(block, (*itr)["read_key"].GetString());
+		}
+		else
+		{
+			block += "\\N";
+		}
+		block += '\t';
+
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		(*itr)["reading"].Accept(writer);
+		copyValue(block, buffer.GetString());
+		block += '\n';
+
+		if (block.length() >= READINGS_COPY_BLOCK)
+		{
+			failed = PQputCopyData(dbConnection, block.data(), block.length()) != 1;
+			block.clear();
+		}
+	}
+	if (!failed && !block.empty())
+	{
+		failed = PQputCopyData(dbConnection, block.data(), block.length()) != 1;
+	}
+
+	int rows = -1;
+	if (PQputCopyEnd(dbConnection, failed ? "Readings append aborted" : NULL) == 1)
+	{
+		while ((res = PQgetResult(dbConnection)) != NULL)
+		{
+			if (PQresultStatus(res) == PGRES_COMMAND_OK)
+			{
+				rows = atoi(PQcmdTuples(res));
+			}
+			PQclear(res);
+		}
+	}
+	if (rows == -1)
+	{
+		Logger::getLogger()->warn("COPY of readings failed, using INSERT: %s",
+				PQerrorMessage(dbConnection));
+	}
+	return rows;
+}
+
+/**
+ * Append a set of readings to the readings table with a single INSERT
+ * statement.
+ *
+ * @param readings	The array of readings to append
+ * @return int		The number of readings added or -1 on error
+ */
+int Connection::insertReadings(const Value& readings)
+{
+SQLBuffer	sql;
+int		row = 0;
+bool 		add_row = false;
 
+	sql.append("INSERT INTO foglamp.readings ( user_ts, asset_code, read_key, reading ) VALUES ");
+
+	for (Value::ConstValueIterator itr = readings.Begin(); itr != readings.End(); ++itr)
+	{
+		add_row = true;
 		const char *str = (*itr)["user_ts"].GetString();
 		// Check if the string is a function
 		string s (str);
@@ -1300,8 +1455,9 @@ bool 		add_row = false;
 	delete[] query;
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
+		int rows = atoi(PQcmdTuples(res));
 		PQclear(res);
-		return atoi(PQcmdTuples(res));
+		return rows;
 	}
  	raiseError("appendReadings", PQerrorMessage(dbConnection));
 	PQclear(res);
@@ -1340,6 +1496,8 @@ SQLBuffer sql;
 long unsentPurged = 0;
 long unsentRetained = 0;
 long numReadings = 0;
+unsigned long droppedRows = 0;
+ReadingsPartitions *partitions = ReadingsPartitions::getInstance();
 
 	if (age == 0)
 	{
@@ -1365,6 +1523,11 @@ long numReadings = 0;
 			return 0;
 		}
 	}
+	if (partitions)
+	{
+		// Whole partitions older than the age are dropped, the rest are deleted
+		droppedRows = partitions->dropExpired(this, age, flags, sent, unsentPurged);
+	}
 	if ((flags & 0x01) == 0)
 	{
 		// Get number of unsent rows we are about to remove
@@ -1380,7 +1543,7 @@ long numReadings = 0;
 		delete[] query;
 		if (PQresultStatus(res) == PGRES_TUPLES_OK)
 		{
-			unsentPurged = atol(PQgetvalue(res, 0, 0));
+			unsentPurged += atol(PQgetvalue(res, 0, 0));
 			PQclear(res);
 		}
 		else
@@ -1409,7 +1572,7 @@ long numReadings = 0;
  		raiseError("retrieve", PQerrorMessage(dbConnection));
 		return 0;
 	}
-	unsigned int deletedRows = (unsigned int)atoi(PQcmdTuples(res));
+	unsigned int deletedRows = (unsigned int)(atoi(PQcmdTuples(res)) + droppedRows);
 	PQclear(res);
 
 	SQLBuffer retainedBuffer;
@@ -1430,16 +1593,24 @@ long numReadings = 0;
 	}
 	PQclear(res);
 
-	res = PQexec(dbConnection, "SELECT count(*) FROM foglamp.readings;");
-	if (PQresultStatus(res) == PGRES_TUPLES_OK)
+	if (partitions)
 	{
-		numReadings = atol(PQgetvalue(res, 0, 0));
+		// Counted by the triggers on the readings table
+		numReadings = partitions->count(this);
 	}
 	else
 	{
- 		raiseError("retrieve", PQerrorMessage(dbConnection));
+		res = PQexec(dbConnection, "SELECT count(*) FROM foglamp.readings;");
+		if (PQresultStatus(res) == PGRES_TUPLES_OK)
+		{
+			numReadings = atol(PQgetvalue(res, 0, 0));
+		}
+		else
+		{
+ 			raiseError("retrieve", PQerrorMessage(dbConnection));
+		}
+		PQclear(res);
 	}
-	PQclear(res);
 
 	ostringstream convert;
 
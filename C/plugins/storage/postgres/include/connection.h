@@ -38,6 +38,7 @@ class Connection {
 						    std::string& resultSet);
 
 	private:
+		friend class	ReadingsPartitions;
 		bool		m_logSQL;
 		void		raiseError(const char *operation, const char *reason,...);
 		PGconn		*dbConnection;
@@ -51,5 +52,7 @@ class Connection {
 		const std::string	escape(const std::string&);
     		const std::string 	double_quote_reserved_column_name(const std::string &column_name);
 		void		logSQL(const char *, const char *);
+		int		copyReadings(const rapidjson::Value& readings);
+		int		insertReadings(const rapidjson::Value& readings);
 };
 #endif
@@ -0,0 +1,69 @@
+#ifndef _READINGS_PARTITIONS_H
+#define _READINGS_PARTITIONS_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <connection.h>
+#include <libpq-fe.h>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+// Set to "hour" or "day" to partition the readings table by user_ts
+#define PARTITION_ENV		"POSTGRES_READINGS_PARTITION"
+#define PARTITION_PREFIX	"readings_p"		// Followed by the period, YYYYMMDDHH
+#define PARTITION_DEFAULT	"readings_default"	// Readings outside the partitions
+#define PARTITION_AHEAD		2			// Periods partitions are created ahead
+#define PARTITION_CHECK		600			// Seconds between the checks made by appends
+#define PARTITION_MIN_VERSION	110000			// Default partitions need PostgreSQL 11
+
+/**
+ * The declarative partitioning of the readings table by ranges of
+ * user_ts, an hour or a day per partition.
+ *
+ * Partitions are created ahead of the current period, readings
+ * outside them are held in a default partition and moved when a
+ * partition is created for them. A purge by age detaches and drops
+ * the partitions that end before the age rather than deleting their
+ * readings.
+ *
+ * The number of readings in each partition is kept in the
+ * readings_count table by statement triggers on the readings table,
+ * so that a purge does not count the readings table. Each statement
+ * adds a row of its own, the rows are summed when the partitions are
+ * checked.
+ *
+ * Once the database has been partitioned it stays partitioned, the
+ * existing readings table becomes the first partition.
+ */
+class ReadingsPartitions {
+	public:
+		static bool			initialise(Connection *conn);
+		static void			shutdown();
+		static ReadingsPartitions	*getInstance() { return m_instance; };
+		void				maintain(Connection *conn);
+		unsigned long			dropExpired(Connection *conn, unsigned long age,
+							    unsigned int flags, unsigned long sent,
+							    long& unsentPurged);
+		long				count(Connection *conn);
+
+	private:
+		ReadingsPartitions(const std::string& unit);
+		bool				createPartitions(Connection *conn);
+		bool				compactCounts(Connection *conn);
+		bool				exec(Connection *conn, const std::string& sql);
+		PGresult			*query(Connection *conn, const std::string& sql);
+
+		static ReadingsPartitions	*m_instance;
+		const std::string		m_unit;		// hour or day
+		std::mutex			m_mutex;
+		std::atomic<time_t>		m_checked;	// When partitions were last created
+};
+
+#endif
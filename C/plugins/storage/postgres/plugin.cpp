@@ -9,6 +9,7 @@
  */
 #include <connection_manager.h>
 #include <connection.h>
+#include <readings_partitions.h>
 #include <plugin_api.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -60,6 +61,9 @@ PLUGIN_HANDLE plugin_init()
 ConnectionManager *manager = ConnectionManager::getInstance();
 
 	manager->growPool(5);
+	Connection *connection = manager->allocate();
+	ReadingsPartitions::initialise(connection);
+	manager->release(connection);
 	return manager;
 }
 
@@ -215,6 +219,7 @@ bool plugin_shutdown(PLUGIN_HANDLE handle)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
   
+	ReadingsPartitions::shutdown();
 	manager->shutdown();
 	return true;
 }
@@ -0,0 +1,411 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <readings_partitions.h>
+#include <logger.h>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+
+using namespace std;
+
+ReadingsPartitions *ReadingsPartitions::m_instance = 0;
+
+/**
+ * The indexes of the readings table, created on each partition
+ */
+static string partitionIndexes(const string& name)
+{
+	ostringstream sql;
+	sql << "ALTER TABLE foglamp." << name << " ADD PRIMARY KEY (id);";
+	sql << "CREATE UNIQUE INDEX " << name << "_key ON foglamp." << name << " (read_key);";
+	sql << "CREATE INDEX " << name << "_ix1 ON foglamp." << name << " USING btree (asset_code, user_ts desc);";
+	sql << "CREATE INDEX " << name << "_ix2 ON foglamp." << name << " USING btree (asset_code);";
+	sql << "CREATE INDEX " << name << "_ix3 ON foglamp." << name << " USING btree (user_ts);";
+	return sql.str();
+}
+
+/**
+ * The functions of the triggers that count the readings added to and
+ * removed from each partition. Each statement adds rows of its own to
+ * readings_count rather than updating a total, so that appends in
+ * concurrent transactions do not wait for the lock on the row of a
+ * total. The rows are summed by compactCounts.
+ */
+static string countFunctions()
+{
+	return "CREATE OR REPLACE FUNCTION foglamp.readings_count_insert() RETURNS trigger AS $f$\n"
+		"BEGIN\n"
+		"	INSERT INTO foglamp.readings_count (partition, rows)\n"
+		"		SELECT coalesce(p.name, '" PARTITION_DEFAULT "'), count(*) FROM new_rows r\n"
+		"		LEFT JOIN foglamp.readings_partitions p ON r.user_ts >= p.lower AND r.user_ts < p.upper\n"
+		"		GROUP BY 1;\n"
+		"	RETURN NULL;\n"
+		"END $f$ LANGUAGE plpgsql;\n"
+		"CREATE OR REPLACE FUNCTION foglamp.readings_count_delete() RETURNS trigger AS $f$\n"
+		"BEGIN\n"
+		"	INSERT INTO foglamp.readings_count (partition, rows)\n"
+		"		SELECT coalesce(p.name, '" PARTITION_DEFAULT "'), -count(*) FROM old_rows r\n"
+		"		LEFT JOIN foglamp.readings_partitions p ON r.user_ts >= p.lower AND r.user_ts < p.upper\n"
+		"		GROUP BY 1;\n"
+		"	RETURN NULL;\n"
+		"END $f$ LANGUAGE plpgsql;";
+}
+
+/**
+ * Partition the readings table if the POSTGRES_READINGS_PARTITION
+ * environment variable is set, or the table is already partitioned,
+ * and create the partitions for the coming periods. Called when the
+ * plugin is initialised.
+ *
+ * @param conn	A connection to the database
+ * @return bool	True if the readings table is partitioned
+ */
+bool ReadingsPartitions::initialise(Connection *conn)
+{
+	const char *setting = getenv(PARTITION_ENV);
+	string unit = (setting && strcasecmp(setting, "hour") == 0) ? "hour" : "day";
+
+	PGresult *res = PQexec(conn->dbConnection,
+			"SELECT c.relkind, current_setting('server_version_num')::integer "
+			"FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace "
+			"WHERE n.nspname = 'foglamp' AND c.relname = 'readings';");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		conn->raiseError("partition", PQerrorMessage(conn->dbConnection));
+		PQclear(res);
+		return false;
+	}
+	bool partitioned = PQgetvalue(res, 0, 0)[0] == 'p';
+	int version = atoi(PQgetvalue(res, 0, 1));
+	PQclear(res);
+
+	if (!partitioned)
+	{
+		if (!setting || (strcasecmp(setting, "hour") && strcasecmp(setting, "day")))
+		{
+			return false;
+		}
+		if (version < PARTITION_MIN_VERSION)
+		{
+			Logger::getLogger()->error("Partitioning the readings table needs PostgreSQL 11 or later");
+			return false;
+		}
+		/*
+		 * The readings table becomes the first partition, it holds
+		 * readings up to the end of the current period. The readings
+		 * are counted once.
+		 */
+		ostringstream sql;
+		sql << "DO $$\n"
+			"DECLARE\n"
+			"	bound timestamptz;\n"
+			"BEGIN\n"
+			"	LOCK TABLE foglamp.readings IN ACCESS EXCLUSIVE MODE;\n"
+			"	SELECT date_trunc('" << unit << "', greatest(max(user_ts), now()) AT TIME ZONE 'UTC') AT TIME ZONE 'UTC'"
+				" + interval '1 " << unit << "' INTO bound FROM foglamp.readings;\n"
+			"	ALTER TABLE foglamp.readings RENAME TO " PARTITION_PREFIX "0;\n"
+			"	CREATE TABLE foglamp.readings (LIKE foglamp." PARTITION_PREFIX "0 INCLUDING DEFAULTS)"
+				" PARTITION BY RANGE (user_ts);\n"
+			"	EXECUTE format('ALTER TABLE foglamp." PARTITION_PREFIX "0 ADD CONSTRAINT " PARTITION_PREFIX "0_range"
+				" CHECK (user_ts < %L)', bound);\n"
+			"	EXECUTE format('ALTER TABLE foglamp.readings ATTACH PARTITION foglamp." PARTITION_PREFIX "0"
+				" FOR VALUES FROM (MINVALUE) TO (%L)', bound);\n"
+			"	CREATE TABLE foglamp." PARTITION_DEFAULT " PARTITION OF foglamp.readings DEFAULT;\n"
+			"	" << partitionIndexes(PARTITION_DEFAULT) << "\n"
+			"	CREATE TABLE foglamp.readings_partitions (name text PRIMARY KEY,"
+				" lower timestamptz NOT NULL, upper timestamptz NOT NULL);\n"
+			"	INSERT INTO foglamp.readings_partitions VALUES ('" PARTITION_PREFIX "0', '-infinity', bound);\n"
+			"	CREATE TABLE foglamp.readings_count (partition text NOT NULL, rows bigint NOT NULL);\n"
+			"	INSERT INTO foglamp.readings_count SELECT '" PARTITION_PREFIX "0', count(*) FROM foglamp." PARTITION_PREFIX "0;\n"
+			"	INSERT INTO foglamp.readings_count VALUES ('" PARTITION_DEFAULT "', 0);\n"
+			"	" << countFunctions() << "\n"
+			"	CREATE TRIGGER readings_count_insert AFTER INSERT ON foglamp.readings\n"
+			"		REFERENCING NEW TABLE AS new_rows FOR EACH STATEMENT\n"
+			"		EXECUTE PROCEDURE foglamp.readings_count_insert();\n"
+			"	CREATE TRIGGER readings_count_delete AFTER DELETE ON foglamp.readings\n"
+			"		REFERENCING OLD TABLE AS old_rows FOR EACH STATEMENT\n"
+			"		EXECUTE PROCEDURE foglamp.readings_count_delete();\n"
+			"END $$;";
+		m_instance = new ReadingsPartitions(unit);
+		if (!m_instance->exec(conn, sql.str()))
+		{
+			delete m_instance;
+			m_instance = 0;
+			return false;
+		}
+		Logger::getLogger()->info("The readings table has been partitioned by %s", unit.c_str());
+	}
+	else
+	{
+		m_instance = new ReadingsPartitions(unit);
+		// Partitions counted with a single row per partition are counted with a row per statement
+		m_instance->exec(conn, "ALTER TABLE foglamp.readings_count DROP CONSTRAINT IF EXISTS readings_count_pkey;"
+				+ countFunctions());
+	}
+	lock_guard<mutex> guard(m_instance->m_mutex);
+	m_instance->createPartitions(conn);
+	m_instance->compactCounts(conn);
+	return true;
+}
+
+/**
+ * Release the partitioning, called when the plugin is shutdown
+ */
+void ReadingsPartitions::shutdown()
+{
+	delete m_instance;
+	m_instance = 0;
+}
+
+/**
+ * Construct the partitioning
+ *
+ * @param unit	The period of new partitions, hour or day
+ */
+ReadingsPartitions::ReadingsPartitions(const string& unit) : m_unit(unit), m_checked(0)
+{
+}
+
+/**
+ * Run a statement, or several in one transaction
+ */
+bool ReadingsPartitions::exec(Connection *conn, const string& sql)
+{
+	conn->logSQL("ReadingsPartition", sql.c_str());
+	PGresult *res = PQexec(conn->dbConnection, sql.c_str());
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+	{
+		conn->raiseError("partition", PQerrorMessage(conn->dbConnection));
+		PQclear(res);
+		return false;
+	}
+	PQclear(res);
+	return true;
+}
+
+/**
+ * Run a query, the result must be cleared by the caller
+ *
+ * @return	The result or NULL on error
+ */
+PGresult *ReadingsPartitions::query(Connection *conn, const string& sql)
+{
+	conn->logSQL("ReadingsPartition", sql.c_str());
+	PGresult *res = PQexec(conn->dbConnection, sql.c_str());
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		conn->raiseError("partition", PQerrorMessage(conn->dbConnection));
+		PQclear(res);
+		return NULL;
+	}
+	return res;
+}
+
+/**
+ * Create the partitions for the current period and the
+ * PARTITION_AHEAD periods after it, if they do not exist. A gap left
+ * while the service was not running is left to the default
+ * partition. Called with the mutex held.
+ *
+ * @param conn	A connection to the database
+ */
+bool ReadingsPartitions::createPartitions(Connection *conn)
+{
+	ostringstream next;
+	next << "SELECT to_char(lo AT TIME ZONE 'UTC', 'YYYYMMDDHH24'),"
+		" to_char(lo AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS+00'),"
+		" to_char((lo + interval '1 " << m_unit << "') AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS+00'),"
+		" lo < now() + interval '" << PARTITION_AHEAD << " " << m_unit << "'"
+		" FROM (SELECT greatest(max(upper), date_trunc('" << m_unit << "', now() AT TIME ZONE 'UTC') AT TIME ZONE 'UTC') AS lo"
+		" FROM foglamp.readings_partitions) AS next;";
+
+	m_checked = time(0);
+	while (true)
+	{
+		PGresult *res = query(conn, next.str());
+		if (!res)
+		{
+			return false;
+		}
+		string name = PARTITION_PREFIX + string(PQgetvalue(res, 0, 0));
+		string lower = PQgetvalue(res, 0, 1);
+		string upper = PQgetvalue(res, 0, 2);
+		bool needed = PQgetvalue(res, 0, 3)[0] == 't';
+		PQclear(res);
+		if (!needed)
+		{
+			return true;
+		}
+
+		/*
+		 * Readings of the period held by the default partition are
+		 * moved to the new partition before it is attached
+		 */
+		ostringstream sql;
+		sql << "DO $$\n"
+			"DECLARE\n"
+			"	moved bigint;\n"
+			"BEGIN\n"
+			"	CREATE TABLE foglamp." << name << " (LIKE foglamp.readings INCLUDING DEFAULTS);\n"
+			"	" << partitionIndexes(name) << "\n"
+			"	WITH moved_rows AS (DELETE FROM foglamp." PARTITION_DEFAULT
+				" WHERE user_ts >= '" << lower << "' AND user_ts < '" << upper << "' RETURNING *)\n"
+			"		INSERT INTO foglamp." << name << " SELECT * FROM moved_rows;\n"
+			"	GET DIAGNOSTICS moved = ROW_COUNT;\n"
+			"	ALTER TABLE foglamp.readings ATTACH PARTITION foglamp." << name <<
+				" FOR VALUES FROM ('" << lower << "') TO ('" << upper << "');\n"
+			"	INSERT INTO foglamp.readings_partitions VALUES ('" << name << "', '" << lower << "', '" << upper << "');\n"
+			"	INSERT INTO foglamp.readings_count VALUES ('" << name << "', moved), ('" PARTITION_DEFAULT "', -moved);\n"
+			"END $$;";
+		if (!exec(conn, sql.str()))
+		{
+			Logger::getLogger()->error("Failed to create readings partition %s", name.c_str());
+			return false;
+		}
+		Logger::getLogger()->info("Created readings partition %s", name.c_str());
+	}
+}
+
+/**
+ * Create the partitions for the coming periods if they have not been
+ * checked recently. Called by appends, an append does not wait for
+ * another thread that is creating partitions.
+ *
+ * @param conn	A connection to the database
+ */
+void ReadingsPartitions::maintain(Connection *conn)
+{
+	if (time(0) - m_checked < PARTITION_CHECK)
+	{
+		return;
+	}
+	unique_lock<mutex> lck(m_mutex, try_to_lock);
+	if (lck.owns_lock())
+	{
+		createPartitions(conn);
+		compactCounts(conn);
+	}
+}
+
+/**
+ * Replace the rows of readings_count with one row for each partition.
+ * The rows added by transactions that are not committed are not seen
+ * and are kept. Called with the mutex held.
+ *
+ * @param conn	A connection to the database
+ */
+bool ReadingsPartitions::compactCounts(Connection *conn)
+{
+	return exec(conn, "WITH counted AS (DELETE FROM foglamp.readings_count RETURNING partition, rows) "
+			"INSERT INTO foglamp.readings_count SELECT partition, sum(rows) FROM counted GROUP BY partition;");
+}
+
+/**
+ * Detach and drop the partitions that end before the purge age, the
+ * oldest first. If unsent readings are retained, a partition with
+ * readings that have not been sent is kept along with those after it.
+ *
+ * @param conn		A connection to the database
+ * @param age		The age in hours
+ * @param flags		0x01 to retain readings that have not been sent
+ * @param sent		The id of the last reading sent
+ * @param unsentPurged	Incremented by the unsent readings dropped
+ * @return		The number of readings dropped
+ */
+unsigned long ReadingsPartitions::dropExpired(Connection *conn, unsigned long age,
+					      unsigned int flags, unsigned long sent,
+					      long& unsentPurged)
+{
+	lock_guard<mutex> guard(m_mutex);
+	unsigned long dropped = 0;
+
+	createPartitions(conn);
+	compactCounts(conn);
+
+	ostringstream expired;
+	expired << "SELECT p.name, coalesce(c.rows, 0) FROM foglamp.readings_partitions p"
+		" LEFT JOIN (SELECT partition, sum(rows) AS rows FROM foglamp.readings_count GROUP BY partition) c"
+		" ON c.partition = p.name"
+		" WHERE p.upper <= now() - INTERVAL '" << age << " hours' ORDER BY p.upper;";
+	PGresult *res = query(conn, expired.str());
+	if (!res)
+	{
+		return 0;
+	}
+	vector<pair<string, unsigned long>> partitions;
+	for (int i = 0; i < PQntuples(res); i++)
+	{
+		partitions.push_back(make_pair(string(PQgetvalue(res, i, 0)),
+					       strtoul(PQgetvalue(res, i, 1), NULL, 10)));
+	}
+	PQclear(res);
+
+	for (auto& partition : partitions)
+	{
+		const string& name = partition.first;
+		// The ids of the readings are found with the primary key of the partition
+		ostringstream unsent;
+		if ((flags & 0x01) == 0x01)
+		{
+			unsent << "SELECT count(*) FROM (SELECT id FROM foglamp." << name
+				<< " WHERE id > " << sent << " LIMIT 1) AS unsent;";
+		}
+		else
+		{
+			unsent << "SELECT count(*) FROM foglamp." << name << " WHERE id > " << sent << ";";
+		}
+		res = query(conn, unsent.str());
+		if (!res)
+		{
+			break;
+		}
+		long unsentRows = atol(PQgetvalue(res, 0, 0));
+		PQclear(res);
+		if ((flags & 0x01) == 0x01 && unsentRows)
+		{
+			break;
+		}
+
+		ostringstream drop;
+		drop << "ALTER TABLE foglamp.readings DETACH PARTITION foglamp." << name << ";"
+			"DROP TABLE foglamp." << name << ";"
+			"DELETE FROM foglamp.readings_partitions WHERE name = '" << name << "';"
+			"DELETE FROM foglamp.readings_count WHERE partition = '" << name << "';";
+		if (!exec(conn, drop.str()))
+		{
+			break;
+		}
+		Logger::getLogger()->info("Purge dropped readings partition %s of %lu readings",
+				name.c_str(), partition.second);
+		dropped += partition.second;
+		unsentPurged += unsentRows;
+	}
+	return dropped;
+}
+
+/**
+ * Return the number of readings from the counts of the partitions
+ *
+ * @param conn	A connection to the database
+ * @return	The number of readings or -1 on error
+ */
+long ReadingsPartitions::count(Connection *conn)
+{
+	PGresult *res = query(conn, "SELECT coalesce(sum(rows), 0) FROM foglamp.readings_count;");
+	if (!res)
+	{
+		return -1;
+	}
+	long rows = atol(PQgetvalue(res, 0, 0));
+	PQclear(res);
+	return rows;
+}
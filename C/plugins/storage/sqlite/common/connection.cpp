@@ -11,6 +11,10 @@
 #include <connection_manager.h>
 #include <common.h>
 #include <utils.h>
+#include <ctype.h>
+#ifndef SQLITE_SPLIT_READINGS
+#include <readings_partitions.h>
+#endif
 
 /*
  * Control the way purge deletes readings. The block size sets a limit as to how many rows
@@ -61,9 +65,6 @@ int	      maxQueue = 0;
 #endif
 
 static std::atomic<int> m_waiting(0);
-static std::atomic<int> m_writeAccessOngoing(0);
-static std::mutex	db_mutex;
-static std::condition_variable	db_cv;
 static int purgeBlockSize = PURGE_DELETE_BLOCK_SIZE;
 
 #define START_TIME std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
@@ -74,6 +75,38 @@ static int purgeBlockSize = PURGE_DELETE_BLOCK_SIZE;
 
 static time_t connectErrorTime = 0;
 
+/**
+ * Return true if a table holds readings, the readings table or one
+ * of its time partitions, readings_p followed by the period
+ *
+ * @param table	The table name
+ */
+static bool isReadingsTable(const char *table)
+{
+	return strcmp(table, "readings") == 0 ||
+		(strncmp(table, "readings_p", 10) == 0 && isdigit(table[10]));
+}
+
+#ifndef SQLITE_SPLIT_READINGS
+/**
+ * Return the rows changed by the last common table call. The partitioned
+ * readings view is written by its triggers, whose changes are not
+ * counted by sqlite3_changes.
+ *
+ * @param db		The database handle
+ * @param table		The table written
+ * @param totalBefore	sqlite3_total_changes before the call
+ */
+static int changedRows(sqlite3 *db, const string& table, int totalBefore)
+{
+	if (table.compare("readings") == 0 && ReadingsPartitions::getInstance())
+	{
+		return sqlite3_total_changes(db) - totalBefore;
+	}
+	return sqlite3_changes(db);
+}
+#endif
+
 /**
  * This SQLIte3 query callback returns a formatted date
  * by SELECT strftime('format', column, 'locatime')
@@ -127,7 +160,7 @@ bool Connection::applyColumnDateTimeFormat(sqlite3_stmt *pStmt,
 	{
 
 		if ((strcmp(sqlite3_column_origin_name(pStmt, i), "user_ts") == 0) &&
-		    (strcmp(sqlite3_column_table_name(pStmt, i), "readings") == 0) &&
+		    isReadingsTable(sqlite3_column_table_name(pStmt, i)) &&
 		    (strlen((char *) sqlite3_column_text(pStmt, i)) == 32))
 		{
 
@@ -233,6 +266,46 @@ bool Connection::applyColumnDateTimeFormat(sqlite3_stmt *pStmt,
 	return false;
 }
 
+/**
+ * Check if applyColumnDateTimeFormat may format the values of a column.
+ * This depends only upon the column, not the row, so it is checked once
+ * for each column of a result set rather than for every value.
+ *
+ * @param pStmt    Current SQLite3 result set
+ * @param i        Current column index
+ * @return         True if the column values may need formatting
+ */
+bool Connection::isDateTimeColumn(sqlite3_stmt *pStmt, int i)
+{
+	const char *origin = sqlite3_column_origin_name(pStmt, i);
+	const char *table = sqlite3_column_table_name(pStmt, i);
+
+	if (sqlite3_column_database_name(pStmt, i) == NULL || table == NULL || origin == NULL)
+	{
+		// Not a column of a table
+		return false;
+	}
+	if (strcmp(origin, "user_ts") == 0 && isReadingsTable(table))
+	{
+		return true;
+	}
+	if (strcmp(origin, sqlite3_column_name(pStmt, i)) != 0)
+	{
+		// Renamed columns are not formatted
+		return false;
+	}
+	const char *pzDataType;
+	int retType = sqlite3_table_column_metadata(dbHandle,
+						    sqlite3_column_database_name(pStmt, i),
+						    table,
+						    origin,
+						    &pzDataType,
+						    NULL, NULL, NULL, NULL);
+	// Leave failures to applyColumnDateTimeFormat to report
+	return retType != SQLITE_OK ||
+		(pzDataType != NULL && strcmp(pzDataType, SQLITE3_FOGLAMP_DATETIME_TYPE) == 0);
+}
+
 /**
  * Apply the specified date format
  * using the available formats in SQLite3
@@ -396,6 +469,11 @@ Connection::Connection()
 
 	m_logSQL = false;
 	m_queuing = 0;
+	m_appendStmt = NULL;
+	m_appendTailStmt = NULL;
+	m_appendBatch = READINGS_APPEND_BATCH;
+	m_appendTail = 0;
+	m_appendTable = "readings";
 
 	if (defaultConnection == NULL)
 	{
@@ -507,6 +585,10 @@ Connection::Connection()
  */
 Connection::~Connection()
 {
+#ifndef SQLITE_SPLIT_READINGS
+	sqlite3_finalize(m_appendStmt);
+	sqlite3_finalize(m_appendTailStmt);
+#endif
 	sqlite3_close_v2(dbHandle);
 }
 
@@ -520,117 +602,173 @@ void Connection::setTrace(bool flag)
 	m_logSQL = flag;
 }
 
+#define RESULT_SET_CHUNK_SIZE	65536	// Bytes passed to a result set writer at a time
+
+/**
+ * A rapidjson output stream that writes directly into a string,
+ * avoiding the copy from a StringBuffer once the document is written
+ */
+class ResultSetStream {
+	public:
+		typedef char Ch;
+		ResultSetStream(string& str) : m_str(str) {};
+		void	Put(char c) { m_str.push_back(c); };
+		void	Flush() {};
+	private:
+		string&	m_str;
+};
+
+/**
+ * Check if the text of a column is a JSON object, array, string or
+ * literal that should be included in the result set as JSON rather
+ * than as a string. Text that is not JSON, and JSON numbers, are
+ * returned as strings.
+ *
+ * @param reader	The reader used to validate the text
+ * @param str		The column text
+ * @return		True if the text should be written as JSON
+ */
+static bool isJSONColumn(Reader& reader, const char *str)
+{
+	const char *p = str;
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+	{
+		p++;
+	}
+	if (*p != '{' && *p != '[' && *p != '"' && *p != 't' && *p != 'f' && *p != 'n')
+	{
+		// Not JSON or a number, either way a string
+		return false;
+	}
+	StringStream stream(str);
+	BaseReaderHandler<> validate;
+	return !reader.Parse(stream, validate).IsError();
+}
+
 /**
  * Map a SQLite3 result set to a string version of a JSON document
  *
+ * The document is written as the rows are stepped through rather than
+ * built in memory first. Text columns that hold JSON are copied into
+ * the result set as they are, the reading column of the readings
+ * table always holds a JSON object and is not checked.
+ *
+ * If a writer is given the document is passed to it in parts of about
+ * RESULT_SET_CHUNK_SIZE bytes, resultSet is then only used as a buffer.
+ *
  * @param res          Sqlite3 result set
  * @param resultSet    Output Json as string
- * @return             SQLite3 result code of sqlite3_step(res)
+ * @param writer       Optional writer for the parts of the document
+ * @param context      The context passed to the writer
+ * @return             SQLite3 result code of sqlite3_step(res),
+ *		       SQLITE_ABORT if the writer failed
  *
  */
-int Connection::mapResultSet(void* res, string& resultSet)
+int Connection::mapResultSet(void* res, string& resultSet,
+			     PLUGIN_STREAM_WRITER writer, void *context)
 {
 // Cast to SQLite3 result set
 sqlite3_stmt* pStmt = (sqlite3_stmt *)res;
-// JSON generic document
-Document doc;
 // SQLite3 return code
 int rc;
 // Number of returned rows, number of columns
-unsigned long nRows = 0, nCols = 0;
-
-	// Create the JSON document
-	doc.SetObject();
-	// Get document allocator
-	Document::AllocatorType& allocator = doc.GetAllocator();
-	// Create the array for returned rows
-	Value rows(kArrayType);
-	// Rows counter, set it to 0 now
-	Value count;
-	count.SetInt(0);
+unsigned long nRows = 0, nCols = sqlite3_column_count(pStmt);
+// Column names, copied as the statement may be prepared again by its first step,
+// the columns holding readings JSON and DATETIME columns
+vector<string> names;
+vector<bool> readingColumns;
+vector<bool> dateTimeColumns;
+// Validation of text columns that may hold JSON
+Reader reader;
+
+	for (int i = 0; i < nCols; i++)
+	{
+		names.push_back(sqlite3_column_name(pStmt, i));
+		const char *origin = sqlite3_column_origin_name(pStmt, i);
+		const char *table = sqlite3_column_table_name(pStmt, i);
+		readingColumns.push_back(origin && table &&
+				strcmp(origin, "reading") == 0 &&
+				isReadingsTable(table));
+		dateTimeColumns.push_back(isDateTimeColumn(pStmt, i));
+	}
+
+	resultSet.clear();
+	ResultSetStream stream(resultSet);
+	Writer<ResultSetStream> json(stream);
+	json.StartObject();
+	json.Key("rows");
+	json.StartArray();
 
 	// Iterate over all the rows in the resultSet
 	while ((rc = SQLstep(pStmt)) == SQLITE_ROW)
 	{
-		// Get number of columns for current row
-		nCols = sqlite3_column_count(pStmt);
-		// Create the 'row' object
-		Value row(kObjectType);
+		json.StartObject();
 
-		// Build the row with all fields
+		// Write the row with all fields
 		for (int i = 0; i < nCols; i++)
 		{
-			// JSON document for the current row
-			Document d;
 			// Set object name as the column name
-			Value name(sqlite3_column_name(pStmt, i), allocator);
-			// Get the "TEXT" value of the column value
-			char* str = (char *)sqlite3_column_text(pStmt, i);
+			json.Key(names[i].c_str(), names[i].length());
 
 			// Check the column value datatype
 			switch (sqlite3_column_type(pStmt, i))
 			{
 				case (SQLITE_NULL):
 				{
-					row.AddMember(name, "", allocator);
+					json.String("");
 					break;
 				}
 				case (SQLITE3_TEXT):
 				{
+					// Get the "TEXT" value of the column value
+					const char *str = (const char *)sqlite3_column_text(pStmt, i);
+					size_t len = sqlite3_column_bytes(pStmt, i);
+
+					if (readingColumns[i] && *str == '{')
+					{
+						json.RawValue(str, len, kObjectType);
+						break;
+					}
 
 					/**
 					 * Handle here possible unformatted DATETIME column type
 					 */
 					string newDate;
-					if (applyColumnDateTimeFormat(pStmt, i, newDate))
+					if (dateTimeColumns[i] && applyColumnDateTimeFormat(pStmt, i, newDate))
 					{
 						// Use new formatted datetime value
-						str = (char *)newDate.c_str();
+						str = newDate.c_str();
+						len = newDate.length();
 					}
 
-					Value value;
-					if (!d.Parse(str).HasParseError())
+					if (isJSONColumn(reader, str))
 					{
-						if (d.IsNumber())
-						{
-							// Set string
-							value = Value(str, allocator);
-						}
-						else
-						{
-							// JSON parsing ok, use the document
-							value = Value(d, allocator);
-						}
+						// JSON parsing ok, use the text as it is
+						json.RawValue(str, len, kObjectType);
 					}
 					else
 					{
 						// Use (char *) value
-						value = Value(str, allocator);
+						json.String(str, len);
 					}
-					// Add name & value to the current row
-					row.AddMember(name, value, allocator);
 					break;
 				}
 				case (SQLITE_INTEGER):
 				{
-					int64_t intVal = atol(str);
-					// Add name & value to the current row
-					row.AddMember(name, intVal, allocator);
+					json.Int64(sqlite3_column_int64(pStmt, i));
 					break;
 				}
 				case (SQLITE_FLOAT):
 				{
-					double dblVal = atof(str);
-					// Add name & value to the current row
-					row.AddMember(name, dblVal, allocator);
+					// Use the text of the value, as previously, to keep its precision
+					json.Double(atof((const char *)sqlite3_column_text(pStmt, i)));
 					break;
 				}
 				default:
 				{
 					// Default: use  (char *) value
-					Value value(str != NULL ? str : "", allocator);
-					// Add name & value to the current row
-					row.AddMember(name, value, allocator);
+					const char *str = (const char *)sqlite3_column_text(pStmt, i);
+					json.String(str != NULL ? str : "");
 					break;
 				}
 			}
@@ -638,25 +776,28 @@ unsigned long nRows = 0, nCols = 0;
 
 		// All fields added: increase row counter
 		nRows++;
+		json.EndObject();
 
-		// Add the current row to the all rows object
-		rows.PushBack(row, allocator);
+		if (writer && resultSet.length() >= RESULT_SET_CHUNK_SIZE)
+		{
+			if (!writer(context, resultSet.data(), resultSet.length()))
+			{
+				return SQLITE_ABORT;
+			}
+			resultSet.clear();
+		}
 	}
+	json.EndArray();
 
-	// All rows added: update rows count
-	count.SetInt(nRows);
-
-	// Add 'rows' and 'count' to the final JSON document
-	doc.AddMember("count", count, allocator);
-	doc.AddMember("rows", rows, allocator);
+	// All rows added: add the rows count
+	json.Key("count");
+	json.Int64(nRows);
+	json.EndObject();
 
-	/* Write out the JSON document we created */
-	StringBuffer buffer;
-	Writer<StringBuffer> writer(buffer);
-	doc.Accept(writer);
-
-	// Set the result as a CPP string 
-	resultSet = buffer.GetString();
+	if (writer && !writer(context, resultSet.data(), resultSet.length()))
+	{
+		return SQLITE_ABORT;
+	}
 
 	// Return SQLite3 ret code
 	return rc;
@@ -1098,16 +1239,14 @@ std::size_t arr = data.find("inserts");
 	char *zErrMsg = NULL;
 	int rc;
 
+	int totalChanges = sqlite3_total_changes(dbHandle);
+
 	// Exec INSERT statement: no callback, no result set
-	m_writeAccessOngoing.fetch_add(1);
 	rc = SQLexec(dbHandle,
 		     query,
 		     NULL,
 		     NULL,
 		     &zErrMsg);
-	m_writeAccessOngoing.fetch_sub(1);
-	if (m_writeAccessOngoing == 0)
-		db_cv.notify_all();
 
 	// Check exec result
 	if (rc != SQLITE_OK )
@@ -1143,7 +1282,7 @@ std::size_t arr = data.find("inserts");
 		// Release memory for 'query' var
 		delete[] query;
 
-		int insert = sqlite3_changes(dbHandle);
+		int insert = changedRows(dbHandle, table, totalChanges);
 
 		if (insert == 0)
 			raiseError("insert", "Not all inserts within transaction succeeded");
@@ -1473,16 +1612,14 @@ SQLBuffer	sql;
 	char *zErrMsg = NULL;
 	int rc;
 
+	int totalChanges = sqlite3_total_changes(dbHandle);
+
 	// Exec the UPDATE statement: no callback, no result set
-	m_writeAccessOngoing.fetch_add(1);
 	rc = SQLexec(dbHandle,
 		     query,
 		     NULL,
 		     NULL,
 		     &zErrMsg);
-	m_writeAccessOngoing.fetch_sub(1);
-	if (m_writeAccessOngoing == 0)
-		db_cv.notify_all();
 
 	// Check result code
 	if (rc != SQLITE_OK)
@@ -1512,7 +1649,7 @@ SQLBuffer	sql;
 		// Release memory for 'query' var
 		delete[] query;
 
-		int update = sqlite3_changes(dbHandle);
+		int update = changedRows(dbHandle, table, totalChanges);
 
 		int return_value=0;
 
@@ -1686,7 +1823,9 @@ bool Connection::jsonAggregates(const Value& payload,
 			string col = aggregates["column"].GetString();
 			if (col.compare("*") == 0)	// Faster to count ROWID rather than *
 			{
-				sql.append("ROWID");
+				// The id of the readings is also its ROWID, a
+				// partitioned readings view has no ROWID
+				sql.append(isTableReading ? "id" : "ROWID");
 			}
 			else
 			{
@@ -2823,23 +2962,21 @@ SQLBuffer	sql;
 	int delete_rows;
 	int rc;
 
+	int totalChanges = sqlite3_total_changes(dbHandle);
+
 	// Exec the DELETE statement: no callback, no result set
-	m_writeAccessOngoing.fetch_add(1);
 	rc = SQLexec(dbHandle,
 		     query,
 		     NULL,
 		     NULL,
 		     &zErrMsg);
-	m_writeAccessOngoing.fetch_sub(1);
-	if (m_writeAccessOngoing == 0)
-		db_cv.notify_all();
 
 	// Check result code
 	if (rc == SQLITE_OK)
 	{
 		// Success. Release memory for 'query' var
 		delete[] query;
-        	return sqlite3_changes(dbHandle);
+        	return changedRows(dbHandle, table, totalChanges);
 	}
 	else
 	{
@@ -11,10 +11,12 @@
  */
 
 #include <sql_buffer.h>
+#include <plugin_api.h>
 #include <string>
 #include <rapidjson/document.h>
 #include <sqlite3.h>
 #include <mutex>
+#include <vector>
 
 #define LEN_BUFFER_DATE 100
 #define F_TIMEH24_S             "%H:%M:%S"
@@ -30,6 +32,10 @@
 #define SQLITE3_NOW_READING     "strftime('%Y-%m-%d %H:%M:%f000+00:00', 'now')"
 #define SQLITE3_FOGLAMP_DATETIME_TYPE "DATETIME"
 
+// Default number of rows bound to each execution of the prepared readings INSERT,
+// set with the appendBatchSize plugin configuration item
+#define READINGS_APPEND_BATCH	50
+
 // Set plugin name for log messages
 #ifndef PLUGIN_LOG_NAME
 #define PLUGIN_LOG_NAME "SQLite3"
@@ -63,6 +69,16 @@ int countCallback(void *data,
 
 bool applyDateFormat(const std::string& inFormat, std::string& outFormat);
 
+/**
+ * A row to be appended to the readings table
+ */
+typedef struct {
+	std::string	userTs;
+	std::string	assetCode;
+	std::string	readKey;	// Empty if the reading has no read_key
+	std::string	reading;
+} ReadingRow;
+
 class Connection {
 	public:
 		Connection();
@@ -78,10 +94,14 @@ class Connection {
 		int		load_table_snapshot(const std::string& table, const std::string& id);
 		int		delete_table_snapshot(const std::string& table, const std::string& id);
 		bool		get_table_snapshots(const std::string& table, std::string& resultSet);
+		int		appendReadingsBinary(const char *data, size_t length);
+		void		setAppendBatchSize(unsigned int rows);
 #endif
 		int		appendReadings(const char *readings);
 		bool		fetchReadings(unsigned long id, unsigned int blksize,
-						std::string& resultSet);
+						std::string& resultSet,
+						PLUGIN_STREAM_WRITER writer = NULL,
+						void *context = NULL);
 		bool		retrieveReadings(const std::string& condition,
 						 std::string& resultSet);
 		unsigned int	purgeReadings(unsigned long age, unsigned int flags,
@@ -100,7 +120,9 @@ class Connection {
 		bool		m_logSQL;
 		void		raiseError(const char *operation, const char *reason,...);
 		sqlite3		*dbHandle;
-		int		mapResultSet(void *res, std::string& resultSet);
+		int		mapResultSet(void *res, std::string& resultSet,
+					     PLUGIN_STREAM_WRITER writer = NULL,
+					     void *context = NULL);
 		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, bool convertLocaltime = false);
 		bool		jsonModifiers(const rapidjson::Value&, SQLBuffer&, bool isTableReading = false);
 		bool		jsonAggregates(const rapidjson::Value&,
@@ -112,9 +134,23 @@ class Connection {
 		char		*trim(char *str);
 		const std::string
 				escape(const std::string&);
+		bool		isDateTimeColumn(sqlite3_stmt *pStmt, int i);
 		bool		applyColumnDateTimeFormat(sqlite3_stmt *pStmt,
 						int i,
 						std::string& newDate);
 		void		logSQL(const char *, const char *);
+#ifndef SQLITE_SPLIT_READINGS
+		int		insertRows(const std::vector<ReadingRow>& rows);
+		sqlite3_stmt	*appendStatement(unsigned int rows);
+		sqlite3_stmt	*m_appendStmt;		// INSERT of m_appendBatch rows
+		sqlite3_stmt	*m_appendTailStmt;	// INSERT of the m_appendTail rows left over
+		unsigned int	m_appendBatch;
+		unsigned int	m_appendTail;
+		std::string	m_appendTable;		// The table or partition appended to
+		void		setAppendTable(const std::string& table);
+
+		friend class	ReadingsWriter;
+		friend class	ReadingsPartitions;
+#endif
 };
 #endif
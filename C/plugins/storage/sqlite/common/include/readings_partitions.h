@@ -0,0 +1,81 @@
+#ifndef _READINGS_PARTITIONS_H
+#define _READINGS_PARTITIONS_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <connection.h>
+#include <sql_buffer.h>
+#include <string>
+#include <vector>
+
+// Set to "hour" or "day" to split the readings table into a table per period
+#define PARTITION_ENV		"SQLITE_READINGS_PARTITION"
+#define PARTITION_PREFIX	"readings_p"		// Followed by the period, YYYYMMDDHH
+#define PARTITION_CATALOG	"readings_catalog"
+#define PARTITION_VIEW_PREFIX	"readings_u"		// Followed by a number, a view of up to PARTITION_MAX partitions
+#define PARTITION_MAX		500			// SQLite limit on the terms of a UNION ALL
+
+/**
+ * The time partitioned layout of the readings table.
+ *
+ * Readings are appended to a table for the current hour or day, the
+ * partition. The partitions are listed in a catalog table with the
+ * first id of each, ids increase across the partitions. A view named
+ * readings, the UNION ALL of the partitions, serves the queries made
+ * with the readings table, a fetch by id only reads the partitions
+ * holding the ids it returns. Beyond PARTITION_MAX partitions the view
+ * is the UNION ALL of views that each hold up to PARTITION_MAX of them.
+ * Triggers on the view insert into the current partition and update
+ * and delete in the partitions, so the readings table can still be
+ * written by the common table calls.
+ *
+ * A purge by age drops the partitions in which no reading is younger
+ * than the age, rather than deleting the readings. The partition
+ * being appended to is never dropped.
+ *
+ * Once the database has been partitioned it stays partitioned, the
+ * existing readings table becomes the first partition.
+ */
+class ReadingsPartitions {
+	public:
+		static bool			initialise(Connection *conn);
+		static void			shutdown();
+		static ReadingsPartitions	*getInstance() { return m_instance; };
+		std::string			current(Connection *conn);
+		bool				fetchSource(Connection *conn, unsigned long id,
+							    unsigned int blksize, SQLBuffer& source);
+		unsigned int			purge(Connection *conn, unsigned long age,
+						      unsigned int flags, unsigned long sent,
+						      std::string& result);
+
+	private:
+		/**
+		 * A partition listed in the catalog
+		 */
+		typedef struct {
+			std::string	name;
+			std::string	period;
+			unsigned long	startId;	// The first id appended to the partition
+		} Partition;
+
+		ReadingsPartitions(bool hourly);
+		std::string		period(time_t when);
+		bool			catalog(Connection *conn, std::vector<Partition>& partitions);
+		bool			createView(Connection *conn, const std::vector<Partition>& partitions);
+		bool			dropViews(Connection *conn);
+		bool			idRange(Connection *conn, const std::string& partition,
+						unsigned long& minId, unsigned long& maxId);
+
+		static ReadingsPartitions	*m_instance;
+		bool				m_hourly;
+		std::string			m_current;	// The partition appended to
+		std::string			m_currentPeriod;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _READINGS_WRITER_H
+#define _READINGS_WRITER_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <connection.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#define WRITER_MAX_ROWS	20000	// Rows appended in one transaction
+
+/**
+ * The single thread that writes to the readings table of the SQLite
+ * database, using a connection of its own.
+ *
+ * Appends queued by the API threads while the previous transaction
+ * is committed are inserted together in the next transaction, each in
+ * a savepoint so that the failure of one does not fail the others.
+ * Other writes, such as the blocks deleted by a purge, are run between
+ * those transactions. Reads use their own connections and are not
+ * blocked by the writer as the database is in WAL mode.
+ */
+class ReadingsWriter {
+	public:
+		static ReadingsWriter	*getInstance();
+		int			append(const std::vector<ReadingRow>& rows);
+		int			execute(const std::function<int(Connection *)>& job);
+		static void		shutdown();
+
+	private:
+		/**
+		 * A write waiting for the writer thread, either the rows
+		 * to append or a job to run
+		 */
+		typedef struct {
+			const std::vector<ReadingRow>		*rows;
+			const std::function<int(Connection *)>	*job;
+			int					result;
+			bool					done;
+		} Request;
+
+		ReadingsWriter();
+		int			submit(Request& request);
+		void			run();
+		void			commit(const std::vector<Request *>& group,
+					       std::vector<int>& results);
+		void			complete(Request *request, int result);
+
+		static ReadingsWriter	*m_instance;
+		Connection		*m_connection;
+		std::deque<Request *>	m_queue;
+		bool			m_running;
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;		// Signals the writer thread
+		std::condition_variable	m_doneCv;	// Signals the requesting threads
+		std::thread		*m_thread;
+		unsigned long		m_appends;
+		unsigned long		m_transactions;
+};
+
+#endif
@@ -10,6 +10,10 @@
 #include <connection.h>
 #include <connection_manager.h>
 #include <common.h>
+#include <binary_readings.h>
+#include <readings_writer.h>
+#include <readings_partitions.h>
+#include <sys/time.h>
 
 /*
  * Control the way purge deletes readings. The block size sets a limit as to how many rows
@@ -64,9 +68,6 @@ int	      maxQueue = 0;
 #endif
 
 static std::atomic<int> m_waiting(0);
-static std::atomic<int> m_writeAccessOngoing(0);
-static std::mutex	db_mutex;
-static std::condition_variable	db_cv;
 static int purgeBlockSize = PURGE_DELETE_BLOCK_SIZE;
 
 #define START_TIME std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
@@ -85,9 +86,7 @@ int Connection::appendReadings(const char *readings)
 {
 // Default template parameter uses UTF8 and MemoryPoolAllocator.
 Document 	doc;
-SQLBuffer	sql;
-int		row = 0;
-bool 		add_row = false;
+vector<ReadingRow>	rows;
 
 	ParseResult ok = doc.Parse(readings);
 	if (!ok)
@@ -96,8 +95,6 @@ bool 		add_row = false;
 		return -1;
 	}
 
-	sql.append("INSERT INTO foglamp.readings ( user_ts, asset_code, read_key, reading ) VALUES ");
-
 	if (!doc.HasMember("readings"))
 	{
  		raiseError("appendReadings", "Payload is missing a readings array");
@@ -109,6 +106,7 @@ bool 		add_row = false;
 		raiseError("appendReadings", "Payload is missing the readings array");
 		return -1;
 	}
+	rows.reserve(rdings.Size());
 	for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
 	{
 		if (!itr->IsObject())
@@ -118,120 +116,238 @@ bool 		add_row = false;
 			return -1;
 		}
 
-		add_row = true;
+		ReadingRow row;
 
 		// Handles - user_ts
 		const char *str = (*itr)["user_ts"].GetString();
+		char formatted_date[LEN_BUFFER_DATE] = {0};
 		if (strcmp(str, "now()") == 0)
 		{
-			if (row)
-			{
-				sql.append(", (");
-			}
-			else
-			{
-				sql.append('(');
-			}
-
-			sql.append(SQLITE3_NOW_READING);
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			BinaryReadingsReader::formatTimestamp((int64_t)tv.tv_sec * 1000000 + tv.tv_usec,
+							formatted_date);
 		}
-		else
+		else if (! formatDate(formatted_date, sizeof(formatted_date), str) )
 		{
-			char formatted_date[LEN_BUFFER_DATE] = {0};
-			if (! formatDate(formatted_date, sizeof(formatted_date), str) )
-			{
-				raiseError("appendReadings", "Invalid date |%s|", str);
-				add_row = false;
-			}
-			else
-			{
-				if (row)
-				{
-					sql.append(", (");
-				}
-				else
-				{
-					sql.append('(');
-				}
-
-				sql.append('\'');
-				sql.append(formatted_date);
-				sql.append('\'');
-			}
+			raiseError("appendReadings", "Invalid date |%s|", str);
+			continue;
 		}
+		row.userTs = formatted_date;
+
+		// Handles - asset_code
+		row.assetCode = (*itr)["asset_code"].GetString();
 
-		if (add_row)
+		// Handles - read_key
+		// Python code is passing the string None when here is no read_key in the payload
+		if (itr->HasMember("read_key") && strcmp((*itr)["read_key"].GetString(), "None") != 0)
 		{
-			row++;
+			row.readKey = (*itr)["read_key"].GetString();
+		}
 
-			// Handles - asset_code
-			sql.append(",\'");
-			sql.append((*itr)["asset_code"].GetString());
+		// Handles - reading
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		(*itr)["reading"].Accept(writer);
+		row.reading.assign(buffer.GetString(), buffer.GetSize());
 
-			// Handles - read_key
-			// Python code is passing the string None when here is no read_key in the payload
-			if (itr->HasMember("read_key") && strcmp((*itr)["read_key"].GetString(), "None") != 0)
-			{
-				sql.append("', \'");
-				sql.append((*itr)["read_key"].GetString());
-				sql.append("', \'");
-			}
-			else
-			{
-				// No "read_key" in this reading, insert NULL
-				sql.append("', NULL, '");
-			}
+		rows.push_back(move(row));
+	}
 
-			// Handles - reading
-			StringBuffer buffer;
-			Writer<StringBuffer> writer(buffer);
-			(*itr)["reading"].Accept(writer);
-			sql.append(buffer.GetString());
-			sql.append('\'');
+	return ReadingsWriter::getInstance()->append(rows);
+}
 
-			sql.append(')');
-		}
+/**
+ * Append a set of readings sent in the binary batch format to the
+ * readings table. The rows are taken directly from the batch without
+ * the need to parse a JSON document.
+ *
+ * @param data		The binary readings batch
+ * @param length	The length of the batch
+ * @return int		The number of readings added or -1 on error
+ */
+int Connection::appendReadingsBinary(const char *data, size_t length)
+{
+vector<ReadingRow>	rows;
 
+	BinaryReadingsReader reader(data, length);
+	if (!reader.isValid())
+	{
+		raiseError("appendReadings", reader.getError().c_str());
+		return -1;
 	}
-	sql.append(';');
-
-	const char *query = sql.coalesce();
-	logSQL("ReadingsAppend", query);
-	char *zErrMsg = NULL;
-	int rc;
 
+	rows.reserve(reader.getCount());
+	for (unsigned int i = 0; i < reader.getCount(); i++)
 	{
-	m_writeAccessOngoing.fetch_add(1);
-	unique_lock<mutex> lck(db_mutex);
-
-	// Exec the INSERT statement: no callback, no result set
-	rc = SQLexec(dbHandle,
-		     query,
-		     NULL,
-		     NULL,
-		     &zErrMsg);
+		ReadingRow row;
+		char timestamp[40];
+		char formatted_date[LEN_BUFFER_DATE] = {0};
+		BinaryReadingsReader::formatTimestamp(reader.getUserTs(i), timestamp);
+		if (! formatDate(formatted_date, sizeof(formatted_date), timestamp))
+		{
+			raiseError("appendReadings", "Invalid date |%s|", timestamp);
+			continue;
+		}
+		row.userTs = formatted_date;
+		row.assetCode = reader.getAssetCode(i);
+		row.readKey = reader.getReadKey(i);
+		reader.readingJSON(i, row.reading);
+		rows.push_back(move(row));
+	}
+
+	return ReadingsWriter::getInstance()->append(rows);
+}
 
-	m_writeAccessOngoing.fetch_sub(1);
-	db_cv.notify_all();
+/**
+ * Set the number of rows bound to each execution of the prepared
+ * statement used to append readings. The value is limited by the
+ * maximum number of parameters SQLite allows in a statement.
+ *
+ * @param rows	The number of rows per INSERT
+ */
+void Connection::setAppendBatchSize(unsigned int rows)
+{
+	if (rows == 0)
+	{
+		rows = 1;
+	}
+	if (rows != m_appendBatch)
+	{
+		// Discard the statement prepared for the old batch size
+		sqlite3_finalize(m_appendStmt);
+		m_appendStmt = NULL;
+		m_appendBatch = rows;
 	}
+}
 
-	// Release memory for 'query' var
-	delete[] query;
+/**
+ * Set the table readings are appended to, the readings table or
+ * the partition of the current period
+ *
+ * @param table	The name of the table
+ */
+void Connection::setAppendTable(const string& table)
+{
+	if (table != m_appendTable)
+	{
+		// Discard the statements prepared for the old table
+		sqlite3_finalize(m_appendStmt);
+		sqlite3_finalize(m_appendTailStmt);
+		m_appendStmt = NULL;
+		m_appendTailStmt = NULL;
+		m_appendTable = table;
+	}
+}
 
-	// Check result code
-	if (rc == SQLITE_OK)
+/**
+ * Return a prepared INSERT statement for the readings table that
+ * inserts the given number of rows. The statement for a full batch is
+ * prepared once and kept for the life of the connection, a second
+ * statement is kept for the rows left over after the last full batch
+ * and prepared again when the number of rows left over changes.
+ *
+ * @param rows		Number of rows, m_appendBatch or fewer
+ * @return sqlite3_stmt*	The statement or NULL if it could not be prepared
+ */
+sqlite3_stmt *Connection::appendStatement(unsigned int rows)
+{
+	sqlite3_stmt **stmt = &m_appendStmt;
+	if (rows != m_appendBatch)
 	{
-		// Success
-		return sqlite3_changes(dbHandle);
+		stmt = &m_appendTailStmt;
+		if (rows != m_appendTail)
+		{
+			sqlite3_finalize(m_appendTailStmt);
+			m_appendTailStmt = NULL;
+			m_appendTail = rows;
+		}
 	}
-	else
+	if (*stmt == NULL)
+	{
+		SQLBuffer sql;
+		sql.append("INSERT INTO foglamp.");
+		sql.append(m_appendTable);
+		sql.append(" ( user_ts, asset_code, read_key, reading ) VALUES ");
+		for (unsigned int i = 0; i < rows; i++)
+		{
+			sql.append(i ? ", (?, ?, ?, ?)" : "(?, ?, ?, ?)");
+		}
+		sql.append(';');
+		const char *query = sql.coalesce();
+		if (sqlite3_prepare_v2(dbHandle, query, -1, stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("appendReadings", sqlite3_errmsg(dbHandle));
+			*stmt = NULL;
+		}
+		delete[] query;
+	}
+	return *stmt;
+}
+
+/**
+ * Insert rows into the readings table within the transaction of the
+ * caller, the readings writer. The rows are bound to cached prepared
+ * statements, m_appendBatch rows at a time with the rows left over
+ * inserted by one final statement.
+ *
+ * @param rows		The rows to insert
+ * @return int		The number of rows inserted or -1 on error
+ */
+int Connection::insertRows(const vector<ReadingRow>& rows)
+{
+int	rc = SQLITE_OK;
+int	added = 0;
+
+	// Keep within the number of parameters SQLite allows per statement
+	unsigned int maxRows = (unsigned int)sqlite3_limit(dbHandle, SQLITE_LIMIT_VARIABLE_NUMBER, -1) / 4;
+	if (m_appendBatch > maxRows)
 	{
-	 	raiseError("appendReadings", zErrMsg);
-		sqlite3_free(zErrMsg);
+		setAppendBatchSize(maxRows);
+	}
 
-		// Failure
-		return -1;
+	size_t i = 0;
+	while (i < rows.size() && rc == SQLITE_OK)
+	{
+		unsigned int n = (rows.size() - i >= m_appendBatch) ? m_appendBatch
+								: (unsigned int)(rows.size() - i);
+		sqlite3_stmt *stmt = appendStatement(n);
+		if (!stmt)
+		{
+			rc = SQLITE_ERROR;
+			break;
+		}
+		int param = 1;
+		for (unsigned int j = 0; j < n; j++, i++)
+		{
+			const ReadingRow& row = rows[i];
+			sqlite3_bind_text(stmt, param++, row.userTs.c_str(), row.userTs.length(), SQLITE_STATIC);
+			sqlite3_bind_text(stmt, param++, row.assetCode.c_str(), row.assetCode.length(), SQLITE_STATIC);
+			if (row.readKey.empty())
+			{
+				sqlite3_bind_null(stmt, param++);
+			}
+			else
+			{
+				sqlite3_bind_text(stmt, param++, row.readKey.c_str(), row.readKey.length(), SQLITE_STATIC);
+			}
+			sqlite3_bind_text(stmt, param++, row.reading.c_str(), row.reading.length(), SQLITE_STATIC);
+		}
+		rc = SQLstep(stmt);
+		if (rc == SQLITE_DONE)
+		{
+			added += sqlite3_changes(dbHandle);
+			rc = SQLITE_OK;
+		}
+		else
+		{
+			raiseError("appendReadings", sqlite3_errmsg(dbHandle));
+		}
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
 	}
+
+	return rc == SQLITE_OK ? added : -1;
 }
 #endif
 
@@ -246,12 +362,23 @@ bool 		add_row = false;
  * like for example :
  *
  *    2019-01-11 15:45:01.123456+01:00
+ *
+ * If a writer is given the result is passed to it in parts as the
+ * rows are read, rather than returned in resultSet.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The result, or the buffer used for each part
+ * @param writer	Optional writer for the parts of the result
+ * @param context	The context passed to the writer
  */
 bool Connection::fetchReadings(unsigned long id,
 			       unsigned int blksize,
-			       std::string& resultSet)
+			       std::string& resultSet,
+			       PLUGIN_STREAM_WRITER writer,
+			       void *context)
 {
-char sqlbuffer[512];
+SQLBuffer sql;
 char *zErrMsg = NULL;
 int rc;
 int retrieve;
@@ -263,31 +390,43 @@ int retrieve;
 		asset_code,
 		read_key,
 		reading,
-		strftime('%%Y-%%m-%%d %%H:%%M:%%S', user_ts, 'utc')  ||
+		strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
 		substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
-		strftime('%%Y-%%m-%%d %%H:%%M:%%f', ts, 'utc') AS ts
-	FROM foglamp.readings
-	WHERE id >= %lu
-	ORDER BY id ASC
-	LIMIT %u;
-	)";
+		strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts
+	FROM )";
+
+	sql.append(sql_cmd);
+#ifndef SQLITE_SPLIT_READINGS
+	ReadingsPartitions *partitions = ReadingsPartitions::getInstance();
+	if (partitions)
+	{
+		// Only read the partitions that hold the readings
+		if (!partitions->fetchSource(this, id, blksize, sql))
+		{
+			return false;
+		}
+	}
+	else
+#endif
+	{
+		sql.append("foglamp.readings");
+	}
+	sql.append(" WHERE id >= ");
+	sql.append(id);
+	sql.append(" ORDER BY id ASC LIMIT ");
+	sql.append(blksize);
+	sql.append(';');
 
 	/*
 	 * This query assumes datetime values are in 'localtime'
 	 */
-	snprintf(sqlbuffer,
-		 sizeof(sqlbuffer),
-		 sql_cmd,
-		 id,
-		 blksize);
-	logSQL("ReadingsFetch", sqlbuffer);
+	const char *query = sql.coalesce();
+	logSQL("ReadingsFetch", query);
 	sqlite3_stmt *stmt;
 	// Prepare the SQL statement and get the result set
-	if (sqlite3_prepare_v2(dbHandle,
-			       sqlbuffer,
-			       -1,
-			       &stmt,
-			       NULL) != SQLITE_OK)
+	rc = sqlite3_prepare_v2(dbHandle, query, -1, &stmt, NULL);
+	delete[] query;
+	if (rc != SQLITE_OK)
 	{
 		raiseError("retrieve", sqlite3_errmsg(dbHandle));
 
@@ -297,13 +436,20 @@ int retrieve;
 	else
 	{
 		// Call result set mapping
-		rc = mapResultSet(stmt, resultSet);
+		rc = mapResultSet(stmt, resultSet, writer, context);
 
 		// Delete result set
 		sqlite3_finalize(stmt);
 
 		// Check result set errors
-		if (rc != SQLITE_DONE)
+		if (rc == SQLITE_ABORT)
+		{
+			raiseError("retrieve", "Readings fetch abandoned by the caller");
+
+			// Failure
+			return false;
+		}
+		else if (rc != SQLITE_DONE)
 		{
 			raiseError("retrieve", sqlite3_errmsg(dbHandle));
 
@@ -684,6 +830,14 @@ int blocks = 0;
 
 	Logger *logger = Logger::getLogger();
 
+#ifndef SQLITE_SPLIT_READINGS
+	ReadingsPartitions *partitions = ReadingsPartitions::getInstance();
+	if (partitions)
+	{
+		// Partitions are dropped rather than readings deleted
+		return partitions->purge(this, age, flags, sent, result);
+	}
+#endif
 	result = "{ \"removed\" : 0, ";
 	result += " \"unsentPurged\" : 0, ";
 	result += " \"unsentRetained\" : 0, ";
@@ -875,14 +1029,6 @@ int blocks = 0;
 			unsentPurged = unsent;
 		}
 	}
-	if (m_writeAccessOngoing)
-	{
-		while (m_writeAccessOngoing)
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
-		}
-	}
-
 	unsigned int deletedRows = 0;
 	char *zErrMsg = NULL;
 	unsigned int rowsAffected, totTime=0, prevBlocks=0, prevTotTime=0;
@@ -902,18 +1048,19 @@ int blocks = 0;
 		const char *query = sql.coalesce();
 		logSQL("ReadingsPurge", query);
 
-		int rc;
-		{
-		unique_lock<mutex> lck(db_mutex);
-		if (m_writeAccessOngoing) db_cv.wait(lck);
-
-		START_TIME;
 		// Exec DELETE query: no callback, no resultset
-		rc = SQLexec(dbHandle,
-			     query,
-			     NULL,
-			     NULL,
-			     &zErrMsg);
+		auto deleteBlock = [query, &zErrMsg, &rowsAffected](Connection *conn) -> int {
+			int rc = conn->SQLexec(conn->dbHandle, query, NULL, NULL, &zErrMsg);
+			rowsAffected = sqlite3_changes(conn->dbHandle);
+			return rc;
+		};
+		START_TIME;
+#ifndef SQLITE_SPLIT_READINGS
+		// Deletes are run by the readings writer between appends
+		int rc = ReadingsWriter::getInstance()->execute(deleteBlock);
+#else
+		int rc = deleteBlock(this);
+#endif
 		END_TIME;
 
 		// Release memory for 'query' var
@@ -925,7 +1072,6 @@ int blocks = 0;
 		{
 			std::this_thread::sleep_for(std::chrono::milliseconds(100+usecs/10000));
 		}
-		}
 
 		if (rc != SQLITE_OK)
 		{
@@ -934,8 +1080,6 @@ int blocks = 0;
 			return 0;
 		}
 
-		// Get db changes
-		rowsAffected = sqlite3_changes(dbHandle);
 		deletedRows += rowsAffected;
 		logger->debug("Purge delete block #%d with %d readings", blocks, rowsAffected);
 
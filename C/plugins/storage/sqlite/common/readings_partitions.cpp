@@ -0,0 +1,654 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#ifndef SQLITE_SPLIT_READINGS
+#include <readings_partitions.h>
+#include <readings_writer.h>
+#include <logger.h>
+#include <sstream>
+#include <time.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace std;
+
+ReadingsPartitions *ReadingsPartitions::m_instance = 0;
+
+/**
+ * Partition the readings table if the SQLITE_READINGS_PARTITION
+ * environment variable is set, or the database is already partitioned.
+ * Called when the plugin is initialised, before any readings are read
+ * or written.
+ *
+ * @param conn	A connection to the database
+ * @return bool	True if the readings table is partitioned
+ */
+bool ReadingsPartitions::initialise(Connection *conn)
+{
+	const char *setting = getenv(PARTITION_ENV);
+	bool hourly = setting && strcasecmp(setting, "hour") == 0;
+	unsigned long partitioned = 0;
+	char *zErrMsg = NULL;
+
+	int rc = conn->SQLexec(conn->dbHandle,
+			"SELECT count(*) FROM foglamp.sqlite_master WHERE type = 'table' AND name = '" PARTITION_CATALOG "';",
+			rowidCallback, &partitioned, &zErrMsg);
+	if (rc != SQLITE_OK)
+	{
+		conn->raiseError("partition", zErrMsg);
+		sqlite3_free(zErrMsg);
+		return false;
+	}
+	if (!partitioned)
+	{
+		if (!setting || (!hourly && strcasecmp(setting, "day") != 0))
+		{
+			return false;
+		}
+		// The readings table becomes the first partition
+		rc = conn->SQLexec(conn->dbHandle, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
+		if (rc == SQLITE_OK)
+		{
+			rc = conn->SQLexec(conn->dbHandle,
+				"ALTER TABLE foglamp.readings RENAME TO " PARTITION_PREFIX "0;"
+				"CREATE TABLE foglamp." PARTITION_CATALOG " ("
+					"name TEXT PRIMARY KEY, period TEXT NOT NULL, start_id INTEGER NOT NULL);"
+				"INSERT INTO foglamp." PARTITION_CATALOG " VALUES ('" PARTITION_PREFIX "0', '0', 1);",
+				NULL, NULL, &zErrMsg);
+		}
+	}
+	else
+	{
+		rc = conn->SQLexec(conn->dbHandle, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
+	}
+
+	// The view is created again in case its triggers were not created with it
+	ReadingsPartitions *instance = new ReadingsPartitions(hourly);
+	vector<Partition> partitions;
+	if (rc == SQLITE_OK)
+	{
+		if (instance->catalog(conn, partitions) && instance->createView(conn, partitions))
+		{
+			rc = conn->SQLexec(conn->dbHandle, "COMMIT TRANSACTION;", NULL, NULL, &zErrMsg);
+		}
+		else
+		{
+			rc = SQLITE_ERROR;
+		}
+	}
+	if (rc != SQLITE_OK)
+	{
+		if (zErrMsg)
+			conn->raiseError("partition", zErrMsg);
+		sqlite3_free(zErrMsg);
+		if (sqlite3_get_autocommit(conn->dbHandle) == 0)
+		{
+			sqlite3_exec(conn->dbHandle, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		}
+		if (!partitioned)
+		{
+			delete instance;
+			return false;
+		}
+		Logger::getLogger()->warn("%s: the readings view could not be created again, "
+				"the readings table can not be written by the common table calls",
+				PLUGIN_LOG_NAME);
+	}
+	else if (!partitioned)
+	{
+		Logger::getLogger()->info("%s: the readings table has been partitioned by %s",
+				PLUGIN_LOG_NAME, hourly ? "hour" : "day");
+	}
+	m_instance = instance;
+	return true;
+}
+
+/**
+ * Release the partitioned layout, called when the plugin is shutdown
+ */
+void ReadingsPartitions::shutdown()
+{
+	delete m_instance;
+	m_instance = 0;
+}
+
+/**
+ * Construct the partitioned layout
+ *
+ * @param hourly	True for a partition per hour, else per day
+ */
+ReadingsPartitions::ReadingsPartitions(bool hourly) : m_hourly(hourly)
+{
+}
+
+/**
+ * Return the period of the partition that holds the readings appended
+ * at a given time. Daily periods have an hour of 00 so that hourly
+ * and daily periods compare in time order.
+ *
+ * @param when	The time
+ */
+string ReadingsPartitions::period(time_t when)
+{
+	struct tm tm;
+	char buf[20];
+
+	gmtime_r(&when, &tm);
+	if (!m_hourly)
+	{
+		tm.tm_hour = 0;
+	}
+	strftime(buf, sizeof(buf), "%Y%m%d%H", &tm);
+	return string(buf);
+}
+
+/**
+ * Return the partitions in the catalog in id order
+ *
+ * @param conn		The connection to read the catalog with
+ * @param partitions	Set to the partitions
+ */
+bool ReadingsPartitions::catalog(Connection *conn, vector<Partition>& partitions)
+{
+	sqlite3_stmt *stmt;
+
+	partitions.clear();
+	if (sqlite3_prepare_v2(conn->dbHandle,
+			"SELECT name, period, start_id FROM foglamp." PARTITION_CATALOG " ORDER BY start_id;",
+			-1, &stmt, NULL) != SQLITE_OK)
+	{
+		conn->raiseError("partition", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	int rc;
+	while ((rc = conn->SQLstep(stmt)) == SQLITE_ROW)
+	{
+		Partition partition;
+		partition.name = (const char *)sqlite3_column_text(stmt, 0);
+		partition.period = (const char *)sqlite3_column_text(stmt, 1);
+		partition.startId = (unsigned long)sqlite3_column_int64(stmt, 2);
+		partitions.push_back(partition);
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		conn->raiseError("partition", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Replace the readings view with the UNION ALL of the partitions and
+ * create the triggers that write the partitions through it, within the
+ * transaction of the caller.
+ *
+ * SQLite limits a compound SELECT to PARTITION_MAX terms, beyond that
+ * the partitions are grouped in views of PARTITION_MAX partitions and
+ * the readings view is the UNION ALL of those views. A trigger is
+ * removed with its view, so the triggers always name the partitions
+ * of the view.
+ *
+ * @param conn		The writer connection
+ * @param partitions	The partitions, in id order, the last is the
+ *			partition appended to
+ */
+bool ReadingsPartitions::createView(Connection *conn, const vector<Partition>& partitions)
+{
+	if (partitions.empty() || partitions.size() > PARTITION_MAX * PARTITION_MAX)
+	{
+		conn->raiseError("partition", "%u readings partitions, there must be between 1 and %d",
+				(unsigned int)partitions.size(), PARTITION_MAX * PARTITION_MAX);
+		return false;
+	}
+	if (!dropViews(conn))
+	{
+		return false;
+	}
+
+	// The tables of a view and its triggers are in the schema of the view
+	SQLBuffer sql;
+	vector<string> terms;
+	if (partitions.size() <= PARTITION_MAX)
+	{
+		for (auto& partition : partitions)
+		{
+			terms.push_back(partition.name);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < partitions.size(); i += PARTITION_MAX)
+		{
+			string view = PARTITION_VIEW_PREFIX + to_string(i / PARTITION_MAX);
+			sql.append("CREATE VIEW foglamp.");
+			sql.append(view);
+			sql.append(" AS ");
+			for (size_t j = i; j < partitions.size() && j < i + PARTITION_MAX; j++)
+			{
+				if (j > i)
+					sql.append(" UNION ALL ");
+				sql.append("SELECT * FROM ");
+				sql.append(partitions[j].name);
+			}
+			sql.append(';');
+			terms.push_back(view);
+		}
+	}
+	sql.append("CREATE VIEW foglamp.readings AS ");
+	for (size_t i = 0; i < terms.size(); i++)
+	{
+		if (i)
+			sql.append(" UNION ALL ");
+		sql.append("SELECT * FROM ");
+		sql.append(terms[i]);
+	}
+	sql.append(';');
+
+	// The view has no defaults, the trigger supplies those of the partitions
+	sql.append("CREATE TRIGGER foglamp.readings_insert INSTEAD OF INSERT ON readings BEGIN ");
+	sql.append("INSERT INTO ");
+	sql.append(partitions.back().name);
+	sql.append(" (asset_code, read_key, reading, user_ts, ts) VALUES (NEW.asset_code, NEW.read_key, "
+			"coalesce(NEW.reading, '{}'), "
+			"coalesce(NEW.user_ts, STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')), "
+			"coalesce(NEW.ts, STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW'))); END;");
+	sql.append("CREATE TRIGGER foglamp.readings_update INSTEAD OF UPDATE ON readings BEGIN ");
+	for (auto& partition : partitions)
+	{
+		sql.append("UPDATE ");
+		sql.append(partition.name);
+		sql.append(" SET asset_code = NEW.asset_code, read_key = NEW.read_key, reading = NEW.reading, "
+				"user_ts = NEW.user_ts, ts = NEW.ts WHERE id = OLD.id;");
+	}
+	sql.append(" END;");
+	sql.append("CREATE TRIGGER foglamp.readings_delete INSTEAD OF DELETE ON readings BEGIN ");
+	for (auto& partition : partitions)
+	{
+		sql.append("DELETE FROM ");
+		sql.append(partition.name);
+		sql.append(" WHERE id = OLD.id;");
+	}
+	sql.append(" END;");
+
+	const char *query = sql.coalesce();
+	char *zErrMsg = NULL;
+	int rc = conn->SQLexec(conn->dbHandle, query, NULL, NULL, &zErrMsg);
+	delete[] query;
+	if (rc != SQLITE_OK)
+	{
+		conn->raiseError("partition", zErrMsg);
+		sqlite3_free(zErrMsg);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Drop the readings view and the views of groups of partitions it
+ * is made from, within the transaction of the caller
+ *
+ * @param conn		The writer connection
+ */
+bool ReadingsPartitions::dropViews(Connection *conn)
+{
+	sqlite3_stmt *stmt;
+	vector<string> views;
+
+	if (sqlite3_prepare_v2(conn->dbHandle,
+			"SELECT name FROM foglamp.sqlite_master WHERE type = 'view' AND "
+				"(name = 'readings' OR name LIKE '" PARTITION_VIEW_PREFIX "%');",
+			-1, &stmt, NULL) != SQLITE_OK)
+	{
+		conn->raiseError("partition", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	int rc;
+	while ((rc = conn->SQLstep(stmt)) == SQLITE_ROW)
+	{
+		views.push_back((const char *)sqlite3_column_text(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		conn->raiseError("partition", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	for (auto& view : views)
+	{
+		string sql = "DROP VIEW foglamp." + view + ";";
+		char *zErrMsg = NULL;
+		if (conn->SQLexec(conn->dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+		{
+			conn->raiseError("partition", zErrMsg);
+			sqlite3_free(zErrMsg);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return the partition readings are appended to, creating the partition
+ * for the current period if it has started. Called by the readings
+ * writer before each transaction.
+ *
+ * If the partition can not be created the readings are appended to
+ * the previous partition.
+ *
+ * @param conn	The writer connection
+ * @return	The name of the partition
+ */
+string ReadingsPartitions::current(Connection *conn)
+{
+	vector<Partition> partitions;
+
+	if (m_current.empty())
+	{
+		if (!catalog(conn, partitions) || partitions.empty())
+		{
+			return string("readings");
+		}
+		m_current = partitions.back().name;
+		m_currentPeriod = partitions.back().period;
+	}
+	string now = period(time(0));
+	if (now.compare(m_currentPeriod) <= 0)
+	{
+		// Periods only move forwards, even if the clock does not
+		return m_current;
+	}
+
+	string name = PARTITION_PREFIX + now;
+	char *zErrMsg = NULL;
+	int rc = conn->SQLexec(conn->dbHandle, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
+	if (rc == SQLITE_OK)
+	{
+		// The ids of the new partition follow those of the others
+		unsigned long lastId = 0;
+		rc = conn->SQLexec(conn->dbHandle,
+				"SELECT coalesce(max(seq), 0) FROM foglamp.sqlite_sequence WHERE name LIKE '" PARTITION_PREFIX "%';",
+				rowidCallback, &lastId, &zErrMsg);
+		if (rc == SQLITE_OK)
+		{
+			ostringstream sql;
+			sql << "CREATE TABLE foglamp." << name << " ("
+				"id INTEGER PRIMARY KEY AUTOINCREMENT, "
+				"asset_code character varying(50) NOT NULL, "
+				"read_key uuid UNIQUE, "
+				"reading JSON NOT NULL DEFAULT '{}', "
+				"user_ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')), "
+				"ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')));";
+			sql << "CREATE INDEX foglamp." << name << "_ix1 ON " << name << " (asset_code, user_ts desc);";
+			sql << "CREATE INDEX foglamp." << name << "_ix2 ON " << name << " (asset_code);";
+			sql << "CREATE INDEX foglamp." << name << "_ix3 ON " << name << " (user_ts);";
+			sql << "INSERT INTO foglamp.sqlite_sequence (name, seq) VALUES ('" << name << "', " << lastId << ");";
+			sql << "INSERT INTO foglamp." PARTITION_CATALOG " VALUES ('" << name << "', '" << now << "', "
+				<< lastId + 1 << ");";
+			rc = conn->SQLexec(conn->dbHandle, sql.str().c_str(), NULL, NULL, &zErrMsg);
+		}
+	}
+	if (rc == SQLITE_OK)
+	{
+		if (catalog(conn, partitions) && createView(conn, partitions))
+		{
+			rc = conn->SQLexec(conn->dbHandle, "COMMIT TRANSACTION;", NULL, NULL, &zErrMsg);
+		}
+		else
+		{
+			rc = SQLITE_ERROR;
+		}
+	}
+	if (rc != SQLITE_OK)
+	{
+		Logger::getLogger()->error("%s: failed to create readings partition %s: %s",
+				PLUGIN_LOG_NAME, name.c_str(),
+				zErrMsg ? zErrMsg : sqlite3_errmsg(conn->dbHandle));
+		sqlite3_free(zErrMsg);
+		if (sqlite3_get_autocommit(conn->dbHandle) == 0)
+		{
+			sqlite3_exec(conn->dbHandle, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		}
+		return m_current;
+	}
+	m_current = name;
+	m_currentPeriod = now;
+	return m_current;
+}
+
+/**
+ * Return the source of a readings fetch, the UNION ALL of the first
+ * blksize readings from id of each partition that may hold them. As
+ * ids increase across the partitions the union never holds more than
+ * blksize readings from each.
+ *
+ * @param conn		The connection to read the catalog with
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param source	The FROM clause of the fetch is appended to this
+ */
+bool ReadingsPartitions::fetchSource(Connection *conn, unsigned long id,
+				     unsigned int blksize, SQLBuffer& source)
+{
+	vector<Partition> partitions;
+	if (!catalog(conn, partitions))
+	{
+		return false;
+	}
+	size_t first = 0;
+	while (first + 1 < partitions.size() && partitions[first + 1].startId <= id)
+	{
+		first++;
+	}
+	source.append('(');
+	unsigned long spanned = 0;
+	for (size_t i = first; i < partitions.size() && spanned < blksize; i++)
+	{
+		if (i > first)
+			source.append(" UNION ALL ");
+		source.append("SELECT * FROM (SELECT * FROM foglamp.");
+		source.append(partitions[i].name);
+		source.append(" WHERE id >= ");
+		source.append(id);
+		source.append(" ORDER BY id LIMIT ");
+		source.append(blksize);
+		source.append(')');
+		if (i + 1 < partitions.size())
+		{
+			spanned += partitions[i + 1].startId - max(id, partitions[i].startId);
+		}
+	}
+	source.append(')');
+	return true;
+}
+
+/**
+ * Return the lowest and highest ids in a partition, both are 0 if it
+ * is empty
+ */
+bool ReadingsPartitions::idRange(Connection *conn, const string& partition,
+				 unsigned long& minId, unsigned long& maxId)
+{
+	sqlite3_stmt *stmt;
+	string sql = "SELECT min(id), max(id) FROM foglamp." + partition + ";";
+
+	minId = maxId = 0;
+	if (sqlite3_prepare_v2(conn->dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		conn->raiseError("purge", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	int rc = conn->SQLstep(stmt);
+	if (rc == SQLITE_ROW)
+	{
+		minId = (unsigned long)sqlite3_column_int64(stmt, 0);
+		maxId = (unsigned long)sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_ROW)
+	{
+		conn->raiseError("purge", sqlite3_errmsg(conn->dbHandle));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Purge readings by dropping the oldest partitions in which every
+ * reading is older than the age. The partition being appended to is
+ * kept. The partitions are dropped by the readings writer.
+ *
+ * @param conn		The connection to read the partitions with
+ * @param age		The age in hours, 0 drops the oldest partition
+ * @param flags		0x01 to retain readings that have not been sent
+ * @param sent		The id of the last reading sent
+ * @param result	Set to the JSON result of the purge
+ * @return		The number of readings removed
+ */
+unsigned int ReadingsPartitions::purge(Connection *conn, unsigned long age,
+				       unsigned int flags, unsigned long sent,
+				       string& result)
+{
+	Logger *logger = Logger::getLogger();
+	vector<Partition> partitions;
+	unsigned long removed = 0, unsentPurged = 0, unsentRetained = 0, remaining = 0;
+
+	result = "{ \"removed\" : 0, ";
+	result += " \"unsentPurged\" : 0, ";
+	result += " \"unsentRetained\" : 0, ";
+	result += " \"readings\" : 0 }";
+
+	if (!catalog(conn, partitions))
+	{
+		return 0;
+	}
+
+	size_t drop = 0;
+	for (size_t i = 0; i + 1 < partitions.size(); i++)
+	{
+		unsigned long minId, maxId;
+		if (!idRange(conn, partitions[i].name, minId, maxId))
+		{
+			return 0;
+		}
+		if (age && maxId)
+		{
+			unsigned long young = 0;
+			ostringstream sql;
+			sql << "SELECT max(user_ts) >= datetime('now', '-" << age << " hours') FROM foglamp."
+				<< partitions[i].name << ";";
+			char *zErrMsg = NULL;
+			if (conn->SQLexec(conn->dbHandle, sql.str().c_str(), rowidCallback, &young, &zErrMsg) != SQLITE_OK)
+			{
+				conn->raiseError("purge", zErrMsg);
+				sqlite3_free(zErrMsg);
+				return 0;
+			}
+			if (young)
+			{
+				break;
+			}
+		}
+		if ((flags & 0x01) && sent && maxId > sent)
+		{
+			break;
+		}
+		if (maxId)
+		{
+			removed += maxId - minId + 1;
+			if (sent && maxId > sent)
+			{
+				unsentPurged += maxId - max(sent, minId - 1);
+			}
+		}
+		drop++;
+		if (age == 0)
+		{
+			break;
+		}
+	}
+
+	if (drop)
+	{
+		vector<Partition> dropped(partitions.begin(), partitions.begin() + drop);
+		vector<Partition> kept(partitions.begin() + drop, partitions.end());
+		auto dropPartitions = [this, &dropped, &kept](Connection *conn) -> int {
+			char *zErrMsg = NULL;
+			int rc = conn->SQLexec(conn->dbHandle, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
+			if (rc == SQLITE_OK)
+			{
+				rc = createView(conn, kept) ? SQLITE_OK : SQLITE_ERROR;
+			}
+			for (auto& partition : dropped)
+			{
+				if (rc != SQLITE_OK)
+					break;
+				string sql = "DROP TABLE foglamp." + partition.name + ";"
+					"DELETE FROM foglamp." PARTITION_CATALOG " WHERE name = '" + partition.name + "';";
+				rc = conn->SQLexec(conn->dbHandle, sql.c_str(), NULL, NULL, &zErrMsg);
+			}
+			if (rc == SQLITE_OK)
+			{
+				rc = conn->SQLexec(conn->dbHandle, "COMMIT TRANSACTION;", NULL, NULL, &zErrMsg);
+			}
+			if (rc != SQLITE_OK)
+			{
+				if (zErrMsg)
+					conn->raiseError("purge", zErrMsg);
+				sqlite3_free(zErrMsg);
+				if (sqlite3_get_autocommit(conn->dbHandle) == 0)
+				{
+					sqlite3_exec(conn->dbHandle, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+				}
+			}
+			return rc;
+		};
+		if (ReadingsWriter::getInstance()->execute(dropPartitions) != SQLITE_OK)
+		{
+			return 0;
+		}
+		for (auto& partition : dropped)
+		{
+			logger->info("Purge dropped readings partition %s", partition.name.c_str());
+		}
+	}
+	else
+	{
+		logger->info("No readings partition to purge");
+	}
+
+	for (size_t i = drop; i < partitions.size(); i++)
+	{
+		unsigned long minId, maxId;
+		if (idRange(conn, partitions[i].name, minId, maxId) && maxId)
+		{
+			remaining += maxId - minId + 1;
+			if (maxId > sent)
+			{
+				unsentRetained += maxId - max(sent, minId - 1);
+			}
+		}
+	}
+
+	if (sent == 0)	// Special case when not north process is used
+	{
+		unsentPurged = removed;
+	}
+
+	ostringstream convert;
+
+	convert << "{ \"removed\" : " << removed << ", ";
+	convert << " \"unsentPurged\" : " << unsentPurged << ", ";
+	convert << " \"unsentRetained\" : " << unsentRetained << ", ";
+	convert << " \"readings\" : " << remaining << " }";
+
+	result = convert.str();
+	return removed;
+}
+#endif
@@ -0,0 +1,248 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#ifndef SQLITE_SPLIT_READINGS
+#include <readings_writer.h>
+#include <connection_manager.h>
+#include <readings_partitions.h>
+#include <logger.h>
+
+using namespace std;
+
+ReadingsWriter *ReadingsWriter::m_instance = 0;
+static mutex instanceMutex;
+
+/**
+ * Return the writer, starting it on first use
+ */
+ReadingsWriter *ReadingsWriter::getInstance()
+{
+	lock_guard<mutex> guard(instanceMutex);
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsWriter();
+	}
+	return m_instance;
+}
+
+/**
+ * Open the connection used for writing and start the writer thread
+ */
+ReadingsWriter::ReadingsWriter() : m_running(true), m_appends(0), m_transactions(0)
+{
+	m_connection = new Connection();
+	m_thread = new thread(&ReadingsWriter::run, this);
+}
+
+/**
+ * Append rows to the readings table, waiting for the transaction
+ * they are inserted in to be committed
+ *
+ * @param rows	The rows to insert
+ * @return int	The number of rows inserted or -1 on error
+ */
+int ReadingsWriter::append(const vector<ReadingRow>& rows)
+{
+	if (rows.empty())
+	{
+		return 0;
+	}
+	Request request = { &rows, NULL, 0, false };
+	return submit(request);
+}
+
+/**
+ * Run a write on the writer connection between append transactions,
+ * waiting for it to complete
+ *
+ * @param job	The write, passed the writer connection
+ * @return int	The result of the job
+ */
+int ReadingsWriter::execute(const function<int(Connection *)>& job)
+{
+	Request request = { NULL, &job, 0, false };
+	return submit(request);
+}
+
+/**
+ * Queue a request for the writer thread and wait for its result
+ */
+int ReadingsWriter::submit(Request& request)
+{
+	unique_lock<mutex> lck(m_mutex);
+	if (!m_running)
+	{
+		ConnectionManager::getInstance()->setError("appendReadings",
+				"The storage plugin is shutting down", true);
+		return -1;
+	}
+	m_queue.push_back(&request);
+	m_cv.notify_one();
+	m_doneCv.wait(lck, [&request] { return request.done; });
+	return request.result;
+}
+
+/**
+ * Stop the writer, if it was started, once the queued requests are
+ * complete. Later appends fail.
+ */
+void ReadingsWriter::shutdown()
+{
+	ReadingsWriter *writer;
+	{
+		lock_guard<mutex> guard(instanceMutex);
+		writer = m_instance;
+	}
+	if (!writer)
+	{
+		return;
+	}
+	{
+		lock_guard<mutex> guard(writer->m_mutex);
+		if (!writer->m_running)
+		{
+			return;
+		}
+		writer->m_running = false;
+	}
+	writer->m_cv.notify_one();
+	writer->m_thread->join();
+	delete writer->m_thread;
+	delete writer->m_connection;
+	Logger::getLogger()->info("%s readings writer: %lu appends in %lu transactions",
+			PLUGIN_LOG_NAME, writer->m_appends, writer->m_transactions);
+}
+
+/**
+ * The writer thread. Takes the appends queued ahead of the first job
+ * as one group, or the job on its own.
+ */
+void ReadingsWriter::run()
+{
+	vector<Request *> group;
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_cv.wait(lck, [this] { return !m_queue.empty() || !m_running; });
+		if (m_queue.empty())
+		{
+			break;
+		}
+		group.clear();
+		if (m_queue.front()->job)
+		{
+			group.push_back(m_queue.front());
+			m_queue.pop_front();
+		}
+		else
+		{
+			size_t rows = 0;
+			while (!m_queue.empty() && !m_queue.front()->job
+				&& (group.empty() || rows + m_queue.front()->rows->size() <= WRITER_MAX_ROWS))
+			{
+				rows += m_queue.front()->rows->size();
+				group.push_back(m_queue.front());
+				m_queue.pop_front();
+			}
+		}
+		lck.unlock();
+		vector<int> results;
+		if (group[0]->job)
+		{
+			results.push_back((*group[0]->job)(m_connection));
+		}
+		else
+		{
+			commit(group, results);
+		}
+		lck.lock();
+		for (size_t i = 0; i < group.size(); i++)
+		{
+			complete(group[i], results[i]);
+		}
+		m_doneCv.notify_all();
+	}
+}
+
+/**
+ * Insert the rows of a group of appends in one transaction, each in
+ * its own savepoint so that an append that fails is rolled back alone.
+ *
+ * Some errors make SQLite roll back the whole transaction rather than
+ * the statement, the appends already inserted are then lost and the
+ * rest of the group would run outside a transaction. The whole group
+ * fails in that case, as it does if a savepoint can not be used.
+ *
+ * @param group		The appends
+ * @param results	Set to the result of each append
+ */
+void ReadingsWriter::commit(const vector<Request *>& group, vector<int>& results)
+{
+	Connection *conn = m_connection;
+	sqlite3 *db = conn->dbHandle;
+	char *zErrMsg = NULL;
+
+	results.assign(group.size(), -1);
+	ReadingsPartitions *partitions = ReadingsPartitions::getInstance();
+	if (partitions)
+	{
+		conn->setAppendTable(partitions->current(conn));
+	}
+	int rc = conn->SQLexec(db, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
+	for (size_t i = 0; i < group.size() && rc == SQLITE_OK; i++)
+	{
+		rc = sqlite3_exec(db, "SAVEPOINT append;", NULL, NULL, &zErrMsg);
+		if (rc != SQLITE_OK)
+		{
+			break;
+		}
+		results[i] = conn->insertRows(*group[i]->rows);
+		if (results[i] == -1)
+		{
+			if (sqlite3_get_autocommit(db))
+			{
+				// The transaction has been rolled back
+				rc = SQLITE_ABORT;
+				break;
+			}
+			rc = sqlite3_exec(db, "ROLLBACK TO append;", NULL, NULL, &zErrMsg);
+			if (rc != SQLITE_OK)
+			{
+				break;
+			}
+		}
+		rc = sqlite3_exec(db, "RELEASE append;", NULL, NULL, &zErrMsg);
+	}
+	if (rc == SQLITE_OK)
+	{
+		rc = conn->SQLexec(db, "COMMIT TRANSACTION;", NULL, NULL, &zErrMsg);
+	}
+	if (rc != SQLITE_OK)
+	{
+		if (sqlite3_get_autocommit(db) == 0)
+		{
+			sqlite3_exec(db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		}
+		conn->raiseError("appendReadings", "%s", zErrMsg ? zErrMsg : sqlite3_errmsg(db));
+		results.assign(group.size(), -1);
+	}
+	sqlite3_free(zErrMsg);
+	m_transactions++;
+	m_appends += group.size();
+}
+
+/**
+ * Set the result of a request, called with the mutex held
+ */
+void ReadingsWriter::complete(Request *request, int result)
+{
+	request->result = result;
+	request->done = true;
+}
+#endif
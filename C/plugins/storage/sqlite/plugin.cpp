@@ -9,6 +9,8 @@
  */
 #include <connection_manager.h>
 #include <connection.h>
+#include <readings_writer.h>
+#include <readings_partitions.h>
 #include <plugin_api.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,7 +41,9 @@ static PLUGIN_INFORMATION info = {
 	"1.0.0",                  // Version
 	SP_COMMON|SP_READINGS,    // Flags
 	PLUGIN_TYPE_STORAGE,      // Type
-	"1.2.0"                   // Interface version
+	"1.2.0",                  // Interface version
+	"{ \"appendBatchSize\" : { \"value\" : \"50\", "
+		"\"description\" : \"The number of readings inserted by each SQLite INSERT statement\" } }"
 };
 
 /**
@@ -60,9 +64,44 @@ PLUGIN_HANDLE plugin_init()
 ConnectionManager *manager = ConnectionManager::getInstance();
 
 	manager->growPool(5);
+	Connection *connection = manager->allocate();
+	ReadingsPartitions::initialise(connection);
+	manager->release(connection);
 	return manager;
 }
 
+/**
+ * Apply the storage service configuration category to the plugin,
+ * called once the plugin is loaded and again when the category changes
+ */
+void plugin_reconfigure(PLUGIN_HANDLE handle, const char *config)
+{
+Document doc;
+
+	doc.Parse(config);
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		Logger::getLogger()->error("SQLite3 plugin: unable to parse the storage configuration");
+		return;
+	}
+	if (doc.HasMember("appendBatchSize") && doc["appendBatchSize"].IsObject()
+			&& doc["appendBatchSize"].HasMember("value")
+			&& doc["appendBatchSize"]["value"].IsString())
+	{
+		int rows = atoi(doc["appendBatchSize"]["value"].GetString());
+		if (rows <= 0)
+		{
+			Logger::getLogger()->warn("SQLite3 plugin: ignoring appendBatchSize of %d", rows);
+			return;
+		}
+		// The statements are prepared on the connection of the readings writer
+		ReadingsWriter::getInstance()->execute([rows](Connection *connection) {
+			connection->setAppendBatchSize((unsigned int)rows);
+			return 0;
+		});
+	}
+}
+
 /**
  * Insert into an arbitrary table
  */
@@ -133,6 +172,20 @@ Connection        *connection = manager->allocate();
 	return result;;
 }
 
+/**
+ * Append a sequence of readings in the binary batch format
+ * to the readings buffer
+ */
+int plugin_reading_append_binary(PLUGIN_HANDLE handle, const char *data, size_t length)
+{
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+
+	int result = connection->appendReadingsBinary(data, length);
+	manager->release(connection);
+	return result;
+}
+
 /**
  * Fetch a block of readings from the readings buffer
  */
@@ -147,6 +200,22 @@ std::string	  resultSet;
 	return strdup(resultSet.c_str());
 }
 
+/**
+ * Fetch a block of readings from the readings buffer, passing the
+ * result to the writer in parts as it is read
+ */
+bool plugin_reading_fetch_stream(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize,
+				 PLUGIN_STREAM_WRITER writer, void *context)
+{
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+std::string	  buffer;
+
+	bool rval = connection->fetchReadings(id, blksize, buffer, writer, context);
+	manager->release(connection);
+	return rval;
+}
+
 /**
  * Retrieve some readings from the readings buffer
  */
@@ -215,6 +284,8 @@ bool plugin_shutdown(PLUGIN_HANDLE handle)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
   
+	ReadingsWriter::shutdown();
+	ReadingsPartitions::shutdown();
 	manager->shutdown();
 	return true;
 }
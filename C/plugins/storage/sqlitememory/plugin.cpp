@@ -89,6 +89,22 @@ std::string	  resultSet;
 	return strdup(resultSet.c_str());
 }
 
+/**
+ * Fetch a block of readings from the readings buffer, passing the
+ * result to the writer in parts as it is read
+ */
+bool plugin_reading_fetch_stream(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize,
+				 PLUGIN_STREAM_WRITER writer, void *context)
+{
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+std::string	  buffer;
+
+	bool rval = connection->fetchReadings(id, blksize, buffer, writer, context);
+	manager->release(connection);
+	return rval;
+}
+
 /**
  * Retrieve some readings from the readings buffer
  */
@@ -0,0 +1,42 @@
+#ifndef _LOCAL_HTTP_SERVER_H
+#define _LOCAL_HTTP_SERVER_H
+/*
+ * FogLAMP HTTP server on a Unix domain socket.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <server_http.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <string>
+#include <memory>
+
+/**
+ * An HTTP server that, as well as the TCP port, listens on a Unix
+ * domain socket for clients on the same host.
+ *
+ * Connections accepted on the socket are served by the same resources
+ * as those accepted on the port, so the REST API is identical on both.
+ */
+class LocalHttpServer : public SimpleWeb::Server<SimpleWeb::HTTP> {
+	public:
+		LocalHttpServer();
+		~LocalHttpServer();
+		void			setSocketPath(const std::string& path);
+		const std::string&	getSocketPath() const { return m_socketPath; };
+		void			stop();
+
+	protected:
+		void			after_bind() override;
+
+	private:
+		void			acceptLocal();
+		std::string		m_socketPath;
+		std::unique_ptr<boost::asio::local::stream_protocol::acceptor>
+					m_localAcceptor;
+};
+
+#endif
@@ -16,6 +16,9 @@
 #include <string>
 #include <time.h>
 #include <thread>
+#include <mutex>
+#include <vector>
+#include <utility>
 
 #define PING			"/foglamp/service/ping"
 #define SERVICE_SHUTDOWN	"/foglamp/service/shutdown"
@@ -36,6 +39,7 @@ class ManagementApi {
 		void stop();
 		void stopServer();
 		void registerStats(JSONProvider *statsProvider);
+		void registerStats(const std::string& name, JSONProvider *provider);
 		void registerService(ServiceHandler *serviceHandler) {
 			m_serviceHandler = serviceHandler;
 		}
@@ -53,6 +57,10 @@ class ManagementApi {
 		time_t		m_startTime;
 		HttpServer	*m_server;
 		JSONProvider	*m_statsProvider;
+		// Further statistics returned by ping, each under its own name
+		std::vector<std::pair<std::string, JSONProvider *>>
+				m_namedStats;
+		std::mutex	m_statsMutex;
 		ServiceHandler	*m_serviceHandler;
 		std::thread	*m_thread;
 	private:
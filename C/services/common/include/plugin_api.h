@@ -9,6 +9,7 @@
  *
  * Author: Mark Riddoch, Massimiliano Pinto
  */
+#include <stddef.h>
  
 typedef struct {
         const char	*name;
@@ -26,6 +27,13 @@ typedef struct {
 } PLUGIN_ERROR;
  
 typedef void * PLUGIN_HANDLE;
+
+/**
+ * Called by a storage plugin with each part of a result that is
+ * streamed rather than returned as a whole. Returns false if the
+ * caller no longer wants the result, the plugin should then stop.
+ */
+typedef bool (*PLUGIN_STREAM_WRITER)(void *context, const char *data, size_t length);
  
 /**
  * Plugin options bitmask values
@@ -36,6 +44,15 @@ typedef void * PLUGIN_HANDLE;
 #define SP_PERSIST_DATA	0x0008
 #define SP_INGEST	0x0010
  
+/**
+ * The lowest interface version of a C south, north or filter plugin.
+ * Reading and Datapoint objects are allocated and freed by the class
+ * operator new and delete declared in reading.h and datapoint.h, a
+ * plugin built against an earlier interface creates and deletes them
+ * with the global operators and cannot share them with the service.
+ */
+#define PLUGIN_READING_INTERFACE_MAJOR	2
+
 /**
  * Plugin types
  */
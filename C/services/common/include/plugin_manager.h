@@ -43,6 +43,7 @@ class PluginManager {
 
 	private:
                 PluginManager();
+                static bool	sharesReadings(const std::string& type);
 
 	private:
                 std::list<PLUGIN_HANDLE>		plugins;
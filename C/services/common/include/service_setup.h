@@ -0,0 +1,39 @@
+#ifndef _SERVICE_SETUP_H
+#define _SERVICE_SETUP_H
+/*
+ * FogLAMP plugin service setup.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <management_api.h>
+#include <management_client.h>
+#include <service_handler.h>
+#include <config_category.h>
+#include <string>
+
+/**
+ * The steps shared by the services that run a plugin, the south and
+ * north services, to start their management API and to register their
+ * configuration with the core.
+ */
+class ServiceSetup {
+	public:
+		static void		startManagement(ManagementApi& management,
+							ServiceHandler *service);
+		static std::string	serviceAddress(const std::string& coreAddress,
+							unsigned short corePort);
+		static void		createParentCategory(ManagementClient *mgtClient,
+							const std::string& parent);
+		static void		createConfigCategories(ManagementClient *mgtClient,
+							DefaultConfigCategory configCategory,
+							const std::string& parent,
+							const std::string& current);
+		static ConfigCategory	createAdvancedCategory(ManagementClient *mgtClient,
+							const std::string& name,
+							DefaultConfigCategory& defaults);
+};
+#endif
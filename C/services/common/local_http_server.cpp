@@ -0,0 +1,143 @@
+/*
+ * FogLAMP HTTP server on a Unix domain socket.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <local_http_server.h>
+#include <logger.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace boost::asio;
+
+/**
+ * Create the server, it only listens on the TCP port until
+ * a socket path is set
+ */
+LocalHttpServer::LocalHttpServer()
+{
+}
+
+/**
+ * Destroy the server, removing the Unix domain socket
+ */
+LocalHttpServer::~LocalHttpServer()
+{
+	stop();
+}
+
+/**
+ * Set the path of the Unix domain socket to listen on, this must
+ * be set before the server is started.
+ *
+ * @param path	The path of the socket
+ */
+void LocalHttpServer::setSocketPath(const string& path)
+{
+	m_socketPath = path;
+}
+
+/**
+ * Called when the TCP port has been bound, start listening on the
+ * Unix domain socket. If the socket can not be created the server
+ * continues on the TCP port alone and the socket path is cleared.
+ */
+void LocalHttpServer::after_bind()
+{
+	if (m_socketPath.empty())
+	{
+		return;
+	}
+	if (m_socketPath.length() >= sizeof(((struct sockaddr_un *)0)->sun_path))
+	{
+		Logger::getLogger()->error("Unix domain socket path %s is too long", m_socketPath.c_str());
+		m_socketPath.clear();
+		return;
+	}
+	try {
+		local::stream_protocol::endpoint endpoint(m_socketPath);
+		// Remove a socket left by a server that is no longer running
+		local::stream_protocol::socket probe(*io_service);
+		boost::system::error_code ec;
+		probe.connect(endpoint, ec);
+		if (!ec)
+		{
+			Logger::getLogger()->error("Unix domain socket %s is in use by another server",
+						   m_socketPath.c_str());
+			m_socketPath.clear();
+			return;
+		}
+		unlink(m_socketPath.c_str());
+		m_localAcceptor.reset(new local::stream_protocol::acceptor(*io_service, endpoint));
+	} catch (const boost::system::system_error& e) {
+		Logger::getLogger()->error("Unable to listen on Unix domain socket %s: %s",
+					   m_socketPath.c_str(), e.what());
+		m_localAcceptor.reset();
+		m_socketPath.clear();
+		return;
+	}
+	acceptLocal();
+}
+
+/**
+ * Accept the next connection on the Unix domain socket.
+ *
+ * The server connections are TCP sockets, the accepted descriptor
+ * is assigned to one so the connection can be served in the same
+ * way as those accepted on the port.
+ */
+void LocalHttpServer::acceptLocal()
+{
+	auto socket = make_shared<local::stream_protocol::socket>(*io_service);
+	m_localAcceptor->async_accept(*socket, [this, socket](const boost::system::error_code& ec) {
+		auto lock = handler_runner->continue_lock();
+		if (!lock || ec == error::operation_aborted || !m_localAcceptor->is_open())
+		{
+			return;
+		}
+		this->acceptLocal();
+		if (ec)
+		{
+			return;
+		}
+		int fd = dup(socket->native_handle());
+		socket->close();
+		if (fd == -1)
+		{
+			return;
+		}
+		auto connection = create_connection(*io_service);
+		boost::system::error_code aec;
+		connection->socket->assign(ip::tcp::v4(), fd, aec);
+		if (aec)
+		{
+			::close(fd);
+			return;
+		}
+		// Clients on the socket are reported as the loopback address
+		connection->remote_endpoint = make_shared<ip::tcp::endpoint>(ip::address_v4::loopback(), 0);
+		auto session = make_shared<Session>(config.max_request_streambuf_size, connection);
+		this->read(session);
+	});
+}
+
+/**
+ * Stop listening on the Unix domain socket and the TCP port, and
+ * close all the current connections
+ */
+void LocalHttpServer::stop()
+{
+	if (m_localAcceptor && m_localAcceptor->is_open())
+	{
+		boost::system::error_code ec;
+		m_localAcceptor->close(ec);
+		unlink(m_socketPath.c_str());
+	}
+	SimpleWeb::Server<SimpleWeb::HTTP>::stop();
+}
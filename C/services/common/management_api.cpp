@@ -118,9 +118,34 @@ ManagementApi::~ManagementApi()
  */
 void ManagementApi::registerStats(JSONProvider *statsProvider)
 {
+	lock_guard<mutex> guard(m_statsMutex);
 	m_statsProvider = statsProvider;
 }
 
+/**
+ * Register a provider of statistics returned by the ping request
+ * under the given name, a NULL provider removes the name
+ *
+ * @param name		The name of the statistics in the ping response
+ * @param provider	The statistics provider
+ */
+void ManagementApi::registerStats(const string& name, JSONProvider *provider)
+{
+	lock_guard<mutex> guard(m_statsMutex);
+	for (auto it = m_namedStats.begin(); it != m_namedStats.end(); ++it)
+	{
+		if (it->first.compare(name) == 0)
+		{
+			m_namedStats.erase(it);
+			break;
+		}
+	}
+	if (provider)
+	{
+		m_namedStats.push_back(make_pair(name, provider));
+	}
+}
+
 /**
  * Received a ping request, construct a reply and return to caller
  */
@@ -132,11 +157,20 @@ string responsePayload;
 	(void)request;	// Unsused argument
 	convert << "{ \"uptime\" : " << time(0) - m_startTime << ",";
 	convert << "\"name\" : \"" << m_name << "\"";
-	if (m_statsProvider)
 	{
-		string stats;
-		m_statsProvider->asJSON(stats);
-		convert << ", \"statistics\" : " << stats;
+		lock_guard<mutex> guard(m_statsMutex);
+		if (m_statsProvider)
+		{
+			string stats;
+			m_statsProvider->asJSON(stats);
+			convert << ", \"statistics\" : " << stats;
+		}
+		for (auto& named : m_namedStats)
+		{
+			string stats;
+			named.second->asJSON(stats);
+			convert << ", \"" << named.first << "\" : " << stats;
+		}
 	}
 	convert << " }";
 	responsePayload = convert.str();
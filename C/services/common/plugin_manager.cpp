@@ -8,6 +8,7 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <cstdio>
+#include <cstdlib>
 #include <dlfcn.h>
 #include <string.h>
 #include <iostream>
@@ -103,6 +104,15 @@ char          buf[128];
         delete pluginHandle;
         return NULL;
       }
+
+      if (sharesReadings(type) && atoi(info->interface) < PLUGIN_READING_INTERFACE_MAJOR)
+      {
+        // Built against a Reading class with a different allocator
+        logger->error("C plugin %s implements interface %s, interface %d.0.0 or later is required.\n",
+          name.c_str(), info->interface, PLUGIN_READING_INTERFACE_MAJOR);
+        delete pluginHandle;
+        return NULL;
+      }
 	  
       plugins.push_back(pluginHandle);
       pluginNames[name] = hndl;
@@ -173,6 +183,17 @@ char          buf[128];
   return NULL;
 }
 
+/**
+ * Return if plugins of the given type create or delete the Reading
+ * and Datapoint objects of the service
+ */
+bool PluginManager::sharesReadings(const string& type)
+{
+  return type.compare(PLUGIN_TYPE_SOUTH) == 0 ||
+         type.compare(PLUGIN_TYPE_NORTH) == 0 ||
+         type.compare(PLUGIN_TYPE_FILTER) == 0;
+}
+
 /**
  * Find a loaded plugin by name.
  */
@@ -0,0 +1,178 @@
+/*
+ * FogLAMP plugin service setup.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <service_setup.h>
+#include <logger.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Start the management API of a service, allowing time for the
+ * listener to start before the service registers with the core
+ *
+ * @param management	The management API of the service
+ * @param service	The service the API calls
+ */
+void ServiceSetup::startManagement(ManagementApi& management, ServiceHandler *service)
+{
+	management.registerService(service);
+
+	// Listen for incoming management requests
+	management.start();
+
+	sleep(1);
+}
+
+/**
+ * Return the address the core reaches the service on, that of the
+ * interface the service uses to reach the core. No data is sent, the
+ * UDP socket is only connected to have the route to the core chosen.
+ *
+ * @param coreAddress	The address of the core
+ * @param corePort	The management port of the core
+ * @return		The address of the service or "localhost" if
+ *			it can not be found
+ */
+string ServiceSetup::serviceAddress(const string& coreAddress, unsigned short corePort)
+{
+	struct addrinfo hints = {}, *result;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(coreAddress.c_str(), to_string(corePort).c_str(), &hints, &result) != 0)
+	{
+		Logger::getLogger()->warn("Unable to resolve the core address %s, registering as localhost",
+				coreAddress.c_str());
+		return "localhost";
+	}
+
+	string address("localhost");
+	int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	if (sock != -1)
+	{
+		struct sockaddr_in local;
+		socklen_t len = sizeof(local);
+		char buf[INET_ADDRSTRLEN];
+		if (connect(sock, result->ai_addr, result->ai_addrlen) == 0
+			&& getsockname(sock, (struct sockaddr *)&local, &len) == 0
+			&& inet_ntop(AF_INET, &local.sin_addr, buf, sizeof(buf)))
+		{
+			address = buf;
+		}
+		close(sock);
+	}
+	freeaddrinfo(result);
+	return address;
+}
+
+/**
+ * Create the empty category, such as "South" or "North", that the
+ * categories of the services of a type are children of, if it does
+ * not exist
+ *
+ * @param mgtClient	The management client of the service
+ * @param parent	The name of the category
+ */
+void ServiceSetup::createParentCategory(ManagementClient *mgtClient, const string& parent)
+{
+	DefaultConfigCategory parentConfig(parent, string("{}"));
+	parentConfig.setDescription(parent);
+	mgtClient->addCategory(parentConfig, true);
+}
+
+/**
+ * Creates config categories and sub categories recursively, along with
+ * their parent-child relations.
+ *
+ * The description of a sub category is that of the item it is defined
+ * by, the description of the category of the plugin is that of its
+ * "plugin" item.
+ *
+ * @param mgtClient	The management client of the service
+ * @param configCategory	The default configuration of the category
+ * @param parent	The name of the parent category
+ * @param current	The name of the category
+ */
+void ServiceSetup::createConfigCategories(ManagementClient *mgtClient,
+					  DefaultConfigCategory configCategory,
+					  const string& parent,
+					  const string& current)
+{
+	// Deal with registering and fetching the configuration
+	DefaultConfigCategory defConfig(configCategory);
+	string description = defConfig.getDescription();
+	if (description.empty() && defConfig.itemExists("plugin"))
+	{
+		description = defConfig.getDescription("plugin");
+	}
+	defConfig.setDescription(description.empty() ? current : description);
+
+	DefaultConfigCategory defConfigCategoryOnly(defConfig);
+	defConfigCategoryOnly.keepItemsType(ConfigCategory::ItemType::CategoryType);
+	defConfig.removeItemsType(ConfigCategory::ItemType::CategoryType);
+
+	// Create/Update category name (we pass keep_original_items=true)
+	mgtClient->addCategory(defConfig, true);
+
+	// Add this category under its parent category
+	vector<string> children;
+	children.push_back(current);
+	mgtClient->addChildCategories(parent, children);
+
+	// Adds sub categories to the configuration
+	bool extracted = true;
+	ConfigCategory subCategory;
+	while (extracted) {
+
+		extracted = subCategory.extractSubcategory(defConfigCategoryOnly);
+
+		if (extracted) {
+			DefaultConfigCategory defSubCategory(subCategory);
+
+			createConfigCategories(mgtClient, defSubCategory, current, subCategory.getName());
+
+			// Cleans the category
+			subCategory.removeItems();
+			subCategory = ConfigCategory() ;
+		}
+	}
+}
+
+/**
+ * Create the advanced configuration category of a service, a child
+ * of the category of the service, and return the merged category
+ *
+ * @param mgtClient	The management client of the service
+ * @param name		The name of the service
+ * @param defaults	The default advanced configuration
+ * @return		The advanced configuration of the service
+ */
+ConfigCategory ServiceSetup::createAdvancedCategory(ManagementClient *mgtClient,
+						    const string& name,
+						    DefaultConfigCategory& defaults)
+{
+	string advancedCatName = name + string("Advanced");
+	defaults.setDescription(name + string(" advanced config params"));
+
+	// Create/Update category name (we pass keep_original_items=true)
+	mgtClient->addCategory(defaults, true);
+
+	// Add the advanced category under the category of the service
+	vector<string> children;
+	children.push_back(advancedCatName);
+	mgtClient->addChildCategories(name, children);
+
+	// Must now reload the merged configuration
+	return mgtClient->getCategory(advancedCatName);
+}
@@ -0,0 +1,32 @@
+#ifndef _DEFAULTS_H
+#define _DEFAULTS_H
+/*
+ * FogLAMP north service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+static struct {
+	const char	*name;
+	const char	*displayName;
+	const char	*description;
+	const char	*type;
+	const char	*value;
+} defaults[] = {
+	{ "blockSize",		"Readings Block Size",
+			"The number of readings fetched and sent in each block", "integer", "500" },
+	{ "memoryBufferSize",	"Memory Buffer Size",
+			"The number of blocks of readings to hold in memory ahead of sending", "integer", "10" },
+	{ "checkpointInterval",	"Checkpoint Interval (s)",
+			"Seconds between saving the position of the last reading sent", "integer", "10" },
+	{ "storageConnections",	"Storage Connections",
+			"Maximum number of connections held open to the storage service", "integer", "4" },
+	{ "storageIdleTimeout",	"Storage Idle Timeout (s)",
+			"Seconds after which an idle connection to the storage service is closed", "integer", "60" },
+	{ NULL, NULL, NULL, NULL, NULL }
+};
+#endif
@@ -0,0 +1,117 @@
+#ifndef _NORTH_SERVICE_H
+#define _NORTH_SERVICE_H
+/*
+ * FogLAMP north service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <logger.h>
+#include <north_plugin.h>
+#include <service_handler.h>
+#include <management_client.h>
+#include <storage_client.h>
+#include <config_category.h>
+#include <filter_pipeline.h>
+#include <asset_tracking.h>
+#include <reading_set.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+#define SERVICE_NAME  "FogLAMP North"
+
+/**
+ * The NorthService class. A north service sends the readings, or
+ * statistics, held in the storage service to a north plugin
+ * continuously, rather than for the fixed duration of a scheduled
+ * sending process task.
+ *
+ * A load thread fetches blocks of readings from the storage service
+ * and passes them through the filter pipeline into a queue, the
+ * service thread sends the blocks in the queue with the plugin. The
+ * id of the last reading sent is saved in the streams table
+ * periodically and when the service shuts down.
+ *
+ * Changes to the configuration of the plugin restart the plugin,
+ * changes to the filters rebuild the filter pipeline, without
+ * restarting the service.
+ */
+class NorthService : public ServiceHandler {
+	// The unit tests run the load thread against a fake core and storage
+	friend class NorthServiceTest;
+	public:
+		NorthService(const std::string& name);
+		~NorthService();
+		void 				start(std::string& coreAddress,
+						      unsigned short corePort);
+		void 				stop();
+		void				shutdown();
+		void				configChange(const std::string&,
+						const std::string&);
+		static void			passToOnwardFilter(OUTPUT_HANDLE *outHandle,
+							READINGSET *readings);
+		static void			useFilteredData(OUTPUT_HANDLE *outHandle,
+							READINGSET *readings);
+	private:
+		/**
+		 * A block of readings loaded and waiting to be sent
+		 */
+		typedef struct {
+			ReadingSet	*readings;	// The filtered readings, may be NULL
+			unsigned long	lastId;		// The last id fetched for the block
+		} Block;
+
+		void				addConfigDefaults(DefaultConfigCategory& defaults);
+		bool 				loadPlugin();
+		void				startPlugin(const ConfigCategory& config);
+		void				stopPlugin();
+		bool				loadFilters();
+		void				reloadFilters();
+		bool				getStream();
+		void				loadThread();
+		ReadingSet			*fetch(unsigned long lastId);
+		void				trackAssets(ReadingSet *readings);
+		void				send();
+		void				checkpoint();
+		void				updateStatistics(const std::string& key,
+							const std::string& description,
+							unsigned long sent);
+		void				setAdvanced();
+	private:
+		NorthPlugin			*m_plugin;
+		const std::string		m_name;
+		Logger        			*logger;
+		bool				m_shutdown;
+		ConfigCategory			m_config;
+		ConfigCategory			m_configAdvanced;
+		ManagementClient		*m_mgtClient;
+		StorageClient			*m_storage;
+		AssetTracker			*m_assetTracker;
+		FilterPipeline			*m_filterPipeline;
+		std::mutex			m_filterMutex;
+		bool				m_filtersFailed;	// Guarded by both mutexes
+		ReadingSet			*m_filtered;	// Output of the filter pipeline
+		std::string			m_pluginName;
+		std::string			m_pipeline;	// The filters in the pipeline
+		std::string			m_source;
+		int				m_streamId;
+		std::thread			*m_loadThread;
+		std::mutex			m_mutex;
+		std::condition_variable		m_cv;
+		std::deque<Block>		m_queue;
+		std::atomic<unsigned long>	m_blockSize;
+		std::atomic<unsigned long>	m_queueSize;
+		std::atomic<unsigned int>	m_checkpointInterval;
+		std::string			m_reconfigure;	// A new plugin configuration
+		unsigned long			m_lastSent;
+		unsigned long			m_sent;		// Sent since the last checkpoint
+		unsigned long			m_checkpointed;	// The last id saved in the streams table
+};
+#endif
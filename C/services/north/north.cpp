@@ -0,0 +1,998 @@
+/*
+ * FogLAMP north service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <execinfo.h>
+#include <dlfcn.h>    // for dladdr
+#include <cxxabi.h>   // for __cxa_demangle
+#include <unistd.h>
+#include <north_service.h>
+#include <management_api.h>
+#include <service_setup.h>
+#include <service_record.h>
+#include <plugin_manager.h>
+#include <plugin_api.h>
+#include <plugin.h>
+#include <logger.h>
+#include <reading.h>
+#include <iostream>
+#include <defaults.h>
+#include <filter_plugin.h>
+#include <config_handler.h>
+#include <syslog.h>
+
+#define NORTH_FETCH_SLEEP	500	// mS to wait when there are no readings to send
+#define NORTH_READING_WAIT	1000	// mS the storage service holds a wait for readings
+#define NORTH_SEND_SLEEP	500	// mS to wait after the first failure to send
+#define NORTH_SEND_SLEEP_MAX	32000	// The longest wait after repeated failures
+
+extern int makeDaemon(void);
+extern void handler(int sig);
+
+using namespace std;
+
+/**
+ * North service main entry point
+ */
+int main(int argc, char *argv[])
+{
+unsigned short corePort = 8082;
+string	       coreAddress = "localhost";
+bool	       daemonMode = true;
+string	       myName = SERVICE_NAME;
+string	       logLevel = "warning";
+
+	signal(SIGSEGV, handler);
+	signal(SIGILL, handler);
+	signal(SIGBUS, handler);
+	signal(SIGFPE, handler);
+	signal(SIGABRT, handler);
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-d"))
+		{
+			daemonMode = false;
+		}
+		else if (!strncmp(argv[i], "--port=", 7))
+		{
+			corePort = (unsigned short)strtol(&argv[i][7], NULL, 10);
+		}
+		else if (!strncmp(argv[i], "--name=", 7))
+		{
+			myName = &argv[i][7];
+		}
+		else if (!strncmp(argv[i], "--address=", 10))
+		{
+			coreAddress = &argv[i][10];
+		}
+		else if (!strncmp(argv[i], "--logLevel=", 11))
+		{
+			logLevel = &argv[i][11];
+		}
+	}
+
+	if (daemonMode && makeDaemon() == -1)
+	{
+		// Failed to run in daemon mode
+		cout << "Failed to run as deamon - proceeding in interactive mode." << endl;
+	}
+
+	NorthService *service = new NorthService(myName);
+	Logger::getLogger()->setMinLevel(logLevel);
+	service->start(coreAddress, corePort);
+	return 0;
+}
+
+/**
+ * Detach the process from the terminal and run in the background.
+ */
+int makeDaemon()
+{
+pid_t pid;
+
+	/* Make the child process inherit the log level */
+	int logmask = setlogmask(0);
+	/* create new process */
+	if ((pid = fork()  ) == -1)
+	{
+		return -1;
+	}
+	else if (pid != 0)
+	{
+		exit (EXIT_SUCCESS);
+	}
+	setlogmask(logmask);
+
+	// If we got here we are a child process
+
+	// create new session and process group
+	if (setsid() == -1)
+	{
+		return -1;
+	}
+
+	// Close stdin, stdout and stderr
+	close(0);
+	close(1);
+	close(2);
+	// redirect fd's 0,1,2 to /dev/null
+	(void)open("/dev/null", O_RDWR);  	// stdin
+	(void)dup(0);  			// stdout	GCC bug 66425 produces warning
+	(void)dup(0);  			// stderr	GCC bug 66425 produces warning
+ 	return 0;
+}
+
+void handler(int sig)
+{
+Logger	*logger = Logger::getLogger();
+void	*array[20];
+char	buf[1024];
+int	size;
+
+	// get void*'s for all entries on the stack
+	size = backtrace(array, 20);
+
+	// print out all the frames to stderr
+	logger->fatal("Signal %d (%s) trapped:\n", sig, strsignal(sig));
+	char **messages = backtrace_symbols(array, size);
+	for (int i = 0; i < size; i++)
+	{
+		Dl_info info;
+		if (dladdr(array[i], &info) && info.dli_sname)
+		{
+		    char *demangled = NULL;
+		    int status = -1;
+		    if (info.dli_sname[0] == '_')
+		        demangled = abi::__cxa_demangle(info.dli_sname, NULL, 0, &status);
+		    snprintf(buf, sizeof(buf), "%-3d %*p %s + %zd---------",
+		             i, int(2 + sizeof(void*) * 2), array[i],
+		             status == 0 ? demangled :
+		             info.dli_sname == 0 ? messages[i] : info.dli_sname,
+		             (char *)array[i] - (char *)info.dli_saddr);
+		    free(demangled);
+		}
+		else
+		{
+		    snprintf(buf, sizeof(buf), "%-3d %*p %s---------",
+		             i, int(2 + sizeof(void*) * 2), array[i], messages[i]);
+		}
+		logger->fatal("(%d) %s", i, buf);
+	}
+	free(messages);
+	exit(1);
+}
+
+/**
+ * Return true if the items of the plugin configuration, the
+ * category without the filter pipeline, differ
+ */
+static bool pluginConfigChanged(const ConfigCategory& current, const ConfigCategory& updated)
+{
+	for (auto item : updated)
+	{
+		if (item->m_name.compare("filter") == 0)
+		{
+			continue;
+		}
+		if (!current.itemExists(item->m_name)
+			|| current.getValue(item->m_name).compare(item->m_value))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Constructor for the north service
+ */
+NorthService::NorthService(const string& myName) : m_plugin(NULL), m_name(myName), m_shutdown(false),
+	m_mgtClient(NULL), m_storage(NULL), m_assetTracker(NULL), m_filterPipeline(NULL),
+	m_filtersFailed(false), m_filtered(NULL), m_streamId(0), m_loadThread(NULL), m_blockSize(500),
+	m_queueSize(10), m_checkpointInterval(10), m_lastSent(0), m_sent(0), m_checkpointed(0)
+{
+	logger = new Logger(myName);
+	logger->setMinLevel("warning");
+}
+
+/**
+ * Destructor for the north service
+ */
+NorthService::~NorthService()
+{
+	delete m_plugin;
+	delete m_storage;
+	delete m_assetTracker;
+	delete m_mgtClient;
+	delete logger;
+}
+
+/**
+ * Start the north service
+ */
+void NorthService::start(string& coreAddress, unsigned short corePort)
+{
+	unsigned short managementPort = (unsigned short)0;
+	ManagementApi management(SERVICE_NAME, managementPort);	// Start management API
+	logger->info("Starting north service...");
+	ServiceSetup::startManagement(management, this);
+
+	if (! m_shutdown)
+	{
+		// Now register our service
+		unsigned short managementListener = management.getListenerPort();
+		ServiceRecord record(m_name, "Northbound", "http",
+				ServiceSetup::serviceAddress(coreAddress, corePort), 0, managementListener);
+		m_mgtClient = new ManagementClient(coreAddress, corePort);
+
+		// Create an empty North category if one doesn't exist
+		ServiceSetup::createParentCategory(m_mgtClient, "North");
+
+		m_config = m_mgtClient->getCategory(m_name);
+		if (!loadPlugin())
+		{
+			logger->fatal("Failed to load north plugin, exiting...");
+			management.stop();
+			return;
+		}
+		if (!m_mgtClient->registerService(record))
+		{
+			logger->error("Failed to register service %s", m_name.c_str());
+		}
+
+		// Get a handle on the storage layer
+		ServiceRecord storageRecord("FogLAMP Storage");
+		if (!m_mgtClient->getService(storageRecord))
+		{
+			logger->fatal("Unable to find storage service");
+			m_mgtClient->unregisterService();
+			management.stop();
+			return;
+		}
+		logger->info("Connect to storage on %s:%d",
+				storageRecord.getAddress().c_str(),
+				storageRecord.getPort());
+		m_storage = new StorageClient(storageRecord.getAddress(),
+						storageRecord.getPort(),
+						storageRecord.getSocket());
+		// The use of the storage connections is returned by the ping request
+		management.registerStats("storageClient", m_storage);
+
+		setAdvanced();
+		try {
+			m_source = m_config.itemExists("source") ? m_config.getValue("source") : "readings";
+			m_pipeline = m_config.itemExists("filter") ? m_config.getValue("filter") : "";
+		} catch (ConfigItemNotFound& e) {
+			logger->info("Defaulting to inline defaults for north configuration");
+		}
+
+		if (!getStream())
+		{
+			logger->fatal("Unable to find or create the stream for %s", m_name.c_str());
+			m_mgtClient->unregisterService();
+			management.stop();
+			return;
+		}
+
+		m_assetTracker = new AssetTracker(m_mgtClient, m_name);
+		m_assetTracker->populateAssetTrackingCache(m_name, "Egress");
+
+		startPlugin(m_config);
+
+		// Load filter plugins
+		if (!loadFilters())
+		{
+			string errMsg("'" + m_name + "' plugin: failed loading filter plugins.");
+			Logger::getLogger()->fatal((errMsg + " Exiting.").c_str());
+			throw runtime_error(errMsg);
+		}
+
+		ConfigHandler *configHandler = ConfigHandler::getInstance(m_mgtClient);
+		configHandler->registerCategory(this, m_name);
+		configHandler->registerCategory(this, m_name+"Advanced");
+
+		// Stream the readings until the service is shutdown
+		m_loadThread = new thread(&NorthService::loadThread, this);
+		send();
+		m_loadThread->join();
+		delete m_loadThread;
+
+		checkpoint();
+		stopPlugin();
+
+		// Readings loaded but not sent are fetched again on restart
+		for (auto& block : m_queue)
+		{
+			delete block.readings;
+		}
+		m_queue.clear();
+		{
+			lock_guard<mutex> guard(m_filterMutex);
+			if (m_filterPipeline)
+			{
+				m_filterPipeline->cleanupFilters(m_name);
+				delete m_filterPipeline;
+				m_filterPipeline = NULL;
+			}
+		}
+
+		// Clean shutdown, unregister the north service
+		m_mgtClient->unregisterService();
+	}
+	management.stop();
+	logger->info("North service shutdown completed");
+}
+
+/**
+ * Stop the north service
+ */
+void NorthService::stop()
+{
+	logger->info("Stopping north service...\n");
+}
+
+/**
+ * Load the configured north plugin
+ */
+bool NorthService::loadPlugin()
+{
+	try {
+		PluginManager *manager = PluginManager::getInstance();
+
+		if (! m_config.itemExists("plugin"))
+		{
+			logger->error("Unable to fetch plugin name from configuration.\n");
+			return false;
+		}
+		m_pluginName = m_config.getValue("plugin");
+		logger->info("Loading north plugin %s.", m_pluginName.c_str());
+		PLUGIN_HANDLE handle;
+		if ((handle = manager->loadPlugin(m_pluginName, PLUGIN_TYPE_NORTH)) != NULL)
+		{
+			// Adds categories and sub categories to the configuration
+			DefaultConfigCategory defConfig(m_name, manager->getInfo(handle)->config);
+			ServiceSetup::createConfigCategories(m_mgtClient, defConfig, "North", m_name);
+
+			// Must now reload the configuration to obtain any items added from
+			// the plugin
+			m_config.removeItems();
+			m_config = m_mgtClient->getCategory(m_name);
+
+			// Deal with registering and fetching the advanced configuration
+			DefaultConfigCategory defConfigAdvanced(m_name + string("Advanced"), string("{}"));
+			addConfigDefaults(defConfigAdvanced);
+			m_configAdvanced = ServiceSetup::createAdvancedCategory(m_mgtClient, m_name, defConfigAdvanced);
+
+			m_plugin = new NorthPlugin(handle);
+			return true;
+		}
+	} catch (exception& e) {
+		logger->fatal("Failed to load north plugin: %s\n", e.what());
+	}
+	return false;
+}
+
+/**
+ * Initialise and start the plugin. Data the plugin persisted when it
+ * was last shutdown, such as the types an OMF plugin has sent, is
+ * passed to the plugin.
+ *
+ * @param config	The configuration of the plugin
+ */
+void NorthService::startPlugin(const ConfigCategory& config)
+{
+	m_plugin->init(config);
+	if (m_plugin->persistData())
+	{
+		if (!m_plugin->m_plugin_data)
+		{
+			m_plugin->m_plugin_data = new PluginData(m_storage);
+		}
+		// The key is the same as that of the sending process task
+		string storedData = m_plugin->m_plugin_data->loadStoredData(m_name + m_pluginName);
+		m_plugin->startData(storedData);
+	}
+	else
+	{
+		m_plugin->start();
+	}
+}
+
+/**
+ * Shutdown the plugin, saving the data it persists
+ */
+void NorthService::stopPlugin()
+{
+	if (m_plugin->m_plugin_data)
+	{
+		string saveData = m_plugin->shutdownSaveData();
+		string key(m_name + m_pluginName);
+		if (!m_plugin->m_plugin_data->persistPluginData(key, saveData))
+		{
+			logger->error("Plugin %s has failed to save data [%s] for key %s",
+					m_pluginName.c_str(), saveData.c_str(), key.c_str());
+		}
+	}
+	else
+	{
+		m_plugin->shutdown();
+	}
+}
+
+/**
+ * Load the filter pipeline of the service. Called with the
+ * filter mutex held once the service is running.
+ *
+ * @return	True if the filters were loaded and initialised
+ *		or there are no filters
+ */
+bool NorthService::loadFilters()
+{
+	m_filterPipeline = new FilterPipeline(m_mgtClient, *m_storage, m_name);
+	if (!m_filterPipeline->loadFilters(m_name))
+	{
+		return false;
+	}
+	if (m_filterPipeline->getFilterCount() == 0)
+	{
+		return true;
+	}
+	return m_filterPipeline->setupFiltersPipeline((void *)passToOnwardFilter,
+						       (void *)useFilteredData, this);
+}
+
+/**
+ * Replace the filter pipeline of the running service, called with the
+ * filter mutex held. If the new pipeline fails to load no readings are
+ * loaded for sending, rather than sending them unfiltered, until a
+ * later change to the pipeline or its filters loads it.
+ */
+void NorthService::reloadFilters()
+{
+	if (m_filterPipeline)
+	{
+		m_filterPipeline->cleanupFilters(m_name);
+		delete m_filterPipeline;
+		m_filterPipeline = NULL;
+	}
+	bool loaded = loadFilters();
+	if (!loaded)
+	{
+		logger->error("Failed to load the new filter pipeline, sending is stopped until it is corrected");
+		delete m_filterPipeline;
+		m_filterPipeline = NULL;
+	}
+	else if (m_filtersFailed)
+	{
+		logger->info("The filter pipeline has loaded, sending is resumed");
+	}
+	lock_guard<mutex> guard(m_mutex);
+	m_filtersFailed = !loaded;
+	m_cv.notify_all();
+}
+
+/**
+ * Pass the current readings set to the next filter in the pipeline
+ *
+ * @param outHandle	Pointer to next filter
+ * @param readings	Current readings set
+ */
+void NorthService::passToOnwardFilter(OUTPUT_HANDLE *outHandle, READINGSET *readings)
+{
+	FilterPlugin *next = (FilterPlugin *)outHandle;
+	next->ingest(readings);
+}
+
+/**
+ * Use the readings output by the last filter in the pipeline
+ *
+ * @param outHandle	The north service
+ * @param readings	The filtered readings
+ */
+void NorthService::useFilteredData(OUTPUT_HANDLE *outHandle, READINGSET *readings)
+{
+	NorthService *service = (NorthService *)outHandle;
+	service->m_filtered = (ReadingSet *)readings;
+}
+
+/**
+ * Find the stream of the service and the id of the last reading sent
+ * on it, creating the stream if the configuration does not have one.
+ *
+ * @return	True if the stream was found or created
+ */
+bool NorthService::getStream()
+{
+	m_streamId = m_config.itemExists("streamId") ? atoi(m_config.getValue("streamId").c_str()) : 0;
+	if (m_streamId == 0)
+	{
+		InsertValues streamValues;
+		streamValues.push_back(InsertValue("description", m_name));
+		streamValues.push_back(InsertValue("last_object", 0));
+		if (m_storage->insertTable("streams", streamValues) != 1)
+		{
+			logger->error("Failed to insert a row into the streams table");
+			return false;
+		}
+		const Condition conditionId(Equals);
+		Query qName(new Where("description", conditionId, m_name));
+		ResultSet *rows = m_storage->queryTable("streams", qName);
+		if (rows != NULL && rows->rowCount())
+		{
+			ResultSet::RowIterator it = rows->firstRow();
+			m_streamId = (int)(*it)->getColumn("id")->getInteger();
+		}
+		delete rows;
+		if (m_streamId == 0)
+		{
+			return false;
+		}
+		try {
+			m_mgtClient->setCategoryItemValue(m_name, "streamId", to_string(m_streamId));
+		} catch (...) {
+			logger->error("Failed to set the stream id %d in the configuration", m_streamId);
+		}
+		m_lastSent = 0;
+	}
+	else
+	{
+		const Condition conditionId(Equals);
+		Query qLastId(new Where("id", conditionId, to_string(m_streamId)));
+		ResultSet *lastObject = m_storage->queryTable("streams", qLastId);
+		bool found = lastObject != NULL && lastObject->rowCount();
+		if (found)
+		{
+			ResultSet::RowIterator it = lastObject->firstRow();
+			m_lastSent = (unsigned long)(*it)->getColumn("last_object")->getInteger();
+		}
+		delete lastObject;
+		if (!found)
+		{
+			InsertValues streamValues;
+			streamValues.push_back(InsertValue("id", m_streamId));
+			streamValues.push_back(InsertValue("description", m_name));
+			streamValues.push_back(InsertValue("last_object", 0));
+			if (m_storage->insertTable("streams", streamValues) != 1)
+			{
+				logger->error("Failed to insert a row into the streams table for stream %d", m_streamId);
+				return false;
+			}
+			m_lastSent = 0;
+		}
+	}
+	m_checkpointed = m_lastSent;
+	logger->info("Sending on stream %d from reading id %lu", m_streamId, m_lastSent);
+	return true;
+}
+
+/**
+ * The load thread. Fetches blocks of readings after the last one
+ * fetched, passes them through the filter pipeline and queues them
+ * for sending, waiting while the queue is full.
+ *
+ * When there are no readings the thread waits in the storage service
+ * for readings to be appended, or sleeps if the source is statistics,
+ * the storage service does not support the wait or refuses it.
+ */
+void NorthService::loadThread()
+{
+	unsigned long lastFetched = m_lastSent;
+	bool waitSupported = m_source.compare("statistics") != 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait(lck, [this] {
+					return m_shutdown || (m_queue.size() < m_queueSize && !m_filtersFailed);
+					});
+			if (m_shutdown)
+			{
+				break;
+			}
+		}
+
+		ReadingSet *readings = fetch(lastFetched);
+		if (readings == NULL || readings->getCount() == 0)
+		{
+			bool fetched = readings != NULL;
+			delete readings;
+			if (fetched && waitSupported)
+			{
+				try {
+					m_storage->readingWait(lastFetched, NORTH_READING_WAIT);
+					continue;
+				} catch (ReadingWaitUnsupported&) {
+					logger->warn("Waiting for readings is not available, polling for readings instead");
+					waitSupported = false;
+				} catch (exception&) {
+					// The storage service refused or failed the wait,
+					// it is tried again after the sleep
+				}
+			}
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::milliseconds(NORTH_FETCH_SLEEP), [this] { return m_shutdown; });
+			continue;
+		}
+
+		// The position is that of the unfiltered readings
+		Block block;
+		block.lastId = readings->getLastId();
+		{
+			lock_guard<mutex> guard(m_filterMutex);
+			if (m_filtersFailed)
+			{
+				// Fetched again once the pipeline loads
+				delete readings;
+				continue;
+			}
+			FilterPlugin *firstFilter = m_filterPipeline ? m_filterPipeline->getFirstFilterPlugin() : NULL;
+			if (firstFilter)
+			{
+				m_filtered = NULL;
+				firstFilter->ingest(readings);
+				block.readings = m_filtered;
+			}
+			else
+			{
+				block.readings = readings;
+			}
+		}
+		lastFetched = block.lastId;
+		if (block.readings)
+		{
+			trackAssets(block.readings);
+		}
+
+		lock_guard<mutex> guard(m_mutex);
+		m_queue.push_back(block);
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Fetch the block of readings, or statistics history, that follows
+ * the given id
+ *
+ * @param lastId	The id of the last reading fetched
+ * @return		The readings or NULL on error
+ */
+ReadingSet *NorthService::fetch(unsigned long lastId)
+{
+	try {
+		if (m_source.compare("statistics"))
+		{
+			return m_storage->readingFetch(lastId + 1, m_blockSize);
+		}
+
+		// SELECT id, key AS asset_code, key AS read_key, ts, history_ts AS user_ts, value
+		// FROM statistics_history WHERE id > lastId ORDER BY id LIMIT blockSize
+		const Condition conditionId(GreaterThan);
+		Where *wId = new Where("id", conditionId, to_string(lastId));
+		vector<Returns *> columns;
+		columns.push_back(new Returns("id"));
+		columns.push_back(new Returns("key", "asset_code"));
+		columns.push_back(new Returns("key", "read_key"));
+		columns.push_back(new Returns("ts"));
+		Returns *userTs = new Returns("history_ts", "user_ts");
+		userTs->timezone("utc");
+		columns.push_back(userTs);
+		columns.push_back(new Returns("value"));
+		Query qStatistics(columns, wId);
+		qStatistics.limit(m_blockSize);
+		qStatistics.sort(new Sort("id"));
+		return m_storage->queryTableToReadings("statistics_history", qStatistics);
+	} catch (ReadingSetException *e) {
+		logger->error("Failed to fetch readings: %s", e->what());
+	} catch (exception& e) {
+		logger->error("Failed to fetch readings: %s", e.what());
+	}
+	return NULL;
+}
+
+/**
+ * Add the assets of the readings sent to the asset tracker
+ */
+void NorthService::trackAssets(ReadingSet *readings)
+{
+	const vector<Reading *>& vec = readings->getAllReadings();
+	InternedName plugin(m_pluginName), event("Egress");
+	for (auto it = vec.cbegin(); it != vec.cend(); ++it)
+	{
+		if (!m_assetTracker->checkAssetTrackingCache(plugin, (*it)->getInternedAssetName(), event))
+		{
+			AssetTrackingTuple tuple(m_name, m_pluginName, (*it)->getAssetName(), "Egress");
+			m_assetTracker->addAssetTrackingTuple(tuple);
+		}
+	}
+}
+
+/**
+ * Send the queued blocks of readings until the service is shutdown.
+ * A block that fails to send is retried after a wait that doubles up
+ * to NORTH_SEND_SLEEP_MAX. The plugin is reconfigured here, or
+ * restarted if it can not be, when its configuration changes,
+ * between blocks.
+ */
+void NorthService::send()
+{
+	unsigned long backoff = NORTH_SEND_SLEEP;
+	time_t lastCheckpoint = time(0);
+
+	while (true)
+	{
+		Block block;
+		bool queued = false;
+		string reconfigure;
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(1), [this] {
+					return m_shutdown || !m_queue.empty() || !m_reconfigure.empty();
+					});
+			if (m_shutdown)
+			{
+				break;
+			}
+			reconfigure.swap(m_reconfigure);
+			if (!m_queue.empty())
+			{
+				block = m_queue.front();
+				queued = true;
+			}
+		}
+		if (!reconfigure.empty())
+		{
+			if (m_plugin->hasReconfigure())
+			{
+				logger->info("Reconfiguring the north plugin");
+				m_plugin->reconfigure(reconfigure);
+			}
+			else
+			{
+				logger->info("Restarting the north plugin with the new configuration");
+				stopPlugin();
+				startPlugin(ConfigCategory(m_name, reconfigure));
+			}
+			backoff = NORTH_SEND_SLEEP;
+		}
+
+		if (queued)
+		{
+			uint32_t sent = 0;
+			if (block.readings && block.readings->getCount())
+			{
+				sent = m_plugin->send(block.readings->getAllReadings());
+			}
+			if (sent || !block.readings || block.readings->getCount() == 0)
+			{
+				{
+					lock_guard<mutex> guard(m_mutex);
+					m_queue.pop_front();
+					m_cv.notify_all();
+				}
+				delete block.readings;
+				m_lastSent = block.lastId;
+				m_sent += sent;
+				backoff = NORTH_SEND_SLEEP;
+			}
+			else
+			{
+				logger->debug("Failed to send %d readings, retrying in %lu mS",
+						block.readings->getCount(), backoff);
+				unique_lock<mutex> lck(m_mutex);
+				m_cv.wait_for(lck, chrono::milliseconds(backoff), [this] {
+						return m_shutdown || !m_reconfigure.empty();
+						});
+				backoff = min(backoff * 2, (unsigned long)NORTH_SEND_SLEEP_MAX);
+			}
+		}
+
+		if (time(0) - lastCheckpoint >= (time_t)m_checkpointInterval)
+		{
+			checkpoint();
+			lastCheckpoint = time(0);
+		}
+	}
+}
+
+/**
+ * Save the id of the last reading sent in the streams table and add
+ * the readings sent since the last checkpoint to the statistics
+ */
+void NorthService::checkpoint()
+{
+	if (m_lastSent == m_checkpointed && m_sent == 0)
+	{
+		return;
+	}
+
+	const Condition conditionStream(Equals);
+	Where wStreamId("id", conditionStream, to_string(m_streamId));
+	InsertValues lastId;
+	lastId.push_back(InsertValue("last_object", (long)m_lastSent));
+	if (m_storage->updateTable("streams", lastId, wStreamId) == -1)
+	{
+		logger->error("Failed to save the last reading id sent, %lu, on stream %d",
+				m_lastSent, m_streamId);
+		return;
+	}
+	m_checkpointed = m_lastSent;
+
+	if (m_sent)
+	{
+		if (m_source.compare("statistics"))
+		{
+			updateStatistics("Readings Sent", "Readings Sent North", m_sent);
+		}
+		else
+		{
+			updateStatistics("Statistics Sent", "Statistics Sent North", m_sent);
+		}
+		updateStatistics(m_name, m_name, m_sent);
+		m_sent = 0;
+	}
+}
+
+/**
+ * Add the readings sent to a statistic, creating it if needed
+ *
+ * @param key		The key of the statistic
+ * @param description	The description of the statistic
+ * @param sent		The number of readings sent
+ */
+void NorthService::updateStatistics(const string& key, const string& description, unsigned long sent)
+{
+	const Condition conditionStat(Equals);
+	Where wLastStat("key", conditionStat, key);
+	ExpressionValues updateValue;
+	updateValue.push_back(Expression("value", "+", (int)sent));
+	if (m_storage->updateTable("statistics", updateValue, wLastStat) == -1)
+	{
+		InsertValues values;
+		values.push_back(InsertValue("key", key));
+		values.push_back(InsertValue("description", description));
+		values.push_back(InsertValue("value", (int)sent));
+		if (m_storage->insertTable("statistics", values) != 1)
+		{
+			logger->error("Failed to add the statistic %s", key.c_str());
+		}
+	}
+}
+
+/**
+ * Shutdown request
+ */
+void NorthService::shutdown()
+{
+	/* Stop the load and send threads, the position of the
+	 * last reading sent is saved once they have stopped.
+	 */
+	lock_guard<mutex> guard(m_mutex);
+	m_shutdown = true;
+	m_cv.notify_all();
+	logger->info("North service shutdown in progress.");
+}
+
+/**
+ * Configuration change notification
+ */
+void NorthService::configChange(const string& categoryName, const string& category)
+{
+	logger->info("Configuration change in category %s: %s", categoryName.c_str(),
+			category.c_str());
+	if (categoryName.compare(m_name) == 0)
+	{
+		ConfigCategory config(m_name, category);
+		string pipeline = config.itemExists("filter") ? config.getValue("filter") : "";
+		if (pipeline.compare(m_pipeline))
+		{
+			// Blocks the load thread while the pipeline is rebuilt
+			lock_guard<mutex> guard(m_filterMutex);
+			logger->info("Filter pipeline has changed, recreating filter pipeline");
+			reloadFilters();
+			m_pipeline = pipeline;
+		}
+		if (pluginConfigChanged(m_config, config))
+		{
+			// The plugin is reconfigured or restarted by the send thread
+			lock_guard<mutex> guard(m_mutex);
+			m_reconfigure = category;
+			m_cv.notify_all();
+		}
+		m_config = config;
+	}
+	else if (categoryName.compare(m_name+"Advanced") == 0)
+	{
+		m_configAdvanced = ConfigCategory(m_name+"Advanced", category);
+		setAdvanced();
+	}
+	else
+	{
+		// Change to the configuration of a filter
+		lock_guard<mutex> guard(m_filterMutex);
+		if (m_filtersFailed)
+		{
+			// The change may correct the filter that failed to load
+			reloadFilters();
+		}
+		else if (m_filterPipeline)
+		{
+			m_filterPipeline->configChange(categoryName, category);
+		}
+	}
+}
+
+/**
+ * Apply the advanced configuration of the service
+ */
+void NorthService::setAdvanced()
+{
+	unsigned long blockSize = m_blockSize;
+	unsigned long queueSize = m_queueSize;
+	unsigned int checkpointInterval = m_checkpointInterval;
+	if (m_configAdvanced.itemExists("blockSize"))
+	{
+		blockSize = strtoul(m_configAdvanced.getValue("blockSize").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("memoryBufferSize"))
+	{
+		queueSize = strtoul(m_configAdvanced.getValue("memoryBufferSize").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("checkpointInterval"))
+	{
+		checkpointInterval = (unsigned int)strtoul(m_configAdvanced.getValue("checkpointInterval").c_str(), NULL, 10);
+	}
+	{
+		// The load and send threads wait on the sizes with the mutex held
+		lock_guard<mutex> guard(m_mutex);
+		m_blockSize = blockSize ? blockSize : 1;
+		m_queueSize = queueSize ? queueSize : 1;
+		m_checkpointInterval = checkpointInterval;
+		m_cv.notify_all();
+	}
+	if (m_configAdvanced.itemExists("logLevel"))
+	{
+		logger->setMinLevel(m_configAdvanced.getValue("logLevel"));
+	}
+	if (m_storage && m_configAdvanced.itemExists("storageConnections"))
+	{
+		m_storage->setPoolSize((unsigned int)strtoul(m_configAdvanced.getValue("storageConnections").c_str(), NULL, 10));
+	}
+	if (m_storage && m_configAdvanced.itemExists("storageIdleTimeout"))
+	{
+		m_storage->setIdleTimeout((unsigned int)strtoul(m_configAdvanced.getValue("storageIdleTimeout").c_str(), NULL, 10));
+	}
+}
+
+/**
+ * Add the generic north service configuration options to the advanced
+ * category
+ *
+ * @param defaultConfiguration	The default configuration from the plugin
+ */
+void NorthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
+{
+	for (int i = 0; defaults[i].name; i++)
+	{
+		defaultConfig.addItem(defaults[i].name, defaults[i].description,
+			defaults[i].type, defaults[i].value, defaults[i].value);
+		defaultConfig.setItemDisplayName(defaults[i].name, defaults[i].displayName);
+	}
+
+	/* Add the set of logging levels to the service */
+	vector<string>	logLevels = { "error", "warning", "info", "debug" };
+	defaultConfig.addItem("logLevel", "Minimum logging level reported",
+			"warning", "warning", logLevels);
+	defaultConfig.setItemDisplayName("logLevel", "Minimum Log Level");
+}
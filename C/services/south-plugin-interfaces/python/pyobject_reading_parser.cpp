@@ -102,7 +102,7 @@ DatapointValue* Py2C_createDictDPV(PyObject *data)
 		}
 		if (dpv)
 		{
-			dpVec->emplace_back(new Datapoint(std::string(PyUnicode_AsUTF8(dKey)), *dpv));
+			dpVec->emplace_back(new Datapoint(std::string(PyUnicode_AsUTF8(dKey)), std::move(*dpv)));
 			delete dpv;
 		}
 	}
@@ -165,7 +165,7 @@ DatapointValue* Py2C_createListDPV(PyObject *data)
 		}
 		if (dpv)
 		{
-			dpVec->emplace_back(new Datapoint(std::string("unnamed_list_elem#") + std::to_string(i), *dpv));
+			dpVec->emplace_back(new Datapoint(std::string("unnamed_list_elem#") + std::to_string(i), std::move(*dpv)));
 			delete dpv;
 		}
 	}
@@ -269,12 +269,12 @@ Reading* Py2C_parseReadingElement(PyObject *reading, std::string assetName)
 		{
 			newReading = new Reading(assetName,
 							new Datapoint(std::string(PyUnicode_AsUTF8(dKey)),
-								*dataPoint));
+								std::move(*dataPoint)));
 		}
 		else
 		{
 			newReading->addDatapoint(new Datapoint(std::string(PyUnicode_AsUTF8(dKey)),
-										*dataPoint));
+										std::move(*dataPoint)));
 		}
 
 		// Remove temp objects
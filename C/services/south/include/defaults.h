@@ -21,8 +21,14 @@ static struct {
 			"Maximum time to spend filling buffer before sending", "integer", "5000" },
 	{ "bufferThreshold",	"Maximum buffered Readings",
 			"Number of readings to buffer before sending", "integer", "100" },
+	{ "spillBufferSize",	"Spill Buffer Size (MB)",
+			"Disk space used to hold readings while the storage service is unavailable, 0 to disable", "integer", "64" },
 	{ "readingsPerSec",	"Reading Rate",
 			"Number of readings to generate per interval",	"integer", "1" },
+	{ "storageConnections",	"Storage Connections",
+			"Maximum number of connections held open to the storage service", "integer", "4" },
+	{ "storageIdleTimeout",	"Storage Idle Timeout (s)",
+			"Seconds after which an idle connection to the storage service is closed", "integer", "60" },
 	{ NULL, NULL, NULL, NULL, NULL }
 };
 #endif
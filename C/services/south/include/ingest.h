@@ -11,6 +11,7 @@
  */
 #include <storage_client.h>
 #include <reading.h>
+#include <reading_arena.h>
 #include <logger.h>
 #include <vector>
 #include <thread>
@@ -18,19 +19,52 @@
 #include <mutex>
 #include <sstream>
 #include <unordered_set>
+#include <unordered_map>
 #include <condition_variable>
 #include <filter_plugin.h>
 #include <filter_pipeline.h>
 #include <asset_tracking.h>
 #include <service_handler.h>
+#include <mpsc_queue.h>
+#include <spill_buffer.h>
+#include <reading_ring.h>
+#include <deque>
 
 #define SERVICE_NAME  "FogLAMP South"
+#define INGEST_QUEUE_CAPACITY	65536	// Maximum readings held in the ingest queue
+#define INGEST_RING_RETRY	30	// Seconds between requests for a shared memory ring
+#define INGEST_RING_WAIT	10	// Milliseconds between checks for space in a full ring
+
+/**
+ * A batch of readings written to the shared memory ring that the
+ * storage service has not yet acknowledged, the batch is kept so
+ * that it can be spilled if the storage service fails to append it
+ */
+typedef struct {
+	uint64_t				seq;
+	unsigned int				count;
+	std::unordered_map<InternedName, int>	stats;	// Readings by asset name
+	std::string				batch;	// The encoded readings
+} RingBatch;
 
 /**
  * The ingest class is used to ingest asset readings.
  * It maintains a queue of readings to be sent to storage,
  * these are sent using a background thread that regularly
  * wakes up and sends the queued readings.
+ *
+ * The queue is a bounded lock-free ring, plugin threads add
+ * readings without taking a lock and only the background
+ * thread removes them.
+ *
+ * If the storage service is on the same host the readings are
+ * written to a shared memory ring it reads rather than sent in
+ * append requests. When the ring is full the readings wait for space,
+ * for at most the maximum send latency, and are then spilled. Batches
+ * the storage service fails to append, or stops reading before it
+ * acknowledges them, are spilled too. The spill buffer is not replayed
+ * until every batch in the ring has been acknowledged, so readings
+ * reach the storage service in the order they were ingested.
  */
 class Ingest : public ServiceHandler {
 
@@ -44,6 +78,7 @@ public:
 	~Ingest();
 
 	void		ingest(const Reading& reading);
+	void		ingest(Reading&& reading);
 	void		ingest(const std::vector<Reading *> *vec);
 	bool		running();
 	void		processQueue();
@@ -59,19 +94,30 @@ public:
 
 	void		setTimeout(const unsigned long timeout) { m_timeout = timeout; };
 	void		setThreshold(const unsigned int threshold) { m_queueSizeThreshold = threshold; };
+	void		setSpillSize(const unsigned long megabytes) { m_spill->setMaxSize(megabytes * 1024 * 1024); };
+	SpillBuffer	*getSpillBuffer() const { return m_spill; };
 	void		configChange(const std::string&, const std::string&);
 	void		shutdown() {};	// Satisfy ServiceHandler
 
 private:
+	void		enqueue(Reading *reading);
+	bool		replaySpilled();
+	bool		ringAppend(const std::unordered_map<InternedName, int>& stats);
+	void		ringCompleted();
+	void		ringAbandon();
+	bool		ringSpill(const RingBatch& batch);
+
 	StorageClient&			m_storage;
 	unsigned long			m_timeout;
 	unsigned int			m_queueSizeThreshold;
 	bool				m_running;
 	std::string 			m_serviceName;
 	std::string 			m_pluginName;
+	InternedName			m_pluginId;	// m_pluginName interned for asset tracking
+	InternedName			m_ingestEvent;
 	ManagementClient		*m_mgtClient;
 	// New data: queued
-	std::vector<Reading *>*		m_queue;
+	MPSCQueue<Reading *>		m_queue;
 	std::mutex			m_qMutex;
 	std::mutex			m_statsMutex;
 	std::thread*			m_thread;
@@ -82,10 +128,16 @@ private:
 	// Data ready to be filtered/sent
 	std::vector<Reading *>*		m_data;
 	unsigned int			m_discardedReadings; // discarded readings since last update to statistics table
+	SpillBuffer*			m_spill;	// readings waiting for the storage service to return
+	ReadingArena			m_filterArena;	// allocates readings created by the filter pipeline
+	ReadingRing*			m_ring;		// shared memory ring to the storage service, if any
+	std::deque<RingBatch>		m_ringBatches;	// batches written to the ring awaiting acknowledgement
+	std::chrono::steady_clock::time_point
+					m_ringRetry;	// time to next ask for a ring
 	FilterPipeline*			filterPipeline;
 	
-	std::unordered_set<std::string>   		statsDbEntriesCache;  // confirmed stats table entries
-	std::map<std::string, int>		statsPendingEntries;  // pending stats table entries
+	std::unordered_set<InternedName>	statsDbEntriesCache;  // assets with confirmed stats table entries
+	std::unordered_map<InternedName, int>	statsPendingEntries;  // pending stats table entries by asset
 };
 
 #endif
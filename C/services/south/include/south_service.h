@@ -37,8 +37,8 @@ class SouthService : public ServiceHandler {
 	private:
 		void				addConfigDefaults(DefaultConfigCategory& defaults);
 		bool 				loadPlugin();
+		void				configureStorage();
 		int 				createTimerFd(struct timeval rate);
-		void 				createConfigCategories(DefaultConfigCategory configCategory, std::string parent_name,std::string current_name);
 	private:
 		SouthPlugin			*southPlugin;
 		const std::string&		m_name;
@@ -52,6 +52,7 @@ class SouthService : public ServiceHandler {
 		unsigned int			m_threshold;
 		unsigned long			m_timeout;
 		Ingest				*m_ingest;
+		StorageClient			*m_storage;
 		int				m_timerfd;
 };
 #endif
@@ -0,0 +1,125 @@
+#ifndef _SPILL_BUFFER_H
+#define _SPILL_BUFFER_H
+/*
+ * FogLAMP south service spill buffer.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <logger.h>
+#include <json_provider.h>
+#include <string>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+
+#define SPILL_SEGMENT_SIZE	(4 * 1024 * 1024)	// Default size of a segment file
+#define SPILL_RECORD_MAGIC	0x464c5350		// "FLSP"
+#define SPILL_RECORD_PENDING	0
+#define SPILL_RECORD_REPLAYED	1
+#define SPILL_RECORD_QUARANTINED	2
+#define SPILL_QUARANTINE_FILE	"quarantine.json"	// Holds the payloads storage rejected
+
+/**
+ * The header written before every record in a spill segment.
+ * A record whose magic is not set marks the end of the data in
+ * the segment.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	state;		// SPILL_RECORD_PENDING, _REPLAYED or _QUARANTINED
+	uint32_t	length;		// Length of the payload that follows
+	uint32_t	count;		// Number of readings in the payload
+	uint32_t	crc;		// CRC32 of the payload
+	uint32_t	reserved;
+} SpillRecordHeader;
+
+/**
+ * A durable, append-only log of reading blocks that could not be
+ * sent to the storage service.
+ *
+ * The log is held in a directory as a sequence of memory mapped
+ * segment files. Records are appended to the newest segment and
+ * replayed from the oldest, a record is marked as replayed in place
+ * once the storage service has accepted it and a segment is removed
+ * once all of its records have been replayed. Any records not
+ * replayed when the service stops are found again on the next start.
+ *
+ * A record the storage service rejects outright is quarantined, its
+ * payload is copied to SPILL_QUARANTINE_FILE and replay moves on.
+ *
+ * Only the ingest thread spills and replays records, the statistics
+ * may be read from any thread.
+ */
+class SpillBuffer : public JSONProvider {
+	public:
+		SpillBuffer(const std::string& directory, size_t maxSize);
+		virtual ~SpillBuffer();
+		bool		spill(const std::string& payload, unsigned int count);
+		bool		peek(std::string& payload, unsigned int& count);
+		void		consume();
+		void		quarantine();
+		bool		empty() const { return m_pendingRecords == 0; };
+		void		setMaxSize(size_t maxSize) { m_maxSize = maxSize; };
+		size_t		getSpilledBytes() const { return m_spilledBytes; };
+		size_t		getPendingBytes() const { return m_pendingBytes; };
+		unsigned long	getPendingReadings() const { return m_pendingReadings; };
+		unsigned long	getReplayedReadings() const { return m_replayedReadings; };
+		unsigned long	getQuarantinedReadings() const { return m_quarantinedReadings; };
+		void		asJSON(std::string& json) const;
+
+	private:
+		class Segment {
+			public:
+				Segment(const std::string& path, uint64_t seq, size_t size, bool create);
+				~Segment();
+				bool		isValid() const { return m_base != NULL; };
+				SpillRecordHeader
+						*header(size_t offset) const
+						{
+							return (SpillRecordHeader *)(m_base + offset);
+						};
+				char		*payload(size_t offset) const
+						{
+							return m_base + offset + sizeof(SpillRecordHeader);
+						};
+				bool		fits(size_t length) const
+						{
+							return m_reserved &&
+								m_writeOffset + recordSize(length) <= m_size;
+						};
+				std::string	m_path;
+				uint64_t	m_seq;
+				size_t		m_size;
+				size_t		m_readOffset;
+				size_t		m_writeOffset;
+				bool		m_reserved;	// Disk space is allocated for the whole segment
+				char		*m_base;
+		};
+
+		void		load();
+		Segment		*newSegment(size_t length);
+		void		scan(Segment *segment);
+		void		release(Segment *segment);
+		unsigned int	advance(uint32_t state);
+		static size_t	recordSize(size_t length);
+		static uint32_t	crc32(const char *data, size_t length);
+
+		std::string			m_directory;
+		std::atomic<size_t>		m_maxSize;
+		std::deque<Segment *>		m_segments;
+		uint64_t			m_nextSeq;
+		std::atomic<size_t>		m_diskSize;
+		std::atomic<size_t>		m_spilledBytes;
+		std::atomic<size_t>		m_pendingBytes;
+		std::atomic<unsigned long>	m_pendingRecords;
+		std::atomic<unsigned long>	m_pendingReadings;
+		std::atomic<unsigned long>	m_replayedReadings;
+		std::atomic<unsigned long>	m_quarantinedReadings;
+		Logger				*m_logger;
+};
+
+#endif
@@ -12,6 +12,8 @@
 #include <config_handler.h>
 #include <thread>
 #include <logger.h>
+#include <utils.h>
+#include <binary_readings.h>
 
 using namespace std;
 
@@ -112,17 +114,18 @@ void Ingest::updateStats()
 	
 	for (auto it = statsPendingEntries.begin(); it != statsPendingEntries.end(); ++it)
 		{
+		const string& assetName = it->first.str();
 		if (statsDbEntriesCache.find(it->first) == statsDbEntriesCache.end())
 			{
-			createStatsDbEntry(it->first);
+			createStatsDbEntry(assetName);
 			statsDbEntriesCache.insert(it->first);
-			//Logger::getLogger()->info("%s:%d : Created stats entry for asset name %s and added to cache", __FUNCTION__, __LINE__, it->first.c_str());
+			//Logger::getLogger()->info("%s:%d : Created stats entry for asset name %s and added to cache", __FUNCTION__, __LINE__, assetName.c_str());
 			}
 		
 		if (it->second)
 			{
 			// Prepare foglamp.statistics update
-			key = it->first;
+			key = assetName;
 			for (auto & c: key) c = toupper(c);
 
 			// Prepare "WHERE key = name
@@ -152,27 +155,15 @@ void Ingest::updateStats()
 		statsUpdates.emplace_back(updateValue, wPluginStat);
  		}
 	
-	try
-		{
-		int rv = m_storage.updateTable("statistics", statsUpdates);
-		
-		if (rv<0)
-			Logger::getLogger()->info("%s:%d : Update stats failed, rv=%d", __FUNCTION__, __LINE__, rv);
-		else
-			{
-			m_discardedReadings=0;
-			for (auto it = statsUpdates.begin(); it != statsUpdates.end(); ++it)
-				{
-				delete it->first;
-				delete it->second;
-				}
-			statsPendingEntries.clear();
-			}
-		}
-	catch (...)
+	// The storage client sends the updates in the background and retries them on failure
+	m_storage.queueUpdates("statistics", statsUpdates);
+	m_discardedReadings=0;
+	for (auto it = statsUpdates.begin(); it != statsUpdates.end(); ++it)
 		{
-		Logger::getLogger()->info("%s:%d : Statistics table update failed, will retry on next iteration", __FUNCTION__, __LINE__);
+		delete it->first;
+		delete it->second;
 		}
+	statsPendingEntries.clear();
 }
 
 /**
@@ -198,13 +189,17 @@ Ingest::Ingest(StorageClient& storage,
 			m_queueSizeThreshold(threshold),
 			m_serviceName(serviceName),
 			m_pluginName(pluginName),
-			m_mgtClient(mgmtClient)
+			m_pluginId(pluginName),
+			m_ingestEvent("Ingest"),
+			m_mgtClient(mgmtClient),
+			m_queue(INGEST_QUEUE_CAPACITY),
+			m_ring(NULL)
 {
 	m_running = true;
-	m_queue = new vector<Reading *>();
+	m_logger = Logger::getLogger();
+	m_spill = new SpillBuffer(getDataDir() + "/buffer/" + m_serviceName, 0);
 	m_thread = new thread(ingestThread, this);
 	m_statsThread = new thread(statsThread, this);
-	m_logger = Logger::getLogger();
 	m_data = NULL;
 	m_discardedReadings = 0;
 	
@@ -230,12 +225,25 @@ Ingest::~Ingest()
 	m_cv.notify_one();
 	m_thread->join();
 	processQueue();
+	if (m_ring)
+	{
+		// Give the storage service time to append the batches in the ring
+		auto deadline = chrono::steady_clock::now() + chrono::milliseconds(READING_RING_TIMEOUT);
+		ringCompleted();
+		while (!m_ringBatches.empty() && m_ring->consumerAlive()
+				&& chrono::steady_clock::now() < deadline)
+		{
+			this_thread::sleep_for(chrono::milliseconds(10));
+			ringCompleted();
+		}
+		ringAbandon();
+	}
 	m_statsCv.notify_one();
 	m_statsThread->join();
 	updateStats();
-	delete m_queue;
 	delete m_thread;
 	delete m_statsThread;
+	delete m_spill;
 	//delete m_data;
 	
 	// Cleanup filters
@@ -262,9 +270,19 @@ bool Ingest::running()
  */
 void Ingest::ingest(const Reading& reading)
 {
-	lock_guard<mutex> guard(m_qMutex);
-	m_queue->push_back(new Reading(reading));
-	if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
+	enqueue(new Reading(reading));
+	if (m_queue.size() >= m_queueSizeThreshold || m_running == false)
+		m_cv.notify_all();
+}
+
+/**
+ * Add a reading to the reading queue, the datapoints are moved
+ * into the queued reading rather than copied
+ */
+void Ingest::ingest(Reading&& reading)
+{
+	enqueue(new Reading(std::move(reading)));
+	if (m_queue.size() >= m_queueSizeThreshold || m_running == false)
 		m_cv.notify_all();
 }
 
@@ -273,17 +291,33 @@ void Ingest::ingest(const Reading& reading)
  */
 void Ingest::ingest(const vector<Reading *> *vec)
 {
-	lock_guard<mutex> guard(m_qMutex);
-	
 	// Get the readings in the set
 	for (auto & rdng : *vec)
 	{
-		m_queue->push_back(rdng);
+		enqueue(rdng);
 	}
-	if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
+	if (m_queue.size() >= m_queueSizeThreshold || m_running == false)
 		m_cv.notify_all();
 }
 
+/**
+ * Add a single reading to the lock-free queue.
+ *
+ * If the queue is full the ingest thread is woken and the caller
+ * waits for space, this applies back pressure to the plugin rather
+ * than allowing the queue to grow without bound.
+ *
+ * @param reading	The reading to queue, ownership passes to the queue
+ */
+void Ingest::enqueue(Reading *reading)
+{
+	while (!m_queue.push(reading))
+	{
+		m_cv.notify_all();
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
 
 void Ingest::waitForQueue()
 {
@@ -297,23 +331,27 @@ void Ingest::waitForQueue()
  * Process the queue of readings.
  *
  * Send them to the storage layer as a block. If the append call
- * fails requeue the readings for the next transmission.
+ * fails the readings are counted as discarded.
  *
- * In order not to lock the queue for an excessie time a new queue
- * is created and the old one moved to a local variable. This minimise
- * the time we hold the queue mutex to the time it takes to swap two
- * variables.
+ * Producers add to the lock-free queue without taking a lock, the
+ * readings queued at the time of the call are moved into m_data.
+ * Only this thread removes readings from the queue.
  */
 void Ingest::processQueue()
 {
-bool requeue = false;
-vector<Reading *>* newQ = new vector<Reading *>();
+	ringCompleted();
 
 	// Block of code to execute holding the mutex
 	{
 		lock_guard<mutex> guard(m_qMutex);
-		m_data = m_queue;
-		m_queue = newQ;
+		size_t queued = m_queue.size();
+		m_data = new vector<Reading *>();
+		m_data->reserve(queued);
+		Reading *reading;
+		while (queued-- > 0 && m_queue.pop(reading))
+		{
+			m_data->push_back(reading);
+		}
 	}
 	
 	/*
@@ -332,7 +370,8 @@ vector<Reading *>* newQ = new vector<Reading *>();
 		{
 			ReadingSet *readingSet = new ReadingSet(m_data);
 			m_data->clear();
-			// Pass readingSet to filter chain
+			// Pass readingSet to filter chain, readings the filters create come from the arena
+			ReadingArena::Scope scope(&m_filterArena);
 			firstFilter->ingest(readingSet);
 
 			/*
@@ -348,17 +387,21 @@ vector<Reading *>* newQ = new vector<Reading *>();
 		}
 	}
 
-	std::map<std::string, int>		statsEntriesCurrQueue;
-	// check if this requires addition of a new asset tracker tuple
+	// Count the readings of each asset using the interned asset name
+	std::unordered_map<InternedName, int>	statsEntriesCurrQueue;
 	for (vector<Reading *>::iterator it = m_data->begin(); it != m_data->end(); ++it)
 	{
-		Reading *reading = *it;
-		AssetTrackingTuple tuple(m_serviceName, m_pluginName, reading->getAssetName(), "Ingest");
-		if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
+		++statsEntriesCurrQueue[(*it)->getInternedAssetName()];
+	}
+	// check if this requires addition of a new asset tracker tuple
+	AssetTracker *tracker = AssetTracker::getAssetTracker();
+	for (auto &it : statsEntriesCurrQueue)
+	{
+		if (!tracker->checkAssetTrackingCache(m_pluginId, it.first, m_ingestEvent))
 		{
-			AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
+			AssetTrackingTuple tuple(m_serviceName, m_pluginName, it.first.str(), "Ingest");
+			tracker->addAssetTrackingTuple(tuple);
 		}
-		++statsEntriesCurrQueue[reading->getAssetName()];
 	}
 		
 	/**
@@ -372,41 +415,44 @@ vector<Reading *>* newQ = new vector<Reading *>();
 	 *	2- some readings removed
 	 *	3- New set of readings
 	 */
-	int rv = 0;
-	if ((!m_data->empty()) &&
-			(rv = m_storage.readingAppend(*m_data)) == false && requeue == true)
+	// Spilled readings are newer than those in the ring, they wait for the ring to empty
+	bool stored = m_ringBatches.empty() ? replaySpilled() : m_spill->empty();
+	if (!m_data->empty() && stored && ringAppend(statsEntriesCurrQueue))
 	{
-		m_logger->error("Failed to write readings to storage layer, buffering");
-		lock_guard<mutex> guard(m_qMutex);
-
-		// BUffer current data in m_data
-		m_queue->insert(m_queue->begin(),
-				m_data->begin(),
-				m_data->end());
-		// Is it possible that some of the readings are stored in DB, and others are not?
+		// The readings are counted once the storage service acknowledges them
+		statsEntriesCurrQueue.clear();
 	}
-	else
-	{	
-		if (!m_data->empty() && rv==false) // m_data had some (possibly filtered) readings, but they couldn't be sent successfully to storage service
-			{
-			m_logger->info("%s:%d, Couldn't send %d readings to storage service", __FUNCTION__, __LINE__, m_data->size());
-			m_discardedReadings += m_data->size();
-			}
-		else
-			{
-			unique_lock<mutex> lck(m_statsMutex);
-			for (auto &it : statsEntriesCurrQueue)
-				statsPendingEntries[it.first] += it.second;
-			}
-		
-		// Remove the Readings in the vector
-		for (vector<Reading *>::iterator it = m_data->begin();
-						 it != m_data->end(); ++it)
+	else if (!m_data->empty())
+	{
+		// Readings still waiting in the spill buffer must reach storage first
+		stored = stored && m_storage.readingAppend(*m_data);
+		if (!stored && m_spill->spill(StorageClient::readingsPayload(*m_data), m_data->size()))
 		{
-			Reading *reading = *it;
-			delete reading;
+			m_logger->warn("Storage service unavailable, %d readings written to the spill buffer, "
+					"%lu bytes waiting to be sent", m_data->size(), m_spill->getPendingBytes());
+			stored = true;
 		}
 	}
+	if (!m_data->empty() && !stored) // m_data had some (possibly filtered) readings, but they couldn't be sent successfully to storage service
+	{
+		m_logger->info("%s:%d, Couldn't send %d readings to storage service", __FUNCTION__, __LINE__, m_data->size());
+		m_discardedReadings += m_data->size();
+	}
+	else
+	{
+		// Readings held in the spill buffer are counted as they are safely on disk
+		unique_lock<mutex> lck(m_statsMutex);
+		for (auto &it : statsEntriesCurrQueue)
+			statsPendingEntries[it.first] += it.second;
+	}
+		
+	// Remove the Readings in the vector
+	for (vector<Reading *>::iterator it = m_data->begin();
+					 it != m_data->end(); ++it)
+	{
+		Reading *reading = *it;
+		delete reading;
+	}
 
 	delete m_data;
 	m_data = NULL;
@@ -416,6 +462,238 @@ vector<Reading *>* newQ = new vector<Reading *>();
 	m_statsCv.notify_all();
 }
 
+/**
+ * Send the readings held in the spill buffer to the storage service,
+ * oldest first. Replay stops at the first failure or once the maximum
+ * send latency has been used so that new readings are not held up for
+ * too long, any readings left are sent on the next call.
+ *
+ * A block the storage service rejects with a client error will never
+ * be accepted, it is quarantined and counted as discarded so that the
+ * blocks behind it are not held up.
+ *
+ * @return	True if the spill buffer is now empty
+ */
+bool Ingest::replaySpilled()
+{
+	if (m_spill->empty())
+	{
+		return true;
+	}
+
+	string payload;
+	unsigned int count;
+	unsigned long replayed = 0;
+	auto start = chrono::steady_clock::now();
+	while (m_spill->peek(payload, count))
+	{
+		int status;
+		if (!m_storage.readingAppend(payload, status))
+		{
+			// Timeouts and throttling are worth retrying, other client errors are not
+			if (status < 400 || status >= 500 || status == 408 || status == 429)
+			{
+				break;
+			}
+			m_spill->quarantine();
+			lock_guard<mutex> guard(m_statsMutex);
+			m_discardedReadings += count;
+			continue;
+		}
+		m_spill->consume();
+		replayed += count;
+		if (chrono::steady_clock::now() - start > chrono::milliseconds(m_timeout))
+		{
+			break;
+		}
+	}
+	if (replayed)
+	{
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+		m_logger->info("Replayed %lu readings from the spill buffer at %.0f readings/sec, "
+				"%lu readings (%lu bytes) remain, %lu readings replayed in total",
+				replayed, replayed / elapsed.count(),
+				m_spill->getPendingReadings(), m_spill->getPendingBytes(),
+				m_spill->getReplayedReadings());
+	}
+	return m_spill->empty();
+}
+
+/**
+ * Write the readings in m_data to the shared memory ring of the
+ * storage service, asking for a ring if there is none.
+ *
+ * If the ring is full the readings wait, for at most the maximum send
+ * latency, for the storage service to make space and are then spilled.
+ * Sending them in an append request would store them ahead of the
+ * readings still in the ring.
+ *
+ * @param stats	The readings of each asset, counted once the batch
+ *		is acknowledged or spilled
+ * @return	False if the readings must be sent in an append request
+ */
+bool Ingest::ringAppend(const unordered_map<InternedName, int>& stats)
+{
+	if (!m_ring)
+	{
+		if (chrono::steady_clock::now() < m_ringRetry)
+		{
+			return false;
+		}
+		m_ringRetry = chrono::steady_clock::now() + chrono::seconds(INGEST_RING_RETRY);
+		m_ring = m_storage.readingRing(m_serviceName);
+		if (!m_ring)
+		{
+			return false;
+		}
+		m_logger->info("Sending readings to the storage service through shared memory ring %s",
+				m_ring->getName().c_str());
+	}
+	if (!m_ring->consumerAlive())
+	{
+		m_logger->warn("The storage service has stopped reading shared memory ring %s, "
+				"reverting to append requests", m_ring->getName().c_str());
+		ringAbandon();
+		return false;
+	}
+	RingBatch batch{0, (unsigned int)m_data->size(), stats, string()};
+	if (!BinaryReadingsWriter::encode(*m_data, batch.batch))
+	{
+		return false;
+	}
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(m_timeout);
+	while (!m_ring->write(batch.batch, batch.count, batch.seq))
+	{
+		// The ring is full, the storage service is behind
+		if (chrono::steady_clock::now() >= deadline || !m_ring->consumerAlive())
+		{
+			if (ringSpill(batch))
+			{
+				m_logger->warn("Shared memory ring %s is full, %d readings written to the spill buffer",
+						m_ring->getName().c_str(), batch.count);
+				return true;
+			}
+			m_logger->warn("Shared memory ring %s is full and the spill buffer can not hold %d readings, "
+					"they may be stored ahead of readings in the ring",
+					m_ring->getName().c_str(), batch.count);
+			return false;
+		}
+		this_thread::sleep_for(chrono::milliseconds(INGEST_RING_WAIT));
+		ringCompleted();
+	}
+	m_ringBatches.push_back(std::move(batch));
+	return true;
+}
+
+/**
+ * Count the readings in the batches the storage service has
+ * acknowledged in the statistics. A batch the storage service
+ * failed to append is spilled so that it is sent again later.
+ */
+void Ingest::ringCompleted()
+{
+	int64_t result;
+	while (m_ring && !m_ringBatches.empty() && m_ring->completed(m_ringBatches.front().seq, result))
+	{
+		RingBatch& batch = m_ringBatches.front();
+		if (result == -1)
+		{
+			if (ringSpill(batch))
+			{
+				m_logger->warn("Storage service failed to append %d readings from the ring, "
+						"they have been written to the spill buffer", batch.count);
+			}
+			else
+			{
+				m_logger->info("%s:%d, Storage service failed to append %d readings from the ring",
+						__FUNCTION__, __LINE__, batch.count);
+				lock_guard<mutex> guard(m_statsMutex);
+				m_discardedReadings += batch.count;
+			}
+		}
+		else
+		{
+			lock_guard<mutex> guard(m_statsMutex);
+			for (auto &it : batch.stats)
+				statsPendingEntries[it.first] += it.second;
+		}
+		m_ringBatches.pop_front();
+	}
+}
+
+/**
+ * Write a batch that was sent through the ring to the spill buffer,
+ * counting its readings if it is held there
+ *
+ * @param batch	The batch to spill
+ * @return	False if the spill buffer can not hold the batch
+ */
+bool Ingest::ringSpill(const RingBatch& batch)
+{
+	BinaryReadingsReader reader(batch.batch.data(), batch.batch.length());
+	if (!m_spill->spill(reader.toJSON(), batch.count))
+	{
+		return false;
+	}
+	lock_guard<mutex> guard(m_statsMutex);
+	for (auto &it : batch.stats)
+		statsPendingEntries[it.first] += it.second;
+	return true;
+}
+
+/**
+ * Stop using the shared memory ring. Batches the storage service has
+ * not read are taken back and sent in append requests, or spilled.
+ * Batches it read but did not acknowledge are spilled, the storage
+ * service may have appended them so they could be stored twice, but
+ * they are not lost.
+ */
+void Ingest::ringAbandon()
+{
+	if (!m_ring)
+	{
+		return;
+	}
+	vector<pair<uint64_t, string>> unread;
+	m_ring->reclaim(unread);
+	ringCompleted();
+	m_ring->close();
+	for (auto& batch : m_ringBatches)
+	{
+		auto it = unread.begin();
+		while (it != unread.end() && it->first != batch.seq)
+		{
+			++it;
+		}
+		bool stored = false;
+		if (it == unread.end())
+		{
+			m_logger->warn("The outcome of %d readings sent through the shared memory ring is unknown, "
+					"they are written to the spill buffer", batch.count);
+		}
+		else if (m_spill->empty())
+		{
+			BinaryReadingsReader reader(batch.batch.data(), batch.batch.length());
+			stored = m_storage.readingAppend(reader.toJSON());
+			if (stored)
+			{
+				lock_guard<mutex> guard(m_statsMutex);
+				for (auto &it : batch.stats)
+					statsPendingEntries[it.first] += it.second;
+			}
+		}
+		if (!stored && !ringSpill(batch))
+		{
+			lock_guard<mutex> guard(m_statsMutex);
+			m_discardedReadings += batch.count;
+		}
+	}
+	m_ringBatches.clear();
+	delete m_ring;
+	m_ring = NULL;
+	m_ringRetry = chrono::steady_clock::now() + chrono::seconds(INGEST_RING_RETRY);
+}
+
 /**
  * Load filter plugins
  *
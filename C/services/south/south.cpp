@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <south_service.h>
 #include <management_api.h>
+#include <service_setup.h>
 #include <storage_client.h>
 #include <service_record.h>
 #include <plugin_manager.h>
@@ -179,7 +180,7 @@ int	size;
  */
 void doIngest(Ingest *ingest, Reading reading)
 {
-	ingest->ingest(reading);
+	ingest->ingest(std::move(reading));
 }
 
 void doIngestV2(Ingest *ingest, const vector<Reading *> *vec)
@@ -191,7 +192,8 @@ void doIngestV2(Ingest *ingest, const vector<Reading *> *vec)
 /**
  * Constructor for the south service
  */
-SouthService::SouthService(const string& myName) : m_name(myName), m_shutdown(false), m_readingsPerSec(1)
+SouthService::SouthService(const string& myName) : m_name(myName), m_shutdown(false), m_readingsPerSec(1),
+	m_storage(NULL)
 {
 	logger = new Logger(myName);
 	logger->setMinLevel("warning");
@@ -203,27 +205,20 @@ SouthService::SouthService(const string& myName) : m_name(myName), m_shutdown(fa
 void SouthService::start(string& coreAddress, unsigned short corePort)
 {
 	unsigned short managementPort = (unsigned short)0;
-	ManagementApi management(SERVICE_NAME, managementPort);	// Start managemenrt API
+	ManagementApi management(SERVICE_NAME, managementPort);	// Start management API
 	logger->info("Starting south service...");
-	management.registerService(this);
+	ServiceSetup::startManagement(management, this);
 
-	// Listen for incomming managment requests
-	management.start();
-
-	// Allow time for the listeners to start before we register
-	sleep(1);
 	if (! m_shutdown)
 	{
 		// Now register our service
-		// TODO proper hostname lookup
 		unsigned short managementListener = management.getListenerPort();
-		ServiceRecord record(m_name, "Southbound", "http", "localhost", 0, managementListener);
+		ServiceRecord record(m_name, "Southbound", "http",
+				ServiceSetup::serviceAddress(coreAddress, corePort), 0, managementListener);
 		m_mgtClient = new ManagementClient(coreAddress, corePort);
 
 		// Create an empty South category if one doesn't exist
-		DefaultConfigCategory southConfig(string("South"), string("{}"));
-		southConfig.setDescription("South");
-		m_mgtClient->addCategory(southConfig, true);
+		ServiceSetup::createParentCategory(m_mgtClient, "South");
 
 		m_config = m_mgtClient->getCategory(m_name);
 		if (!loadPlugin())
@@ -253,7 +248,12 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 
 		
 		StorageClient storage(storageRecord.getAddress(),
-						storageRecord.getPort());
+						storageRecord.getPort(),
+						storageRecord.getSocket());
+		m_storage = &storage;
+		configureStorage();
+		// The use of the storage connections is returned by the ping request
+		management.registerStats("storageClient", &storage);
 		unsigned int threshold = 100;
 		unsigned long timeout = 5000;
 		std::string pluginName;
@@ -276,6 +276,12 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 		// Instantiate the Ingest class
 		Ingest ingest(storage, timeout, threshold, m_name, pluginName, m_mgtClient);
 		m_ingest = &ingest;
+		if (m_configAdvanced.itemExists("spillBufferSize"))
+		{
+			ingest.setSpillSize(strtoul(m_configAdvanced.getValue("spillBufferSize").c_str(), NULL, 10));
+		}
+		// The spill buffer statistics are returned by the ping request
+		management.registerStats(ingest.getSpillBuffer());
 
 		try {
 			m_readingsPerSec = 1;
@@ -324,6 +330,8 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 			bool pollInterfaceV2 = (pluginInterfaceVer[0]=='2' && pluginInterfaceVer[1]=='.');
 			logger->info("pollInterfaceV2=%s", pollInterfaceV2?"true":"false");
 
+			// The readings created by the plugin are allocated from an arena
+			ReadingArena arena;
 			while (!m_shutdown)
 			{
 				uint64_t exp;
@@ -338,13 +346,14 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				for (uint64_t i=0; i<exp; i++)
 #endif
 				{
+					ReadingArena::Scope scope(&arena);
 					if (!pollInterfaceV2) // v1 poll method
 					{
 					
 						Reading reading = southPlugin->poll();
 						if (reading.getDatapointCount())
 						{
-							ingest.ingest(reading);
+							ingest.ingest(std::move(reading));
 						}
 						++pollCount;
 					}
@@ -400,7 +409,10 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 			}
 		}
+		management.registerStats(NULL);
 		}
+		management.registerStats("storageClient", NULL);
+		m_storage = NULL;
 
 		if (southPlugin)
 			southPlugin->shutdown();
@@ -420,48 +432,6 @@ void SouthService::stop()
 	logger->info("Stopping south service...\n");
 }
 
-/**
- * Creates config categories and sub categories recursively, along with their parent-child relations
- */
-void SouthService::createConfigCategories(DefaultConfigCategory configCategory, std::string parent_name, std::string current_name)
-{
-
-	// Deal with registering and fetching the configuration
-	DefaultConfigCategory defConfig(configCategory);
-	defConfig.setDescription(current_name);	// TODO We do not have access to the description
-
-	DefaultConfigCategory defConfigCategoryOnly(defConfig);
-	defConfigCategoryOnly.keepItemsType(ConfigCategory::ItemType::CategoryType);
-	defConfig.removeItemsType(ConfigCategory::ItemType::CategoryType);
-
-	// Create/Update category name (we pass keep_original_items=true)
-	m_mgtClient->addCategory(defConfig, true);
-
-	// Add this service under 'South' parent category
-	vector<string> children;
-	children.push_back(current_name);
-	m_mgtClient->addChildCategories(parent_name, children);
-
-	// Adds sub categories to the configuration
-	bool extracted = true;
-	ConfigCategory subCategory;
-	while (extracted) {
-
-		extracted = subCategory.extractSubcategory(defConfigCategoryOnly);
-
-		if (extracted) {
-			DefaultConfigCategory defSubCategory(subCategory);
-
-			createConfigCategories(defSubCategory, current_name, subCategory.getName());
-
-			// Cleans the category
-			subCategory.removeItems();
-			subCategory = ConfigCategory() ;
-		}
-	}
-
-}
-
 /**
  * Load the configured south plugin
  *
@@ -484,7 +454,7 @@ bool SouthService::loadPlugin()
 		{
 			// Adds categories and sub categories to the configuration
 			DefaultConfigCategory defConfig(m_name, manager->getInfo(handle)->config);
-			createConfigCategories(defConfig, string("South"), m_name);
+			ServiceSetup::createConfigCategories(m_mgtClient, defConfig, "South", m_name);
 
 			// Must now reload the configuration to obtain any items added from
 			// the plugin
@@ -493,21 +463,9 @@ bool SouthService::loadPlugin()
 			m_config = m_mgtClient->getCategory(m_name);
 
 			// Deal with registering and fetching the advanced configuration
-			string advancedCatName = m_name+string("Advanced");
-			DefaultConfigCategory defConfigAdvanced(advancedCatName, string("{}"));
+			DefaultConfigCategory defConfigAdvanced(m_name + string("Advanced"), string("{}"));
 			addConfigDefaults(defConfigAdvanced);
-			defConfigAdvanced.setDescription(m_name+string(" advanced config params"));
-
-			// Create/Update category name (we pass keep_original_items=true)
-			m_mgtClient->addCategory(defConfigAdvanced, true);
-
-			// Add this service under 'm_name' parent category
-			vector<string> children1;
-			children1.push_back(advancedCatName);
-			m_mgtClient->addChildCategories(m_name, children1);
-
-			// Must now reload the merged configuration
-			m_configAdvanced = m_mgtClient->getCategory(advancedCatName);
+			m_configAdvanced = ServiceSetup::createAdvancedCategory(m_mgtClient, m_name, defConfigAdvanced);
 
 			try {
 				southPlugin = new SouthPlugin(handle, m_config);
@@ -589,10 +547,35 @@ void SouthService::configChange(const string& categoryName, const string& catego
 		{
 			m_ingest->setTimeout((unsigned long)strtol(m_configAdvanced.getValue("maxSendLatency").c_str(), NULL, 10));
 		}
+		if (m_configAdvanced.itemExists("spillBufferSize"))
+		{
+			m_ingest->setSpillSize(strtoul(m_configAdvanced.getValue("spillBufferSize").c_str(), NULL, 10));
+		}
 		if (m_configAdvanced.itemExists("logLevel"))
 		{
 			logger->setMinLevel(m_configAdvanced.getValue("logLevel"));
 		}
+		configureStorage();
+	}
+}
+
+/**
+ * Apply the advanced configuration of the connections to the
+ * storage service
+ */
+void SouthService::configureStorage()
+{
+	if (!m_storage)
+	{
+		return;
+	}
+	if (m_configAdvanced.itemExists("storageConnections"))
+	{
+		m_storage->setPoolSize((unsigned int)strtoul(m_configAdvanced.getValue("storageConnections").c_str(), NULL, 10));
+	}
+	if (m_configAdvanced.itemExists("storageIdleTimeout"))
+	{
+		m_storage->setIdleTimeout((unsigned int)strtoul(m_configAdvanced.getValue("storageIdleTimeout").c_str(), NULL, 10));
 	}
 }
 
@@ -0,0 +1,474 @@
+/*
+ * FogLAMP south service spill buffer.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <spill_buffer.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+/**
+ * Construct a spill buffer in the given directory. Any segments
+ * left by a previous run of the service are loaded so that their
+ * records may be replayed.
+ *
+ * @param directory	The directory that holds the segment files
+ * @param maxSize	The maximum disk space to use in bytes, 0 disables spilling
+ */
+SpillBuffer::SpillBuffer(const string& directory, size_t maxSize) :
+	m_directory(directory), m_maxSize(maxSize), m_nextSeq(1),
+	m_diskSize(0), m_spilledBytes(0), m_pendingBytes(0),
+	m_pendingRecords(0), m_pendingReadings(0), m_replayedReadings(0),
+	m_quarantinedReadings(0)
+{
+	m_logger = Logger::getLogger();
+	load();
+}
+
+/**
+ * Destructor for the spill buffer. Unmaps the segments, the files
+ * are left on disk to be replayed when the service next starts.
+ */
+SpillBuffer::~SpillBuffer()
+{
+	for (auto& segment : m_segments)
+	{
+		delete segment;
+	}
+}
+
+/**
+ * Append a block of readings to the spill buffer
+ *
+ * @param payload	The readings payload as sent to the storage service
+ * @param count		The number of readings in the payload
+ * @return bool		True if the readings were spilled to disk
+ */
+bool SpillBuffer::spill(const string& payload, unsigned int count)
+{
+	Segment *segment = m_segments.empty() ? NULL : m_segments.back();
+	if (!segment || !segment->fits(payload.length()))
+	{
+		if ((segment = newSegment(payload.length())) == NULL)
+		{
+			return false;
+		}
+	}
+
+	SpillRecordHeader *hdr = segment->header(segment->m_writeOffset);
+	memcpy(segment->payload(segment->m_writeOffset), payload.data(), payload.length());
+	hdr->state = SPILL_RECORD_PENDING;
+	hdr->length = payload.length();
+	hdr->count = count;
+	hdr->crc = crc32(payload.data(), payload.length());
+	hdr->reserved = 0;
+	// Setting the magic last makes the record visible
+	__sync_synchronize();
+	hdr->magic = SPILL_RECORD_MAGIC;
+	msync(segment->m_base, segment->m_size, MS_ASYNC);
+
+	segment->m_writeOffset += recordSize(payload.length());
+	m_spilledBytes += payload.length();
+	m_pendingBytes += payload.length();
+	m_pendingRecords++;
+	m_pendingReadings += count;
+	return true;
+}
+
+/**
+ * Return the oldest record that has not yet been replayed
+ *
+ * @param payload	Set to the readings payload of the record
+ * @param count		Set to the number of readings in the record
+ * @return bool		False if there are no records to replay
+ */
+bool SpillBuffer::peek(string& payload, unsigned int& count)
+{
+	while (!m_segments.empty())
+	{
+		Segment *segment = m_segments.front();
+		if (segment->m_readOffset < segment->m_writeOffset)
+		{
+			SpillRecordHeader *hdr = segment->header(segment->m_readOffset);
+			payload.assign(segment->payload(segment->m_readOffset), hdr->length);
+			count = hdr->count;
+			return true;
+		}
+		if (segment == m_segments.back())
+		{
+			// The segment being written to is kept
+			return false;
+		}
+		m_segments.pop_front();
+		release(segment);
+	}
+	return false;
+}
+
+/**
+ * Mark the record returned by the last call to peek as replayed
+ */
+void SpillBuffer::consume()
+{
+	m_replayedReadings += advance(SPILL_RECORD_REPLAYED);
+}
+
+/**
+ * Set aside the record returned by the last call to peek, the storage
+ * service will never accept it and it must not hold up the records
+ * behind it. The payload is appended to the quarantine file in the
+ * spill directory so that it may be examined later.
+ */
+void SpillBuffer::quarantine()
+{
+	if (m_segments.empty())
+	{
+		return;
+	}
+	Segment *segment = m_segments.front();
+	if (segment->m_readOffset >= segment->m_writeOffset)
+	{
+		return;
+	}
+	SpillRecordHeader *hdr = segment->header(segment->m_readOffset);
+	string path = m_directory + "/" SPILL_QUARANTINE_FILE;
+	FILE *fp = fopen(path.c_str(), "a");
+	if (fp)
+	{
+		fwrite(segment->payload(segment->m_readOffset), 1, hdr->length, fp);
+		fputc('\n', fp);
+		fclose(fp);
+	}
+	else
+	{
+		m_logger->error("Unable to write quarantined readings to %s: %s",
+				path.c_str(), strerror(errno));
+	}
+	unsigned int count = advance(SPILL_RECORD_QUARANTINED);
+	m_quarantinedReadings += count;
+	m_logger->error("The storage service rejected %u readings from the spill buffer, "
+			"they have been quarantined in %s", count, path.c_str());
+}
+
+/**
+ * Mark the oldest pending record with its final state and move past it,
+ * removing its segment once every record in the segment has been dealt with.
+ *
+ * @param state		SPILL_RECORD_REPLAYED or SPILL_RECORD_QUARANTINED
+ * @return		The number of readings in the record
+ */
+unsigned int SpillBuffer::advance(uint32_t state)
+{
+	if (m_segments.empty())
+	{
+		return 0;
+	}
+	Segment *segment = m_segments.front();
+	if (segment->m_readOffset >= segment->m_writeOffset)
+	{
+		return 0;
+	}
+	SpillRecordHeader *hdr = segment->header(segment->m_readOffset);
+	unsigned int count = hdr->count;
+	hdr->state = state;
+	segment->m_readOffset += recordSize(hdr->length);
+	m_pendingBytes -= hdr->length;
+	m_pendingRecords--;
+	m_pendingReadings -= count;
+
+	if (segment->m_readOffset >= segment->m_writeOffset)
+	{
+		// Everything in the segment has been dealt with
+		m_segments.pop_front();
+		release(segment);
+	}
+	return count;
+}
+
+/**
+ * Serialise the spill buffer statistics as JSON
+ */
+void SpillBuffer::asJSON(string& json) const
+{
+	ostringstream convert;
+	convert << "{ \"spilledBytes\" : " << m_spilledBytes << ",";
+	convert << " \"pendingBytes\" : " << m_pendingBytes << ",";
+	convert << " \"pendingReadings\" : " << m_pendingReadings << ",";
+	convert << " \"replayedReadings\" : " << m_replayedReadings << ",";
+	convert << " \"quarantinedReadings\" : " << m_quarantinedReadings << ",";
+	convert << " \"diskSize\" : " << m_diskSize << ",";
+	convert << " \"maxSize\" : " << m_maxSize << " }";
+	json = convert.str();
+}
+
+/**
+ * Load any segment files that exist in the spill directory
+ */
+void SpillBuffer::load()
+{
+	DIR *dir = opendir(m_directory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+	vector<uint64_t> seqs;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned long long seq;
+		char suffix[8];
+		if (sscanf(entry->d_name, "%llu.%7s", &seq, suffix) == 2 &&
+				strcmp(suffix, "seg") == 0)
+		{
+			seqs.push_back(seq);
+		}
+	}
+	closedir(dir);
+	sort(seqs.begin(), seqs.end());
+
+	for (auto seq : seqs)
+	{
+		char name[40];
+		snprintf(name, sizeof(name), "/%016llu.seg", (unsigned long long)seq);
+		Segment *segment = new Segment(m_directory + name, seq, 0, false);
+		if (!segment->isValid())
+		{
+			delete segment;
+			continue;
+		}
+		m_diskSize += segment->m_size;
+		scan(segment);
+		m_segments.push_back(segment);
+		m_nextSeq = seq + 1;
+	}
+	if (m_pendingRecords)
+	{
+		m_logger->warn("Spill buffer contains %lu readings from a previous run, "
+				"these will be sent to the storage service", m_pendingReadings.load());
+	}
+}
+
+/**
+ * Scan a segment loaded from disk, skip over the records that have
+ * already been replayed and count those that have not. The scan stops
+ * at the end of the written data or at the first corrupt record.
+ *
+ * @param segment	The segment to scan
+ */
+void SpillBuffer::scan(Segment *segment)
+{
+	size_t offset = 0;
+	bool replayed = true;
+	while (offset + sizeof(SpillRecordHeader) <= segment->m_size)
+	{
+		SpillRecordHeader *hdr = segment->header(offset);
+		if (hdr->magic != SPILL_RECORD_MAGIC)
+		{
+			break;
+		}
+		if (offset + recordSize(hdr->length) > segment->m_size ||
+			crc32(segment->payload(offset), hdr->length) != hdr->crc)
+		{
+			m_logger->error("Spill buffer segment %s has a corrupt record at offset %lu, "
+					"the remainder of the segment will be ignored",
+					segment->m_path.c_str(), offset);
+			break;
+		}
+		if (hdr->state != SPILL_RECORD_PENDING && replayed)
+		{
+			segment->m_readOffset = offset + recordSize(hdr->length);
+		}
+		else
+		{
+			replayed = false;
+			m_pendingBytes += hdr->length;
+			m_pendingRecords++;
+			m_pendingReadings += hdr->count;
+		}
+		offset += recordSize(hdr->length);
+	}
+	segment->m_writeOffset = offset;
+}
+
+/**
+ * Create a new segment large enough to hold a record of the given length
+ *
+ * @param length	The length of the record payload
+ * @return Segment*	The new segment or NULL if the size limit would be exceeded
+ */
+SpillBuffer::Segment *SpillBuffer::newSegment(size_t length)
+{
+	size_t size = SPILL_SEGMENT_SIZE;
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	if (recordSize(length) > size)
+	{
+		size = ((recordSize(length) + pageSize - 1) / pageSize) * pageSize;
+	}
+	if (m_diskSize + size > m_maxSize)
+	{
+		return NULL;
+	}
+	// Create the directory and any missing parents
+	for (size_t pos = m_directory.find('/', 1); ; pos = m_directory.find('/', pos + 1))
+	{
+		string dir = m_directory.substr(0, pos);
+		if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST)
+		{
+			m_logger->error("Unable to create spill buffer directory %s: %s",
+					dir.c_str(), strerror(errno));
+			return NULL;
+		}
+		if (pos == string::npos)
+			break;
+	}
+
+	char name[40];
+	snprintf(name, sizeof(name), "/%016llu.seg", (unsigned long long)m_nextSeq);
+	Segment *segment = new Segment(m_directory + name, m_nextSeq, size, true);
+	if (!segment->isValid())
+	{
+		delete segment;
+		return NULL;
+	}
+	m_nextSeq++;
+	m_diskSize += size;
+	m_segments.push_back(segment);
+	return segment;
+}
+
+/**
+ * Remove a segment whose records have all been replayed
+ *
+ * @param segment	The segment to remove
+ */
+void SpillBuffer::release(Segment *segment)
+{
+	m_diskSize -= segment->m_size;
+	unlink(segment->m_path.c_str());
+	delete segment;
+}
+
+/**
+ * Return the space used in a segment by a record with a payload of
+ * the given length. Records are aligned on 8 byte boundaries.
+ */
+size_t SpillBuffer::recordSize(size_t length)
+{
+	return (sizeof(SpillRecordHeader) + length + 7) & ~((size_t)7);
+}
+
+/**
+ * Calculate the CRC32 (IEEE 802.3) of a block of data
+ */
+uint32_t SpillBuffer::crc32(const char *data, size_t length)
+{
+	static uint32_t table[256];
+	static bool initialised = false;
+	if (!initialised)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		initialised = true;
+	}
+	uint32_t crc = 0xffffffff;
+	for (size_t i = 0; i < length; i++)
+	{
+		crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffff;
+}
+
+/**
+ * Open or create a segment file and map it into memory
+ *
+ * @param path		The path of the segment file
+ * @param seq		The sequence number of the segment
+ * @param size		The size of the segment to create
+ * @param create	Create a new segment rather than open an existing one
+ */
+SpillBuffer::Segment::Segment(const string& path, uint64_t seq, size_t size, bool create) :
+	m_path(path), m_seq(seq), m_size(size), m_readOffset(0), m_writeOffset(0),
+	m_reserved(false), m_base(NULL)
+{
+	int fd = open(path.c_str(), create ? O_RDWR|O_CREAT|O_TRUNC : O_RDWR, 0644);
+	if (fd == -1)
+	{
+		Logger::getLogger()->error("Unable to open spill buffer segment %s: %s",
+				path.c_str(), strerror(errno));
+		return;
+	}
+	if (!create)
+	{
+		struct stat st;
+		if (fstat(fd, &st) == -1 || st.st_size == 0)
+		{
+			close(fd);
+			return;
+		}
+		m_size = (size_t)st.st_size;
+	}
+	/*
+	 * Allocate the disk blocks for the whole segment now, writing to
+	 * a page of a sparse file through the mapping when the disk is
+	 * full would raise SIGBUS rather than return an error
+	 */
+	int rval = posix_fallocate(fd, 0, (off_t)m_size);
+	if (rval != 0)
+	{
+		Logger::getLogger()->error("Unable to allocate %lu bytes for spill buffer segment %s: %s",
+				m_size, path.c_str(), strerror(rval));
+		if (create)
+		{
+			close(fd);
+			unlink(path.c_str());
+			return;
+		}
+		// The records of an existing segment may still be replayed
+	}
+	else
+	{
+		m_reserved = true;
+	}
+	void *addr = mmap(NULL, m_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+	{
+		Logger::getLogger()->error("Unable to map spill buffer segment %s: %s",
+				path.c_str(), strerror(errno));
+		return;
+	}
+	m_base = (char *)addr;
+}
+
+/**
+ * Flush and unmap the segment
+ */
+SpillBuffer::Segment::~Segment()
+{
+	if (m_base)
+	{
+		msync(m_base, m_size, MS_SYNC);
+		munmap(m_base, m_size);
+	}
+}
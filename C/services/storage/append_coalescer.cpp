@@ -0,0 +1,254 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <append_coalescer.h>
+#include <rapidjson/reader.h>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Start the coalescer thread
+ *
+ * @param window	Milliseconds to wait for further appends
+ * @param rows		Readings after which appends are flushed without waiting
+ * @param maxAppends	Appends that may wait to be merged
+ * @param maxBytes	Bytes of readings that may wait to be merged
+ * @param flush		Called with each group of appends
+ */
+AppendCoalescer::AppendCoalescer(unsigned int window, unsigned int rows, unsigned int maxAppends,
+				 size_t maxBytes, const Flush& flush) :
+	m_window(window), m_maxRows(rows), m_maxAppends(maxAppends), m_maxBytes(maxBytes),
+	m_flush(flush), m_rows(0), m_bytes(0), m_running(true)
+{
+	m_thread = thread(&AppendCoalescer::run, this);
+}
+
+/**
+ * Flush the pending appends and stop the thread
+ */
+AppendCoalescer::~AppendCoalescer()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread.join();
+}
+
+/**
+ * Queue an append to be merged with others, the response is sent
+ * once the group it is merged into has been appended
+ *
+ * @param response	The response to the append request
+ * @param readings	The elements of the readings array, moved from
+ *			if the append is queued
+ * @param count		The number of readings
+ * @return bool		False if too many appends or bytes are waiting,
+ *			the append is not queued
+ */
+bool AppendCoalescer::append(shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+			     string& readings, unsigned int count)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (!m_pending.empty() &&
+		(m_pending.size() >= m_maxAppends || m_bytes + readings.length() > m_maxBytes))
+	{
+		return false;
+	}
+	if (m_pending.empty())
+	{
+		m_first = chrono::steady_clock::now();
+	}
+	m_bytes += readings.length();
+	m_pending.push_back(PendingAppend{response, move(readings), count});
+	m_rows += count;
+	if (m_pending.size() == 1 || m_rows >= m_maxRows)
+	{
+		m_cv.notify_all();
+	}
+	return true;
+}
+
+/**
+ * The coalescer thread, waits for the window of the first pending
+ * append to close and flushes the appends that arrived in it
+ */
+void AppendCoalescer::run()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_cv.wait(lck, [this] { return !m_pending.empty() || !m_running; });
+		if (m_pending.empty())
+		{
+			break;
+		}
+		m_cv.wait_until(lck, m_first + m_window, [this] { return m_rows >= m_maxRows || !m_running; });
+		vector<PendingAppend> appends;
+		appends.swap(m_pending);
+		m_rows = 0;
+		m_bytes = 0;
+		lck.unlock();
+		m_flush(appends);
+		lck.lock();
+	}
+}
+
+/**
+ * SAX handler that finds the readings array of an append payload and
+ * counts its elements
+ */
+class ReadingsArrayHandler : public BaseReaderHandler<UTF8<>, ReadingsArrayHandler> {
+	public:
+		ReadingsArrayHandler(StringStream& stream) : m_stream(stream), m_depth(0),
+			m_key(false), m_inArray(false), m_found(false), m_start(0), m_end(0), m_count(0) {};
+		bool	Key(const char *str, SizeType length, bool)
+		{
+			if (m_depth == 1)
+				m_key = length == 8 && strncmp(str, "readings", 8) == 0;
+			return true;
+		};
+		bool	StartObject()
+		{
+			element();
+			m_depth++;
+			return true;
+		};
+		bool	EndObject(SizeType)
+		{
+			m_depth--;
+			return true;
+		};
+		bool	StartArray()
+		{
+			if (m_depth == 1 && m_key && !m_found)
+			{
+				m_inArray = true;
+				m_start = m_stream.Tell();
+			}
+			else
+			{
+				element();
+			}
+			m_depth++;
+			return true;
+		};
+		bool	EndArray(SizeType)
+		{
+			m_depth--;
+			if (m_inArray && m_depth == 1)
+			{
+				m_inArray = false;
+				m_found = true;
+				m_end = m_stream.Tell() - 1;
+			}
+			return true;
+		};
+		bool	Default()
+		{
+			element();
+			return true;
+		};
+
+		StringStream&	m_stream;
+		unsigned int	m_depth;
+		bool		m_key;		// The last key of the payload object was "readings"
+		bool		m_inArray;
+		bool		m_found;
+		size_t		m_start;	// Offset after the [ of the readings array
+		size_t		m_end;		// Offset of the ] of the readings array
+		unsigned int	m_count;
+
+	private:
+		void	element()
+		{
+			if (m_inArray && m_depth == 2)
+				m_count++;
+		};
+};
+
+/**
+ * Return the elements of the readings array of an append payload
+ * without building a document
+ *
+ * @param payload	The JSON append payload
+ * @param readings	Set to the text between the brackets of the array
+ * @param count		Set to the number of readings
+ * @return		False if the payload is not valid JSON or has no
+ *			readings array
+ */
+bool AppendCoalescer::readingsArray(const string& payload, string& readings, unsigned int& count)
+{
+	StringStream stream(payload.c_str());
+	ReadingsArrayHandler handler(stream);
+	Reader reader;
+	if (reader.Parse(stream, handler).IsError() || !handler.m_found)
+	{
+		return false;
+	}
+	readings = payload.substr(handler.m_start, handler.m_end - handler.m_start);
+	count = handler.m_count;
+	return true;
+}
+
+/**
+ * Append a group of appends in one call and respond to each of them
+ *
+ * Each response reports the readings of its own request. The append
+ * function only returns the total it added, if it skipped readings the
+ * shortfall is reported against the last requests of the group. If the
+ * merged call fails the requests are appended one by one, so that a
+ * request with bad readings does not fail the others.
+ *
+ * @param appends	The appends to merge
+ * @param append	Appends a JSON payload, returns the readings
+ *			added or -1
+ * @param respond	Responds to a request with the readings added
+ *			or -1, called once for each request in order
+ */
+void AppendCoalescer::merge(vector<PendingAppend>& appends, const Append& append, const Respond& respond)
+{
+	int rval = -1;
+	if (appends.size() > 1)
+	{
+		string payload = "{ \"readings\" : [ ";
+		bool first = true;
+		for (auto& pending : appends)
+		{
+			if (pending.count == 0)
+				continue;
+			if (!first)
+				payload += ", ";
+			payload += pending.readings;
+			first = false;
+		}
+		payload += " ] }";
+		rval = append(payload);
+	}
+	if (rval != -1)
+	{
+		// Attribute the readings added to the requests in order
+		unsigned int remaining = (unsigned int)rval;
+		for (auto& pending : appends)
+		{
+			unsigned int added = pending.count < remaining ? pending.count : remaining;
+			remaining -= added;
+			respond(pending, (int)added);
+		}
+		return;
+	}
+	for (auto& pending : appends)
+	{
+		string payload = "{ \"readings\" : [ " + pending.readings + " ] }";
+		respond(pending, append(payload));
+	}
+}
@@ -12,6 +12,7 @@
 #include <rapidjson/istreamwrapper.h>
 #include <rapidjson/ostreamwrapper.h>
 #include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
 #include <fstream>
 #include <iostream>
 #include <unistd.h>
@@ -20,8 +21,16 @@ static const char *defaultConfiguration =
 " { \"plugin\" : { \"value\" : \"sqlite\", \"description\" : \"The main storage plugin to load\"},"
 " \"readingPlugin\" : { \"value\" : \"\", \"description\" : \"The storage plugin to load for readings data. If blank the main storage plugin is used.\"},"
 " \"threads\" : { \"value\" : \"1\", \"description\" : \"The number of threads to run\" },"
+" \"appendThreads\" : { \"value\" : \"2\", \"description\" : \"The number of threads that append readings\" },"
+" \"fetchThreads\" : { \"value\" : \"2\", \"description\" : \"The number of threads that fetch readings\" },"
+" \"purgeThreads\" : { \"value\" : \"1\", \"description\" : \"The number of threads that purge readings\" },"
+" \"workerQueueSize\" : { \"value\" : \"64\", \"description\" : \"The number of readings calls that may wait for a thread before calls are refused\" },"
 " \"managedStatus\" : { \"value\" : \"false\", \"description\" : \"Control if FogLAMP should manage the storage provider\" },"
 " \"port\" : { \"value\" : \"0\", \"description\" : \"The port to listen on\" },"
+" \"unixSocket\" : { \"value\" : \"true\", \"description\" : \"Also listen on a Unix domain socket for services on the same host\" },"
+" \"readingRing\" : { \"value\" : \"true\", \"description\" : \"Allow south services on the same host to pass readings through shared memory\" },"
+" \"appendCoalesceWindow\" : { \"value\" : \"0\", \"description\" : \"Milliseconds a readings append waits to be merged with others into one plugin call, 0 disables merging\" },"
+" \"appendCoalesceRows\" : { \"value\" : \"1000\", \"description\" : \"The number of readings at which merged appends are passed to the plugin without waiting\" },"
 " \"managementPort\" : { \"value\" : \"0\", \"description\" : \"The management port to listen on.\" } }";
 
 using namespace std;
@@ -91,6 +100,52 @@ void StorageConfiguration::updateCategory(const string& json)
 	writeCache();
 }
 
+/**
+ * Add the default configuration items of a plugin that are not
+ * already in the category, existing values are left unchanged.
+ *
+ * @param json	The plugin default configuration items
+ */
+void StorageConfiguration::addDefaults(const char *json)
+{
+Document defaults;
+
+	defaults.Parse(json);
+	if (defaults.HasParseError() || !defaults.IsObject() || !document.IsObject())
+	{
+		logger->error("Plugin default configuration failed to parse.");
+		return;
+	}
+	bool added = false;
+	for (auto& item : defaults.GetObject())
+	{
+		if (!document.HasMember(item.name))
+		{
+			Value name(item.name, document.GetAllocator());
+			Value value(item.value, document.GetAllocator());
+			document.AddMember(name, value, document.GetAllocator());
+			added = true;
+		}
+	}
+	if (added)
+	{
+		writeCache();
+	}
+}
+
+/**
+ * Return the cached configuration category as JSON
+ *
+ * @param json	Set to the category
+ */
+void StorageConfiguration::getCategory(string& json)
+{
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	document.Accept(writer);
+	json = buffer.GetString();
+}
+
 /**
  * Read the cache JSON for te configuration category from the cache file 
  * into memory.
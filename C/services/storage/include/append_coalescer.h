@@ -0,0 +1,84 @@
+#ifndef _APPEND_COALESCER_H
+#define _APPEND_COALESCER_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <server_http.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#define DEFAULT_COALESCE_WINDOW	0	// Milliseconds appends are held to be merged, 0 disables merging
+#define DEFAULT_COALESCE_ROWS	1000	// Readings that are appended without waiting for the window
+#define DEFAULT_COALESCE_BYTES	(16 * 1024 * 1024)	// Bytes of readings that may wait to be merged
+
+/**
+ * A readings append request waiting to be merged with others
+ */
+typedef struct {
+	std::shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response>
+				response;
+	std::string		readings;	// The elements of the readings array
+	unsigned int		count;
+} PendingAppend;
+
+/**
+ * Merges the readings append requests that arrive within a short
+ * window so that they are passed to the storage plugin in one call,
+ * and committed in one transaction.
+ *
+ * The first append starts the window, the appends that arrive before
+ * it closes, or until the number of readings reaches a limit, are
+ * passed together to the flush function on the coalescer thread. The
+ * flush function sends the response to each request.
+ *
+ * The requests waiting do not hold a worker thread, so the number of
+ * them and the bytes of readings they hold are limited separately.
+ * An append beyond either limit is refused and the caller tells its
+ * client to retry later.
+ */
+class AppendCoalescer {
+	public:
+		typedef std::function<void(std::vector<PendingAppend>&)> Flush;
+		typedef std::function<int(std::string&)> Append;
+		typedef std::function<void(PendingAppend&, int)> Respond;
+
+		AppendCoalescer(unsigned int window, unsigned int rows, unsigned int maxAppends,
+				size_t maxBytes, const Flush& flush);
+		~AppendCoalescer();
+		bool		append(std::shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+				       std::string& readings, unsigned int count);
+		static bool	readingsArray(const std::string& payload, std::string& readings,
+					      unsigned int& count);
+		static void	merge(std::vector<PendingAppend>& appends, const Append& append,
+				      const Respond& respond);
+
+	private:
+		void		run();
+
+		std::chrono::milliseconds		m_window;
+		unsigned int				m_maxRows;
+		unsigned int				m_maxAppends;
+		size_t					m_maxBytes;
+		Flush					m_flush;
+		std::vector<PendingAppend>		m_pending;
+		unsigned int				m_rows;		// Readings in m_pending
+		size_t					m_bytes;	// Bytes of readings in m_pending
+		std::chrono::steady_clock::time_point	m_first;	// Arrival of the first pending append
+		bool					m_running;
+		std::mutex				m_mutex;
+		std::condition_variable			m_cv;
+		std::thread				m_thread;
+};
+
+#endif
@@ -33,6 +33,8 @@ class StorageConfiguration {
     bool		  hasValue(const std::string& key);
     bool                  setValue(const std::string& key, const std::string& value);
     void                  updateCategory(const std::string& json);
+    void                  addDefaults(const char *json);
+    void                  getCategory(std::string& json);
   private:
     void		  getConfigCache(std::string& cache);
     rapidjson::Document   document;
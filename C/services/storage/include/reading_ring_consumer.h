@@ -0,0 +1,55 @@
+#ifndef _READING_RING_CONSUMER_H
+#define _READING_RING_CONSUMER_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring.h>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#define READING_RING_POLL	1000	// Milliseconds between heartbeats of an idle ring
+#define READING_RING_SUBMIT	10	// Milliseconds between attempts to queue a batch on a full pool
+
+class StorageApi;
+
+/**
+ * Reads the batches of readings a south service on this host writes
+ * to a shared memory ring and appends them as if they had been sent
+ * in an append request. Each batch is acknowledged with the number of
+ * readings stored so that the south service can count them.
+ *
+ * The batches are appended by the append worker pool, so they share
+ * its threads with append requests. The heartbeat is kept up whilst a
+ * batch waits for and runs on a worker, a slow append is not taken by
+ * the south service as a consumer that has stopped.
+ *
+ * The thread exits once the south service closes the ring and it is
+ * empty, or the south service reclaims the batches.
+ */
+class ReadingRingConsumer {
+	public:
+		ReadingRingConsumer(StorageApi *api, const std::string& service, ReadingRing *ring);
+		~ReadingRingConsumer();
+		const std::string&	getRingName() const { return m_ring->getName(); };
+		bool			running() const { return m_running; };
+
+	private:
+		void			consume();
+		int			append(std::string& batch);
+
+		StorageApi		*m_api;
+		const std::string	m_service;
+		ReadingRing		*m_ring;
+		std::atomic<bool>	m_running;
+		std::atomic<bool>	m_shutdown;
+		std::thread		m_thread;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _READING_WAITERS_H
+#define _READING_WAITERS_H
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <server_http.hpp>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#define MAX_READING_WAIT	30000	// Longest wait for readings a client may ask for, milliseconds
+#define MAX_READING_WAITERS	256	// Requests held waiting for readings at once
+
+/**
+ * The requests of clients waiting for readings to be appended after
+ * a given reading id, the long poll behind GET /storage/reading/wait.
+ *
+ * A request is held, without occupying a thread of the HTTP server,
+ * until the next readings append or until its timeout, then answered
+ * with whether new readings are available. Every append is counted,
+ * the caller reads the count before it checks for readings so that an
+ * append made between the check and the wait is not missed.
+ *
+ * The number of requests held is limited, a request that would be
+ * held past the limit is refused and the caller answers it with 503
+ * Service Unavailable.
+ */
+class ReadingWaiters {
+	public:
+		ReadingWaiters(unsigned int maxWaiters);
+		~ReadingWaiters();
+		unsigned long	appends();
+		bool		wait(std::shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+				     unsigned long after, unsigned long appends, unsigned long timeout);
+		void		notify();
+		static void	respond(std::shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+					unsigned long after, bool available);
+
+	private:
+		/**
+		 * A request waiting for readings
+		 */
+		typedef struct {
+			std::shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response>
+						response;
+			unsigned long		after;		// The last reading id the client has
+			unsigned long		appends;	// The appends counted when it checked
+			std::chrono::steady_clock::time_point
+						deadline;
+		} Waiter;
+
+		void		run();
+
+		std::vector<Waiter>		m_waiters;
+		const unsigned int		m_maxWaiters;
+		unsigned long			m_appends;
+		bool				m_running;
+		std::mutex			m_mutex;
+		std::condition_variable		m_cv;
+		std::thread			m_thread;
+};
+
+#endif
@@ -10,14 +10,23 @@
  * Author: Mark Riddoch
  */
 
-#include <server_http.hpp>
+#include <local_http_server.h>
 #include <storage_plugin.h>
 #include <storage_stats.h>
 #include <storage_registry.h>
+#include <worker_pool.h>
+#include <binary_readings.h>
+#include <append_coalescer.h>
+#include <reading_waiters.h>
+#include <functional>
+#include <map>
+#include <mutex>
 
 using namespace std;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 
+class ReadingRingConsumer;
+
 /*
  * The URL for each entry point
  */
@@ -26,6 +35,8 @@ using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 #define READING_ACCESS  	"^/storage/reading$"
 #define READING_QUERY   	"^/storage/reading/query"
 #define READING_PURGE   	"^/storage/reading/purge"
+#define READING_RING		"^/storage/reading/ring$"
+#define READING_WAIT		"^/storage/reading/wait$"
 #define READING_INTEREST	"^/storage/reading/interest/([A-Za-z\\*][a-zA-Z0-9_]*)$"
 #define GET_TABLE_SNAPSHOTS	"^/storage/table/([A-Za-z][a-zA-Z_0-9_]*)/snapshot$"
 #define CREATE_TABLE_SNAPSHOT	GET_TABLE_SNAPSHOTS
@@ -35,6 +46,13 @@ using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 #define PURGE_FLAG_RETAIN	"retain"
 #define PURGE_FLAG_PURGE	"purge"
 
+#define DEFAULT_APPEND_THREADS		2	// Worker threads for readings append
+#define DEFAULT_FETCH_THREADS		2	// Worker threads for readings fetch
+#define DEFAULT_PURGE_THREADS		1	// Worker threads for readings purge
+#define DEFAULT_WORKER_QUEUE_SIZE	64	// Calls that may wait for a worker thread
+#define WORKER_RETRY_AFTER		1	// Seconds a client is asked to wait when a pool is full
+#define DEFAULT_READING_WAIT		1000	// Milliseconds a reading wait lasts without a timeout
+
 #define TABLE_NAME_COMPONENT	1
 #define ASSET_NAME_COMPONENT	1
 #define SNAPSHOT_ID_COMPONENT	2
@@ -57,6 +75,10 @@ public:
 	void	wait();
 	void	stopServer();
 	unsigned short getListenerPort();
+	void	setSocketPath(const string& path);
+	const string&	getSocketPath();
+	void	enableReadingRings(bool enable);
+	void	setAppendCoalescing(unsigned int window, unsigned int rows);
 	void	commonInsert(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	commonSimpleQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	commonQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
@@ -69,18 +91,27 @@ public:
 	void	readingPurge(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingRegister(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingUnregister(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingRing(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingWait(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	int	appendReadingsBatch(string& batch);
 	void	createTableSnapshot(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	loadTableSnapshot(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	deleteTableSnapshot(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	getTableSnapshots(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	printList();
+	void	setWorkerThreads(unsigned int append, unsigned int fetch,
+				 unsigned int purge, unsigned int queueSize);
+	void	dispatch(WorkerPool *pool, shared_ptr<HttpServer::Response> response,
+			 const std::function<void()>& call);
 
 public:
-	std::atomic<int>        m_workers_count;
+	WorkerPool		*m_appendPool;
+	WorkerPool		*m_fetchPool;
+	WorkerPool		*m_purgePool;
 
 private:
         static StorageApi       *m_instance;
-        HttpServer              *m_server;
+        LocalHttpServer         *m_server;
 	unsigned short          m_port;
 	unsigned int		m_threads;
         thread                  *m_thread;
@@ -92,9 +123,26 @@ private:
 	std::list<std::string>	seqnum_map_lru_list; // has the most recently accessed elements of m_seqnum_map at front of the dequeue
 	std::mutex 		mtx_seqnum_map;
 	StorageRegistry		registry;
+	unsigned int		m_appendThreads;
+	unsigned int		m_fetchThreads;
+	unsigned int		m_purgeThreads;
+	unsigned int		m_workerQueueSize;
+	bool			m_readingRings;
+	std::map<string, ReadingRingConsumer *>
+				m_ringConsumers;	// By south service
+	std::mutex		m_ringMutex;
+	unsigned int		m_coalesceWindow;
+	unsigned int		m_coalesceRows;
+	AppendCoalescer		*m_coalescer;
+	ReadingWaiters		*m_waiters;
+	int			appendReadings(string& payload, const BinaryReadingsReader *reader);
+	void			appendCoalesced(std::vector<PendingAppend>& appends);
 	void			respond(shared_ptr<HttpServer::Response>, const string&);
+	void			respond(shared_ptr<HttpServer::Response>, const char *);
 	void			respond(shared_ptr<HttpServer::Response>, SimpleWeb::StatusCode, const string&);
+	void			respondAppended(shared_ptr<HttpServer::Response>, int);
 	void			internalError(shared_ptr<HttpServer::Response>, const exception&);
+	void			serviceUnavailable(shared_ptr<HttpServer::Response>, const string&);
 	void			mapError(string&, PLUGIN_ERROR *);
 };
 
@@ -39,7 +39,12 @@ public:
 	int		commonUpdate(const std::string& table, const std::string& payload);
 	int		commonDelete(const std::string& table, const std::string& payload);
 	int		readingsAppend(const std::string& payload);
+	bool		hasReadingsAppendBinary() const { return readingsAppendBinaryPtr != NULL; };
+	int		readingsAppendBinary(const std::string& payload);
 	char		*readingsFetch(unsigned long id, unsigned int blksize);
+	bool		hasReadingsFetchStream() const { return readingsFetchStreamPtr != NULL; };
+	bool		readingsFetchStream(unsigned long id, unsigned int blksize,
+					    PLUGIN_STREAM_WRITER writer, void *context);
 	char		*readingsRetrieve(const std::string& payload);
 	char		*readingsPurge(unsigned long age, unsigned int flags, unsigned long sent);
 	long		*readingsPurge();
@@ -49,6 +54,8 @@ public:
 	int		deleteTableSnapshot(const std::string& table, const std::string& id);
 	char		*getTableSnapshots(const std::string& table);
 	PLUGIN_ERROR	*lastError();
+	bool		hasReconfigure() const { return reconfigurePtr != NULL; };
+	void		reconfigure(const std::string& config);
 
 private:
 	PLUGIN_HANDLE	instance;
@@ -57,7 +64,10 @@ private:
 	int		(*commonUpdatePtr)(PLUGIN_HANDLE, const char *, const char *);
 	int		(*commonDeletePtr)(PLUGIN_HANDLE, const char *, const char *);
 	int		(*readingsAppendPtr)(PLUGIN_HANDLE, const char *);
+	int		(*readingsAppendBinaryPtr)(PLUGIN_HANDLE, const char *, size_t);
 	char		*(*readingsFetchPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize);
+	bool		(*readingsFetchStreamPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize,
+						  PLUGIN_STREAM_WRITER writer, void *context);
 	char		*(*readingsRetrievePtr)(PLUGIN_HANDLE, const char *payload);
 	char		*(*readingsPurgePtr)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent);
 	void		(*releasePtr)(PLUGIN_HANDLE, const char *payload);
@@ -66,6 +76,7 @@ private:
 	int		(*deleteTableSnapshotPtr)(PLUGIN_HANDLE, const char *, const char *);
 	char		*(*getTableSnapshotsPtr)(PLUGIN_HANDLE, const char *);
 	PLUGIN_ERROR	*(*lastErrorPtr)(PLUGIN_HANDLE);
+	void		(*reconfigurePtr)(PLUGIN_HANDLE, const char *);
 };
 
 #endif
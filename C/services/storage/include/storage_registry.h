@@ -22,6 +22,7 @@ class StorageRegistry {
 		void		registerAsset(const std::string& asset, const std::string& url);
 		void		unregisterAsset(const std::string& asset, const std::string& url);
 		void		process(const std::string& payload);
+		bool		hasRegistrations() const { return m_registrations.size() != 0; };
 		void		run();
 	private:
 		void		processPayload(char *payload);
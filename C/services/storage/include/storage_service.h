@@ -37,6 +37,7 @@ class StorageService : public ServiceHandler {
 	private:
 		const string&		m_name;
 		bool 			loadPlugin();
+		void			configurePlugin(StoragePlugin *plugin);
 		StorageApi    		*api;
 		StorageConfiguration	*config;
 		Logger        		*logger;
@@ -10,12 +10,17 @@
  * Author: Mark Riddoch
  */
 #include <json_provider.h>
+#include <worker_pool.h>
 #include <string>
+#include <vector>
+#include <mutex>
 
 class StorageStats : public JSONProvider {
 	public:
 		StorageStats();
 		void		asJSON(std::string &) const;
+		void		readingsAppended(int rows, double seconds);
+		void		addWorkerPool(const WorkerPool *pool);
 		unsigned int commonInsert;
 		unsigned int commonSimpleQuery;
 		unsigned int commonQuery;
@@ -23,7 +28,13 @@ class StorageStats : public JSONProvider {
 		unsigned int commonDelete;
 		unsigned int readingAppend;
 		unsigned int readingFetch;
+		unsigned int readingWait;
 		unsigned int readingQuery;
 		unsigned int readingPurge;
+	private:
+		mutable std::mutex	m_appendMutex;
+		unsigned long		m_readingsAppended;
+		double			m_appendTime;	// Seconds spent in the plugin appending readings
+		std::vector<const WorkerPool *>	m_pools;
 };
 #endif
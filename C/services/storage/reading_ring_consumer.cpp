@@ -0,0 +1,115 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring_consumer.h>
+#include <storage_api.h>
+#include <logger.h>
+#include <future>
+#include <memory>
+
+using namespace std;
+
+/**
+ * Start a thread to read the batches written to a ring
+ *
+ * @param api		The storage API that appends the readings
+ * @param service	The south service that writes to the ring
+ * @param ring		The ring, owned by the consumer from now on
+ */
+ReadingRingConsumer::ReadingRingConsumer(StorageApi *api, const string& service, ReadingRing *ring) :
+	m_api(api), m_service(service), m_ring(ring), m_running(true), m_shutdown(false)
+{
+	m_thread = thread(&ReadingRingConsumer::consume, this);
+}
+
+/**
+ * Stop reading the ring, the south service will send any batches
+ * left in it by other means
+ */
+ReadingRingConsumer::~ReadingRingConsumer()
+{
+	m_shutdown = true;
+	m_thread.join();
+	delete m_ring;
+}
+
+/**
+ * Append each batch as it is written to the ring
+ */
+void ReadingRingConsumer::consume()
+{
+	Logger *logger = Logger::getLogger();
+	unsigned long batches = 0, readings = 0;
+	string batch;
+	unsigned int count;
+	uint64_t seq;
+
+	logger->info("Reading ring %s opened for service %s", m_ring->getName().c_str(), m_service.c_str());
+	while (!m_shutdown)
+	{
+		m_ring->heartbeat();
+		if (m_ring->read(batch, count, seq, READING_RING_POLL))
+		{
+			// The south service has the ring open, the name is no longer needed
+			if (batches++ == 0)
+			{
+				m_ring->unlink();
+			}
+			int rval = append(batch);
+			m_ring->acknowledge(seq, rval);
+			if (rval != -1)
+			{
+				readings += count;
+			}
+		}
+		else if (m_ring->abandoned() || m_ring->producerClosed())
+		{
+			break;
+		}
+	}
+	// Batches not yet read are reclaimed by the south service
+	m_ring->shutdown();
+	m_running = false;
+	logger->info("Reading ring %s for service %s closed, %lu readings appended from %lu batches",
+			m_ring->getName().c_str(), m_service.c_str(), readings, batches);
+}
+
+/**
+ * Append a batch on the append worker pool and wait for the result,
+ * refreshing the heartbeat whilst waiting
+ *
+ * @param batch	The batch, it is moved to the worker
+ * @return int	The number of readings appended or -1
+ */
+int ReadingRingConsumer::append(string& batch)
+{
+	StorageApi *api = m_api;
+	auto data = make_shared<string>();
+	data->swap(batch);
+	auto result = make_shared<promise<int>>();
+	future<int> done = result->get_future();
+	function<void()> task = [api, data, result]() {
+		result->set_value(api->appendReadingsBatch(*data));
+	};
+	while (!api->m_appendPool->submit(task))
+	{
+		if (m_shutdown)
+		{
+			// The pool is stopping, the batch has been read and must be appended
+			return api->appendReadingsBatch(*data);
+		}
+		m_ring->heartbeat();
+		this_thread::sleep_for(chrono::milliseconds(READING_RING_SUBMIT));
+	}
+	while (done.wait_for(chrono::milliseconds(READING_RING_POLL)) != future_status::ready)
+	{
+		m_ring->heartbeat();
+	}
+	return done.get();
+}
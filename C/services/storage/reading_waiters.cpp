@@ -0,0 +1,163 @@
+/*
+ * FogLAMP storage service.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_waiters.h>
+#include <string>
+
+using namespace std;
+
+/**
+ * Start the thread that answers the waiting requests
+ *
+ * @param maxWaiters	The most requests held at once
+ */
+ReadingWaiters::ReadingWaiters(unsigned int maxWaiters) : m_maxWaiters(maxWaiters), m_appends(0), m_running(true)
+{
+	m_thread = thread(&ReadingWaiters::run, this);
+}
+
+/**
+ * Answer the waiting requests and stop the thread
+ */
+ReadingWaiters::~ReadingWaiters()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread.join();
+}
+
+/**
+ * Return the number of readings appends made so far
+ */
+unsigned long ReadingWaiters::appends()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_appends;
+}
+
+/**
+ * Hold a request until readings are appended or the timeout expires.
+ * If readings have been appended since the caller counted the appends
+ * the request is answered at once.
+ *
+ * @param response	The response to the wait request
+ * @param after		The last reading id the client has
+ * @param appends	The appends counted before checking for readings
+ * @param timeout	Milliseconds to wait for readings
+ * @return		False if the request was not answered because
+ *			the most requests are already held
+ */
+bool ReadingWaiters::wait(shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+			  unsigned long after, unsigned long appends, unsigned long timeout)
+{
+	bool available;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		available = appends != m_appends;
+		if (!available && m_running)
+		{
+			if (m_waiters.size() >= m_maxWaiters)
+			{
+				return false;
+			}
+			m_waiters.push_back(Waiter{response, after, appends,
+				chrono::steady_clock::now() + chrono::milliseconds(timeout)});
+			m_cv.notify_all();
+			return true;
+		}
+	}
+	respond(response, after, available);
+	return true;
+}
+
+/**
+ * Called after each readings append, wakes the waiting requests
+ */
+void ReadingWaiters::notify()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_appends++;
+	if (!m_waiters.empty())
+	{
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Send the answer to a wait request
+ *
+ *	{ "after" : 1234, "available" : true }
+ *
+ * @param response	The response to the wait request
+ * @param after		The last reading id the client has
+ * @param available	Readings may have been added after it
+ */
+void ReadingWaiters::respond(shared_ptr<SimpleWeb::Server<SimpleWeb::HTTP>::Response> response,
+			     unsigned long after, bool available)
+{
+	string payload = "{ \"after\" : " + to_string(after) +
+			", \"available\" : " + (available ? "true" : "false") + " }";
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << payload.length() << "\r\n"
+		 <<  "Content-type: application/json\r\n\r\n" << payload;
+}
+
+/**
+ * The waiter thread, answers the requests that are waiting when
+ * readings are appended or when their timeout expires. The responses
+ * are sent without holding the mutex so that appends are not delayed.
+ */
+void ReadingWaiters::run()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (m_running || !m_waiters.empty())
+	{
+		if (m_waiters.empty())
+		{
+			m_cv.wait(lck);
+			continue;
+		}
+		auto deadline = m_waiters.front().deadline;
+		for (auto& waiter : m_waiters)
+		{
+			if (waiter.deadline < deadline)
+				deadline = waiter.deadline;
+		}
+		m_cv.wait_until(lck, deadline);
+
+		vector<pair<Waiter, bool>> answered;
+		auto now = chrono::steady_clock::now();
+		for (auto it = m_waiters.begin(); it != m_waiters.end(); )
+		{
+			bool available = it->appends != m_appends;
+			if (available || it->deadline <= now || !m_running)
+			{
+				answered.push_back(make_pair(move(*it), available));
+				it = m_waiters.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		if (answered.empty())
+		{
+			continue;
+		}
+		lck.unlock();
+		for (auto& waiter : answered)
+		{
+			respond(waiter.first.response, waiter.first.after, waiter.second);
+		}
+		answered.clear();
+		lck.lock();
+	}
+}
@@ -16,6 +16,7 @@
 #include <plugin_api.h>
 #include <plugin.h>
 #include <logger.h>
+#include <utils.h>
 #include <iostream>
 #include <string>
 #include <signal.h>
@@ -23,6 +24,7 @@
 #include <dlfcn.h>
 #include <cxxabi.h>
 #include <syslog.h>
+#include <sys/stat.h>
 
 extern int makeDaemon(void);
 
@@ -172,7 +174,8 @@ pid_t pid;
 /**
  * Constructor for the storage service
  */
-StorageService::StorageService(const string& myName) : m_name(myName), m_shutdown(false)
+StorageService::StorageService(const string& myName) : m_name(myName),
+	storagePlugin(NULL), readingPlugin(NULL), m_shutdown(false)
 {
 unsigned short servicePort;
 
@@ -209,6 +212,52 @@ unsigned short servicePort;
 
 
 	api = new StorageApi(servicePort, threads);
+
+	unsigned int appendThreads = DEFAULT_APPEND_THREADS;
+	unsigned int fetchThreads = DEFAULT_FETCH_THREADS;
+	unsigned int purgeThreads = DEFAULT_PURGE_THREADS;
+	unsigned int queueSize = DEFAULT_WORKER_QUEUE_SIZE;
+	if (config->hasValue("appendThreads"))
+	{
+		appendThreads = (unsigned int)atoi(config->getValue("appendThreads"));
+	}
+	if (config->hasValue("fetchThreads"))
+	{
+		fetchThreads = (unsigned int)atoi(config->getValue("fetchThreads"));
+	}
+	if (config->hasValue("purgeThreads"))
+	{
+		purgeThreads = (unsigned int)atoi(config->getValue("purgeThreads"));
+	}
+	if (config->hasValue("workerQueueSize"))
+	{
+		queueSize = (unsigned int)atoi(config->getValue("workerQueueSize"));
+	}
+	api->setWorkerThreads(appendThreads, fetchThreads, purgeThreads, queueSize);
+
+	// Services on this host may connect on a Unix domain socket
+	if (!config->hasValue("unixSocket") || strcmp(config->getValue("unixSocket"), "true") == 0)
+	{
+		string dir = getDataDir() + "/var";
+		mkdir(dir.c_str(), 0755);
+		dir += "/run";
+		mkdir(dir.c_str(), 0755);
+		api->setSocketPath(dir + "/storage.sock");
+	}
+	api->enableReadingRings(!config->hasValue("readingRing") ||
+				strcmp(config->getValue("readingRing"), "true") == 0);
+
+	unsigned int coalesceWindow = DEFAULT_COALESCE_WINDOW;
+	unsigned int coalesceRows = DEFAULT_COALESCE_ROWS;
+	if (config->hasValue("appendCoalesceWindow"))
+	{
+		coalesceWindow = (unsigned int)atoi(config->getValue("appendCoalesceWindow"));
+	}
+	if (config->hasValue("appendCoalesceRows"))
+	{
+		coalesceRows = (unsigned int)atoi(config->getValue("appendCoalesceRows"));
+	}
+	api->setAppendCoalescing(coalesceWindow, coalesceRows);
 }
 
 /**
@@ -243,6 +292,7 @@ void StorageService::start(string& coreAddress, unsigned short corePort)
 		unsigned short listenerPort = api->getListenerPort();
 		unsigned short managementListener = management.getListenerPort();
 		ServiceRecord record(m_name, "Storage", "http", "localhost", listenerPort, managementListener);
+		record.setSocket(api->getSocketPath());
 		ManagementClient *client = new ManagementClient(coreAddress, corePort);
 		client->registerService(record);
 		unsigned int retryCount = 0;
@@ -305,6 +355,7 @@ bool StorageService::loadPlugin()
 					plugin);
 			return false;
 		}
+		configurePlugin(storagePlugin);
 		api->setPlugin(storagePlugin);
 		logger->info("Loaded storage plugin %s.", plugin);
 	}
@@ -338,6 +389,7 @@ bool StorageService::loadPlugin()
 					readingPluginName);
 			return false;
 		}
+		configurePlugin(readingPlugin);
 		api->setReadingPlugin(readingPlugin);
 		logger->info("Loaded reading plugin %s.", readingPluginName);
 	}
@@ -369,6 +421,35 @@ void StorageService::configChange(const string& categoryName, const string& cate
 	if (!categoryName.compare(STORAGE_CATEGORY))
 	{
 		config->updateCategory(category);
+		if (storagePlugin)
+		{
+			configurePlugin(storagePlugin);
+		}
+		if (readingPlugin)
+		{
+			configurePlugin(readingPlugin);
+		}
+	}
+}
+
+/**
+ * Add the default configuration of a plugin to the storage category
+ * and pass the category to the plugin if it accepts configuration
+ *
+ * @param plugin	The loaded plugin
+ */
+void StorageService::configurePlugin(StoragePlugin *plugin)
+{
+	const PLUGIN_INFORMATION *info = plugin->getInfo();
+	if (info->config)
+	{
+		config->addDefaults(info->config);
+	}
+	if (plugin->hasReconfigure())
+	{
+		string category;
+		config->getCategory(category);
+		plugin->reconfigure(category);
 	}
 }
 
@@ -14,23 +14,27 @@
 #include "management_api.h"
 #include "logger.h"
 #include "plugin_exception.h"
+#include <binary_readings.h>
+#include <reading_ring_consumer.h>
 #include <rapidjson/document.h>
 #include <atomic>
+#include <chrono>
+#include <future>
 
 // Added for the default_resource example
 #include <algorithm>
 #include <fstream>
 #include <vector>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
 #ifdef HAVE_OPENSSL
 #include "crypto.hpp"
 #endif
 
-// Enable worker threads for readings append and fetch
+// Run readings append, fetch and purge on the worker pools
 #define WORKER_THREADS		1
 
-// Threshold for logging number of threads in use for some "readings" wrappers
-#define MAX_WORKER_THREADS	5
-
 /**
  * Definition of the Storage Service REST API
  */
@@ -120,31 +124,10 @@ void readingAppendWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
+	api->dispatch(api->m_appendPool, response, [api, response, request]
 	{
-		Logger::getLogger()->warn("Storage API: readingAppend() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d"
-					  "%d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
-	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingAppend(response, request);
-
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingAppend(response, request);
 #endif
@@ -158,31 +141,10 @@ void readingFetchWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
-	{
-		Logger::getLogger()->warn("Storage API: readingFetch() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d"
-					  "%d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
+	api->dispatch(api->m_fetchPool, response, [api, response, request]
 	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingFetch(response, request);
-
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingFetch(response, request);
 #endif
@@ -206,35 +168,32 @@ void readingPurgeWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
-	{
-		Logger::getLogger()->warn("Storage API: readingPurge() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d"
-					  "%d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
+	api->dispatch(api->m_purgePool, response, [api, response, request]
 	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingPurge(response, request);
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingPurge(response, request);
 #endif
 }
 
+/**
+ * Wrapper function for the reading wait API call.
+ */
+void readingWaitWrapper(shared_ptr<HttpServer::Response> response,
+			shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+#if WORKER_THREADS
+	api->dispatch(api->m_fetchPool, response, [api, response, request]
+	{
+		api->readingWait(response, request);
+	});
+#else
+	api->readingWait(response, request);
+#endif
+}
+
 /**
  * Wrapper function for the reading purge API call.
  */
@@ -244,6 +203,15 @@ void readingRegisterWrapper(shared_ptr<HttpServer::Response> response, shared_pt
 	api->readingRegister(response, request);
 }
 
+/**
+ * Wrapper function for the reading ring API call.
+ */
+void readingRingWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->readingRing(response, request);
+}
+
 /**
  * Wrapper function for the reading purge API call.
  */
@@ -296,11 +264,16 @@ void getTableSnapshotsWrapper(shared_ptr<HttpServer::Response> response,
 /**
  * Construct the singleton Storage API 
  */
-StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : readingPlugin(0) {
+StorageApi::StorageApi(const unsigned short port, const unsigned int threads) :
+	m_appendPool(NULL), m_fetchPool(NULL), m_purgePool(NULL), readingPlugin(0),
+	m_appendThreads(DEFAULT_APPEND_THREADS), m_fetchThreads(DEFAULT_FETCH_THREADS),
+	m_purgeThreads(DEFAULT_PURGE_THREADS), m_workerQueueSize(DEFAULT_WORKER_QUEUE_SIZE),
+	m_readingRings(false), m_coalesceWindow(DEFAULT_COALESCE_WINDOW),
+	m_coalesceRows(DEFAULT_COALESCE_ROWS), m_coalescer(NULL), m_waiters(NULL) {
 
 	m_port = port;
 	m_threads = threads;
-	m_server = new HttpServer();
+	m_server = new LocalHttpServer();
 	m_server->config.port = port;
 	m_server->config.thread_pool_size = threads;
 	StorageApi::m_instance = this;
@@ -326,14 +299,71 @@ unsigned short StorageApi::getListenerPort()
 	return m_server->getLocalPort();
 }
 
+/**
+ * Set the Unix domain socket to listen on as well as the port,
+ * must be called before the server is started
+ *
+ * @param path	The path of the socket
+ */
+void StorageApi::setSocketPath(const string& path)
+{
+	m_server->setSocketPath(path);
+}
+
+/**
+ * Return the Unix domain socket the server is listening on, or
+ * an empty string if it is only listening on the port
+ */
+const string& StorageApi::getSocketPath()
+{
+	return m_server->getSocketPath();
+}
+
+/**
+ * Allow south services on this host to pass readings through shared
+ * memory rings rather than append requests
+ *
+ * @param enable	True if rings may be created
+ */
+void StorageApi::enableReadingRings(bool enable)
+{
+	m_readingRings = enable;
+}
+
+/**
+ * Merge the readings appends that arrive within a window into one
+ * call of the storage plugin. Must be called before initResources.
+ *
+ * @param window	Milliseconds an append waits for others, 0 disables merging
+ * @param rows		Readings that are appended without waiting for the window
+ */
+void StorageApi::setAppendCoalescing(unsigned int window, unsigned int rows)
+{
+	m_coalesceWindow = window;
+	m_coalesceRows = rows;
+}
+
 /**
  * Initialise the API entry points for the common data resource and
  * the readings resource.
  */
 void StorageApi::initResources()
 {
-	// Initialise workers threads counter
-	m_workers_count = ATOMIC_VAR_INIT(0);
+	// Create the worker pools for the readings calls
+	m_appendPool = new WorkerPool("append", m_appendThreads, m_workerQueueSize);
+	m_fetchPool = new WorkerPool("fetch", m_fetchThreads, m_workerQueueSize);
+	m_purgePool = new WorkerPool("purge", m_purgeThreads, m_workerQueueSize);
+	stats.addWorkerPool(m_appendPool);
+	stats.addWorkerPool(m_fetchPool);
+	stats.addWorkerPool(m_purgePool);
+
+	m_waiters = new ReadingWaiters(MAX_READING_WAITERS);
+	if (m_coalesceWindow)
+	{
+		m_coalescer = new AppendCoalescer(m_coalesceWindow, m_coalesceRows,
+			m_workerQueueSize, DEFAULT_COALESCE_BYTES,
+			[this](vector<PendingAppend>& appends) { appendCoalesced(appends); });
+	}
 
 	// Initialise the API entry points
 	m_server->resource[COMMON_ACCESS]["POST"] = commonInsertWrapper;
@@ -358,6 +388,8 @@ void StorageApi::initResources()
 	m_server->resource[READING_ACCESS]["GET"] = readingFetchWrapper;
 	m_server->resource[READING_QUERY]["PUT"] = readingQueryWrapper;
 	m_server->resource[READING_PURGE]["PUT"] = readingPurgeWrapper;
+	m_server->resource[READING_RING]["POST"] = readingRingWrapper;
+	m_server->resource[READING_WAIT]["GET"] = readingWaitWrapper;
 
 	m_server->on_error = on_error;
 
@@ -383,7 +415,81 @@ void StorageApi::startServer() {
 
 void StorageApi::stopServer() {
 	m_server->stop();
+	{
+		lock_guard<mutex> guard(m_ringMutex);
+		for (auto& consumer : m_ringConsumers)
+		{
+			delete consumer.second;
+		}
+		m_ringConsumers.clear();
+	}
+	if (m_appendPool)
+	{
+		m_appendPool->stop();
+		m_fetchPool->stop();
+		m_purgePool->stop();
+	}
+	// Appends that are waiting to be merged are flushed
+	delete m_coalescer;
+	m_coalescer = NULL;
+	// Requests waiting for readings are answered
+	delete m_waiters;
+	m_waiters = NULL;
+}
+
+/**
+ * Set the number of threads in each of the worker pools used for
+ * the readings calls. Must be called before initResources.
+ *
+ * @param append	Threads for readings append
+ * @param fetch		Threads for readings fetch
+ * @param purge		Threads for readings purge
+ * @param queueSize	Calls that may wait in each pool for a thread
+ */
+void StorageApi::setWorkerThreads(unsigned int append, unsigned int fetch,
+				  unsigned int purge, unsigned int queueSize)
+{
+	m_appendThreads = append;
+	m_fetchThreads = fetch;
+	m_purgeThreads = purge;
+	m_workerQueueSize = queueSize;
+}
+
+/**
+ * Run an API call on a worker pool. If the pool has too many calls
+ * waiting the call is refused with 503 Service Unavailable and a
+ * Retry-After header, rather than queued without limit.
+ *
+ * @param pool		The worker pool to run the call
+ * @param response	The response stream for the call
+ * @param call		The API call to run
+ */
+void StorageApi::dispatch(WorkerPool *pool, shared_ptr<HttpServer::Response> response,
+			  const function<void()>& call)
+{
+	if (!pool->submit(call))
+	{
+		Logger::getLogger()->warn("Storage API: %s worker pool is full, request refused", pool->getName().c_str());
+		serviceUnavailable(response, pool->getName());
+	}
+}
+
+/**
+ * Refuse a call with 503 Service Unavailable and a Retry-After header
+ * because too many calls are waiting
+ *
+ * @param response	The response stream for the call
+ * @param entryPoint	The entry point reported in the payload
+ */
+void StorageApi::serviceUnavailable(shared_ptr<HttpServer::Response> response, const string& entryPoint)
+{
+	string payload = "{ \"entryPoint\" : \"" + entryPoint + "\", "
+			"\"message\" : \"Too many requests waiting, retry later\", \"retryable\" : true }";
+	*response << "HTTP/1.1 " << status_code(SimpleWeb::StatusCode::server_error_service_unavailable)
+		<< "\r\nRetry-After: " << WORKER_RETRY_AFTER << "\r\nContent-Length: " << payload.length() << "\r\n"
+		<<  "Content-type: application/json\r\n\r\n" << payload;
 }
+
 /**
  * Wait for the HTTP server to shutdown
  */
@@ -421,6 +527,21 @@ void StorageApi::respond(shared_ptr<HttpServer::Response> response, const string
 }
 
 
+/**
+ * Construct an HTTP response with the 200 OK return code using a result
+ * returned by a plugin, without copying it into a string first.
+ *
+ * @param response	The response stream to send the response on
+ * @param payload	The payload to send
+ */
+void StorageApi::respond(shared_ptr<HttpServer::Response> response, const char *payload)
+{
+	size_t length = strlen(payload);
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << length << "\r\n"
+		 <<  "Content-type: application/json\r\n\r\n";
+	response->write(payload, (streamsize)length);
+}
+
 /**
  * Construct an HTTP response with the specified return code using the payload
  * provided.
@@ -435,6 +556,28 @@ void StorageApi::respond(shared_ptr<HttpServer::Response> response, SimpleWeb::S
 		 <<  "Content-type: application/json\r\n\r\n" << payload;
 }
 
+/**
+ * Construct the response to a readings append request. The response
+ * advertises the binary readings batch format if the plugin that
+ * stores the readings accepts it, clients will then use it for
+ * subsequent requests.
+ *
+ * @param response	The response stream to send the response on
+ * @param count		The number of readings added
+ */
+void StorageApi::respondAppended(shared_ptr<HttpServer::Response> response, int count)
+{
+	string payload = "{ \"response\" : \"appended\", \"readings_added\" : ";
+	payload += to_string(count);
+	payload += " }";
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << payload.length() << "\r\n";
+	if ((readingPlugin ? readingPlugin : plugin)->hasReadingsAppendBinary())
+	{
+		*response << "Accept: " READINGS_BINARY_CONTENT_TYPE ", application/json\r\n";
+	}
+	*response << "Content-type: application/json\r\n\r\n" << payload;
+}
+
 /**
  * Perform an insert into a table of the data provided in the payload.
  *
@@ -582,9 +725,7 @@ string payload;
 		char *pluginResult = plugin->commonRetrieve(tableName, payload);
 		if (pluginResult)
 		{
-			string res = pluginResult;
-
-			respond(response, res);
+			respond(response, pluginResult);
 			free(pluginResult);
 		}
 		else
@@ -617,9 +758,7 @@ string	payload;
 		char *pluginResult = plugin->commonRetrieve(tableName, payload);
 		if (pluginResult)
 		{
-			string res = pluginResult;
-
-			respond(response, res);
+			respond(response, pluginResult);
 			free(pluginResult);
 		}
 		else
@@ -694,12 +833,9 @@ string  responsePayload;
 			{
 				if (seqNum <= it->second.first)
 				{
-					responsePayload = "{ \"response\" : \"appended\", \"readings_added\" : ";
-					responsePayload += to_string(0);
-					responsePayload += " }";
 					Logger::getLogger()->info("%s:%d: Repeat/old request: responding with zero response - threadId=%s, last seen seqNum for this threadId=%d, HTTP request header seqNum=%d",
 									__FUNCTION__, __LINE__, threadId.c_str(), it->second.first, seqNum);
-					respond(response, responsePayload);
+					respondAppended(response, 0);
 					return;
 				}
 				// remove this threadId from LRU list; will add this to front of LRU list below
@@ -723,19 +859,54 @@ string  responsePayload;
 
 	stats.readingAppend++;
 	try {
+		StoragePlugin *appendPlugin = readingPlugin ? readingPlugin : plugin;
 		payload = request->content.string();
-		int rval = (readingPlugin ? readingPlugin : plugin)->readingsAppend(payload);
+		int rval;
+		auto contentType = request->header.find("Content-Type");
+		unique_ptr<BinaryReadingsReader> reader;
+		if (contentType != request->header.end() &&
+			contentType->second.compare(READINGS_BINARY_CONTENT_TYPE) == 0)
+		{
+			reader.reset(new BinaryReadingsReader(payload.data(), payload.length()));
+			if (!reader->isValid())
+			{
+				responsePayload = "{ \"entryPoint\" : \"appendReadings\", \"message\" : \"";
+				responsePayload += reader->getError();
+				responsePayload += "\", \"retryable\" : false }";
+				respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+				return;
+			}
+			if (m_coalescer && !appendPlugin->hasReadingsAppendBinary())
+			{
+				// The batch would be converted to JSON anyway
+				string json = reader->toJSON();
+				reader.reset();
+				payload.swap(json);
+			}
+		}
+		if (!reader && m_coalescer)
+		{
+			string readings;
+			unsigned int count;
+			if (AppendCoalescer::readingsArray(payload, readings, count))
+			{
+				// The response is sent once the merged append completes
+				if (!m_coalescer->append(response, readings, count))
+				{
+					Logger::getLogger()->warn("Storage API: too many appends waiting to be merged, request refused");
+					serviceUnavailable(response, "appendReadings");
+				}
+				return;
+			}
+		}
+		rval = appendReadings(payload, reader.get());
 		if (rval != -1)
 		{
-			registry.process(payload);
-			responsePayload = "{ \"response\" : \"appended\", \"readings_added\" : ";
-			responsePayload += to_string(rval);
-			responsePayload += " }";
-			respond(response, responsePayload);
+			respondAppended(response, rval);
 		}
 		else
 		{
-			mapError(responsePayload, (readingPlugin ? readingPlugin : plugin)->lastError());
+			mapError(responsePayload, appendPlugin->lastError());
 			respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
 		}
 
@@ -745,6 +916,272 @@ string  responsePayload;
 	}
 }
 
+/**
+ * Append a block of readings to the readings plugin and pass them to
+ * any registrations of interest in the assets.
+ *
+ * A binary batch is passed directly to the plugin if it supports it,
+ * otherwise it is converted to JSON. JSON is only created for the
+ * plugin or if there are notification registrations that need it.
+ *
+ * @param payload	The readings, a binary batch is replaced by
+ *			JSON if it is converted
+ * @param reader	The reader of a binary batch, NULL for JSON
+ * @return int		The number of readings appended or -1
+ */
+int StorageApi::appendReadings(string& payload, const BinaryReadingsReader *reader)
+{
+	StoragePlugin *appendPlugin = readingPlugin ? readingPlugin : plugin;
+	int rval;
+	auto start = chrono::steady_clock::now();
+	if (!reader)
+	{
+		rval = appendPlugin->readingsAppend(payload);
+	}
+	else if (appendPlugin->hasReadingsAppendBinary())
+	{
+		rval = appendPlugin->readingsAppendBinary(payload);
+		if (rval != -1 && registry.hasRegistrations())
+		{
+			payload = reader->toJSON();
+		}
+	}
+	else
+	{
+		payload = reader->toJSON();
+		rval = appendPlugin->readingsAppend(payload);
+	}
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	stats.readingsAppended(rval, elapsed.count());
+	if (rval > 0 && m_waiters)
+	{
+		m_waiters->notify();
+	}
+	if (rval != -1)
+	{
+		registry.process(payload);
+	}
+	return rval;
+}
+
+/**
+ * Append a group of readings appends merged by the coalescer in one
+ * call of the storage plugin and respond to each of them
+ *
+ * @param appends	The appends to merge
+ */
+void StorageApi::appendCoalesced(vector<PendingAppend>& appends)
+{
+	StoragePlugin *appendPlugin = readingPlugin ? readingPlugin : plugin;
+	size_t responded = 0;
+	try {
+		AppendCoalescer::merge(appends,
+			[this](string& payload) { return appendReadings(payload, NULL); },
+			[this, appendPlugin, &responded](PendingAppend& append, int rval) {
+				if (rval != -1)
+				{
+					respondAppended(append.response, rval);
+				}
+				else
+				{
+					string responsePayload;
+					mapError(responsePayload, appendPlugin->lastError());
+					respond(append.response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+				}
+				responded++;
+			});
+	} catch (exception& ex) {
+		for (size_t i = responded; i < appends.size(); i++)
+		{
+			internalError(appends[i].response, ex);
+		}
+	}
+}
+
+/**
+ * Append a binary batch of readings read from the shared memory ring
+ * of a south service on this host
+ *
+ * @param batch		The binary batch, it may be converted to JSON
+ * @return int		The number of readings appended or -1
+ */
+int StorageApi::appendReadingsBatch(string& batch)
+{
+	stats.readingAppend++;
+	try {
+		BinaryReadingsReader reader(batch.data(), batch.length());
+		if (!reader.isValid())
+		{
+			Logger::getLogger()->error("Invalid readings batch in shared memory ring: %s",
+					reader.getError().c_str());
+			return -1;
+		}
+		return appendReadings(batch, &reader);
+	} catch (exception& ex) {
+		Logger::getLogger()->error("Failed to append readings from shared memory ring: %s", ex.what());
+	}
+	return -1;
+}
+
+/**
+ * Create a shared memory ring for a south service on this host to pass
+ * readings through rather than append requests. A ring previously
+ * created for the same service is closed.
+ *
+ * The payload names the service, the response names the ring:
+ *	{ "service" : "Sine" }	->	{ "ring" : "/foglamp.1234.Sine" }
+ */
+void StorageApi::readingRing(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string		payload;
+Document	doc;
+
+	payload = request->content.string();
+	doc.Parse(payload.c_str());
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("service") || !doc["service"].IsString())
+	{
+		string resp = "{ \"error\" : \"Badly formed payload\" }";
+		respond(response, SimpleWeb::StatusCode::client_error_bad_request, resp);
+		return;
+	}
+	if (!m_readingRings)
+	{
+		string resp = "{ \"error\" : \"Shared memory rings are not enabled\" }";
+		respond(response, SimpleWeb::StatusCode::client_error_not_found, resp);
+		return;
+	}
+	string service = doc["service"].GetString();
+	string name = "/foglamp." + to_string(getpid()) + ".";
+	for (char c : service)
+	{
+		name += isalnum((unsigned char)c) ? c : '_';
+	}
+	name = name.substr(0, NAME_MAX - 1);
+
+	lock_guard<mutex> guard(m_ringMutex);
+	auto it = m_ringConsumers.find(service);
+	if (it != m_ringConsumers.end())
+	{
+		delete it->second;
+		m_ringConsumers.erase(it);
+	}
+	ReadingRing *ring = ReadingRing::create(name);
+	if (!ring)
+	{
+		Logger::getLogger()->error("Failed to create shared memory ring %s: %s",
+				name.c_str(), strerror(errno));
+		string resp = "{ \"error\" : \"Unable to create shared memory ring\" }";
+		respond(response, SimpleWeb::StatusCode::server_error_internal_server_error, resp);
+		return;
+	}
+	m_ringConsumers[service] = new ReadingRingConsumer(this, service, ring);
+	respond(response, "{ \"ring\" : \"" + name + "\" }");
+}
+
+/**
+ * A response that is sent using chunked transfer encoding as a plugin
+ * passes the parts of its result to write().
+ *
+ * Each chunk is sent as soon as it is written, write() waits for the
+ * previous chunk to be sent first so that no more than one chunk is
+ * held by the server at a time. It must therefore be called from a
+ * thread other than those of the HTTP server.
+ */
+class ChunkedResponse {
+	public:
+		ChunkedResponse(shared_ptr<HttpServer::Response> response) :
+			m_response(response), m_started(false), m_failed(false) {};
+		static bool	write(void *context, const char *data, size_t length);
+		bool		end(bool complete);
+	private:
+		bool		sent();
+
+		shared_ptr<HttpServer::Response>	m_response;
+		future<bool>				m_sent;
+		bool					m_started;
+		bool					m_failed;
+};
+
+/**
+ * Send a part of the result as a chunk, the headers are sent with
+ * the first part
+ *
+ * @param context	The ChunkedResponse
+ * @param data		The part of the result
+ * @param length	The length of the part
+ * @return bool		False if the client can no longer be sent the result
+ */
+bool ChunkedResponse::write(void *context, const char *data, size_t length)
+{
+	ChunkedResponse *chunked = (ChunkedResponse *)context;
+	HttpServer::Response& response = *chunked->m_response;
+
+	if (!chunked->m_started)
+	{
+		response << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+			 << "Content-type: application/json\r\n\r\n";
+		chunked->m_started = true;
+	}
+	// An empty chunk would end the response
+	if (length == 0)
+	{
+		return true;
+	}
+	if (!chunked->sent())
+	{
+		return false;
+	}
+	response << hex << length << dec << "\r\n";
+	response.write(data, (streamsize)length);
+	response << "\r\n";
+
+	shared_ptr<promise<bool>> done = make_shared<promise<bool>>();
+	chunked->m_sent = done->get_future();
+	response.send([done](const SimpleWeb::error_code& ec) {
+		done->set_value(!ec);
+	});
+	return true;
+}
+
+/**
+ * Wait for the previous chunk to be sent
+ *
+ * @return bool	False if a chunk could not be sent
+ */
+bool ChunkedResponse::sent()
+{
+	if (m_sent.valid() && !m_sent.get())
+	{
+		m_failed = true;
+	}
+	return !m_failed;
+}
+
+/**
+ * Finish the response once the plugin has returned. If the result was
+ * not complete the connection is closed without the final chunk, so
+ * that the client sees the response is incomplete.
+ *
+ * @param complete	The plugin returned all of the result
+ * @return bool		False if nothing has been sent to the client
+ */
+bool ChunkedResponse::end(bool complete)
+{
+	if (!m_started)
+	{
+		return false;
+	}
+	if (complete && sent())
+	{
+		*m_response << "0\r\n\r\n";
+	}
+	else
+	{
+		m_response->close_connection_after_response = true;
+	}
+	return true;
+}
+
 /**
  * Fetch a block of readings.
  *
@@ -788,12 +1225,29 @@ unsigned long			   count = 0;
 			count = (unsigned)atol(search->second.c_str());
 		}
 
+		StoragePlugin *readings = readingPlugin ? readingPlugin : plugin;
+#if WORKER_THREADS
+		// Send the readings as the plugin reads them
+		if (readings->hasReadingsFetchStream())
+		{
+			ChunkedResponse chunked(response);
+			bool complete = readings->readingsFetchStream(id, count,
+							ChunkedResponse::write, &chunked);
+			if (!chunked.end(complete))
+			{
+				string responsePayload;
+				mapError(responsePayload, readings->lastError());
+				respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+			}
+			return;
+		}
+#endif
+
 		// Get plugin data
-		char *responsePayload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(id, count);
-		string res = responsePayload;
+		char *responsePayload = readings->readingsFetch(id, count);
 
 		// Reply to client
-		respond(response, res);
+		respond(response, responsePayload);
 		// Free plugin data
 		free(responsePayload);
 	} catch (exception ex) {
@@ -801,6 +1255,93 @@ unsigned long			   count = 0;
 	}
 }
 
+/**
+ * Wait for readings to be appended after a given reading id, the long
+ * poll used by north services in place of polling with fetches.
+ *
+ *	GET /storage/reading/wait?after=1234&timeout=1000
+ *
+ * If there are readings after the id the request is answered at once,
+ * otherwise it is held until the next readings append or until the
+ * timeout in milliseconds expires. The response says whether readings
+ * may be available:
+ *
+ *	{ "after" : 1234, "available" : true }
+ *
+ * A request that would be held when MAX_READING_WAITERS requests are
+ * already held is refused with 503 Service Unavailable.
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::readingWait(shared_ptr<HttpServer::Response> response,
+			     shared_ptr<HttpServer::Request> request)
+{
+SimpleWeb::CaseInsensitiveMultimap query;
+unsigned long			   after = 0;
+unsigned long			   timeout = DEFAULT_READING_WAIT;
+
+	stats.readingWait++;
+	try {
+		query = request->parse_query_string();
+
+		auto search = query.find("after");
+		if (search == query.end())
+		{
+			string payload = "{ \"error\" : \"Missing query parameter after\" }";
+			respond(response,
+				SimpleWeb::StatusCode::client_error_bad_request,
+				payload);
+			return;
+		}
+		after = strtoul(search->second.c_str(), NULL, 10);
+		search = query.find("timeout");
+		if (search != query.end())
+		{
+			timeout = strtoul(search->second.c_str(), NULL, 10);
+		}
+		if (timeout > MAX_READING_WAIT)
+		{
+			timeout = MAX_READING_WAIT;
+		}
+
+		// Count the appends before looking for readings, an append
+		// made after the fetch then ends the wait
+		unsigned long appends = m_waiters->appends();
+		StoragePlugin *readings = readingPlugin ? readingPlugin : plugin;
+		char *resultSet = readings->readingsFetch(after + 1, 1);
+		Document doc;
+		if (resultSet)
+		{
+			doc.Parse(resultSet);
+			free(resultSet);
+		}
+		if (!resultSet || doc.HasParseError() || !doc.IsObject())
+		{
+			// The request was valid, the plugin failed to check for readings
+			string responsePayload;
+			mapError(responsePayload, readings->lastError());
+			respond(response, SimpleWeb::StatusCode::server_error_internal_server_error, responsePayload);
+			return;
+		}
+		if (doc.HasMember("count") && doc["count"].IsNumber() && doc["count"].GetInt() > 0)
+		{
+			ReadingWaiters::respond(response, after, true);
+		}
+		else if (timeout == 0)
+		{
+			ReadingWaiters::respond(response, after, false);
+		}
+		else if (!m_waiters->wait(response, after, appends, timeout))
+		{
+			Logger::getLogger()->warn("Storage API: too many requests waiting for readings, request refused");
+			serviceUnavailable(response, "readingWait");
+		}
+	} catch (exception& ex) {
+		internalError(response, ex);
+	}
+}
+
 /**
  * Perform a query on a set of readings
  *
@@ -816,9 +1357,7 @@ string	payload;
 		payload = request->content.string();
 
 		char *resultSet = (readingPlugin ? readingPlugin : plugin)->readingsRetrieve(payload);
-		string res = resultSet;
-
-		respond(response, res);
+		respond(response, resultSet);
 		free(resultSet);
 	} catch (exception ex) {
 		internalError(response, ex);
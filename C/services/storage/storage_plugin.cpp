@@ -38,8 +38,15 @@ StoragePlugin::StoragePlugin(PLUGIN_HANDLE handle) : Plugin(handle)
 				manager->resolveSymbol(handle, "plugin_common_delete");
 	readingsAppendPtr = (int (*)(PLUGIN_HANDLE, const char *))
 				manager->resolveSymbol(handle, "plugin_reading_append");
+	// Optional entry point that accepts the binary readings batch format
+	readingsAppendBinaryPtr = (int (*)(PLUGIN_HANDLE, const char *, size_t))
+				manager->resolveSymbol(handle, "plugin_reading_append_binary");
 	readingsFetchPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize))
 				manager->resolveSymbol(handle, "plugin_reading_fetch");
+	// Optional entry point that streams the fetched readings
+	readingsFetchStreamPtr = (bool (*)(PLUGIN_HANDLE, unsigned long, unsigned int,
+					   PLUGIN_STREAM_WRITER, void *))
+				manager->resolveSymbol(handle, "plugin_reading_fetch_stream");
 	readingsRetrievePtr = (char * (*)(PLUGIN_HANDLE, const char *))
 				manager->resolveSymbol(handle, "plugin_reading_retrieve");
 	readingsPurgePtr = (char * (*)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent))
@@ -60,6 +67,9 @@ StoragePlugin::StoragePlugin(PLUGIN_HANDLE handle) : Plugin(handle)
 	getTableSnapshotsPtr =
 			(char * (*)(PLUGIN_HANDLE, const char*))
 			      manager->resolveSymbol(handle, "plugin_get_table_snapshots");
+	// Optional entry point that is passed the storage configuration category
+	reconfigurePtr = (void (*)(PLUGIN_HANDLE, const char *))
+				manager->resolveSymbol(handle, "plugin_reconfigure");
 }
 
 /**
@@ -102,6 +112,15 @@ int StoragePlugin::readingsAppend(const string& payload)
 	return this->readingsAppendPtr(instance, payload.c_str());
 }
 
+/**
+ * Call the binary readings append method in the plugin, this
+ * should only be called if hasReadingsAppendBinary() is true
+ */
+int StoragePlugin::readingsAppendBinary(const string& payload)
+{
+	return this->readingsAppendBinaryPtr(instance, payload.data(), payload.length());
+}
+
 /**
  * Call the readings fetch method in the plugin
  */
@@ -110,6 +129,22 @@ char * StoragePlugin::readingsFetch(unsigned long id, unsigned int blksize)
 	return this->readingsFetchPtr(instance, id, blksize);
 }
 
+/**
+ * Call the streaming readings fetch method in the plugin, this
+ * should only be called if hasReadingsFetchStream() is true
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param writer	Called with each part of the result
+ * @param context	Passed to the writer
+ * @return bool		True if all of the result was written
+ */
+bool StoragePlugin::readingsFetchStream(unsigned long id, unsigned int blksize,
+					PLUGIN_STREAM_WRITER writer, void *context)
+{
+	return this->readingsFetchStreamPtr(instance, id, blksize, writer, context);
+}
+
 /**
  * Call the readings retrieve method in the plugin
  */
@@ -173,3 +208,14 @@ char *StoragePlugin::getTableSnapshots(const string& table)
 {
         return this->getTableSnapshotsPtr(instance, table.c_str());
 }
+
+/**
+ * Pass the storage configuration category to the plugin, this
+ * should only be called if hasReconfigure() is true
+ *
+ * @param config	The configuration category as JSON
+ */
+void StoragePlugin::reconfigure(const string& config)
+{
+	this->reconfigurePtr(instance, config.c_str());
+}
@@ -18,11 +18,40 @@ using namespace std;
  */
 StorageStats::StorageStats() : commonInsert(0), commonSimpleQuery(0),
 				commonQuery(0), commonUpdate(0), commonDelete(0),
-				readingAppend(0), readingFetch(0),
-				readingQuery(0), readingPurge(0)
+				readingAppend(0), readingFetch(0), readingWait(0),
+				readingQuery(0), readingPurge(0),
+				m_readingsAppended(0), m_appendTime(0.0)
 {
 }
 
+/**
+ * Record the number of readings added by a readings append call to
+ * the storage plugin and the time the plugin took to add them.
+ *
+ * @param rows		The number of readings added
+ * @param seconds	The time spent in the plugin
+ */
+void StorageStats::readingsAppended(int rows, double seconds)
+{
+	lock_guard<mutex> guard(m_appendMutex);
+	if (rows > 0)
+	{
+		m_readingsAppended += (unsigned long)rows;
+	}
+	m_appendTime += seconds;
+}
+
+/**
+ * Add a worker pool whose queue depth and latency are reported
+ * with the statistics
+ *
+ * @param pool	The worker pool
+ */
+void StorageStats::addWorkerPool(const WorkerPool *pool)
+{
+	m_pools.push_back(pool);
+}
+
 /**
  * Serialise the statistics as JSON
  */
@@ -37,8 +66,29 @@ ostringstream convert;   // stream used for the conversion
 	convert << " \"commonDelete\" : " << commonDelete << ",";
 	convert << " \"readingAppend\" : " << readingAppend << ",";
 	convert << " \"readingFetch\" : " << readingFetch << ",";
+	convert << " \"readingWait\" : " << readingWait << ",";
 	convert << " \"readingQuery\" : " << readingQuery << ",";
-	convert << " \"readingPurge\" : " << readingPurge << " }";
+	convert << " \"readingPurge\" : " << readingPurge << ",";
+	{
+		lock_guard<mutex> guard(m_appendMutex);
+		convert << " \"readingsAppended\" : " << m_readingsAppended << ",";
+		convert << " \"readingAppendRate\" : "
+			<< (unsigned long)(m_appendTime > 0.0 ? m_readingsAppended / m_appendTime : 0);
+	}
+	if (!m_pools.empty())
+	{
+		convert << ", \"workerPools\" : { ";
+		for (auto it = m_pools.cbegin(); it != m_pools.cend(); ++it)
+		{
+			string pool;
+			(*it)->asJSON(pool);
+			if (it != m_pools.cbegin())
+				convert << ", ";
+			convert << "\"" << (*it)->getName() << "\" : " << pool;
+		}
+		convert << " }";
+	}
+	convert << " }";
 
 	json = convert.str();
 }
@@ -40,6 +40,8 @@ class NorthPlugin : public Plugin {
 		bool			persistData() { return info->options & SP_PERSIST_DATA; };
 		void			start();
 		void			startData(const std::string& pluginData);
+		bool			hasReconfigure() const { return pluginReconfigure != NULL; };
+		void			reconfigure(const std::string& newConfig);
 
 	private:
 		// Function pointers
@@ -51,6 +53,8 @@ class NorthPlugin : public Plugin {
 		void			(*pluginStart)(PLUGIN_HANDLE);
 		void			(*pluginStartData)(PLUGIN_HANDLE,
 							   const std::string& pluginData);
+		void			(*pluginReconfigure)(PLUGIN_HANDLE*,
+							     const std::string& newConfig);
 
 	public:
 		// Persist plugin data
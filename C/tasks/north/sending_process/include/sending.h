@@ -100,6 +100,7 @@ class SendingProcess : public FogLampProcess
 	public:
 		std::vector<ReadingSet *>	m_buffer;
 		std::thread*			m_thread_load;
+		std::thread*			m_thread_filter;
 		std::thread*			m_thread_send;
 		NorthPlugin*			m_plugin;
 		std::vector<unsigned long>	m_last_read_id;
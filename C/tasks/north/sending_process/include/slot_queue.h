@@ -0,0 +1,103 @@
+#ifndef _SLOT_QUEUE_H
+#define _SLOT_QUEUE_H
+
+/*
+ * FogLAMP sending process pipeline queue
+ *
+ * Copyright (c) 2018 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <mpsc_queue.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Passes the indexes of the data buffer slots between two stages of
+ * the sending process pipeline: load -> filter -> send -> load.
+ *
+ * A slot is owned by one stage at a time, so the slot content is
+ * accessed without locks. The indexes are passed through a bounded
+ * lock-free queue; the mutex is only taken when the consumer has
+ * nothing to do and goes to sleep, or to wake it.
+ */
+class SlotQueue {
+	public:
+		SlotQueue(size_t slots) : m_queue(slots), m_waiting(false), m_stopped(false) {};
+
+		/**
+		 * Pass a slot to the next stage. The queue holds all
+		 * the slots so the push never fails.
+		 *
+		 * @param slot	The index of the slot
+		 */
+		void		push(unsigned long slot)
+		{
+			m_queue.push(slot);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_waiting.load())
+			{
+				std::lock_guard<std::mutex> guard(m_mutex);
+				m_cv.notify_one();
+			}
+		};
+
+		/**
+		 * Take the next slot without waiting
+		 *
+		 * @param slot	Set to the index of the slot
+		 * @return	False if there is no slot
+		 */
+		bool		tryPop(unsigned long& slot) { return m_queue.pop(slot); };
+
+		/**
+		 * Take the next slot, waiting until one is passed or
+		 * the queue is stopped
+		 *
+		 * @param slot	Set to the index of the slot
+		 * @return	False if the queue has been stopped
+		 */
+		bool		pop(unsigned long& slot)
+		{
+			while (!m_queue.pop(slot))
+			{
+				std::unique_lock<std::mutex> lck(m_mutex);
+				m_waiting.store(true);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (m_queue.pop(slot))
+				{
+					m_waiting.store(false);
+					break;
+				}
+				if (m_stopped)
+				{
+					m_waiting.store(false);
+					return false;
+				}
+				m_cv.wait(lck);
+				m_waiting.store(false);
+			}
+			return true;
+		};
+
+		/**
+		 * Wake the consumer and stop it waiting for slots
+		 */
+		void		stop()
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			m_stopped = true;
+			m_cv.notify_all();
+		};
+
+	private:
+		MPSCQueue<unsigned long>	m_queue;
+		std::atomic<bool>		m_waiting;	// The consumer is, or is about to, sleep
+		bool				m_stopped;
+		std::mutex			m_mutex;
+		std::condition_variable		m_cv;
+};
+
+#endif
@@ -38,6 +38,10 @@ NorthPlugin::NorthPlugin(const PLUGIN_HANDLE handle) : Plugin(handle)
 	pluginStartData = (void (*)(const PLUGIN_HANDLE, const string& storedData))
 				manager->resolveSymbol(handle, "plugin_start");
 
+	// Optional, the plugin is restarted if it can not be reconfigured
+	pluginReconfigure = (void (*)(PLUGIN_HANDLE*, const string& newConfig))
+				manager->resolveSymbol(handle, "plugin_reconfigure");
+
 	// Persist data initialised
 	m_plugin_data = NULL;
 }
@@ -87,6 +91,16 @@ void NorthPlugin::startData(const string& storedData)
 	}
 }
 
+/**
+ * Call the reconfigure method in the plugin
+ *
+ * @param newConfig	The new configuration of the plugin
+ */
+void NorthPlugin::reconfigure(const string& newConfig)
+{
+	this->pluginReconfigure(&m_instance, newConfig);
+}
+
 /**
  * Send vector (by reference) of readings pointer to historian server
  *
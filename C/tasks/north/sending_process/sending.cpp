@@ -118,6 +118,7 @@ static void signalHandler(int signal)
 SendingProcess::~SendingProcess()
 {
 	delete m_thread_load;
+	delete m_thread_filter;
 	delete m_thread_send;
 	delete m_plugin;
 }
@@ -402,6 +403,7 @@ void SendingProcess::stop()
 
 	// Threads execution has completed.
 	this->m_thread_load->join();
+	this->m_thread_filter->join();
         this->m_thread_send->join();
 
 	// Remove the data buffers
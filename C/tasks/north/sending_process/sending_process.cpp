@@ -9,7 +9,8 @@
  */
 
 #include <sending.h>
-#include <condition_variable>
+#include <slot_queue.h>
+#include <latency_histogram.h>
 #include <reading_set.h>
 #include <plugin_manager.h>
 #include <plugin_api.h>
@@ -31,16 +32,22 @@
 #define TASK_FETCH_SLEEP 500
 #define TASK_SEND_SLEEP 500
 #define TASK_SLEEP_MAX_INCREMENTS 7 // from 0,5 secs to up to 32 secs
+#define TIMING_LOG_INTERVAL 60 // Seconds between the logs of the stage timing
 
 using namespace std;
 using namespace std::chrono;
 
-// Mutex for m_buffer access
-mutex      readMutex;
-// Mutex for thread idle time
-mutex	waitMutex;
-// Block the calling thread until notified to resume.
-condition_variable cond_var;
+// The slots of the data buffer are passed between the pipeline
+// stages: free -> load -> filter -> send -> free
+SlotQueue	*freeSlots;
+SlotQueue	*loadedSlots;
+SlotQueue	*filteredSlots;
+
+// Time each stage takes for a block, logged by each stage every
+// TIMING_LOG_INTERVAL seconds and when the process ends
+LatencyHistogram	loadTime;
+LatencyHistogram	filterTime;
+LatencyHistogram	sendTime;
 
 // Buffer max elements
 unsigned long memoryBufferSize;
@@ -56,8 +63,13 @@ const string LOG_SERVICE_NAME = "SendingProcess/sending_process";
 
 // Load data from storage
 static void loadDataThread(SendingProcess *loadData);
+// Apply the filters to the loaded data
+static void filterDataThread(SendingProcess *filterData);
 // Send data from historian
 static void sendDataThread(SendingProcess *sendData);
+// Log the time taken by the pipeline stages
+static void logStageTiming(const char *stage, const LatencyHistogram& timing);
+static void logPipelineTiming();
 
 int main(int argc, char** argv)
 {
@@ -68,19 +80,36 @@ int main(int argc, char** argv)
 
 		memoryBufferSize = sendingProcess.getMemoryBufferSize();
 
+		// All the slots of the data buffer are free to load
+		SlotQueue free(memoryBufferSize), loaded(memoryBufferSize), filtered(memoryBufferSize);
+		freeSlots = &free;
+		loadedSlots = &loaded;
+		filteredSlots = &filtered;
+		for (unsigned long slot = 0; slot < memoryBufferSize; slot++)
+		{
+			free.push(slot);
+		}
+
 		// Launch the load thread
 		sendingProcess.m_thread_load = new thread(loadDataThread, &sendingProcess);
+		// Launch the filter thread
+		sendingProcess.m_thread_filter = new thread(filterDataThread, &sendingProcess);
 		// Launch the send thread
 		sendingProcess.m_thread_send = new thread(sendDataThread, &sendingProcess);
 
 		// Run: max execution time or caught signals can stop it
 		sendingProcess.run();
 
-		// Unlock load & send threads
-		cond_var.notify_all();
+		// Unlock the threads waiting for slots
+		sendingProcess.stopRunning();
+		free.stop();
+		loaded.stop();
+		filtered.stop();
 
 		// End processing
 		sendingProcess.stop();
+
+		logPipelineTiming();
 	}
 	catch (const std::exception& e)
 	{
@@ -122,317 +151,349 @@ void applyFilters(SendingProcess* loadData,
 		firstFilter->ingest(readingSet);
 }
 
+/**
+ * Record the time a stage took for a block and log the timing of the
+ * stage if TIMING_LOG_INTERVAL seconds have passed since it was last
+ * logged. Only the thread of the stage accesses its histogram.
+ *
+ * @param stage		The name of the stage
+ * @param timing	The timing of the stage
+ * @param start		The time the stage started on the block
+ * @param lastLog	The time the timing was last logged
+ */
+static void recordTiming(const char *stage,
+			 LatencyHistogram& timing,
+			 const steady_clock::time_point& start,
+			 steady_clock::time_point& lastLog)
+{
+	steady_clock::time_point now = steady_clock::now();
+	timing.record((unsigned long)duration_cast<microseconds>(now - start).count());
+	if (now - lastLog >= seconds(TIMING_LOG_INTERVAL))
+	{
+		logStageTiming(stage, timing);
+		lastLog = now;
+	}
+}
+
+/**
+ * Fetch the next block of readings, or statistics, from the storage layer
+ *
+ * @param loadData    pointer to SendingProcess instance
+ * @return            The data loaded, NULL on errors
+ */
+static ReadingSet* fetchData(SendingProcess *loadData)
+{
+	ReadingSet* readings = NULL;
+	try
+	{
+		bool isReading = !loadData->getDataSourceType().compare("statistics") ? false : true; 
+		if (isReading)
+		{
+			// Read from storage all readings with id > last sent id
+			unsigned long lastReadId = loadData->getLastFetchId() + 1;
+			readings = loadData->getStorageClient()->readingFetch(lastReadId,
+									      loadData->getReadBlockSize());
+		}
+		else
+		{
+			// SELECT id,
+			//	  key AS asset_code,
+			//	  key AS read_key,
+			//	  ts,
+			//	  history_ts AS user_ts,
+			//	  value
+			// FROM statistic_history
+			// WHERE id > lastId
+			// ORDER BY ID ASC
+			// LIMIT blockSize
+			const Condition conditionId(GreaterThan);
+			// WHERE id > lastId
+			Where* wId = new Where("id",
+						conditionId,
+						to_string(loadData->getLastFetchId()));
+			vector<Returns *> columns;
+			// Add colums and needed aliases
+			columns.push_back(new Returns("id"));
+			columns.push_back(new Returns("key", "asset_code"));
+			columns.push_back(new Returns("key", "read_key"));
+			columns.push_back(new Returns("ts"));
+
+			Returns *tmpReturn = new Returns("history_ts", "user_ts");
+			tmpReturn->timezone("utc");
+			columns.push_back(tmpReturn);
+
+			columns.push_back(new Returns("value"));
+			// Build the query with fields, aliases and where
+			Query qStatistics(columns, wId);
+			// Set limit
+			qStatistics.limit(loadData->getReadBlockSize());
+			// Set sort
+			Sort* sort = new Sort("id");
+			qStatistics.sort(sort);
+
+			// Query the statistics_history tbale and get a ReadingSet result
+			readings = loadData->getStorageClient()->queryTableToReadings("statistics_history",
+										      qStatistics);
+		}
+	}
+	catch (ReadingSetException* e)
+	{
+		Logger::getLogger()->error("SendingProcess loadData(): ReadingSet Exception '%s'", e->what());
+	}
+	catch (std::exception& e)
+	{
+		Logger::getLogger()->error("SendingProcess loadData(): Generic Exception: '%s'", e.what());
+	}
+	return readings;
+}
+
 /**
  * Thread to load data from the storage layer.
  *
+ * First stage of the pipeline: takes a free slot of the data buffer,
+ * loads the next block of data into it and passes it to the filter
+ * thread.
+ *
  * @param loadData    pointer to SendingProcess instance
  */
 static void loadDataThread(SendingProcess *loadData)
 {
-        unsigned int    readIdx = 0;
+	// Wait in the storage service for new readings rather than sleeping
+	bool		waitSupported = loadData->getDataSourceType().compare("statistics") != 0;
+	unsigned long	slot;
+	steady_clock::time_point lastTimingLog = steady_clock::now();
 
 	// Read from the storage last Id already sent
 	loadData->setLastFetchId(loadData->getLastSentId());
 
 	while (loadData->isRunning())
-        {
-                if (readIdx >= memoryBufferSize)
-                {
-                        readIdx = 0;
-                }
-
-		/**
-		 * Check whether m_buffer[readIdx] is NULL or contains a ReadingSet
-		 *
-		 * Access is protected by a mutex.
-		 */
-                readMutex.lock();
-                ReadingSet *canLoad = loadData->m_buffer.at(readIdx);
-                readMutex.unlock();
-
-                if (canLoad)
-                {
-#if VERBOSE_LOG
-			Logger::getLogger()->info("SendingProcess loadDataThread: "
-						  "('%s' stream id %d), readIdx %u, buffer is NOT empty, waiting ...",
-						  loadData->getDataSourceType().c_str(),
-						  loadData->getStreamId(),
-						  readIdx);
-#endif
-
-	                Logger::getLogger()->info("SendingProcess is faster to load data than the destination to process them,"
-	                                          " so all the %lu in memory buffers are full and the load thread should wait until at least a buffer is freed.",
-	                                          loadData->getMemoryBufferSize());
-
-	                if (loadData->isRunning()) {
-
-				// Load thread is put on hold, only if the execution should proceed
-				unique_lock<mutex> lock(waitMutex);
-				cond_var.wait(lock);
-			}
-                }
-                else
-                {
-                        // Load data from storage client (id >= lastId and getReadBlockSize() rows)
-			ReadingSet* readings = NULL;
-			try
+	{
+		if (!freeSlots->tryPop(slot))
+		{
+			Logger::getLogger()->info("SendingProcess is faster to load data than the destination to process them,"
+						  " so all the %lu in memory buffers are full and the load thread should wait until at least a buffer is freed.",
+						  loadData->getMemoryBufferSize());
+			if (!freeSlots->pop(slot))
 			{
-				bool isReading = !loadData->getDataSourceType().compare("statistics") ? false : true; 
-				//high_resolution_clock::time_point t1 = high_resolution_clock::now();
-				if (isReading)
-				{
-					// Read from storage all readings with id > last sent id
-					unsigned long lastReadId = loadData->getLastFetchId() + 1;
-					readings = loadData->getStorageClient()->readingFetch(lastReadId,
-											      loadData->getReadBlockSize());
-				}
-				else
-				{
-					// SELECT id,
-					//	  key AS asset_code,
-					//	  key AS read_key,
-					//	  ts,
-					//	  history_ts AS user_ts,
-					//	  value
-					// FROM statistic_history
-					// WHERE id > lastId
-					// ORDER BY ID ASC
-					// LIMIT blockSize
-					const Condition conditionId(GreaterThan);
-					// WHERE id > lastId
-					Where* wId = new Where("id",
-								conditionId,
-								to_string(loadData->getLastFetchId()));
-					vector<Returns *> columns;
-					// Add colums and needed aliases
-					columns.push_back(new Returns("id"));
-					columns.push_back(new Returns("key", "asset_code"));
-					columns.push_back(new Returns("key", "read_key"));
-					columns.push_back(new Returns("ts"));
-
-					Returns *tmpReturn = new Returns("history_ts", "user_ts");
-					tmpReturn->timezone("utc");
-					columns.push_back(tmpReturn);
-
-					columns.push_back(new Returns("value"));
-					// Build the query with fields, aliases and where
-					Query qStatistics(columns, wId);
-					// Set limit
-					qStatistics.limit(loadData->getReadBlockSize());
-					// Set sort
-					Sort* sort = new Sort("id");
-					qStatistics.sort(sort);
-
-					// Query the statistics_history tbale and get a ReadingSet result
-					readings = loadData->getStorageClient()->queryTableToReadings("statistics_history",
-												      qStatistics);
-				}
-				//high_resolution_clock::time_point t2 = high_resolution_clock::now();
-				//auto duration = duration_cast<microseconds>( t2 - t1 ).count();
+				break;
 			}
-			catch (ReadingSetException* e)
+		}
+
+		// Load data from storage client (id >= lastId and getReadBlockSize() rows)
+		ReadingSet* readings = NULL;
+		while (loadData->isRunning())
+		{
+			steady_clock::time_point start = steady_clock::now();
+			readings = fetchData(loadData);
+
+			// Data fetched from storage layer
+			if (readings != NULL && readings->getCount())
 			{
-				Logger::getLogger()->error("SendingProcess loadData(): ReadingSet Exception '%s'", e->what());
+				recordTiming("load", loadTime, start, lastTimingLog);
+				break;
 			}
-			catch (std::exception& e)
+
+			// Free empty result set
+			bool fetched = readings != NULL;
+			if (readings)
 			{
-				Logger::getLogger()->error("SendingProcess loadData(): Generic Exception: '%s'", e.what());
+				delete readings;
+				readings = NULL;
 			}
-
-			// Data fetched from storage layer
-			if (readings != NULL && readings->getCount())
+			// No data read: wait for readings to be appended
+			if (fetched && waitSupported)
 			{
-				//Update last fetched reading Id
-				loadData->setLastFetchId(readings->getLastId());
-
-				/**
-				 * Set last fetched reading Id for buffer index
-				 * This is used by send thread whiule updating the next
-				 * position to read from db.
-				 * NOTE:
-				 * The saved position is not ffected by the filters
-				 * called below which can skip some or all input readings.
-				 */
-				loadData->m_last_read_id.at(readIdx) = readings->getLastId();
-
-				/**
-				 * The buffer access is protected by a mutex
-				 */
-                	        readMutex.lock();
-
-				/**
-				 * Set now the buffer at index to ReadingSet pointer
-				 * Note: the ReadingSet pointer will be deleted by
-				 * - the sending thread when processin it
-				 * OR
-				 * at program exit by a cleanup routine
-				 *					
-				 * Note: the readings set can be optionally filtered
-				 * if plugin filters are set.
-				 */
-
-				// Apply filters to the reading set
-				if (loadData->filterPipeline)
+				try
 				{
-					FilterPlugin *firstFilter = loadData->filterPipeline->getFirstFilterPlugin();
-					if (firstFilter)
-					{
-						// Make the load readIdx available to filters
-						loadData->setLoadBufferIndex(readIdx);
-						// Apply filters
-						applyFilters(loadData, readings);
-					}
-					else
-					{
-						// No filters: just set buffer with current data
-						loadData->m_buffer.at(readIdx) = readings;
-					}
+					loadData->getStorageClient()->readingWait(loadData->getLastFetchId(),
+										  TASK_FETCH_SLEEP);
+					continue;
 				}
-				else
+				catch (ReadingWaitUnsupported& e)
 				{
-					// No filters: just set buffer with current data
-					loadData->m_buffer.at(readIdx) = readings;
+					Logger::getLogger()->warn("SendingProcess loadData(): waiting for readings is not available, "
+								  "polling for readings instead");
+					waitSupported = false;
 				}
-
-				// Update asset tracker table/cache, if required
-				vector<Reading *> *vec = loadData->m_buffer.at(readIdx)->getAllReadingsPtr();
-				for (vector<Reading *>::iterator it = vec->begin(); it != vec->end(); ++it)
+				catch (std::exception& e)
 				{
-					Reading *reading = *it;
-					AssetTrackingTuple tuple(loadData->getName(), loadData->getPluginName(), reading->getAssetName(), "Egress");
-					if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
-					{
-						AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
-						Logger::getLogger()->info("loadDataThread(): Adding new asset tracking tuple seen during readings' egress: %s", tuple.assetToString().c_str());
-					}
+					// Refused or failed, waited for again after the sleep
 				}
+			}
+			// Error or no data read: just wait
+			// TODO: add increments from 1 to TASK_SLEEP_MAX_INCREMENTS
+			this_thread::sleep_for(chrono::milliseconds(TASK_FETCH_SLEEP));
+		}
+		if (readings == NULL)
+		{
+			break;
+		}
 
-				readMutex.unlock();
+		//Update last fetched reading Id
+		loadData->setLastFetchId(readings->getLastId());
 
-				readIdx++;
+		/**
+		 * Set last fetched reading Id for the buffer slot
+		 * This is used by send thread while updating the next
+		 * position to read from db.
+		 * NOTE:
+		 * The saved position is not affected by the filters
+		 * which can skip some or all input readings.
+		 */
+		loadData->m_last_read_id.at(slot) = readings->getLastId();
+		loadData->m_buffer.at(slot) = readings;
 
-				// Unlock the sendData thread
-				unique_lock<mutex> lock(waitMutex);
-				cond_var.notify_one();
-			}
-			else
-			{
-				// Free empty result set
-				if (readings)
-				{
-					delete readings;
-				}
-				// Error or no data read: just wait
-				// TODO: add increments from 1 to TASK_SLEEP_MAX_INCREMENTS
-				this_thread::sleep_for(chrono::milliseconds(TASK_FETCH_SLEEP));
-			}
-                }
-        }
+		// Pass the slot to the filter thread
+		loadedSlots->push(slot);
+	}
 
 #if VERBOSE_LOG
 	Logger::getLogger()->info("SendingProcess loadData thread: Last ID '%s' read is %lu",
 				  loadData->getDataSourceType().c_str(),
 				  loadData->getLastFetchId());
 #endif
-
-	/**
-	 * The loop is over: unlock the sendData thread
-	 */
-	unique_lock<mutex> lock(waitMutex);
-	cond_var.notify_one();
 }
 
 /**
- * Thread to send data to historian service
+ * Thread to apply the filters to the loaded data.
  *
- * @param loadData    pointer to SendingProcess instance
+ * Second stage of the pipeline: the filters run on a block while the
+ * next block is loaded and the previous one is sent. The filtered
+ * readings replace the loaded ones in the slot of the data buffer,
+ * which is then passed to the send thread.
+ *
+ * @param filterData    pointer to SendingProcess instance
  */
-static void sendDataThread(SendingProcess *sendData)
+static void filterDataThread(SendingProcess *filterData)
 {
-	unsigned long totSent = 0;
-	unsigned int  sendIdx = 0;
+	unsigned long	slot;
+	steady_clock::time_point lastTimingLog = steady_clock::now();
 
-	bool slept;
-	long sleep_time = TASK_SEND_SLEEP;
-	int sleep_num_increments = 0;
-
-        while (sendData->isRunning())
-        {
-		slept = false;
+	while (filterData->isRunning() && loadedSlots->pop(slot))
+	{
+		steady_clock::time_point start = steady_clock::now();
 
-                if (sendIdx >= memoryBufferSize)
+		/**
+		 * Note: the ReadingSet pointer will be deleted by
+		 * - the sending thread when processin it
+		 * OR
+		 * at program exit by a cleanup routine
+		 *
+		 * The filters take the loaded readings and set the
+		 * slot with the filtered ones, which may be none.
+		 */
+		if (filterData->filterPipeline &&
+		    filterData->filterPipeline->getFirstFilterPlugin())
 		{
+			ReadingSet* readings = filterData->m_buffer.at(slot);
+			filterData->m_buffer.at(slot) = NULL;
+			// Make the slot available to filters
+			filterData->setLoadBufferIndex(slot);
+			// Apply filters
+			applyFilters(filterData, readings);
+		}
 
-			if (sendData->getUpdateDb())
+		// Update asset tracker table/cache, if required
+		ReadingSet* filtered = filterData->m_buffer.at(slot);
+		if (filtered)
+		{
+			vector<Reading *> *vec = filtered->getAllReadingsPtr();
+			AssetTracker *tracker = AssetTracker::getAssetTracker();
+			InternedName plugin(filterData->getPluginName()), event("Egress");
+			for (vector<Reading *>::iterator it = vec->begin(); it != vec->end(); ++it)
 			{
-				// Update counters to Database
-				sendData->updateDatabaseCounters();
+				Reading *reading = *it;
+				if (!tracker->checkAssetTrackingCache(plugin, reading->getInternedAssetName(), event))
+				{
+					AssetTrackingTuple tuple(filterData->getName(), filterData->getPluginName(), reading->getAssetName(), "Egress");
+					tracker->addAssetTrackingTuple(tuple);
+					Logger::getLogger()->info("filterDataThread(): Adding new asset tracking tuple seen during readings' egress: %s", tuple.assetToString().c_str());
+				}
+			}
+		}
+		recordTiming("filter", filterTime, start, lastTimingLog);
+
+		// Pass the slot to the send thread
+		filteredSlots->push(slot);
+	}
+}
+
+/**
+ * Update counters to Database, if readings have been sent
+ *
+ * @param sendData    pointer to SendingProcess instance
+ */
+static void updateCounters(SendingProcess *sendData)
+{
+	if (sendData->getUpdateDb())
+	{
+		// Update counters to Database
+		sendData->updateDatabaseCounters();
 
-				// Reset current sent readings
-				sendData->resetSentReadings();	
+		// Reset current sent readings
+		sendData->resetSentReadings();	
 
-				// DB update done
-				sendData->setUpdateDb(false);
-                        }
+		// DB update done
+		sendData->setUpdateDb(false);
+	}
+}
 
-			// Reset send index
-			sendIdx = 0;
-		}
+/**
+ * Thread to send data to historian service
+ *
+ * Last stage of the pipeline: sends the block in each filtered slot,
+ * retrying until it is sent, then frees the slot for the load thread.
+ *
+ * @param loadData    pointer to SendingProcess instance
+ */
+static void sendDataThread(SendingProcess *sendData)
+{
+	unsigned long totSent = 0;
+	unsigned long slot;
+	unsigned long blocks = 0;	// Blocks sent since the counters were updated
+	steady_clock::time_point lastTimingLog = steady_clock::now();
 
-		/*
-		 * Check whether m_buffer[sendIdx] is NULL or contains ReadinSet data.
-		 * Access is protected by a mutex.
-		 */
-                readMutex.lock();
-                ReadingSet *canSend = sendData->m_buffer.at(sendIdx);
-                readMutex.unlock();
+	long sleep_time = TASK_SEND_SLEEP;
+	int sleep_num_increments = 0;
 
-                if (canSend == NULL)
-                {
+	while (sendData->isRunning())
+	{
+		if (!filteredSlots->tryPop(slot))
+		{
 #if VERBOSE_LOG
-                        Logger::getLogger()->info("SendingProcess sendDataThread: " \
-                                                  "('%s' stream id %d), sendIdx %u, buffer is empty, waiting ...",
+			Logger::getLogger()->info("SendingProcess sendDataThread: " \
+						  "('%s' stream id %d), buffer is empty, waiting ...",
 						  sendData->getDataSourceType().c_str(),
-                                                  sendData->getStreamId(),
-                                                  sendIdx);
+						  sendData->getStreamId());
 #endif
+			// Nothing to send: update the counters while waiting
+			updateCounters(sendData);
 
-			if (sendData->getUpdateDb())
+			if (!filteredSlots->pop(slot))
 			{
-                                // Update counters to Database
-				sendData->updateDatabaseCounters();
-
-				// Reset current sent readings
-				sendData->resetSentReadings();	
-
-				// DB update done
-				sendData->setUpdateDb(false);
+				break;
 			}
+		}
 
-			if (sendData->isRunning())
-			{
-				// Send thread is put on hold, only if the execution shoule proceed
-				unique_lock<mutex> lock(waitMutex);
-				cond_var.wait(lock);
-			}
-                }
-                else
-                {
+		bool sent = false;
+		steady_clock::time_point start = steady_clock::now();
+		while (!sent && sendData->isRunning())
+		{
 			/**
 			 * Send the buffer content ( const vector<Readings *>& )
 			 * to historian server via m_plugin->send(data).
 			 * Readings data by getAllReadings() will be
 			 * transformed using historian protocol and then sent to destination.
 			 */
-
-			bool emptyReadings = sendData->m_buffer[sendIdx]->getCount() == 0;
+			ReadingSet* data = sendData->m_buffer.at(slot);
+			bool emptyReadings = data == NULL || data->getCount() == 0;
 			uint32_t sentReadings = 0;
 			bool processUpdate = false;
 
 			if (!emptyReadings)
 			{
 				// We have some readings to send
-				const vector<Reading *> &readingData = sendData->m_buffer.at(sendIdx)->getAllReadings();
+				const vector<Reading *> &readingData = data->getAllReadings();
 				sentReadings = sendData->m_plugin->send(readingData);
 				// Check sent readings result
 				if (sentReadings)
@@ -445,7 +506,7 @@ static void sendDataThread(SendingProcess *sendData)
 			{
 				exitCode = 0;
 				// We have an empty readings set: check last id
-				if (sendData->m_last_read_id.at(sendIdx) > 0)
+				if (sendData->m_last_read_id.at(slot) > 0)
 				{
 					processUpdate = true;
 				}
@@ -458,97 +519,96 @@ static void sendDataThread(SendingProcess *sendData)
 				/** Sending done */
 				sendData->setUpdateDb(true);
 
-				/**
-				 * 1- emptying data in m_buffer[sendIdx].
-				 * The buffer access is protected by a mutex.
-				 */
-				readMutex.lock();
-
 				// Update last sent reading Id using the last id of the unfiltered readings buffer
-				sendData->setLastSentId(sendData->m_last_read_id.at(sendIdx));
+				sendData->setLastSentId(sendData->m_last_read_id.at(slot));
 
 				// Free buffer
-				delete sendData->m_buffer.at(sendIdx);
-				sendData->m_buffer.at(sendIdx) = NULL;
+				delete data;
+				sendData->m_buffer.at(slot) = NULL;
 				// Reset buffer last id
-				sendData->m_last_read_id.at(sendIdx) = 0;
+				sendData->m_last_read_id.at(slot) = 0;
 
-				/** 2- Update sent counter (memory only) */
+				/** Update sent counter (memory only) */
 				sendData->updateSentReadings(sentReadings);
 
 				// numReadings sent so far
 				totSent += sentReadings;
 
-				readMutex.unlock();
-
-				sendIdx++;
-
-				// Unlock the loadData thread
-				unique_lock<mutex> lock(waitMutex);
-				cond_var.notify_one();
+				recordTiming("send", sendTime, start, lastTimingLog);
+				sent = true;
 			}
 			else
 			{
 				Logger::getLogger()->debug("SendingProcess sendDataThread: Error while sending " \
-							   "('%s' stream id %d), sendIdx %u, N. (%d readings), " \
+							   "('%s' stream id %d), slot %lu, N. (%d readings), " \
 							   ", last reading id in buffer %ld",
 							   sendData->getDataSourceType().c_str(),
 							   sendData->getStreamId(),
-							   sendIdx,
-							   sendData->m_buffer[sendIdx]->getCount(),
-							   sendData->m_last_read_id.at(sendIdx));
-
-				if (sendData->getUpdateDb())
-				{
-					// Update counters to Database
-					sendData->updateDatabaseCounters();
+							   slot,
+							   data ? data->getCount() : 0,
+							   sendData->m_last_read_id.at(slot));
 
-					// Reset current sent readings
-					sendData->resetSentReadings();	
-
-					// DB update done
-					sendData->setUpdateDb(false);
-				}
+				updateCounters(sendData);
 
 				// Error: just wait & continue
 				this_thread::sleep_for(chrono::milliseconds(sleep_time));
-				slept = true;
-			}
-                }
 
-		// Handles the sleep time, it is doubled every time up to a limit
-		if (slept)
-		{
-			sleep_num_increments += 1;
-			sleep_time *= 2;
-			if (sleep_num_increments >= TASK_SLEEP_MAX_INCREMENTS)
-			{
-				sleep_time = TASK_SEND_SLEEP;
-				sleep_num_increments = 0;
+				// Handles the sleep time, it is doubled every time up to a limit
+				sleep_num_increments += 1;
+				sleep_time *= 2;
+				if (sleep_num_increments >= TASK_SLEEP_MAX_INCREMENTS)
+				{
+					sleep_time = TASK_SEND_SLEEP;
+					sleep_num_increments = 0;
+				}
 			}
 		}
+		if (!sent)
+		{
+			// Stopped: the slot is freed with the data buffer
+			break;
+		}
+
+		// Pass the slot back to the load thread
+		freeSlots->push(slot);
 
-        }
+		// Update the counters once every round of the buffer
+		if (++blocks >= memoryBufferSize)
+		{
+			updateCounters(sendData);
+			blocks = 0;
+		}
+	}
 #if VERBOSE_LOG
 	Logger::getLogger()->info("SendingProcess sendData thread: sent %lu total '%s'",
 				  totSent,
 				  sendData->getDataSourceType().c_str());
 #endif
 
-	if (sendData->getUpdateDb())
-	{
-                // Update counters to Database
-		sendData->updateDatabaseCounters();
-
-                // Reset current sent readings
-		sendData->resetSentReadings();
+	updateCounters(sendData);
+}
 
-                sendData->setUpdateDb(false);
-        }
+/**
+ * Log the time taken by a stage of the pipeline for a block of data,
+ * in microseconds
+ *
+ * @param stage		The name of the stage
+ * @param timing	The timing of the stage
+ */
+static void logStageTiming(const char *stage, const LatencyHistogram& timing)
+{
+	string json;
+	timing.asJSON(json);
+	Logger::getLogger()->info("SendingProcess %s stage timing: %s", stage, json.c_str());
+}
 
-	/**
-	 * The loop is over: unlock the loadData thread
-	 */
-	unique_lock<mutex> lock(waitMutex);
-	cond_var.notify_one();
+/**
+ * Log the time taken by each stage of the pipeline, once the threads
+ * of the stages have ended
+ */
+static void logPipelineTiming()
+{
+	logStageTiming("load", loadTime);
+	logStageTiming("filter", filterTime);
+	logStageTiming("send", sendTime);
 }
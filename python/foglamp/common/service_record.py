@@ -25,6 +25,7 @@ class ServiceRecord(object):
         Core = 2
         Southbound = 3
         Notification = 4
+        Northbound = 5
 
     class Status(IntEnum):
         """Enumeration for Service Status"""
@@ -42,9 +43,10 @@ class ServiceRecord(object):
         # TODO: tell allowed service status?
         pass
 
-    __slots__ = ['_id', '_name', '_type', '_protocol', '_address', '_port', '_management_port', '_status']
+    __slots__ = ['_id', '_name', '_type', '_protocol', '_address', '_port', '_management_port', '_status',
+                 '_socket']
 
-    def __init__(self, s_id, s_name, s_type, s_protocol, s_address, s_port, m_port):
+    def __init__(self, s_id, s_name, s_type, s_protocol, s_address, s_port, m_port, s_socket=None):
         self._id = s_id
         self._name = s_name
         self._type = self.valid_type(s_type)  # check with ServiceRecord.Type, if not a valid type raise error
@@ -54,6 +56,7 @@ class ServiceRecord(object):
         if s_port is not None:
             self._port = int(s_port)
         self._management_port = int(m_port)
+        self._socket = s_socket
         self._status = ServiceRecord.Status.Running
 
     def __repr__(self):
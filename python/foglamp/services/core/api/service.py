@@ -130,6 +130,7 @@ async def add_service(request):
              curl -X POST http://localhost:8081/foglamp/service -d '{"name": "DHT 11", "plugin": "dht11", "type": "south", "enabled": true}'
              curl -sX POST http://localhost:8081/foglamp/service -d '{"name": "Sine", "plugin": "sinusoid", "type": "south", "enabled": true, "config": {"dataPointsPerSec": {"value": "10"}}}' | jq
              curl -X POST http://localhost:8081/foglamp/service -d '{"name": "NotificationServer", "type": "notification", "enabled": true}' | jq
+             curl -X POST http://localhost:8081/foglamp/service -d '{"name": "PI Server", "plugin": "omf", "type": "north", "enabled": true}' | jq
     """
 
     try:
@@ -153,12 +154,10 @@ async def add_service(request):
             raise web.HTTPBadRequest(reason='Missing type property in payload.')
 
         service_type = str(service_type).lower()
-        if service_type == 'north':
-            raise web.HTTPNotAcceptable(reason='north type is not supported for the time being.')
-        if service_type not in ['south', 'notification']:
-            raise web.HTTPBadRequest(reason='Only south and notification type are supported.')
-        if plugin is None and service_type == 'south':
-            raise web.HTTPBadRequest(reason='Missing plugin property for type south in payload.')
+        if service_type not in ['south', 'north', 'notification']:
+            raise web.HTTPBadRequest(reason='Only south, north and notification type are supported.')
+        if plugin is None and service_type in ['south', 'north']:
+            raise web.HTTPBadRequest(reason='Missing plugin property for type {} in payload.'.format(service_type))
         if plugin and utils.check_reserved(plugin) is False:
             raise web.HTTPBadRequest(reason='Invalid plugin property in payload.')
 
@@ -199,6 +198,20 @@ async def add_service(request):
             except Exception as ex:
                 _logger.exception("Failed to fetch plugin configuration. %s", str(ex))
                 raise web.HTTPInternalServerError(reason='Failed to fetch plugin configuration')
+        elif service_type == 'north':
+            # The north service runs C plugins only
+            try:
+                plugin_config = load_c_plugin(plugin, service_type)
+            except TypeError as ex:
+                _logger.exception(str(ex))
+                raise web.HTTPBadRequest(reason=str(ex))
+            except Exception as ex:
+                _logger.exception("Failed to fetch plugin configuration. %s", str(ex))
+                raise web.HTTPNotFound(reason='Plugin "{}" not found.'.format(plugin))
+            if not plugin_config:
+                raise web.HTTPNotFound(reason='Plugin "{}" not found.'.format(plugin))
+            process_name = 'north_c'
+            script = '["services/north_c"]'
         elif service_type == 'notification':
             process_name = 'notification_c'
             script = '["services/notification_c"]'
@@ -236,7 +249,7 @@ async def add_service(request):
             for ps in res['rows']:
                 if 'notification_c' in ps['process_name']:
                     raise web.HTTPBadRequest(reason='A Notification service schedule already exists.')
-        elif service_type == 'south':
+        else:
             try:
                 # Create a configuration category from the configuration defined in the plugin
                 category_desc = plugin_config['plugin']['description']
@@ -244,9 +257,10 @@ async def add_service(request):
                                                  category_description=category_desc,
                                                  category_value=plugin_config,
                                                  keep_original_items=True)
-                # Create the parent category for all South services
-                await config_mgr.create_category("South", {}, "South microservices", True)
-                await config_mgr.create_child_category("South", [name])
+                # Create the parent category for all South, or North, services
+                parent = service_type.capitalize()
+                await config_mgr.create_category(parent, {}, "{} microservices".format(parent), True)
+                await config_mgr.create_child_category(parent, [name])
 
                 # If config is in POST data, then update the value for each config item
                 if config is not None:
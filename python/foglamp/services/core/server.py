@@ -964,7 +964,7 @@ class Server:
             curl -d '{"type": "Storage", "name": "Storage Services", "address": "127.0.0.1", "service_port": 8090,
                 "management_port": 1090, "protocol": "https"}' -X POST http://localhost:<core mgt port>/foglamp/service
 
-            service_port in payload is optional
+            service_port and service_socket, a Unix domain socket the service also listens on, in payload are optional
         """
 
         try:
@@ -976,6 +976,7 @@ class Server:
             service_port = data.get('service_port', None)
             service_management_port = data.get('management_port', None)
             service_protocol = data.get('protocol', 'http')
+            service_socket = data.get('service_socket', None)
 
             if not (service_name.strip() or service_type.strip() or service_address.strip()
                     or service_management_port.strip() or not service_management_port.isdigit()):
@@ -990,7 +991,8 @@ class Server:
 
             try:
                 registered_service_id = ServiceRegistry.register(service_name, service_type, service_address,
-                                                                   service_port, service_management_port, service_protocol)
+                                                                   service_port, service_management_port, service_protocol,
+                                                                   socket=service_socket)
                 try:
                     if not cls._storage_client_async is None:
                         cls._audit = AuditLogger(cls._storage_client_async)
@@ -1096,6 +1098,8 @@ class Server:
             svc["status"] = ServiceRecord.Status(int(service._status)).name.lower()
             if service._port:
                 svc["service_port"] = service._port
+            if service._socket:
+                svc["service_socket"] = service._socket
             services.append(svc)
 
         return web.json_response({"services": services})
@@ -0,0 +1 @@
+INSERT INTO scheduled_processes ( name, script ) VALUES ( 'north_c',   '["services/north_c"]' ) ON CONFLICT DO NOTHING;
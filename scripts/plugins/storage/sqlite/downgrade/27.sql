@@ -0,0 +1 @@
+DELETE FROM scheduled_processes WHERE name = 'north_c' AND name NOT IN (SELECT process_name FROM schedules);
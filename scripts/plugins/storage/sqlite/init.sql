@@ -674,6 +674,10 @@ INSERT INTO foglamp.scheduled_processes ( name, script ) VALUES ( 'certificate c
 INSERT INTO foglamp.scheduled_processes (name, script) VALUES ('backup',  '["tasks/backup"]'  );
 INSERT INTO foglamp.scheduled_processes (name, script) VALUES ('restore', '["tasks/restore"]' );
 
+-- Services
+--
+INSERT INTO foglamp.scheduled_processes (name, script) VALUES ('north_c', '["services/north_c"]' );
+
 --
 -- Schedules
 --
@@ -0,0 +1 @@
+INSERT OR IGNORE INTO scheduled_processes ( name, script ) VALUES ( 'north_c',   '["services/north_c"]' );
@@ -0,0 +1,132 @@
+/*
+ * FogLAMP ingest queue benchmark.
+ *
+ * Compares the throughput of the original mutex protected vector
+ * ingest queue with the lock-free MPSCQueue for 1 to 16 producers.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <reading.h>
+#include <mpsc_queue.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define READINGS_PER_RUN	4000000
+
+/**
+ * The queue as it was before, a vector swapped under a mutex
+ */
+class VectorQueue {
+	public:
+		VectorQueue() : m_queue(new vector<Reading *>()) {};
+		~VectorQueue() { delete m_queue; };
+		void	push(Reading *reading)
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_queue->push_back(reading);
+		};
+		size_t	drain()
+		{
+			vector<Reading *> *newQ = new vector<Reading *>();
+			vector<Reading *> *data;
+			{
+				lock_guard<mutex> guard(m_mutex);
+				data = m_queue;
+				m_queue = newQ;
+			}
+			size_t n = data->size();
+			delete data;
+			return n;
+		};
+	private:
+		mutex			m_mutex;
+		vector<Reading *>	*m_queue;
+};
+
+/**
+ * The lock-free queue used by Ingest
+ */
+class RingQueue {
+	public:
+		RingQueue() : m_queue(65536) {};
+		void	push(Reading *reading)
+		{
+			while (!m_queue.push(reading))
+				this_thread::yield();
+		};
+		size_t	drain()
+		{
+			size_t queued = m_queue.size(), n = 0;
+			vector<Reading *> data;
+			data.reserve(queued);
+			Reading *reading;
+			while (queued-- > 0 && m_queue.pop(reading))
+			{
+				data.push_back(reading);
+				n++;
+			}
+			return n;
+		};
+	private:
+		MPSCQueue<Reading *>	m_queue;
+};
+
+/**
+ * Run the producers and a single consumer, return readings per second
+ */
+template <class Q> double run(int producers, Reading *reading)
+{
+	Q queue;
+	atomic<bool> done(false);
+	size_t perProducer = READINGS_PER_RUN / producers;
+	size_t total = perProducer * producers;
+
+	auto start = chrono::steady_clock::now();
+	thread consumer([&]() {
+		size_t received = 0;
+		while (received < total)
+		{
+			received += queue.drain();
+		}
+		done = true;
+	});
+	vector<thread> threads;
+	for (int i = 0; i < producers; i++)
+	{
+		threads.push_back(thread([&]() {
+			for (size_t j = 0; j < perProducer; j++)
+				queue.push(reading);
+		}));
+	}
+	for (auto& t : threads)
+		t.join();
+	consumer.join();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return total / elapsed.count();
+}
+
+int main()
+{
+	DatapointValue value(1.0);
+	Reading reading("bench", new Datapoint("value", value));
+
+	cout << setw(10) << "producers" << setw(20) << "mutex readings/s"
+		<< setw(20) << "mpsc readings/s" << setw(10) << "speedup" << endl;
+	for (int producers = 1; producers <= 16; producers *= 2)
+	{
+		double vec = run<VectorQueue>(producers, &reading);
+		double ring = run<RingQueue>(producers, &reading);
+		cout << setw(10) << producers << setw(20) << fixed << setprecision(0) << vec
+			<< setw(20) << ring << setw(10) << setprecision(2) << ring / vec << endl;
+	}
+	return 0;
+}
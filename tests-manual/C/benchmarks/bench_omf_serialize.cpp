@@ -0,0 +1,172 @@
+/*
+ * FogLAMP OMF data message serialisation benchmark.
+ *
+ * Measures the throughput and the peak memory used to build the
+ * gzip compressed payload of an OMF data message for blocks of 1k,
+ * 10k and 50k readings, by writing the whole JSON text into an
+ * ostringstream, copying it and compressing it with compress_string,
+ * as OMF::sendToServer did previously, and by the OMFDataWriter with
+ * and without a copy of the uncompressed text.
+ *
+ * Each test is run in a child process so that its peak resident
+ * set size can be measured.
+ *
+ * Copyright (c) 2018 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <omf.h>
+#include <reading_set.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define RUNS	10
+#define TYPE_ID	1
+
+/**
+ * A sender that is never used, the OMF class needs one
+ */
+class NullSender : public HttpSender
+{
+	public:
+		int sendRequest(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload) { return 204; };
+		string getHostPort() { return ""; };
+};
+
+static string readingsJSON(int count)
+{
+	ostringstream ss;
+	ss << "{ \"count\" : " << count << ", \"rows\" : [ ";
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ \"id\" : " << i + 1 << ", \"asset_code\" : \"accelerometer\", "
+			<< "\"read_key\" : \"5b3be500-ff95-41ae-b5a4-cc99d08bef40\", "
+			<< "\"reading\" : { \"x\" : " << i << ".5, \"y\" : 2.5, \"z\" : 3.5, "
+			<< "\"status\" : \"running\", \"count\" : " << i << " }, "
+			<< "\"user_ts\" : \"2018-09-03 18:40:00.123456+00:00\", "
+			<< "\"ts\" : \"2018-09-03 18:40:00.123456+00:00\" }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+/**
+ * Return the current resident set size in kilobytes
+ */
+static long currentRSS()
+{
+	long pages = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp)
+	{
+		if (fscanf(fp, "%*s %ld", &pages) != 1)
+			pages = 0;
+		fclose(fp);
+	}
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Build the payload as OMF::sendToServer did before the OMFDataWriter,
+ * return the bytes of uncompressed JSON text
+ */
+static size_t stringStream(const vector<Reading *>& readings)
+{
+	NullSender sender;
+	OMF omf(sender, "/", TYPE_ID, "token");
+	ostringstream jsonData;
+	jsonData << "[";
+	for (auto elem = readings.begin(); elem != readings.end(); ++elem)
+	{
+		jsonData << OMFData(**elem, TYPE_ID).OMFdataVal() <<
+			    (elem < (readings.end() - 1 ) ? ", " : "");
+	}
+	jsonData << "]";
+	string json = jsonData.str();
+	string json_not_compressed = json;
+	json = omf.compress_string(json);
+	return json_not_compressed.length();
+}
+
+static size_t writer(const vector<Reading *>& readings, bool keepText)
+{
+	OMFDataWriter writer(true, keepText);
+	for (auto reading : readings)
+	{
+		writer.append(*reading, TYPE_ID);
+	}
+	writer.finish();
+	return writer.length();
+}
+
+static size_t writerKeepText(const vector<Reading *>& readings)
+{
+	return writer(readings, true);
+}
+
+static size_t writerNoText(const vector<Reading *>& readings)
+{
+	return writer(readings, false);
+}
+
+/**
+ * Run a test in a child process and report the throughput and peak memory
+ */
+static void run(const char *name, size_t (*test)(const vector<Reading *>&),
+		const vector<Reading *>& readings)
+{
+	cout << flush;
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		long base = currentRSS();
+		size_t bytes = 0;
+		auto t1 = chrono::steady_clock::now();
+		for (int i = 0; i < RUNS; i++)
+		{
+			bytes += test(readings);
+		}
+		chrono::duration<double> secs = chrono::steady_clock::now() - t1;
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		cout << setw(32) << left << name
+			<< setw(12) << right << fixed << setprecision(2) << (secs.count() * 1000) / RUNS
+			<< setw(12) << fixed << setprecision(1) << bytes / secs.count() / (1024 * 1024)
+			<< setw(16) << usage.ru_maxrss - base << endl;
+		exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+}
+
+int main(int argc, char **argv)
+{
+	int sizes[] = { 1000, 10000, 50000 };
+	for (auto size : sizes)
+	{
+		ReadingSet set(readingsJSON(size));
+		const vector<Reading *>& readings = set.getAllReadings();
+		cout << size << " readings, " << stringStream(readings) / 1024 << "KB of OMF JSON" << endl;
+		cout << setw(32) << left << "Test" << setw(12) << right << "ms/block"
+			<< setw(12) << "MB/sec" << setw(16) << "Peak RSS KB" << endl;
+		run("ostringstream + compress_string", stringStream, readings);
+		run("OMFDataWriter, text kept", writerKeepText, readings);
+		run("OMFDataWriter", writerNoText, readings);
+		cout << endl;
+	}
+	return 0;
+}
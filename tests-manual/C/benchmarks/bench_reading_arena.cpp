@@ -0,0 +1,136 @@
+/*
+ * FogLAMP reading arena benchmark.
+ *
+ * Counts the heap allocations made and measures the throughput of
+ * creating and deleting a batch of 10k readings, and of building a
+ * ReadingSet from a JSON document of 10k readings, with and without
+ * a ReadingArena.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <reading.h>
+#include <reading_set.h>
+#include <reading_arena.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define BATCH_SIZE	10000
+#define RUNS		20
+
+/*
+ * Count every call to malloc, this includes those made by operator new
+ */
+static atomic<unsigned long> mallocs(0);
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size)
+{
+	mallocs++;
+	return __libc_malloc(size);
+}
+
+/**
+ * Create and delete a batch of readings as a south plugin and the
+ * ingest thread would
+ */
+static void batch()
+{
+	vector<Reading *> readings;
+	readings.reserve(BATCH_SIZE);
+	for (int i = 0; i < BATCH_SIZE; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue x(1.0 * i), y(2.0 * i), z(3.0 * i);
+		DatapointValue status(string("a status value longer than the SSO buffer"));
+		values.push_back(new Datapoint("x", x));
+		values.push_back(new Datapoint("y", y));
+		values.push_back(new Datapoint("z", z));
+		values.push_back(new Datapoint("status", status));
+		readings.push_back(new Reading("accelerometer", values));
+	}
+	for (auto reading : readings)
+	{
+		delete reading;
+	}
+}
+
+static string readingsJSON()
+{
+	ostringstream ss;
+	ss << "{ \"count\" : " << BATCH_SIZE << ", \"rows\" : [ ";
+	for (int i = 0; i < BATCH_SIZE; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ \"id\" : " << i + 1 << ", \"asset_code\" : \"accelerometer\", "
+			<< "\"read_key\" : \"5b3be500-ff95-41ae-b5a4-cc99d08bef40\", "
+			<< "\"reading\" : { \"x\" : " << i << ".5, \"y\" : 2.5, \"z\" : 3.5 }, "
+			<< "\"user_ts\" : \"2018-09-03 18:40:00.123456\", "
+			<< "\"ts\" : \"2018-09-03 18:40:00.123456\" }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+static void report(const char *name, unsigned long allocs, double secs)
+{
+	cout << setw(28) << left << name
+		<< setw(16) << right << allocs / RUNS
+		<< setw(16) << fixed << setprecision(0) << (BATCH_SIZE * RUNS) / secs << endl;
+}
+
+int main(int argc, char **argv)
+{
+	cout << setw(28) << left << "Test" << setw(16) << right << "Mallocs/batch"
+		<< setw(16) << "Readings/sec" << endl;
+
+	unsigned long start = mallocs;
+	auto t1 = chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++)
+	{
+		batch();
+	}
+	chrono::duration<double> secs = chrono::steady_clock::now() - t1;
+	report("create/delete, heap", mallocs - start, secs.count());
+
+	ReadingArena arena;
+	start = mallocs;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++)
+	{
+		ReadingArena::Scope scope(&arena);
+		batch();
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("create/delete, arena", mallocs - start, secs.count());
+
+	string json = readingsJSON();
+	start = mallocs;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++)
+	{
+		ReadingSet *set = new ReadingSet(json);
+		delete set;
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("ReadingSet from JSON", mallocs - start, secs.count());
+
+	start = mallocs;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++)
+	{
+		ReadingSet *set = new ArenaReadingSet(json);
+		delete set;
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("ArenaReadingSet from JSON", mallocs - start, secs.count());
+	return 0;
+}
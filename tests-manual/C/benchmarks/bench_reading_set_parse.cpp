@@ -0,0 +1,149 @@
+/*
+ * FogLAMP reading set parsing benchmark.
+ *
+ * Measures the time taken and the peak memory used to build the
+ * readings of a readings fetch result of 5k and 10k readings, by
+ * parsing into a rapidjson Document and creating a JSONReading for
+ * each row, as ReadingSet did previously, and by the streaming
+ * ReadingSet parser from a string and from a stream.
+ *
+ * Each test is run in a child process so that its peak resident
+ * set size can be measured.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <reading_set.h>
+#include <rapidjson/document.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace std;
+using namespace rapidjson;
+
+#define RUNS	10
+
+static string readingsJSON(int count)
+{
+	ostringstream ss;
+	ss << "{ \"count\" : " << count << ", \"rows\" : [ ";
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ \"id\" : " << i + 1 << ", \"asset_code\" : \"accelerometer\", "
+			<< "\"read_key\" : \"5b3be500-ff95-41ae-b5a4-cc99d08bef40\", "
+			<< "\"reading\" : { \"x\" : " << i << ".5, \"y\" : 2.5, \"z\" : 3.5, "
+			<< "\"status\" : \"running\", \"count\" : " << i << " }, "
+			<< "\"user_ts\" : \"2018-09-03 18:40:00.123456+00:00\", "
+			<< "\"ts\" : \"2018-09-03 18:40:00.123456+00:00\" }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+/**
+ * Return the current resident set size in kilobytes
+ */
+static long currentRSS()
+{
+	long pages = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp)
+	{
+		if (fscanf(fp, "%*s %ld", &pages) != 1)
+			pages = 0;
+		fclose(fp);
+	}
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Build the readings as ReadingSet did before the streaming parser
+ */
+static unsigned long domParse(const string& json)
+{
+	Document doc;
+	doc.Parse(json.c_str());
+	vector<Reading *> readings;
+	for (auto& row : doc["rows"].GetArray())
+	{
+		readings.push_back(new JSONReading(row));
+	}
+	unsigned long n = readings.size();
+	for (auto reading : readings)
+	{
+		delete reading;
+	}
+	return n;
+}
+
+static unsigned long saxParse(const string& json)
+{
+	ReadingSet set(json);
+	return set.getCount();
+}
+
+static unsigned long streamParse(const string& json)
+{
+	// The stream is created outside of the timing in the service, here
+	// it adds a copy of the document to the measured memory
+	istringstream stream(json);
+	ReadingSet set(stream);
+	return set.getCount();
+}
+
+/**
+ * Run a test in a child process and report the time and peak memory
+ */
+static void run(const char *name, unsigned long (*test)(const string&), const string& json)
+{
+	cout << flush;
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		long base = currentRSS();
+		unsigned long n = 0;
+		auto t1 = chrono::steady_clock::now();
+		for (int i = 0; i < RUNS; i++)
+		{
+			n += test(json);
+		}
+		chrono::duration<double> secs = chrono::steady_clock::now() - t1;
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		cout << setw(28) << left << name
+			<< setw(12) << right << fixed << setprecision(2) << (secs.count() * 1000) / RUNS
+			<< setw(16) << usage.ru_maxrss - base
+			<< setw(16) << fixed << setprecision(0) << n / secs.count() << endl;
+		exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+}
+
+int main(int argc, char **argv)
+{
+	int sizes[] = { 5000, 10000 };
+	for (auto size : sizes)
+	{
+		string json = readingsJSON(size);
+		cout << size << " readings, " << json.length() / 1024 << "KB document" << endl;
+		cout << setw(28) << left << "Test" << setw(12) << right << "ms/parse"
+			<< setw(16) << "Peak RSS KB" << setw(16) << "Readings/sec" << endl;
+		run("Document + JSONReading", domParse, json);
+		run("ReadingSet from string", saxParse, json);
+		run("ReadingSet from stream", streamParse, json);
+		cout << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * FogLAMP SQLite readings append benchmark.
+ *
+ * Compares the rows per second achieved by the original text SQL
+ * readings append, a single multi-row INSERT statement, with the
+ * prepared statement path in Connection::appendReadings for batches
+ * of 1k, 10k and 100k readings, then the rows per second appended by
+ * 1, 2 and 4 threads at once, which the readings writer commits together.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <connection.h>
+#include <readings_writer.h>
+#include <sql_buffer.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <sqlite3.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace rapidjson;
+
+#define DB_FILE		"/tmp/bench_sqlite_append.sqlite"
+
+/**
+ * Create an empty database with the readings table
+ */
+static void createDatabase()
+{
+	unlink(DB_FILE);
+	unlink(DB_FILE "-wal");
+	unlink(DB_FILE "-shm");
+	sqlite3 *db;
+	sqlite3_open(DB_FILE, &db);
+	sqlite3_exec(db, "CREATE TABLE readings ("
+			"id INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"asset_code character varying(50) NOT NULL, "
+			"read_key uuid UNIQUE, "
+			"reading JSON NOT NULL DEFAULT '{}', "
+			"user_ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')), "
+			"ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')));"
+			"CREATE INDEX fki_readings_fk1 ON readings (asset_code, user_ts desc);",
+			NULL, NULL, NULL);
+	sqlite3_close(db);
+}
+
+/**
+ * Build a readings append payload
+ */
+static string payload(unsigned int count, unsigned int run)
+{
+	ostringstream ss;
+	ss << "{ \"readings\" : [ ";
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ \"asset_code\" : \"sinusoid\", \"read_key\" : \"";
+		ss << setfill('0') << setw(8) << run << "-0000-0000-0000-" << setw(12) << i;
+		ss << "\", \"user_ts\" : \"2018-09-03 18:40:00.123456+00:00\", ";
+		ss << "\"reading\" : { \"sinusoid\" : 0.5878, \"count\" : " << i << " } }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+/**
+ * The readings append as it was before, one multi-row INSERT built as text
+ */
+static int textAppend(Connection& conn, sqlite3 *db, const char *readings)
+{
+Document	doc;
+SQLBuffer	sql;
+int		row = 0;
+
+	doc.Parse(readings);
+	sql.append("INSERT INTO foglamp.readings ( user_ts, asset_code, read_key, reading ) VALUES ");
+	Value &rdings = doc["readings"];
+	for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
+	{
+		char formatted_date[LEN_BUFFER_DATE] = {0};
+		conn.formatDate(formatted_date, sizeof(formatted_date), (*itr)["user_ts"].GetString());
+		sql.append(row++ ? ", ('" : "('");
+		sql.append(formatted_date);
+		sql.append("','");
+		sql.append((*itr)["asset_code"].GetString());
+		sql.append("', '");
+		sql.append((*itr)["read_key"].GetString());
+		sql.append("', '");
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		(*itr)["reading"].Accept(writer);
+		sql.append(buffer.GetString());
+		sql.append("')");
+	}
+	sql.append(';');
+	const char *query = sql.coalesce();
+	int rc = sqlite3_exec(db, query, NULL, NULL, NULL);
+	delete[] query;
+	return rc == SQLITE_OK ? sqlite3_changes(db) : -1;
+}
+
+static void report(const char *path, unsigned int rows, int added, double secs)
+{
+	cout << setw(24) << left << path << setw(10) << right << rows
+		<< setw(14) << fixed << setprecision(0) << (added == (int)rows ? rows / secs : 0)
+		<< endl;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int sizes[] = { 1000, 10000, 100000 };
+	unsigned int batches[] = { 1, 50, 249 };
+	unsigned int run = 0;
+
+	createDatabase();
+	setenv("DEFAULT_SQLITE_DB_FILE", DB_FILE, 1);
+	Connection conn;
+
+	sqlite3 *db;
+	sqlite3_open(DB_FILE, &db);
+	sqlite3_exec(db, "PRAGMA journal_mode = WAL; ATTACH DATABASE '" DB_FILE "' AS foglamp;",
+			NULL, NULL, NULL);
+
+	cout << setw(24) << left << "Path" << setw(10) << right << "Rows"
+		<< setw(14) << "Rows/sec" << endl;
+	for (auto size : sizes)
+	{
+		string data = payload(size, run++);
+		auto start = chrono::steady_clock::now();
+		int added = textAppend(conn, db, data.c_str());
+		chrono::duration<double> secs = chrono::steady_clock::now() - start;
+		report("text SQL", size, added, secs.count());
+
+		for (auto batch : batches)
+		{
+			data = payload(size, run++);
+			// Appends are inserted by the writer on its own connection
+			ReadingsWriter::getInstance()->execute([batch](Connection *writer) {
+				writer->setAppendBatchSize(batch);
+				return 0;
+			});
+			start = chrono::steady_clock::now();
+			added = conn.appendReadings(data.c_str());
+			secs = chrono::steady_clock::now() - start;
+			string name = "prepared, " + to_string(batch) + " rows";
+			report(name.c_str(), size, added, secs.count());
+		}
+	}
+
+	// Concurrent appends of 100 readings, as sent by several south services
+	const unsigned int appends = 200;
+	for (unsigned int threads : { 1, 2, 4 })
+	{
+		vector<string> data;
+		for (unsigned int i = 0; i < threads * appends; i++)
+		{
+			data.push_back(payload(100, run++));
+		}
+		vector<thread> workers;
+		vector<int> added(threads, 0);
+		auto start = chrono::steady_clock::now();
+		for (unsigned int t = 0; t < threads; t++)
+		{
+			workers.push_back(thread([&data, &added, t, appends]() {
+				Connection appender;
+				for (unsigned int i = 0; i < appends; i++)
+				{
+					added[t] += appender.appendReadings(data[t * appends + i].c_str());
+				}
+			}));
+		}
+		int total = 0;
+		for (unsigned int t = 0; t < threads; t++)
+		{
+			workers[t].join();
+			total += added[t];
+		}
+		chrono::duration<double> secs = chrono::steady_clock::now() - start;
+		string name = to_string(threads) + " threads x 100 rows";
+		report(name.c_str(), threads * appends * 100, total, secs.count());
+	}
+	ReadingsWriter::shutdown();
+	sqlite3_close(db);
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * FogLAMP SQLite readings fetch benchmark.
+ *
+ * Compares the rows per second achieved when fetching blocks of 1k and
+ * 10k readings by building a rapidjson Document of the result set and
+ * writing it out, as Connection::mapResultSet did previously, with the
+ * streaming result set writer now used by Connection::fetchReadings.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <connection.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <sqlite3.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace rapidjson;
+
+#define DB_FILE		"/tmp/bench_sqlite_fetch.sqlite"
+#define READINGS	10000
+#define RUNS		20
+
+/**
+ * Create an empty database with the readings table
+ */
+static void createDatabase()
+{
+	unlink(DB_FILE);
+	unlink(DB_FILE "-wal");
+	unlink(DB_FILE "-shm");
+	sqlite3 *db;
+	sqlite3_open(DB_FILE, &db);
+	sqlite3_exec(db, "CREATE TABLE readings ("
+			"id INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"asset_code character varying(50) NOT NULL, "
+			"read_key uuid UNIQUE, "
+			"reading JSON NOT NULL DEFAULT '{}', "
+			"user_ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')), "
+			"ts DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')));"
+			"CREATE INDEX fki_readings_fk1 ON readings (asset_code, user_ts desc);",
+			NULL, NULL, NULL);
+	sqlite3_close(db);
+}
+
+/**
+ * Build a readings append payload
+ */
+static string payload(unsigned int count)
+{
+	ostringstream ss;
+	ss << "{ \"readings\" : [ ";
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ \"asset_code\" : \"sinusoid\", \"read_key\" : \"";
+		ss << "00000000-0000-0000-0000-" << setfill('0') << setw(12) << i;
+		ss << "\", \"user_ts\" : \"2018-09-03 18:40:00.123456+00:00\", ";
+		ss << "\"reading\" : { \"sinusoid\" : 0.5878, \"count\" : " << i << ", ";
+		ss << "\"status\" : \"running\" } }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+/**
+ * The readings fetch as it was before, the result set is built as
+ * a Document, every text column is parsed to check if it is JSON and
+ * the Document is then written to a StringBuffer and copied to a string.
+ */
+static int documentFetch(sqlite3 *db, unsigned int count, string& resultSet)
+{
+	char sql[512];
+	snprintf(sql, sizeof(sql), "SELECT id, asset_code, read_key, reading, "
+		"strftime('%%Y-%%m-%%d %%H:%%M:%%S', user_ts, 'utc') || "
+		"substr(user_ts, instr(user_ts, '.'), 7) AS user_ts, "
+		"strftime('%%Y-%%m-%%d %%H:%%M:%%f', ts, 'utc') AS ts "
+		"FROM foglamp.readings WHERE id >= 1 ORDER BY id ASC LIMIT %u;", count);
+	sqlite3_stmt *stmt;
+	sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+	Document doc;
+	doc.SetObject();
+	Document::AllocatorType& allocator = doc.GetAllocator();
+	Value rows(kArrayType);
+	int rc, nRows = 0;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		int nCols = sqlite3_column_count(stmt);
+		Value row(kObjectType);
+		for (int i = 0; i < nCols; i++)
+		{
+			Document d;
+			Value name(sqlite3_column_name(stmt, i), allocator);
+			char *str = (char *)sqlite3_column_text(stmt, i);
+			switch (sqlite3_column_type(stmt, i))
+			{
+				case SQLITE_NULL:
+					row.AddMember(name, "", allocator);
+					break;
+				case SQLITE3_TEXT:
+				{
+					Value value;
+					if (!d.Parse(str).HasParseError() && !d.IsNumber())
+						value = Value(d, allocator);
+					else
+						value = Value(str, allocator);
+					row.AddMember(name, value, allocator);
+					break;
+				}
+				case SQLITE_INTEGER:
+					row.AddMember(name, (int64_t)atol(str), allocator);
+					break;
+				case SQLITE_FLOAT:
+					row.AddMember(name, atof(str), allocator);
+					break;
+			}
+		}
+		nRows++;
+		rows.PushBack(row, allocator);
+	}
+	sqlite3_finalize(stmt);
+	doc.AddMember("count", nRows, allocator);
+	doc.AddMember("rows", rows, allocator);
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	doc.Accept(writer);
+	resultSet = buffer.GetString();
+	return nRows;
+}
+
+/**
+ * Return the number of rows in a result set
+ */
+static int rows(const string& resultSet)
+{
+	Document doc;
+	doc.Parse(resultSet.c_str());
+	if (doc.HasParseError() || !doc.HasMember("count"))
+		return -1;
+	return doc["count"].GetInt();
+}
+
+static void report(const char *path, unsigned int count, double secs, int nRows)
+{
+	cout << setw(24) << left << path << setw(10) << right << count
+		<< setw(12) << fixed << setprecision(2) << secs * 1000 / RUNS
+		<< setw(14) << setprecision(0) << (nRows == (int)count ? count * RUNS / secs : 0)
+		<< endl;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int sizes[] = { 1000, 10000 };
+
+	createDatabase();
+	setenv("DEFAULT_SQLITE_DB_FILE", DB_FILE, 1);
+	Connection conn;
+	string data = payload(READINGS);
+	conn.appendReadings(data.c_str());
+
+	sqlite3 *db;
+	sqlite3_open(DB_FILE, &db);
+	sqlite3_exec(db, "ATTACH DATABASE '" DB_FILE "' AS foglamp;", NULL, NULL, NULL);
+
+	cout << setw(24) << left << "Path" << setw(10) << right << "Rows"
+		<< setw(12) << "ms/fetch" << setw(14) << "Rows/sec" << endl;
+	for (auto size : sizes)
+	{
+		string resultSet;
+		int nRows = 0;
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < RUNS; i++)
+		{
+			nRows = documentFetch(db, size, resultSet);
+		}
+		chrono::duration<double> secs = chrono::steady_clock::now() - start;
+		report("Document", size, secs.count(), rows(resultSet));
+
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < RUNS; i++)
+		{
+			conn.fetchReadings(1, size, resultSet);
+		}
+		secs = chrono::steady_clock::now() - start;
+		report("streaming writer", size, secs.count(), rows(resultSet));
+	}
+	sqlite3_close(db);
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * FogLAMP storage transport benchmark.
+ *
+ * Compares the calls per second and the CPU time per call of a storage
+ * client talking to an HTTP server, with the storage service REST
+ * resources, over TCP loopback and over a Unix domain socket. The
+ * server answers with canned responses so only the transport and the
+ * HTTP handling are measured.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <local_http_server.h>
+#include <storage_client.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+
+using namespace std;
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+#define SOCKET_PATH	"/tmp/bench_storage_transport.sock"
+#define DURATION	2	// Seconds each test is run for
+
+/**
+ * Build a readings payload, for an append or a fetch result
+ */
+static string readings(unsigned int count, bool result)
+{
+	ostringstream ss;
+	ss << "{ " << (result ? "\"count\" : " + to_string(count) + ", \"rows\"" : "\"readings\"") << " : [ ";
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (i)
+			ss << ", ";
+		ss << "{ ";
+		if (result)
+			ss << "\"id\" : " << i + 1 << ", ";
+		ss << "\"asset_code\" : \"sinusoid\", \"read_key\" : \"";
+		ss << "00000000-0000-0000-0000-" << setfill('0') << setw(12) << i;
+		ss << "\", \"user_ts\" : \"2018-09-03 18:40:00.123456\", ";
+		if (result)
+			ss << "\"ts\" : \"2018-09-03 18:40:00.123456\", ";
+		ss << "\"reading\" : { \"sinusoid\" : 0.5878, \"count\" : " << i << " } }";
+	}
+	ss << " ] }";
+	return ss.str();
+}
+
+static void reply(shared_ptr<HttpServer::Response> response, const string& payload)
+{
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << payload.length() << "\r\n"
+		  << "Content-type: application/json\r\n\r\n" << payload;
+}
+
+/**
+ * Return the CPU time used by the process, client and server, in seconds
+ */
+static double cpuTime()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+/**
+ * Run a call repeatedly for DURATION seconds and report the calls
+ * per second and the CPU time per call
+ */
+static void run(const char *transport, const char *call, const function<bool()>& fn)
+{
+	unsigned long calls = 0;
+	double cpu = cpuTime();
+	auto start = chrono::steady_clock::now();
+	auto end = start + chrono::seconds(DURATION);
+	while (chrono::steady_clock::now() < end)
+	{
+		if (!fn())
+		{
+			cout << call << " failed" << endl;
+			return;
+		}
+		calls++;
+	}
+	chrono::duration<double> secs = chrono::steady_clock::now() - start;
+	cpu = cpuTime() - cpu;
+	cout << setw(12) << left << transport << setw(24) << call
+		<< setw(12) << right << fixed << setprecision(0) << calls / secs.count()
+		<< setw(14) << setprecision(1) << cpu * 1000000 / calls << endl;
+}
+
+int main(int argc, char **argv)
+{
+	string appendPayload = readings(100, false);
+	string fetchResult = readings(1000, true);
+
+	LocalHttpServer server;
+	server.config.port = 0;
+	server.config.address = "127.0.0.1";
+	server.setSocketPath(SOCKET_PATH);
+	server.resource["^/storage/table/([A-Za-z][a-zA-Z0-9_]*)$"]["PUT"] =
+		[](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+			reply(response, "{ \"response\" : \"updated\", \"rows_affected\" : 1 }");
+		};
+	server.resource["^/storage/reading$"]["POST"] =
+		[](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+			reply(response, "{ \"response\" : \"appended\", \"readings_added\" : 100 }");
+		};
+	server.resource["^/storage/reading$"]["GET"] =
+		[&fetchResult](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+			reply(response, fetchResult);
+		};
+	unsigned short port = server.bind();
+	thread serverThread(&LocalHttpServer::accept_and_run, &server);
+
+	cout << setw(12) << left << "Transport" << setw(24) << "Call"
+		<< setw(12) << right << "Calls/sec" << setw(14) << "CPU us/call" << endl;
+	const char *transports[] = { "TCP", "Unix socket" };
+	for (int t = 0; t < 2; t++)
+	{
+		StorageClient client("127.0.0.1", port, t ? server.getSocketPath() : "");
+		ExpressionValues values;
+		values.push_back(Expression("value", "+", 1));
+		Where where("key", Equals, "READINGS");
+		run(transports[t], "update statistics", [&]() {
+			return client.updateTable("statistics", values, where) == 1;
+		});
+		run(transports[t], "append 100 readings", [&]() {
+			return client.readingAppend(appendPayload);
+		});
+		run(transports[t], "fetch 1000 readings", [&]() {
+			ReadingSet *set = client.readingFetch(1, 1000);
+			bool ok = set->getCount() == 1000;
+			delete set;
+			return ok;
+		});
+	}
+
+	server.stop();
+	serverThread.join();
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * FogLAMP timestamp benchmark.
+ *
+ * Measures timestamps per second parsed and formatted by the
+ * strptime/mktime and gmtime_r/strftime functions used previously
+ * in Reading and by the TimestampCodec.
+ *
+ * Copyright (c) 2018 OSisoft, LLC
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <timestamp_codec.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+#define COUNT	1000000
+
+/**
+ * The strptime based parsing previously used by Reading
+ */
+static void libcParse(const char *timestamp, struct timeval *ts)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(struct tm));
+	strptime(timestamp, "%Y-%m-%d %H:%M:%S", &tm);
+	ts->tv_sec = mktime(&tm);
+	extern long timezone;
+	ts->tv_sec -= timezone;
+	const char *ptr = strchr(timestamp, '.');
+	ts->tv_usec = 0;
+	if (ptr)
+	{
+		char *eptr;
+		ts->tv_usec = strtol(ptr + 1, &eptr, 10);
+		for (int digits = eptr - (ptr + 1); digits < 6; digits++)
+			ts->tv_usec *= 10;
+	}
+	ptr = timestamp + 10;
+	while (*ptr && *ptr != '-' && *ptr != '+')
+		ptr++;
+	if (*ptr)
+	{
+		int h, m;
+		int sign = (*ptr == '+' ? -1 : +1);
+		sscanf(ptr + 1, "%02d:%02d", &h, &m);
+		ts->tv_sec += sign * ((3600 * h) + (60 * m));
+	}
+}
+
+/**
+ * The gmtime_r based formatting previously used by Reading
+ */
+static string libcFormat(const struct timeval& tv)
+{
+	char date_time[52], micro_s[10];
+	ostringstream assetTime;
+	struct tm timeinfo;
+	gmtime_r(&tv.tv_sec, &timeinfo);
+	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", &timeinfo);
+	snprintf(micro_s, sizeof(micro_s), ".%06lu", (unsigned long)tv.tv_usec);
+	assetTime << date_time << micro_s;
+	return assetTime.str();
+}
+
+static void report(const char *name, double secs, long check)
+{
+	cout << setw(24) << left << name
+		<< setw(16) << right << fixed << setprecision(0) << COUNT / secs
+		<< "    (" << check << ")" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	tzset();
+
+	// A batch of readings a few milliseconds apart within the same day
+	vector<string> timestamps;
+	struct timeval tv = { 1547114463, 0 };
+	for (int i = 0; i < 1000; i++)
+	{
+		char buf[TIMESTAMP_BUFFER_LEN];
+		TimestampCodec::format(tv, buf);
+		timestamps.push_back(string(buf) + "+00:00");
+		tv.tv_usec += 4999;
+		if (tv.tv_usec >= 1000000)
+		{
+			tv.tv_sec++;
+			tv.tv_usec -= 1000000;
+		}
+	}
+
+	cout << setw(24) << left << "Test" << setw(16) << right << "Timestamps/sec" << endl;
+
+	long check = 0;
+	auto t1 = chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		libcParse(timestamps[i % 1000].c_str(), &tv);
+		check += tv.tv_sec + tv.tv_usec;
+	}
+	chrono::duration<double> secs = chrono::steady_clock::now() - t1;
+	report("parse, strptime", secs.count(), check);
+
+	check = 0;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		TimestampCodec::parse(timestamps[i % 1000].c_str(), &tv);
+		check += tv.tv_sec + tv.tv_usec;
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("parse, TimestampCodec", secs.count(), check);
+
+	check = 0;
+	tv.tv_sec = 1547114463;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		tv.tv_usec = i % 1000000;
+		check += libcFormat(tv).length();
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("format, strftime", secs.count(), check);
+
+	check = 0;
+	t1 = chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		char buf[TIMESTAMP_BUFFER_LEN];
+		tv.tv_usec = i % 1000000;
+		check += TimestampCodec::format(tv, buf);
+	}
+	secs = chrono::steady_clock::now() - t1;
+	report("format, TimestampCodec", secs.count(), check);
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <binary_readings.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(BinaryReadingsTest, RoundTrip)
+{
+	DatapointValue i((long) 10);
+	DatapointValue f(3.1415);
+	DatapointValue s(string("a \"quoted\" string"));
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("i", i));
+	values.push_back(new Datapoint("f", f));
+	values.push_back(new Datapoint("s", s));
+	Reading first(string("asset1"), values);
+	struct timeval tv = { 1536000000, 123456 };
+	first.setUserTimestamp(tv);
+	DatapointValue i2((long) -5);
+	Reading second(string("asset2"), new Datapoint("i", i2));
+	vector<Reading *> readings = { &first, &second };
+
+	string batch;
+	ASSERT_TRUE(BinaryReadingsWriter::encode(readings, batch));
+	BinaryReadingsReader reader(batch.data(), batch.length());
+	ASSERT_TRUE(reader.isValid());
+	ASSERT_EQ(2, reader.getCount());
+	ASSERT_EQ(string("asset1"), reader.getAssetCode(0));
+	ASSERT_EQ(string("asset2"), reader.getAssetCode(1));
+	ASSERT_EQ(1536000000123456LL, reader.getUserTs(0));
+	ASSERT_EQ(first.getUuid(), reader.getReadKey(0));
+
+	string json;
+	reader.readingJSON(0, json);
+	ASSERT_EQ(string("{\"i\":10,\"f\":3.1415,\"s\":\"a \\\"quoted\\\" string\"}"), json);
+	json.clear();
+	reader.readingJSON(1, json);
+	ASSERT_EQ(string("{\"i\":-5}"), json);
+
+	char ts[40];
+	BinaryReadingsReader::formatTimestamp(reader.getUserTs(0), ts);
+	ASSERT_STREQ("2018-09-03 18:40:00.123456+00:00", ts);
+	json = reader.toJSON();
+	ASSERT_NE(json.find("\"user_ts\" : \"2018-09-03 18:40:00.123456+00:00\""), string::npos);
+	ASSERT_NE(json.find("\"asset_code\" : \"asset2\""), string::npos);
+}
+
+TEST(BinaryReadingsTest, Truncated)
+{
+	DatapointValue value((long) 10);
+	Reading reading(string("test"), new Datapoint("x", value));
+	vector<Reading *> readings = { &reading };
+	string batch;
+	ASSERT_TRUE(BinaryReadingsWriter::encode(readings, batch));
+	BinaryReadingsReader reader(batch.data(), batch.length() - 1);
+	ASSERT_FALSE(reader.isValid());
+	BinaryReadingsReader notBatch("{ \"readings\" : [] }", 20);
+	ASSERT_FALSE(notBatch.isValid());
+}
+
+TEST(BinaryReadingsTest, TooLong)
+{
+	DatapointValue value((long) 10);
+	Reading longName(string(70000, 'a'), new Datapoint("x", value));
+	vector<Reading *> readings = { &longName };
+	string batch;
+	ASSERT_FALSE(BinaryReadingsWriter::encode(readings, batch));
+
+	vector<Datapoint *> values;
+	for (int i = 0; i < 65536; i++)
+	{
+		values.push_back(new Datapoint("x", value));
+	}
+	Reading manyDatapoints(string("many"), values);
+	readings = { &manyDatapoints };
+	ASSERT_FALSE(BinaryReadingsWriter::encode(readings, batch));
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <http_stream.h>
+#include <reading_set.h>
+#include <thread>
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+static const char *readings = "{\"rows\":[{\"id\":1,\"asset_code\":\"test\","
+		"\"read_key\":\"5b3be500-ff95-41ae-b5a4-cc99d08bef40\","
+		"\"reading\":{\"x\":1},\"user_ts\":\"2018-09-03 18:40:00.123456\","
+		"\"ts\":\"2018-09-03 18:40:00.123456\"},{\"id\":2,\"asset_code\":\"test\","
+		"\"read_key\":\"5b3be500-ff95-41ae-b5a4-cc99d08bef41\","
+		"\"reading\":{\"x\":2},\"user_ts\":\"2018-09-03 18:40:01.123456\","
+		"\"ts\":\"2018-09-03 18:40:01.123456\"}],\"count\":2}";
+
+/*
+ * A server that accepts one connection, reads the request and sends
+ * the response it is given in several writes.
+ */
+class OneShotServer {
+	public:
+		OneShotServer(const vector<string>& response) : m_response(response)
+		{
+			m_socket = socket(AF_INET, SOCK_STREAM, 0);
+			struct sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			addr.sin_port = 0;
+			bind(m_socket, (struct sockaddr *)&addr, sizeof(addr));
+			listen(m_socket, 1);
+			socklen_t len = sizeof(addr);
+			getsockname(m_socket, (struct sockaddr *)&addr, &len);
+			m_port = ntohs(addr.sin_port);
+			m_thread = thread(&OneShotServer::serve, this);
+		};
+		~OneShotServer()
+		{
+			m_thread.join();
+			close(m_socket);
+		};
+		unsigned short	getPort() const { return m_port; };
+		const string&	getRequest() const { return m_request; };
+	private:
+		void serve()
+		{
+			int conn = accept(m_socket, NULL, NULL);
+			char buf[1024];
+			while (m_request.find("\r\n\r\n") == string::npos)
+			{
+				ssize_t n = recv(conn, buf, sizeof(buf), 0);
+				if (n <= 0)
+					break;
+				m_request.append(buf, n);
+			}
+			for (auto& part : m_response)
+			{
+				send(conn, part.data(), part.length(), MSG_NOSIGNAL);
+				this_thread::sleep_for(chrono::milliseconds(1));
+			}
+			close(conn);
+		};
+		vector<string>	m_response;
+		int		m_socket;
+		unsigned short	m_port;
+		thread		m_thread;
+		string		m_request;
+};
+
+static string chunk(const string& data)
+{
+	ostringstream ss;
+	ss << hex << data.length() << "\r\n" << data << "\r\n";
+	return ss.str();
+}
+
+TEST(HttpStreamTest, Chunked)
+{
+	string doc(readings);
+	size_t third = doc.length() / 3;
+	vector<string> response;
+	response.push_back("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+			   "Content-type: application/json\r\n\r\n");
+	response.push_back(chunk(doc.substr(0, third)));
+	response.push_back(chunk(doc.substr(third, third)).substr(0, 5));
+	response.push_back(chunk(doc.substr(third, third)).substr(5));
+	response.push_back(chunk(doc.substr(2 * third)) + "0\r\n\r\n");
+	OneShotServer server(response);
+
+	HttpStream stream("localhost", server.getPort());
+	ASSERT_EQ(string("200 OK"), stream.request("GET", "/storage/reading?id=1&count=2"));
+	ReadingSet set(stream.content());
+	ASSERT_TRUE(stream.complete());
+	ASSERT_EQ(2, set.getCount());
+	ASSERT_EQ(2, set.getLastId());
+	ASSERT_EQ(0, server.getRequest().find("GET /storage/reading?id=1&count=2 HTTP/1.1\r\n"));
+}
+
+TEST(HttpStreamTest, ContentLength)
+{
+	string doc(readings);
+	vector<string> response;
+	response.push_back("HTTP/1.1 200 OK\r\nContent-Length: " + to_string(doc.length()) + "\r\n\r\n"
+			   + doc.substr(0, 10));
+	response.push_back(doc.substr(10));
+	OneShotServer server(response);
+
+	HttpStream stream("localhost", server.getPort());
+	ASSERT_EQ(string("200 OK"), stream.request("GET", "/storage/reading?id=1&count=2"));
+	ostringstream content;
+	content << stream.content().rdbuf();
+	ASSERT_EQ(doc, content.str());
+	ASSERT_TRUE(stream.complete());
+}
+
+TEST(HttpStreamTest, Truncated)
+{
+	string doc(readings);
+	vector<string> response;
+	response.push_back("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+	response.push_back(chunk(doc.substr(0, doc.length() - 1)));
+	OneShotServer server(response);
+
+	HttpStream stream("localhost", server.getPort());
+	ASSERT_EQ(string("200 OK"), stream.request("GET", "/storage/reading?id=1&count=2"));
+	bool thrown = false;
+	try {
+		ReadingSet set(stream.content());
+	} catch (ReadingSetException *ex) {
+		delete ex;
+		thrown = true;
+	}
+	ASSERT_TRUE(thrown);
+	ASSERT_FALSE(stream.complete());
+}
@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+#include <latency_histogram.h>
+#include <rapidjson/document.h>
+#include <string>
+
+using namespace std;
+using namespace rapidjson;
+
+TEST(LatencyHistogramTest, Buckets)
+{
+	LatencyHistogram histogram;
+	histogram.record(50);
+	histogram.record(100);
+	histogram.record(999);
+	histogram.record(5000000);
+	ASSERT_EQ(4, histogram.getCount());
+	ASSERT_EQ(5000000, histogram.getMax());
+	ASSERT_EQ(1, histogram.getBucket(0));
+	ASSERT_EQ(1, histogram.getBucket(1));
+	ASSERT_EQ(1, histogram.getBucket(3));
+	ASSERT_EQ(1, histogram.getBucket(LATENCY_BUCKETS - 1));
+	ASSERT_EQ(1000, LatencyHistogram::getBucketLimit(3));
+	ASSERT_EQ(0, LatencyHistogram::getBucketLimit(LATENCY_BUCKETS - 1));
+}
+
+TEST(LatencyHistogramTest, JSON)
+{
+	LatencyHistogram histogram;
+	histogram.record(200);
+	histogram.record(1800);
+	string json;
+	histogram.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(2, doc["count"].GetInt());
+	ASSERT_DOUBLE_EQ(1.0, doc["average"].GetDouble());
+	ASSERT_DOUBLE_EQ(1.8, doc["max"].GetDouble());
+	ASSERT_EQ(LATENCY_BUCKETS, doc["buckets"].MemberCount());
+	ASSERT_EQ(1, doc["buckets"]["<0.2"].GetInt());
+	ASSERT_EQ(1, doc["buckets"]["<2.5"].GetInt());
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <mpsc_queue.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(MPSCQueue, Capacity)
+{
+	MPSCQueue<int> queue(100);
+	ASSERT_EQ(128, queue.capacity());
+	ASSERT_TRUE(queue.empty());
+}
+
+TEST(MPSCQueue, Order)
+{
+	MPSCQueue<int> queue(8);
+	for (int i = 0; i < 5; i++)
+		ASSERT_TRUE(queue.push(i));
+	ASSERT_EQ(5, queue.size());
+	int value;
+	for (int i = 0; i < 5; i++)
+	{
+		ASSERT_TRUE(queue.pop(value));
+		ASSERT_EQ(i, value);
+	}
+	ASSERT_FALSE(queue.pop(value));
+}
+
+TEST(MPSCQueue, Full)
+{
+	MPSCQueue<int> queue(4);
+	for (int i = 0; i < 4; i++)
+		ASSERT_TRUE(queue.push(i));
+	ASSERT_FALSE(queue.push(4));
+	int value;
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(0, value);
+	ASSERT_TRUE(queue.push(4));
+	ASSERT_EQ(4, queue.size());
+}
+
+TEST(MPSCQueue, Producers)
+{
+	const int producers = 4, items = 500;
+	MPSCQueue<int> queue(64);
+	vector<thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		threads.push_back(thread([&queue, p]() {
+			for (int i = 0; i < items; i++)
+				while (!queue.push(p * items + i))
+					this_thread::yield();
+		}));
+	}
+	vector<int> last(producers, -1);
+	int value, received = 0;
+	while (received < producers * items)
+	{
+		if (queue.pop(value))
+		{
+			// Each producer's items must arrive in order
+			int p = value / items;
+			ASSERT_GT(value, last[p]);
+			last[p] = value;
+			received++;
+		}
+	}
+	for (auto& t : threads)
+		t.join();
+	ASSERT_TRUE(queue.empty());
+}
@@ -101,3 +101,29 @@ TEST(ReadingTest, rmDatapoint)
 	removed = reading.removeDatapoint("x");
 	ASSERT_EQ(removed,  (Datapoint *)0);
 }
+
+TEST(ReadingTest, CopyNested)
+{
+	vector<Datapoint *> *nested = new vector<Datapoint *>;
+	DatapointValue inner((long) 5);
+	nested->push_back(new Datapoint("inner", inner));
+	DatapointValue dict(nested, true);
+	Reading *reading = new Reading(string("test1"), new Datapoint("outer", dict));
+	Reading copy(*reading);
+	delete reading;
+	ASSERT_EQ(copy.toJSON().find("\"outer\" : {\"inner\" : 5}") != string::npos, true);
+}
+
+TEST(ReadingTest, Move)
+{
+	DatapointValue value(string("moved"));
+	Reading reading(string("test1"), new Datapoint("x", std::move(value)));
+	ASSERT_EQ(value.getType(), DatapointValue::T_INTEGER);
+	Datapoint *dp = reading.getReadingData()[0];
+	Reading moved(std::move(reading));
+	ASSERT_EQ(reading.getDatapointCount(), 0);
+	ASSERT_EQ(moved.getDatapointCount(), 1);
+	ASSERT_EQ(moved.getReadingData()[0], dp);
+	ASSERT_EQ(moved.getReadingData()[0]->getData().toStringValue(), string("moved"));
+	ASSERT_EQ(moved.getAssetName(), string("test1"));
+}
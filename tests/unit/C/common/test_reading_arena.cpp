@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <reading_arena.h>
+#include <reading_set.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(ReadingArenaTest, Allocate)
+{
+	ReadingArena arena;
+	vector<Reading *> readings;
+	{
+		ReadingArena::Scope scope(&arena);
+		for (int i = 0; i < 100; i++)
+		{
+			DatapointValue value((long) i);
+			readings.push_back(new Reading(string("test"), new Datapoint("x", value)));
+		}
+	}
+	ASSERT_EQ(200, arena.getAllocations());
+	ASSERT_EQ(1, arena.getBlocks());
+	for (int i = 0; i < 100; i++)
+	{
+		ASSERT_EQ(i, readings[i]->getReadingData()[0]->getData().toInt());
+		delete readings[i];
+	}
+}
+
+TEST(ReadingArenaTest, OutliveArena)
+{
+	Reading *reading;
+	Reading *heap;
+	{
+		ReadingArena arena(4096);
+		ReadingArena::Scope scope(&arena);
+		DatapointValue value(3.1415);
+		reading = new Reading(string("test"), new Datapoint("pi", value));
+		for (int i = 0; i < 100; i++)
+		{
+			DatapointValue other((long) i);
+			reading->addDatapoint(new Datapoint("n" + to_string(i), other));
+		}
+		ASSERT_LT(1, arena.getBlocks());
+	}
+	DatapointValue value(3.1415);
+	heap = new Reading(string("test"), new Datapoint("pi", value));
+	ASSERT_EQ(101, reading->getDatapointCount());
+	ASSERT_EQ(string("pi"), reading->getReadingData()[0]->getName());
+	delete reading;
+	delete heap;
+}
+
+TEST(ReadingArenaTest, ReadingSet)
+{
+	string json = "{ \"count\" : 2, \"rows\" : [ "
+		"{ \"id\" : 1, \"asset_code\" : \"a\", \"read_key\" : \"5b3be500-ff95-41ae-b5a4-cc99d08bef40\", "
+		"\"reading\" : { \"x\" : 1 }, \"user_ts\" : \"2018-09-03 18:40:00.123456\", \"ts\" : \"2018-09-03 18:40:00.123456\" }, "
+		"{ \"id\" : 2, \"asset_code\" : \"b\", \"read_key\" : \"5b3be500-ff95-41ae-b5a4-cc99d08bef41\", "
+		"\"reading\" : { \"y\" : 2.5 }, \"user_ts\" : \"2018-09-03 18:40:00.123456\", \"ts\" : \"2018-09-03 18:40:00.123456\" } ] }";
+	ReadingSet *set = new ArenaReadingSet(json);
+	ASSERT_EQ(2, set->getCount());
+	ASSERT_EQ(2, set->getLastId());
+	ASSERT_EQ(string("b"), (*set)[1]->getAssetName());
+	delete set;
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <reading_ring.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+static string ringName()
+{
+	return "/foglamp_test_ring." + to_string(getpid());
+}
+
+TEST(ReadingRing, WriteRead)
+{
+	ReadingRing *consumer = ReadingRing::create(ringName(), 4096);
+	ASSERT_TRUE(consumer != NULL);
+	ReadingRing *producer = ReadingRing::open(ringName());
+	ASSERT_TRUE(producer != NULL);
+	ASSERT_TRUE(producer->consumerAlive());
+
+	uint64_t seq;
+	ASSERT_TRUE(producer->write("first", 1, seq));
+	ASSERT_EQ(1, seq);
+	ASSERT_TRUE(producer->write("second", 2, seq));
+	ASSERT_EQ(2, seq);
+
+	string batch;
+	unsigned int count;
+	ASSERT_TRUE(consumer->read(batch, count, seq, 0));
+	ASSERT_EQ(string("first"), batch);
+	ASSERT_EQ(1, count);
+	ASSERT_EQ(1, seq);
+	ASSERT_TRUE(consumer->read(batch, count, seq, 0));
+	ASSERT_EQ(string("second"), batch);
+	ASSERT_EQ(2, count);
+	ASSERT_FALSE(consumer->read(batch, count, seq, 0));
+
+	int64_t result;
+	ASSERT_FALSE(producer->completed(1, result));
+	consumer->acknowledge(1, 1);
+	consumer->acknowledge(2, -1);
+	ASSERT_TRUE(producer->completed(1, result));
+	ASSERT_EQ(1, result);
+	ASSERT_TRUE(producer->completed(2, result));
+	ASSERT_EQ(-1, result);
+
+	ASSERT_FALSE(consumer->producerClosed());
+	producer->close();
+	ASSERT_TRUE(consumer->producerClosed());
+	consumer->shutdown();
+	ASSERT_FALSE(producer->consumerAlive());
+	delete producer;
+	delete consumer;
+	ASSERT_TRUE(ReadingRing::open(ringName()) == NULL);
+}
+
+TEST(ReadingRing, Wrap)
+{
+	ReadingRing *consumer = ReadingRing::create(ringName(), 1024);
+	ReadingRing *producer = ReadingRing::open(ringName());
+	ASSERT_TRUE(consumer != NULL && producer != NULL);
+
+	string batch;
+	unsigned int count;
+	uint64_t seq, read;
+	int64_t result;
+	for (int i = 0; i < 100; i++)
+	{
+		string data(100 + i, 'a' + i % 26);
+		ASSERT_TRUE(producer->write(data, i, seq));
+		ASSERT_TRUE(consumer->read(batch, count, read, 0));
+		ASSERT_EQ(data, batch);
+		ASSERT_EQ(seq, read);
+		consumer->acknowledge(read, i);
+		ASSERT_TRUE(producer->completed(seq, result));
+		ASSERT_EQ(i, result);
+	}
+	delete producer;
+	delete consumer;
+}
+
+TEST(ReadingRing, Full)
+{
+	ReadingRing *consumer = ReadingRing::create(ringName(), 1024);
+	ReadingRing *producer = ReadingRing::open(ringName());
+	ASSERT_TRUE(consumer != NULL && producer != NULL);
+
+	uint64_t seq;
+	ASSERT_FALSE(producer->write(string(600, 'x'), 1, seq));
+	ASSERT_TRUE(producer->write(string(400, 'x'), 1, seq));
+	ASSERT_TRUE(producer->write(string(400, 'y'), 1, seq));
+	ASSERT_FALSE(producer->write(string(400, 'z'), 1, seq));
+
+	string batch;
+	unsigned int count;
+	ASSERT_TRUE(consumer->read(batch, count, seq, 0));
+	ASSERT_TRUE(producer->write(string(400, 'z'), 1, seq));
+	ASSERT_EQ(3, seq);
+	delete producer;
+	delete consumer;
+}
+
+TEST(ReadingRing, Acknowledgements)
+{
+	ReadingRing *consumer = ReadingRing::create(ringName(), 64 * 1024);
+	ReadingRing *producer = ReadingRing::open(ringName());
+	ASSERT_TRUE(consumer != NULL && producer != NULL);
+
+	uint64_t seq;
+	for (int i = 0; i < READING_RING_ACKS; i++)
+	{
+		ASSERT_TRUE(producer->write("x", 1, seq));
+	}
+	// No more batches until the first is acknowledged
+	ASSERT_FALSE(producer->write("x", 1, seq));
+	string batch;
+	unsigned int count;
+	int64_t result;
+	ASSERT_TRUE(consumer->read(batch, count, seq, 0));
+	consumer->acknowledge(seq, 1);
+	ASSERT_FALSE(producer->write("x", 1, seq));
+	ASSERT_TRUE(producer->completed(1, result));
+	ASSERT_TRUE(producer->write("x", 1, seq));
+	ASSERT_EQ(READING_RING_ACKS + 1, seq);
+	delete producer;
+	delete consumer;
+}
+
+TEST(ReadingRing, Reclaim)
+{
+	ReadingRing *consumer = ReadingRing::create(ringName(), 4096);
+	ReadingRing *producer = ReadingRing::open(ringName());
+	ASSERT_TRUE(consumer != NULL && producer != NULL);
+
+	uint64_t seq;
+	for (int i = 0; i < 4; i++)
+	{
+		ASSERT_TRUE(producer->write(to_string(i), 1, seq));
+	}
+	string batch;
+	unsigned int count;
+	ASSERT_TRUE(consumer->read(batch, count, seq, 0));
+
+	vector<pair<uint64_t, string>> batches;
+	producer->reclaim(batches);
+	ASSERT_EQ(3, batches.size());
+	ASSERT_EQ(2, batches[0].first);
+	ASSERT_EQ(string("1"), batches[0].second);
+	ASSERT_EQ(4, batches[2].first);
+
+	// The consumer does not read the reclaimed batches
+	ASSERT_FALSE(consumer->read(batch, count, seq, 0));
+	delete producer;
+	delete consumer;
+}
@@ -65,3 +65,61 @@ TEST(ReadingSet, NotificationIndex)
 	ASSERT_NE(json.find(string("\"readkey\" : ")), 0);
 	ASSERT_NE(json.find(string("\"user_ts\" : \"2017-09-22 14:47:18.872708\"")), 0);
 }
+
+const char *mixed = "{ \"count\" : 4, \"rows\" : [ "
+	    "{ \"id\": 7, \"asset_code\": \"sensor\", \"read_key\": \"5b3be500-ff95-41ae-b5a4-cc99d08bef4a\", "
+	    "\"reading\": { \"s\": \"a \\\"quoted\\\" string\", \"i\": 42, \"big\": 9000000000, \"f\": -1.5 }, "
+	    "\"user_ts\": \"2017-09-21 15:00:08.532958+01:00\", \"ts\": \"2017-09-22 14:47:18.872708\" }, "
+	    "{ \"reading\": 12, \"asset_code\": \"bad\", \"id\": 8, \"read_key\": \"k\", "
+	    "\"user_ts\": \"2017-09-21 15:00:08.532958\" }, "
+	    "{ \"id\": 9, \"asset_code\": \"bad\", \"read_key\": \"k\", \"reading\": \"a \\\"b\\\"\", "
+	    "\"user_ts\": \"2017-09-21 15:00:08.532958\", \"extra\": { \"x\": [1, 2] } }, "
+	    "{ \"id\": 10, \"asset_code\": \"single\", \"read_key\": \"k\", \"reading\": { \"x\": 1 }, "
+	    "\"value\": 3.5, \"user_ts\": \"2017-09-21 15:00:08.532958\" }"
+	    "] }";
+
+TEST(ReadingSet, SameAsJSONReading)
+{
+	ReadingSet readingSet(mixed);
+	ASSERT_EQ(4, readingSet.getCount());
+	ASSERT_EQ(10, readingSet.getLastId());
+
+	Document doc;
+	doc.Parse(mixed);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		JSONReading reading(doc["rows"][i]);
+		ASSERT_EQ(reading.toJSON(), readingSet[i]->toJSON());
+		ASSERT_EQ(reading.getId(), readingSet[i]->getId());
+	}
+}
+
+TEST(ReadingSet, Stream)
+{
+	istringstream stream(input);
+	ReadingSet readingSet(stream);
+	ASSERT_EQ(2, readingSet.getCount());
+	ASSERT_EQ(2, readingSet.getLastId());
+	ReadingSet fromString(input);
+	ASSERT_EQ(fromString[1]->toJSON(), readingSet[1]->toJSON());
+}
+
+TEST(ReadingSet, Invalid)
+{
+	const char *bad[] = {
+		"{ \"count\" : 1, \"rows\" : [ { \"reading\" : ",
+		"{ \"count\" : 1 }",
+		"{ \"rows\" : [ 1 ] }",
+		"{ \"rows\" : { } }",
+		"{ \"rows\" : [ { \"reading\" : { \"x\" : { \"y\" : 1 } } } ] }"
+	};
+	for (auto json : bad)
+	{
+		try {
+			ReadingSet readingSet(json);
+			FAIL() << json;
+		} catch (ReadingSetException *ex) {
+			delete ex;
+		}
+	}
+}
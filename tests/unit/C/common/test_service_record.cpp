@@ -19,3 +19,18 @@ string expected("{ \"name\" : \"test1\",\"type\" : \"testType\",\"protocol\" : \
 	ASSERT_EQ(json.compare(expected), 0);
 }
 
+
+/**
+ * Creation of service record JSON with a Unix domain socket
+ */
+TEST(ServiceRecordTest, SocketJSON)
+{
+ServiceRecord serviceRecord("test1", "testType", "http", "localhost", 1234, 4321);
+string json;
+string expected("{ \"name\" : \"test1\",\"type\" : \"testType\",\"protocol\" : \"http\",\"address\" : \"localhost\",\"management_port\" : 4321,\"service_port\" : 1234 ,\"service_socket\" : \"/tmp/storage.sock\" }");
+
+	serviceRecord.setSocket("/tmp/storage.sock");
+	serviceRecord.asJSON(json);
+
+	ASSERT_EQ(json.compare(expected), 0);
+}
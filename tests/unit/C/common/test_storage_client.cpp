@@ -0,0 +1,369 @@
+#include <gtest/gtest.h>
+#include <storage_client.h>
+#include <binary_readings.h>
+#include <local_http_server.h>
+#include <rapidjson/document.h>
+#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <set>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+using namespace std;
+using namespace rapidjson;
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+#define TEST_SOCKET	"/tmp/test_storage_client.sock"
+
+/*
+ * A storage service that records the table updates it is sent
+ */
+class UpdateServer {
+	public:
+		UpdateServer(const string& socketPath = "")
+		{
+			m_server.setSocketPath(socketPath);
+			m_server.config.port = 0;
+			m_server.config.address = "127.0.0.1";
+			m_server.resource["^/storage/table/([A-Za-z0-9_]*)$"]["PUT"] =
+				[this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+					lock_guard<mutex> guard(m_mutex);
+					m_updates.push_back(request->content.string());
+					string payload = "{ \"response\" : \"updated\", \"rows_affected\" : 1 }";
+					*response << "HTTP/1.1 200 OK\r\nContent-Length: " << payload.length() << "\r\n"
+						  <<  "Content-type: application/json\r\n\r\n" << payload;
+				};
+			m_port = m_server.bind();
+			m_thread = thread(&LocalHttpServer::accept_and_run, &m_server);
+		};
+		~UpdateServer()
+		{
+			m_server.stop();
+			m_thread.join();
+		};
+		unsigned short	getPort() const { return m_port; };
+		vector<string>	getUpdates()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			return m_updates;
+		};
+		const string&	getSocketPath() const { return m_server.getSocketPath(); };
+	private:
+		LocalHttpServer	m_server;
+		unsigned short	m_port;
+		thread		m_thread;
+		mutex		m_mutex;
+		vector<string>	m_updates;
+};
+
+/*
+ * A storage service that answers readings appends with the given
+ * statuses in turn and records the content type of each append
+ */
+class AppendServer {
+	public:
+		AppendServer(const vector<string>& statuses) : m_statuses(statuses)
+		{
+			m_server.config.port = 0;
+			m_server.config.address = "127.0.0.1";
+			m_server.resource["^/storage/reading$"]["POST"] =
+				[this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+					lock_guard<mutex> guard(m_mutex);
+					auto type = request->header.find("Content-Type");
+					m_types.push_back(type == request->header.end() ? "" : type->second);
+					string status = m_statuses.empty() ? "200 OK" : m_statuses.front();
+					if (!m_statuses.empty())
+						m_statuses.erase(m_statuses.begin());
+					string payload = "{ \"response\" : \"appended\" }";
+					*response << "HTTP/1.1 " << status << "\r\nContent-Length: " << payload.length() << "\r\n"
+						  << "Accept: " READINGS_BINARY_CONTENT_TYPE ", application/json\r\n"
+						  << "Retry-After: 1\r\n"
+						  << "Content-type: application/json\r\n\r\n" << payload;
+				};
+			m_port = m_server.bind();
+			m_thread = thread(&LocalHttpServer::accept_and_run, &m_server);
+		};
+		~AppendServer()
+		{
+			m_server.stop();
+			m_thread.join();
+		};
+		unsigned short	getPort() const { return m_port; };
+		vector<string>	getTypes()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			return m_types;
+		};
+	private:
+		LocalHttpServer	m_server;
+		unsigned short	m_port;
+		thread		m_thread;
+		mutex		m_mutex;
+		vector<string>	m_statuses;
+		vector<string>	m_types;
+};
+
+/*
+ * Wait until the server thread listens on the port, the streamed
+ * fetch makes one attempt to connect
+ */
+static void waitForListen(unsigned short port)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for (;;)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		int rval = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+		close(fd);
+		if (rval == 0)
+		{
+			return;
+		}
+		this_thread::yield();
+	}
+}
+
+/*
+ * A storage service that answers readings fetches and records the
+ * client port of each, so the connections used can be counted
+ */
+class FetchServer {
+	public:
+		FetchServer()
+		{
+			m_server.config.port = 0;
+			m_server.config.address = "127.0.0.1";
+			m_server.resource["^/storage/reading$"]["GET"] =
+				[this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+					{
+						lock_guard<mutex> guard(m_mutex);
+						m_ports.insert(request->remote_endpoint_port());
+					}
+					string payload = "{ \"count\" : 1, \"rows\" : [ { \"id\" : 1, "
+						"\"asset_code\" : \"fetch\", \"read_key\" : \"\", "
+						"\"reading\" : { \"value\" : 1 }, "
+						"\"user_ts\" : \"2018-01-01 00:00:00.000000\", "
+						"\"ts\" : \"2018-01-01 00:00:00.000000\" } ] }";
+					*response << "HTTP/1.1 200 OK\r\nContent-Length: " << payload.length() << "\r\n"
+						  << "Content-type: application/json\r\n\r\n" << payload;
+				};
+			m_port = m_server.bind();
+			m_thread = thread(&LocalHttpServer::accept_and_run, &m_server);
+			waitForListen(m_port);
+		};
+		~FetchServer()
+		{
+			m_server.stop();
+			m_thread.join();
+		};
+		unsigned short	getPort() const { return m_port; };
+		size_t		getConnections()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			return m_ports.size();
+		};
+	private:
+		LocalHttpServer	m_server;
+		unsigned short	m_port;
+		thread		m_thread;
+		mutex		m_mutex;
+		set<unsigned short>	m_ports;
+};
+
+static void statistic(vector<pair<ExpressionValues *, Where *>>& updates, const string& key, int value)
+{
+	ExpressionValues *values = new ExpressionValues;
+	values->push_back(Expression("value", "+", value));
+	updates.emplace_back(values, new Where("key", Equals, key));
+}
+
+static void freeUpdates(vector<pair<ExpressionValues *, Where *>>& updates)
+{
+	for (auto& update : updates)
+	{
+		delete update.first;
+		delete update.second;
+	}
+	updates.clear();
+}
+
+TEST(StorageClientTest, QueueUpdates)
+{
+	UpdateServer server;
+	{
+		StorageClient client("127.0.0.1", server.getPort());
+		vector<pair<ExpressionValues *, Where *>> updates;
+		for (int i = 0; i < 10; i++)
+		{
+			statistic(updates, "READINGS", i);
+			client.queueUpdates("statistics", updates);
+			freeUpdates(updates);
+		}
+	}
+	// All the updates are sent, in as many requests as the sender needed
+	vector<string> requests = server.getUpdates();
+	ASSERT_LE(1, requests.size());
+	int sent = 0, total = 0;
+	for (auto& request : requests)
+	{
+		Document doc;
+		doc.Parse(request.c_str());
+		ASSERT_FALSE(doc.HasParseError());
+		for (auto& update : doc["updates"].GetArray())
+		{
+			ASSERT_STREQ("READINGS", update["where"]["value"].GetString());
+			total += update["expressions"][0]["value"].GetInt();
+			sent++;
+		}
+	}
+	ASSERT_EQ(10, sent);
+	ASSERT_EQ(45, total);
+}
+
+TEST(StorageClientTest, Latency)
+{
+	UpdateServer server;
+	StorageClient client("127.0.0.1", server.getPort());
+	client.setPoolSize(2);
+	vector<thread> threads;
+	for (int i = 0; i < 4; i++)
+	{
+		threads.emplace_back([&client]() {
+			ExpressionValues values;
+			values.push_back(Expression("value", "+", 1));
+			for (int j = 0; j < 5; j++)
+			{
+				client.updateTable("statistics", values, Where("key", Equals, "READINGS"));
+			}
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	ASSERT_EQ(20, server.getUpdates().size());
+	Document doc;
+	doc.Parse(client.latencyJSON().c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_TRUE(doc.HasMember("PUT /storage/table/statistics"));
+	ASSERT_EQ(20, doc["PUT /storage/table/statistics"]["count"].GetInt());
+}
+
+TEST(StorageClientTest, PoolStatistics)
+{
+	UpdateServer server;
+	StorageClient client("127.0.0.1", server.getPort());
+	client.setPoolSize(2);
+	client.setIdleTimeout(30);
+	ExpressionValues values;
+	values.push_back(Expression("value", "+", 1));
+	ASSERT_EQ(1, client.updateTable("statistics", values, Where("key", Equals, "READINGS")));
+	string json;
+	client.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(1, doc["connections"].GetInt());
+	ASSERT_EQ(1, doc["idleConnections"].GetInt());
+	ASSERT_EQ(2, doc["poolSize"].GetInt());
+	ASSERT_EQ(30, doc["idleTimeout"].GetInt());
+	ASSERT_EQ(1, doc["latency"]["PUT /storage/table/statistics"]["count"].GetInt());
+}
+
+TEST(StorageClientTest, UnixSocket)
+{
+	UpdateServer server(TEST_SOCKET);
+	ASSERT_EQ(string(TEST_SOCKET), server.getSocketPath());
+	// A port that is not listening, all requests must use the socket
+	StorageClient client("127.0.0.1", 1, server.getSocketPath());
+	ExpressionValues values;
+	values.push_back(Expression("value", "+", 1));
+	for (int i = 0; i < 5; i++)
+	{
+		ASSERT_EQ(1, client.updateTable("statistics", values, Where("key", Equals, "READINGS")));
+	}
+	ASSERT_EQ(5, server.getUpdates().size());
+}
+
+TEST(StorageClientTest, AppendBusy)
+{
+	AppendServer server({ "200 OK", "503 Service Unavailable" });
+	StorageClient client("127.0.0.1", server.getPort());
+	DatapointValue value((long) 1);
+	Reading reading(string("test"), new Datapoint("x", value));
+	vector<Reading *> readings = { &reading };
+
+	// The first append is JSON, the response asks for binary
+	ASSERT_TRUE(client.readingAppend(readings));
+	// A busy storage service must not be sent the readings again as JSON
+	ASSERT_FALSE(client.readingAppend(readings));
+	vector<string> types = server.getTypes();
+	ASSERT_EQ(2, types.size());
+	ASSERT_EQ(string(READINGS_BINARY_CONTENT_TYPE), types[1]);
+	// Nothing is sent until the Retry-After delay has passed
+	ASSERT_FALSE(client.readingAppend(readings));
+	ASSERT_EQ(2, server.getTypes().size());
+}
+
+TEST(StorageClientTest, AppendBadRequest)
+{
+	AppendServer server({ "200 OK", "400 Bad Request", "200 OK" });
+	StorageClient client("127.0.0.1", server.getPort());
+	DatapointValue value((long) 1);
+	Reading reading(string("test"), new Datapoint("x", value));
+	vector<Reading *> readings = { &reading };
+
+	ASSERT_TRUE(client.readingAppend(readings));
+	// A bad request is not resent as JSON and does not stop binary appends
+	ASSERT_FALSE(client.readingAppend(readings));
+	ASSERT_TRUE(client.readingAppend(readings));
+	vector<string> types = server.getTypes();
+	ASSERT_EQ(3, types.size());
+	ASSERT_EQ(string(READINGS_BINARY_CONTENT_TYPE), types[1]);
+	ASSERT_EQ(string(READINGS_BINARY_CONTENT_TYPE), types[2]);
+}
+
+TEST(StorageClientTest, AppendUnsupportedMediaType)
+{
+	AppendServer server({ "200 OK", "415 Unsupported Media Type", "200 OK" });
+	StorageClient client("127.0.0.1", server.getPort());
+	DatapointValue value((long) 1);
+	Reading reading(string("test"), new Datapoint("x", value));
+	vector<Reading *> readings = { &reading };
+
+	ASSERT_TRUE(client.readingAppend(readings));
+	// The binary batch is refused and resent as JSON
+	ASSERT_TRUE(client.readingAppend(readings));
+	vector<string> types = server.getTypes();
+	ASSERT_EQ(3, types.size());
+	ASSERT_EQ(string(READINGS_BINARY_CONTENT_TYPE), types[1]);
+	ASSERT_NE(string(READINGS_BINARY_CONTENT_TYPE), types[2]);
+}
+
+TEST(StorageClientTest, FetchReusesConnection)
+{
+	FetchServer server;
+	StorageClient client("127.0.0.1", server.getPort());
+	for (int i = 0; i < 3; i++)
+	{
+		ReadingSet *readings = client.readingFetch(1, 10);
+		ASSERT_NE((ReadingSet *)NULL, readings);
+		ASSERT_EQ(1, readings->getCount());
+		ASSERT_EQ(string("fetch"), readings->getAllReadings()[0]->getAssetName());
+		delete readings;
+	}
+	ASSERT_EQ(1, server.getConnections());
+	string json = client.latencyJSON();
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(3, doc["GET /storage/reading"]["count"].GetInt());
+}
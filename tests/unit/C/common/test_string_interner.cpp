@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <string_interner.h>
+#include <reading.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(StringInternerTest, SameId)
+{
+	StringInterner *interner = StringInterner::getInstance();
+	unsigned int id = interner->intern("interner_test_one");
+	ASSERT_EQ(id, interner->intern(string("interner_test_one")));
+	ASSERT_NE(id, interner->intern("interner_test_two"));
+	ASSERT_EQ(string("interner_test_one"), interner->lookup(id));
+}
+
+TEST(StringInternerTest, EmptyString)
+{
+	StringInterner *interner = StringInterner::getInstance();
+	ASSERT_EQ(0, interner->intern(""));
+	ASSERT_EQ(string(""), interner->lookup(0));
+}
+
+TEST(StringInternerTest, StableAddress)
+{
+	StringInterner *interner = StringInterner::getInstance();
+	unsigned int id = interner->intern("interner_test_stable");
+	const string *name = &interner->lookup(id);
+	for (int i = 0; i < INTERNER_CHUNK_SIZE + 100; i++)
+	{
+		interner->intern("interner_test_stable_" + to_string(i));
+	}
+	ASSERT_EQ(name, &interner->lookup(id));
+	ASSERT_EQ(string("interner_test_stable"), *name);
+}
+
+TEST(StringInternerTest, ReadingNames)
+{
+	DatapointValue value(1.5);
+	Reading a(string("interner_asset"), new Datapoint("temperature", value));
+	Reading b(string("interner_asset"), new Datapoint("temperature", value));
+	ASSERT_EQ(a.getAssetId(), b.getAssetId());
+	ASSERT_EQ(&a.getAssetName(), &b.getAssetName());
+	ASSERT_EQ(a.getReadingData()[0]->getNameId(), b.getReadingData()[0]->getNameId());
+	b.setAssetName("interner_other");
+	ASSERT_NE(a.getAssetId(), b.getAssetId());
+	ASSERT_EQ(string("interner_other"), b.getAssetName());
+}
+
+TEST(StringInternerTest, Threads)
+{
+	StringInterner *interner = StringInterner::getInstance();
+	vector<unsigned int> ids[4];
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(thread([interner, &ids, t]() {
+			for (int i = 0; i < 200; i++)
+			{
+				ids[t].push_back(interner->intern("interner_test_thread_" + to_string(i)));
+			}
+		}));
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	for (int t = 1; t < 4; t++)
+	{
+		ASSERT_EQ(ids[0], ids[t]);
+	}
+	ASSERT_EQ(string("interner_test_thread_7"), interner->lookup(ids[0][7]));
+}
+
+/**
+ * Fill the interner and check names are still held once it is full
+ */
+static bool fillInterner()
+{
+	StringInterner *interner = StringInterner::getInstance();
+	unsigned int before = interner->intern("interner_test_before");
+	int i = 0;
+	while (interner->intern("interner_test_fill_" + to_string(i++)) != INTERNER_NOT_INTERNED)
+		;
+	InternedName a(string("interner_test_after")), b(string("interner_test_after"));
+	InternedName c(a), d(string("interner_test_other"));
+	DatapointValue value(1L);
+	Reading reading(string("interner_test_asset"), new Datapoint("interner_test_dp", value));
+	return interner->intern("interner_test_before") == before
+		&& a.id() == INTERNER_NOT_INTERNED
+		&& a == b && a == c && !(a == d)
+		&& hash<InternedName>()(a) == hash<InternedName>()(b)
+		&& c.str() == "interner_test_after"
+		&& reading.getAssetName() == "interner_test_asset"
+		&& reading.getReadingData()[0]->getName() == "interner_test_dp";
+}
+
+TEST(StringInternerTest, Full)
+{
+	// Run in a child process as the interner can not be emptied
+	EXPECT_EXIT(exit(fillInterner() ? 0 : 1), ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <timestamp_codec.h>
+#include <reading.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+using namespace std;
+
+/*
+ * The strptime and mktime based conversion the codec replaces
+ */
+static void referenceParse(const char *timestamp, struct timeval *ts)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(struct tm));
+	strptime(timestamp, "%Y-%m-%d %H:%M:%S", &tm);
+	ts->tv_sec = timegm(&tm);
+	const char *ptr = strchr(timestamp, '.');
+	ts->tv_usec = 0;
+	if (ptr)
+	{
+		char *eptr;
+		ts->tv_usec = strtol(ptr + 1, &eptr, 10);
+		for (int digits = eptr - (ptr + 1); digits < 6; digits++)
+			ts->tv_usec *= 10;
+	}
+	ptr = timestamp + 10;
+	while (*ptr && *ptr != '-' && *ptr != '+')
+		ptr++;
+	if (*ptr)
+	{
+		int h, m;
+		int sign = (*ptr == '+' ? -1 : +1);
+		sscanf(ptr + 1, "%02d:%02d", &h, &m);
+		ts->tv_sec += sign * ((3600 * h) + (60 * m));
+	}
+}
+
+/*
+ * The gmtime_r and strftime based formatting the codec replaces
+ */
+static string referenceFormat(const struct timeval& tv)
+{
+	char date_time[52], micro_s[10];
+	struct tm timeinfo;
+	gmtime_r(&tv.tv_sec, &timeinfo);
+	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", &timeinfo);
+	snprintf(micro_s, sizeof(micro_s), ".%06lu", (unsigned long)tv.tv_usec);
+	return string(date_time) + micro_s;
+}
+
+TEST(TimestampCodecTest, Parse)
+{
+	const char *timestamps[] = {
+		"2019-01-10 10:01:03.123456+00:00",
+		"2019-01-10 10:01:03.123456-1:00",
+		"2019-01-10 10:01:03.123456+8:00",
+		"2019-01-10 10:01:03.123456-05:30",
+		"2019-01-10 10:01:03.1+00:00",
+		"2019-01-10 10:01:03",
+		"2016-02-29 23:59:59.999999",
+		"2000-03-01 00:00:00.000001",
+		"1969-12-31 23:59:59.5",
+		"2100-12-31 12:00:00.000010+01:00",
+		"2038-01-19 03:14:08.000000"
+	};
+	for (auto timestamp : timestamps)
+	{
+		struct timeval fast, reference;
+		ASSERT_TRUE(TimestampCodec::parse(timestamp, &fast)) << timestamp;
+		referenceParse(timestamp, &reference);
+		ASSERT_EQ(reference.tv_sec, fast.tv_sec) << timestamp;
+		ASSERT_EQ(reference.tv_usec, fast.tv_usec) << timestamp;
+	}
+}
+
+TEST(TimestampCodecTest, ParseVariants)
+{
+	struct timeval tv;
+	ASSERT_TRUE(TimestampCodec::parse("2019-01-10T10:01:03.5Z", &tv));
+	ASSERT_EQ(1547114463, tv.tv_sec);
+	ASSERT_EQ(500000, tv.tv_usec);
+	ASSERT_TRUE(TimestampCodec::parse("2019-01-10 10:01:03 +0000", &tv));
+	ASSERT_EQ(1547114463, tv.tv_sec);
+	ASSERT_FALSE(TimestampCodec::parse("2019-1-10 10:01:03", &tv));
+	ASSERT_FALSE(TimestampCodec::parse("2019-01-10", &tv));
+	ASSERT_FALSE(TimestampCodec::parse("2019-13-10 10:01:03", &tv));
+	ASSERT_FALSE(TimestampCodec::parse("2019-01-10 10:01:03.+00:00", &tv));
+	ASSERT_FALSE(TimestampCodec::parse("2019-01-10 10:01:03 junk", &tv));
+}
+
+TEST(TimestampCodecTest, Format)
+{
+	// Step through a range of dates either side of the epoch
+	for (long secs = -400L * 86400 * 365; secs < 400L * 86400 * 365; secs += 86400L * 997 + 3607)
+	{
+		struct timeval tv;
+		tv.tv_sec = secs;
+		tv.tv_usec = secs % 1000000;
+		if (tv.tv_usec < 0)
+			tv.tv_usec = -tv.tv_usec;
+		char buf[TIMESTAMP_BUFFER_LEN];
+		size_t len = TimestampCodec::format(tv, buf);
+		ASSERT_EQ(referenceFormat(tv), string(buf, len));
+	}
+}
+
+TEST(TimestampCodecTest, FormatSeparator)
+{
+	struct timeval tv;
+	tv.tv_sec = 1547114463;
+	tv.tv_usec = 42;
+	char buf[TIMESTAMP_BUFFER_LEN];
+	ASSERT_EQ(19, TimestampCodec::format(tv, buf, 'T', false));
+	ASSERT_EQ(string("2019-01-10T10:01:03"), string(buf));
+}
+
+TEST(TimestampCodecTest, RoundTrip)
+{
+	DatapointValue value((long) 1);
+	Reading reading(string("test"), new Datapoint("x", value));
+	reading.setUserTimestamp("2019-01-10 10:01:03.123456+00:00");
+	ASSERT_EQ(string("2019-01-10 10:01:03.123456"), reading.getAssetDateUserTime());
+	ASSERT_EQ(string("2019-01-10T10:01:03.123456"), reading.getAssetDateUserTime(Reading::FMT_STANDARD));
+	ASSERT_EQ(string("2019-01-10 10:01:03 +0000"), reading.getAssetDateUserTime(Reading::FMT_ISO8601));
+	ASSERT_EQ(string("2019-01-10 10:01:03"), reading.getAssetDateUserTime(Reading::FMT_DEFAULT, false));
+}
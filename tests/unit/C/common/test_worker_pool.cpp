@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <worker_pool.h>
+#include <rapidjson/document.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+using namespace std;
+using namespace rapidjson;
+
+TEST(WorkerPoolTest, RunsTasks)
+{
+	atomic<int> count(0);
+	{
+		WorkerPool pool("test", 2, 100);
+		for (int i = 0; i < 50; i++)
+		{
+			ASSERT_TRUE(pool.submit([&count]() { count++; }));
+		}
+		pool.stop();
+	}
+	ASSERT_EQ(50, count);
+}
+
+TEST(WorkerPoolTest, RejectsWhenFull)
+{
+	mutex mtx;
+	condition_variable cv;
+	bool started = false, release = false;
+	WorkerPool pool("test", 1, 2);
+
+	// Block the only thread so that later tasks stay queued
+	ASSERT_TRUE(pool.submit([&]() {
+		unique_lock<mutex> lck(mtx);
+		started = true;
+		cv.notify_all();
+		cv.wait(lck, [&]() { return release; });
+	}));
+	{
+		unique_lock<mutex> lck(mtx);
+		cv.wait(lck, [&]() { return started; });
+	}
+	ASSERT_TRUE(pool.submit([]() {}));
+	ASSERT_TRUE(pool.submit([]() {}));
+	ASSERT_EQ(2, pool.getDepth());
+	ASSERT_FALSE(pool.submit([]() {}));
+	{
+		lock_guard<mutex> guard(mtx);
+		release = true;
+	}
+	cv.notify_all();
+	pool.stop();
+	ASSERT_EQ(0, pool.getDepth());
+	ASSERT_FALSE(pool.submit([]() {}));
+
+	string json;
+	pool.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError()) << json;
+	ASSERT_EQ(1, doc["threads"].GetInt());
+	ASSERT_EQ(2, doc["queueSize"].GetInt());
+	ASSERT_EQ(0, doc["depth"].GetInt());
+	ASSERT_EQ(2, doc["maxDepth"].GetInt());
+	ASSERT_EQ(0, doc["active"].GetInt());
+	ASSERT_EQ(3, doc["completed"].GetInt());
+	ASSERT_EQ(2, doc["rejected"].GetInt());
+	ASSERT_TRUE(doc["averageWait"].IsNumber());
+	ASSERT_TRUE(doc["averageRun"].IsNumber());
+}
+
+TEST(WorkerPoolTest, TaskException)
+{
+	atomic<int> count(0);
+	WorkerPool pool("test", 1, 10);
+	ASSERT_TRUE(pool.submit([]() { throw runtime_error("task failed"); }));
+	ASSERT_TRUE(pool.submit([&count]() { count++; }));
+	pool.stop();
+	ASSERT_EQ(1, count);
+}
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <omf.h>
+#include <http_sender.h>
+#include <algorithm>
+
+/*
+ * FogLAMP OMF parallel data messages unit tests
+ *
+ * Copyright (c) 2018 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+using namespace std;
+
+#define PARALLEL_READINGS 400
+#define PARALLEL_SENDERS 4
+
+/**
+ * An HTTP sender that counts the readings in the data messages
+ * and fails them on request
+ */
+class FakeSender : public HttpSender
+{
+	public:
+		FakeSender() : m_fail(false), m_readings(0) {};
+		int sendRequest(const string& method,
+				const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload)
+		{
+			size_t readings = 0;
+			bool data = false;
+			for (auto& header : headers)
+			{
+				data |= header.first == "messagetype" && header.second == "Data";
+			}
+			for (size_t pos = payload.find("\"Time\": ");
+			     data && pos != string::npos;
+			     pos = payload.find("\"Time\": ", pos + 1))
+			{
+				readings++;
+			}
+			if (readings && m_fail)
+			{
+				return 500;
+			}
+			m_readings += readings;
+			return 204;
+		};
+		string getHostPort() { return "fake:0"; };
+
+		bool		m_fail;
+		size_t		m_readings;
+};
+
+// Build a block of readings with ids from 1
+static ReadingSet *createBlock()
+{
+	string json = "{ \"count\" : " + to_string(PARALLEL_READINGS) + ", \"rows\" : [";
+	for (int i = 1; i <= PARALLEL_READINGS; i++)
+	{
+		if (i > 1)
+		{
+			json += ", ";
+		}
+		json += "{ \"id\": " + to_string(i) + ", \"asset_code\": \"luxometer\", "
+			"\"read_key\": \"5b3be500-ff95-41ae-b5a4-cc99d08bef4a\", "
+			"\"reading\": { \"lux\": " + to_string(i) + ".5 }, "
+			"\"user_ts\": \"2018-06-11 14:00:08.532958\", "
+			"\"ts\": \"2018-06-12 14:47:18.872708\" }";
+	}
+	json += "] }";
+	return new ReadingSet(json);
+}
+
+// All the data messages are acknowledged
+TEST(OMF_parallel, AllAcknowledged)
+{
+	ReadingSet *block = createBlock();
+	FakeSender fakes[PARALLEL_SENDERS];
+	vector<HttpSender *> senders;
+	for (int i = 0; i < PARALLEL_SENDERS; i++)
+	{
+		senders.push_back(&fakes[i]);
+	}
+	map<string, OMFDataTypes> types;
+	OMFAcknowledged acknowledged;
+	vector<pair<string, string>> staticData;
+	OMF omf(fakes[0], "/", types, "ABC");
+	omf.setStaticData(&staticData);
+	omf.setDataSenders(senders);
+	omf.setAcknowledged(&acknowledged);
+
+	ASSERT_EQ(PARALLEL_READINGS, omf.sendToServer(block->getAllReadings(), false));
+	for (int i = 0; i < PARALLEL_SENDERS; i++)
+	{
+		// Each connection has sent a share of the block
+		ASSERT_EQ(PARALLEL_READINGS / PARALLEL_SENDERS, fakes[i].m_readings);
+	}
+	ASSERT_TRUE(acknowledged.acknowledged.empty());
+	delete block;
+}
+
+// Count the readings sent by all the senders
+static size_t sentReadings(FakeSender *fakes)
+{
+	size_t sent = 0;
+	for (int i = 0; i < PARALLEL_SENDERS; i++)
+	{
+		sent += fakes[i].m_readings;
+	}
+	return sent;
+}
+
+// A failed data message does not hold back the messages after it,
+// no acknowledged message is sent again
+TEST(OMF_parallel, PartialAcknowledgement)
+{
+	ReadingSet *block = createBlock();
+	FakeSender fakes[PARALLEL_SENDERS];
+	vector<HttpSender *> senders;
+	for (int i = 0; i < PARALLEL_SENDERS; i++)
+	{
+		senders.push_back(&fakes[i]);
+	}
+	map<string, OMFDataTypes> types;
+	OMFAcknowledged acknowledged;
+	vector<pair<string, string>> staticData;
+	OMF omf(fakes[0], "/", types, "ABC");
+	omf.setStaticData(&staticData);
+	omf.setDataSenders(senders);
+	omf.setAcknowledged(&acknowledged);
+
+	fakes[1].m_fail = true;
+	fakes[3].m_fail = true;
+	ASSERT_EQ(0, omf.sendToServer(block->getAllReadings(), false));
+	ASSERT_EQ(1, acknowledged.firstId);
+	ASSERT_EQ(PARALLEL_READINGS, acknowledged.count);
+	ASSERT_EQ(PARALLEL_READINGS / 2, count(acknowledged.acknowledged.begin(),
+					       acknowledged.acknowledged.end(), true));
+	// The readings of the messages after the failed one are acknowledged
+	ASSERT_TRUE(acknowledged.acknowledged[2 * PARALLEL_READINGS / PARALLEL_SENDERS]);
+	ASSERT_FALSE(acknowledged.acknowledged[PARALLEL_READINGS - 1]);
+
+	// Send the block again, only the readings not acknowledged are sent
+	fakes[1].m_fail = false;
+	fakes[3].m_fail = false;
+	size_t sent = sentReadings(fakes);
+	ASSERT_EQ(PARALLEL_READINGS, omf.sendToServer(block->getAllReadings(), false));
+	ASSERT_EQ(PARALLEL_READINGS / 2, sentReadings(fakes) - sent);
+	ASSERT_EQ(0, acknowledged.count);
+	ASSERT_TRUE(acknowledged.acknowledged.empty());
+	delete block;
+}
+
+// Readings acknowledged by different attempts add up, each reading
+// is acknowledged once
+TEST(OMF_parallel, RepeatedFailures)
+{
+	ReadingSet *block = createBlock();
+	FakeSender fakes[PARALLEL_SENDERS];
+	vector<HttpSender *> senders;
+	for (int i = 0; i < PARALLEL_SENDERS; i++)
+	{
+		senders.push_back(&fakes[i]);
+	}
+	map<string, OMFDataTypes> types;
+	OMFAcknowledged acknowledged;
+	vector<pair<string, string>> staticData;
+	OMF omf(fakes[0], "/", types, "ABC");
+	omf.setStaticData(&staticData);
+	omf.setDataSenders(senders);
+	omf.setAcknowledged(&acknowledged);
+
+	// The first message of each attempt fails
+	fakes[0].m_fail = true;
+	ASSERT_EQ(0, omf.sendToServer(block->getAllReadings(), false));
+	ASSERT_EQ(0, omf.sendToServer(block->getAllReadings(), false));
+	fakes[0].m_fail = false;
+	ASSERT_EQ(PARALLEL_READINGS, omf.sendToServer(block->getAllReadings(), false));
+	ASSERT_EQ(PARALLEL_READINGS, sentReadings(fakes));
+	delete block;
+}
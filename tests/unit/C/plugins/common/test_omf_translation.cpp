@@ -4,6 +4,8 @@
 #include <omf.h>
 #include <rapidjson/document.h>
 #include <simple_https.h>
+#include <string.h>
+#include <zlib.h>
 
 /*
  * FogLAMP Readings to OMF translation unit tests
@@ -173,3 +175,85 @@ TEST(OMF_transation, SuperSet)
 	// Superset map is empty
 	ASSERT_EQ(0, superSetDataPoints.size());
 }
+
+// Inflate a gzip payload
+static string gunzip(const string& payload)
+{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	inflateInit2(&zs, 15 | 16);
+	zs.next_in = (Bytef *)payload.data();
+	zs.avail_in = payload.size();
+	string out;
+	char buffer[4096];
+	int ret;
+	do {
+		zs.next_out = (Bytef *)buffer;
+		zs.avail_out = sizeof(buffer);
+		ret = inflate(&zs, Z_NO_FLUSH);
+		out.append(buffer, sizeof(buffer) - zs.avail_out);
+	} while (ret == Z_OK);
+	inflateEnd(&zs);
+	return out;
+}
+
+// The data message written by OMFDataWriter matches the translated readings
+TEST(OMF_transation, WriterCompareResult)
+{
+	ReadingSet readingSet(two_readings);
+
+	OMFDataWriter writer(false, false);
+	for (auto reading : readingSet.getAllReadings())
+	{
+		writer.append(*reading, TYPE_ID);
+	}
+	ASSERT_EQ(0, writer.finish().compare(two_translated_readings));
+	ASSERT_EQ(2, writer.readings());
+	ASSERT_EQ(two_translated_readings.length(), writer.length());
+}
+
+// A compressed data message larger than the writer buffer inflates
+// to the translated readings
+TEST(OMF_transation, WriterCompressed)
+{
+	ReadingSet readingSet(two_readings);
+
+	string expected = "[";
+	OMFDataWriter writer(true, true);
+	for (int i = 0; i < 1000; i++)
+	{
+		for (auto reading : readingSet.getAllReadings())
+		{
+			if (expected.length() > 1)
+			{
+				expected.append(", ");
+			}
+			expected.append(OMFData(*reading, TYPE_ID).OMFdataVal());
+			writer.append(*reading, TYPE_ID);
+		}
+	}
+	expected.append("]");
+	const string& payload = writer.finish();
+
+	ASSERT_GT(expected.length(), OMF_WRITER_BUFFER);
+	ASSERT_LT(payload.length(), expected.length());
+	ASSERT_EQ(0, gunzip(payload).compare(expected));
+	ASSERT_EQ(0, writer.logText().compare(expected));
+}
+
+// Without a copy of the uncompressed text the log text describes
+// the compressed payload
+TEST(OMF_transation, WriterDescription)
+{
+	ReadingSet readingSet(two_readings);
+
+	OMFDataWriter writer(true);
+	for (auto reading : readingSet.getAllReadings())
+	{
+		writer.append(*reading, TYPE_ID);
+	}
+	writer.finish();
+	ASSERT_EQ(0, writer.logText().compare("<2 readings, " +
+					      to_string(two_translated_readings.length()) +
+					      " bytes compressed>"));
+}
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 #include <connection.h>
+#include <readings_partitions.h>
 #include "gtest/gtest.h"
 #include <logger.h>
+#include <libpq-fe.h>
 #include <string.h>
+#include <stdlib.h>
 #include <string>
+#include <vector>
+#include <thread>
 
 using namespace std;
 
@@ -73,3 +78,160 @@ INSTANTIATE_TEST_CASE_P(
 		RowFormatDate("2019-50-50 10:01:01.0",  "", false)
 	)
 );
+
+/*
+ * The partition tests need a PostgreSQL 11 server, the connection string
+ * of a database they may use is set in FOGLAMP_TEST_DB_CONNECTION. The
+ * foglamp schema of the database is dropped and created again.
+ */
+#define TEST_DB_CONNECTION	"FOGLAMP_TEST_DB_CONNECTION"
+
+/*
+ * Run SQL and return the first column of the first row as an integer
+ */
+static long pgValue(PGconn *conn, const string& sql)
+{
+	PGresult *res = PQexec(conn, sql.c_str());
+	long value = -1;
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
+	{
+		value = atol(PQgetvalue(res, 0, 0));
+	}
+	else if (PQresultStatus(res) == PGRES_COMMAND_OK)
+	{
+		value = 0;
+	}
+	PQclear(res);
+	return value;
+}
+
+/*
+ * A readings payload of readings of an asset taken now
+ */
+static string readingsPayload(const string& asset, int count)
+{
+	string payload = "{ \"readings\" : [ ";
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			payload += ", ";
+		payload += "{ \"asset_code\" : \"" + asset + "\", \"user_ts\" : \"now()\", "
+			"\"reading\" : { \"value\" : " + to_string(i) + " } }";
+	}
+	return payload + " ] }";
+}
+
+/*
+ * A readings table partitioned by hour, created from a table holding
+ * ten readings with ids 1 to 10
+ */
+class PartitionTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			const char *connInfo = getenv(TEST_DB_CONNECTION);
+			if (!connInfo)
+			{
+				GTEST_SKIP() << TEST_DB_CONNECTION << " is not set";
+			}
+			m_admin = PQconnectdb(connInfo);
+			ASSERT_EQ(CONNECTION_OK, PQstatus(m_admin)) << PQerrorMessage(m_admin);
+			ASSERT_EQ(0, pgValue(m_admin, "DROP SCHEMA IF EXISTS foglamp CASCADE;"
+				"CREATE SCHEMA foglamp;"
+				"CREATE SEQUENCE foglamp.readings_id_seq;"
+				"CREATE TABLE foglamp.readings ("
+				"id bigint NOT NULL DEFAULT nextval('foglamp.readings_id_seq'::regclass),"
+				"asset_code character varying(50) NOT NULL,"
+				"read_key uuid UNIQUE,"
+				"reading jsonb NOT NULL DEFAULT '{}'::jsonb,"
+				"user_ts timestamp(6) with time zone NOT NULL DEFAULT now(),"
+				"ts timestamp(6) with time zone NOT NULL DEFAULT now(),"
+				"CONSTRAINT readings_pkey PRIMARY KEY (id));"
+				"INSERT INTO foglamp.readings (asset_code, user_ts) "
+				"SELECT 'old', '2018-01-01 00:00:00+00' FROM generate_series(1, 10);"));
+			setenv("DB_CONNECTION", connInfo, 1);
+			setenv(PARTITION_ENV, "hour", 1);
+			m_conn = new Connection();
+			ASSERT_TRUE(ReadingsPartitions::initialise(m_conn));
+			unsetenv(PARTITION_ENV);
+		}
+		void TearDown()
+		{
+			if (!m_admin)
+			{
+				return;
+			}
+			ReadingsPartitions::shutdown();
+			delete m_conn;
+			pgValue(m_admin, "DROP SCHEMA IF EXISTS foglamp CASCADE;");
+			PQfinish(m_admin);
+		}
+
+		PGconn		*m_admin = NULL;
+		Connection	*m_conn = NULL;
+};
+
+/*
+ * A partition is kept while it holds readings after the last sent
+ * and dropped once all of them have been sent
+ */
+TEST_F(PartitionTest, PurgeRetainsUnsent)
+{
+	// The first partition ends in the current period, make it old enough to purge
+	pgValue(m_admin, "UPDATE foglamp.readings_partitions SET upper = '2018-01-02 00:00:00+00' "
+			"WHERE name = '" PARTITION_PREFIX "0';");
+	long unsentPurged = 0;
+	ASSERT_EQ(0, ReadingsPartitions::getInstance()->dropExpired(m_conn, 1, 0x01, 9, unsentPurged));
+	ASSERT_EQ(10, ReadingsPartitions::getInstance()->count(m_conn));
+	ASSERT_EQ(10, ReadingsPartitions::getInstance()->dropExpired(m_conn, 1, 0x01, 10, unsentPurged));
+	ASSERT_EQ(0, unsentPurged);
+	ASSERT_EQ(0, ReadingsPartitions::getInstance()->count(m_conn));
+	ASSERT_EQ(0, pgValue(m_admin, "SELECT count(*) FROM pg_class WHERE relname = '" PARTITION_PREFIX "0';"));
+}
+
+/*
+ * An append does not wait for the transaction of another to count its readings
+ */
+TEST_F(PartitionTest, ConcurrentAppendCounts)
+{
+	PGconn *open = PQconnectdb(getenv(TEST_DB_CONNECTION));
+	ASSERT_EQ(0, pgValue(open, "BEGIN; INSERT INTO foglamp.readings (asset_code) VALUES ('open');"));
+	ASSERT_EQ(0, pgValue(m_admin, "SET statement_timeout = 5000;"
+				"INSERT INTO foglamp.readings (asset_code) VALUES ('other');"
+				"SET statement_timeout = 0;"));
+	ASSERT_EQ(0, pgValue(open, "COMMIT;"));
+	PQfinish(open);
+
+	const int threads = 4, appends = 10, readings = 10;
+	vector<thread> appenders;
+	vector<int> added(threads);
+	for (int i = 0; i < threads; i++)
+	{
+		appenders.emplace_back([i, &added]() {
+			Connection conn;
+			for (int j = 0; j < appends; j++)
+			{
+				string payload = readingsPayload("concurrent", readings);
+				added[i] += conn.appendReadings(payload.c_str());
+			}
+		});
+	}
+	for (auto& appender : appenders)
+	{
+		appender.join();
+	}
+	for (int i = 0; i < threads; i++)
+	{
+		ASSERT_EQ(appends * readings, added[i]);
+	}
+	long total = 12 + threads * appends * readings;
+	ASSERT_EQ(total, ReadingsPartitions::getInstance()->count(m_conn));
+
+	// A purge sums the rows of the counts, one remains for each partition
+	long unsentPurged = 0;
+	ASSERT_EQ(0, ReadingsPartitions::getInstance()->dropExpired(m_conn, 100000, 0, 0, unsentPurged));
+	ASSERT_EQ(total, ReadingsPartitions::getInstance()->count(m_conn));
+	ASSERT_EQ(0, pgValue(m_admin, "SELECT count(*) FROM (SELECT partition FROM foglamp.readings_count "
+				"GROUP BY partition HAVING count(*) > 1) AS uncompacted;"));
+	ASSERT_EQ(total, pgValue(m_admin, "SELECT count(*) FROM foglamp.readings;"));
+}
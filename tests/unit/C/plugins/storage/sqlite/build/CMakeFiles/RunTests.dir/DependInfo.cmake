@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/C/plugins/storage/sqlite/common/connection.cpp" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection.cpp.o" "gcc" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection.cpp.o.d"
+  "/root/repo/C/plugins/storage/sqlite/common/connection_manager.cpp" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection_manager.cpp.o" "gcc" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection_manager.cpp.o.d"
+  "/root/repo/C/plugins/storage/sqlite/common/readings.cpp" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings.cpp.o" "gcc" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings.cpp.o.d"
+  "/root/repo/C/plugins/storage/sqlite/common/readings_partitions.cpp" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_partitions.cpp.o" "gcc" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_partitions.cpp.o.d"
+  "/root/repo/C/plugins/storage/sqlite/common/readings_writer.cpp" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_writer.cpp.o" "gcc" "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_writer.cpp.o.d"
+  "/root/repo/tests/unit/C/plugins/storage/sqlite/tests.cpp" "CMakeFiles/RunTests.dir/tests.cpp.o" "gcc" "CMakeFiles/RunTests.dir/tests.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
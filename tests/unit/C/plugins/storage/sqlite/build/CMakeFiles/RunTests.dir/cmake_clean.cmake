@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection.cpp.o"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection.cpp.o.d"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection_manager.cpp.o"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/connection_manager.cpp.o.d"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings.cpp.o"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings.cpp.o.d"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_partitions.cpp.o"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_partitions.cpp.o.d"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_writer.cpp.o"
+  "CMakeFiles/RunTests.dir/root/repo/C/plugins/storage/sqlite/common/readings_writer.cpp.o.d"
+  "CMakeFiles/RunTests.dir/tests.cpp.o"
+  "CMakeFiles/RunTests.dir/tests.cpp.o.d"
+  "RunTests"
+  "RunTests.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/RunTests.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,274 @@
+#include <gtest/gtest.h>
+#include <connection.h>
+#include <readings_writer.h>
+#include <readings_partitions.h>
+#include <sqlite3.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+
+using namespace std;
+
+#define TEST_DB		"/tmp/test_sqlite_plugin.db"
+#define PARTITIONED_DB	"/tmp/test_sqlite_partitions.db"
+
+/*
+ * The readings table of the test database, an append of a reading of
+ * the asset "rollback" rolls back the whole transaction it is part of
+ */
+static const char *schema =
+	"CREATE TABLE readings ("
+	"	id         INTEGER                     PRIMARY KEY AUTOINCREMENT,"
+	"	asset_code character varying(50)       NOT NULL,"
+	"	read_key   uuid                        UNIQUE,"
+	"	reading    JSON                        NOT NULL DEFAULT '{}',"
+	"	user_ts    DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')),"
+	"	ts         DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')));"
+	"CREATE TRIGGER rollback_append BEFORE INSERT ON readings "
+	"	WHEN NEW.asset_code = 'rollback' "
+	"	BEGIN SELECT RAISE(ROLLBACK, 'append rolled back'); END;";
+
+/*
+ * Run SQL on a connection of the test's own, returning the first
+ * column of the first row as an integer
+ */
+static int execute(const string& sql, const char *database = TEST_DB)
+{
+	sqlite3 *db;
+	int value = -1;
+	if (sqlite3_open(database, &db) != SQLITE_OK)
+	{
+		return -1;
+	}
+	sqlite3_busy_timeout(db, 5000);
+	sqlite3_exec(db, sql.c_str(), [](void *arg, int, char **values, char **) -> int {
+			*(int *)arg = values[0] ? atoi(values[0]) : 0;
+			return 0;
+		}, &value, NULL);
+	sqlite3_close(db);
+	return value;
+}
+
+static int countReadings(const string& asset)
+{
+	return execute("SELECT count(*) FROM readings WHERE asset_code = '" + asset + "';");
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    testing::GTEST_FLAG(repeat) = 100;
+    testing::GTEST_FLAG(shuffle) = true;
+    testing::GTEST_FLAG(break_on_failure) = true;
+
+    // The plugin connections open the test database
+    unlink(TEST_DB);
+    execute(schema);
+    setenv("DEFAULT_SQLITE_DB_FILE", TEST_DB, 1);
+
+    int rval = RUN_ALL_TESTS();
+    ReadingsWriter::shutdown();
+    unlink(TEST_DB);
+    return rval;
+}
+
+/*
+ * Rows of readings of an asset, with read keys made from the key
+ * prefix if one is given
+ */
+static vector<ReadingRow> makeRows(const string& asset, int count, const string& keyPrefix = "")
+{
+	vector<ReadingRow> rows;
+	for (int i = 0; i < count; i++)
+	{
+		ReadingRow row;
+		row.userTs = "2018-01-01 00:00:00.000000+00:00";
+		row.assetCode = asset;
+		if (!keyPrefix.empty())
+		{
+			char key[37];
+			snprintf(key, sizeof(key), "%s-0000-0000-0000-%012d", keyPrefix.c_str(), i);
+			row.readKey = key;
+		}
+		row.reading = "{\"value\" : " + to_string(i) + "}";
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+class WriterTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			execute("DELETE FROM readings;");
+		}
+};
+
+TEST_F(WriterTest, Append)
+{
+	ASSERT_EQ(3, ReadingsWriter::getInstance()->append(makeRows("append", 3)));
+	ASSERT_EQ(3, countReadings("append"));
+}
+
+TEST_F(WriterTest, FailedAppendAlone)
+{
+	// The second row repeats the read key of the first
+	vector<ReadingRow> rows = makeRows("duplicate", 2, "00000001");
+	rows[1].readKey = rows[0].readKey;
+	ASSERT_EQ(-1, ReadingsWriter::getInstance()->append(rows));
+	ASSERT_EQ(0, countReadings("duplicate"));
+	ASSERT_EQ(2, ReadingsWriter::getInstance()->append(makeRows("after", 2)));
+	ASSERT_EQ(2, countReadings("after"));
+}
+
+TEST_F(WriterTest, RolledBackTransaction)
+{
+	ASSERT_EQ(-1, ReadingsWriter::getInstance()->append(makeRows("rollback", 1)));
+	ASSERT_EQ(0, countReadings("rollback"));
+	// The writer is not left inside or outside a transaction it did not expect
+	ASSERT_EQ(2, ReadingsWriter::getInstance()->append(makeRows("after", 2)));
+	ASSERT_EQ(2, countReadings("after"));
+}
+
+/*
+ * Concurrent appends are grouped in transactions. Whatever the groups,
+ * an append reported as stored must be in the table and one reported
+ * as failed must not, the failure of one append must not be reported
+ * for another unless the whole transaction was rolled back.
+ */
+TEST_F(WriterTest, GroupCommit)
+{
+	const int appends = 8;
+	vector<int> results(appends);
+	vector<thread> threads;
+	for (int i = 0; i < appends; i++)
+	{
+		threads.emplace_back([i, &results]() {
+			vector<ReadingRow> rows;
+			if (i == 3)
+			{
+				rows = makeRows("rollback", 10);
+			}
+			else if (i == 5)
+			{
+				rows = makeRows("group5", 10, "00000005");
+				rows[9].readKey = rows[0].readKey;
+			}
+			else
+			{
+				rows = makeRows("group" + to_string(i), 10);
+			}
+			results[i] = ReadingsWriter::getInstance()->append(rows);
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	ASSERT_EQ(-1, results[3]);
+	ASSERT_EQ(-1, results[5]);
+	ASSERT_EQ(0, countReadings("rollback"));
+	ASSERT_EQ(0, countReadings("group5"));
+	for (int i = 0; i < appends; i++)
+	{
+		if (i == 3 || i == 5)
+			continue;
+		int stored = countReadings("group" + to_string(i));
+		ASSERT_EQ(results[i] == -1 ? 0 : 10, stored);
+		ASSERT_TRUE(results[i] == -1 || results[i] == 10);
+	}
+}
+
+/*
+ * A database of its own with a partitioned readings table, the
+ * partitions are not used by the readings writer
+ */
+class PartitionTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			unlink(PARTITIONED_DB);
+			::execute(schema, PARTITIONED_DB);
+			setenv("DEFAULT_SQLITE_DB_FILE", PARTITIONED_DB, 1);
+			setenv(PARTITION_ENV, "hour", 1);
+			m_conn = new Connection();
+			ASSERT_TRUE(ReadingsPartitions::initialise(m_conn));
+			unsetenv(PARTITION_ENV);
+			setenv("DEFAULT_SQLITE_DB_FILE", TEST_DB, 1);
+		}
+		void TearDown()
+		{
+			ReadingsPartitions::shutdown();
+			delete m_conn;
+			unlink(PARTITIONED_DB);
+		}
+		int partitioned(const string& sql)
+		{
+			return ::execute(sql, PARTITIONED_DB);
+		}
+
+		Connection	*m_conn;
+};
+
+/*
+ * The readings view of more partitions than a compound SELECT may have
+ */
+TEST_F(PartitionTest, ManyPartitions)
+{
+	const int partitions = PARTITION_MAX + 100;
+	string sql = "BEGIN;";
+	for (int i = 0; i < partitions; i++)
+	{
+		// Old periods, each partition holds one reading
+		string name = PARTITION_PREFIX "19" + to_string(10000000 + i);
+		string id = to_string(i + 2);
+		sql += "CREATE TABLE " + name + " (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"asset_code character varying(50) NOT NULL, read_key uuid UNIQUE, "
+			"reading JSON NOT NULL DEFAULT '{}', user_ts DATETIME, ts DATETIME);";
+		sql += "INSERT INTO " + name + " (id, asset_code) VALUES (" + id + ", 'old');";
+		sql += "INSERT INTO " PARTITION_CATALOG " VALUES ('" + name + "', '19" +
+			to_string(10000000 + i) + "', " + id + ");";
+	}
+	sql += "COMMIT;";
+	partitioned(sql);
+
+	string current = ReadingsPartitions::getInstance()->current(m_conn);
+	ASSERT_EQ(strlen(PARTITION_PREFIX) + 10, current.length());
+	ASSERT_EQ(partitions + 2, partitioned("SELECT count(*) FROM " PARTITION_CATALOG ";"));
+	ASSERT_EQ(2, partitioned("SELECT count(*) FROM sqlite_master WHERE type = 'view' AND "
+				"name LIKE '" PARTITION_VIEW_PREFIX "%';"));
+	ASSERT_EQ(partitions, partitioned("SELECT count(*) FROM readings WHERE asset_code = 'old';"));
+
+	// Inserts through the view go to the current partition, the ids follow on
+	ASSERT_EQ(1, m_conn->insert("readings", "{ \"asset_code\" : \"new\", \"reading\" : { \"v\" : 1 } }"));
+	ASSERT_EQ(partitions + 2, partitioned("SELECT id FROM " + current + ";"));
+	ASSERT_EQ(partitions + 1, partitioned("SELECT count(*) FROM readings;"));
+}
+
+/*
+ * The common table calls write the partitions through the readings view
+ */
+TEST_F(PartitionTest, TableWrites)
+{
+	partitioned("INSERT INTO " PARTITION_PREFIX "0 (asset_code) VALUES ('old');");
+	string current = ReadingsPartitions::getInstance()->current(m_conn);
+	ASSERT_NE(string(PARTITION_PREFIX "0"), current);
+
+	ASSERT_EQ(2, m_conn->insert("readings", "{ \"inserts\" : [ "
+				"{ \"asset_code\" : \"table\", \"reading\" : { \"v\" : 1 } }, "
+				"{ \"asset_code\" : \"table\", \"reading\" : { \"v\" : 2 } } ] }"));
+	ASSERT_EQ(2, partitioned("SELECT count(*) FROM " + current + " WHERE asset_code = 'table';"));
+	// The defaults of the partition are applied
+	ASSERT_EQ(0, partitioned("SELECT count(*) FROM readings WHERE user_ts IS NULL OR ts IS NULL;"));
+
+	ASSERT_EQ(3, m_conn->update("readings", "{ \"values\" : { \"asset_code\" : \"updated\" }, "
+				"\"where\" : { \"column\" : \"id\", \"condition\" : \">\", \"value\" : 0 } }"));
+	ASSERT_EQ(3, partitioned("SELECT count(*) FROM readings WHERE asset_code = 'updated';"));
+	ASSERT_EQ(1, partitioned("SELECT count(*) FROM " PARTITION_PREFIX "0 WHERE asset_code = 'updated';"));
+
+	ASSERT_EQ(3, m_conn->deleteRows("readings", "{ \"where\" : { \"column\" : \"asset_code\", "
+				"\"condition\" : \"=\", \"value\" : \"updated\" } }"));
+	ASSERT_EQ(0, partitioned("SELECT count(*) FROM readings;"));
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <north_service.h>
+#include <service_setup.h>
+#include <management_api.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+
+using namespace std;
+
+#define SERVICE		"northTest"
+#define PASS_PIPELINE	"{ \"filter\" : { \"description\" : \"Filters\", \"type\" : \"JSON\", " \
+			"\"default\" : \"{\\\"pipeline\\\":[]}\", \"value\" : \"{\\\"pipeline\\\":[]}\" } }"
+#define FAIL_PIPELINE	"{ \"filter\" : { \"description\" : \"Filters\", \"type\" : \"JSON\", " \
+			"\"default\" : \"{\\\"pipeline\\\":[]}\", \"value\" : \"{\\\"pipeline\\\":[\\\"missing\\\"]}\" } }"
+
+/**
+ * The core and storage service in one, the readings are always empty
+ * and the filter "missing" has no plugin
+ */
+class FakeServer {
+	public:
+		FakeServer() : m_fetches(0)
+		{
+			m_category = PASS_PIPELINE;
+			m_server.config.address = "127.0.0.1";
+			m_server.config.port = 0;
+			m_server.resource["^/storage/reading$"]["GET"] = [this](shared_ptr<HttpServer::Response> response,
+									    shared_ptr<HttpServer::Request>) {
+				m_fetches++;
+				response->write("{ \"count\" : 0, \"rows\" : [] }");
+			};
+			m_server.resource["^/foglamp/service/category/([^/]*)$"]["GET"] =
+				[this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+				lock_guard<mutex> guard(m_mutex);
+				if (request->path_match[1].str().compare(SERVICE) == 0)
+				{
+					response->write(m_category);
+				}
+				else
+				{
+					response->write("{ \"other\" : { \"description\" : \"Not a plugin\", "
+							"\"type\" : \"string\", \"default\" : \"\", \"value\" : \"\" } }");
+				}
+			};
+			// Waiting for readings is not supported, the load thread polls
+			m_server.default_resource["GET"] = [](shared_ptr<HttpServer::Response> response,
+							      shared_ptr<HttpServer::Request>) {
+				response->write(SimpleWeb::StatusCode::client_error_not_found,
+						"{ \"message\" : \"Not found\" }");
+			};
+			m_server.default_resource["POST"] = [this](shared_ptr<HttpServer::Response> response,
+								   shared_ptr<HttpServer::Request> request) {
+				lock_guard<mutex> guard(m_mutex);
+				m_posted.push_back(request->content.string());
+				response->write("{ \"children\" : [] }");
+			};
+			// Listening before the constructor returns
+			m_server.io_service = make_shared<boost::asio::io_service>();
+			m_port = m_server.bind();
+			m_server.accept_and_run();
+			m_thread = thread([this]() { m_server.io_service->run(); });
+		}
+		~FakeServer()
+		{
+			m_server.stop();
+			m_server.io_service->stop();
+			m_thread.join();
+		}
+		unsigned short	port() { return m_port; };
+		void		setCategory(const string& category)
+				{
+					lock_guard<mutex> guard(m_mutex);
+					m_category = category;
+				};
+		vector<string>	posted()
+				{
+					lock_guard<mutex> guard(m_mutex);
+					return m_posted;
+				};
+
+		atomic<int>	m_fetches;
+
+	private:
+		HttpServer	m_server;
+		unsigned short	m_port;
+		thread		m_thread;
+		mutex		m_mutex;
+		string		m_category;
+		vector<string>	m_posted;
+};
+
+class NorthServiceTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			m_server = new FakeServer();
+			m_service = new NorthService(SERVICE);
+			m_service->m_mgtClient = new ManagementClient("127.0.0.1", m_server->port());
+			m_service->m_storage = new StorageClient("127.0.0.1", m_server->port());
+		}
+		void TearDown()
+		{
+			delete m_service;
+			delete m_server;
+		}
+		void startLoading()
+		{
+			m_service->m_loadThread = new thread(&NorthService::loadThread, m_service);
+		}
+		void stopLoading()
+		{
+			m_service->shutdown();
+			m_service->m_loadThread->join();
+			delete m_service->m_loadThread;
+		}
+		unsigned long	blockSize() { return m_service->m_blockSize; };
+		unsigned long	queueSize() { return m_service->m_queueSize; };
+		unsigned int	checkpointInterval() { return m_service->m_checkpointInterval; };
+		bool		filtersFailed() { return m_service->m_filtersFailed; };
+		size_t		queued()
+				{
+					lock_guard<mutex> guard(m_service->m_mutex);
+					return m_service->m_queue.size();
+				};
+		ManagementClient *mgtClient() { return m_service->m_mgtClient; };
+		bool waitForFetch()
+		{
+			for (int i = 0; i < 200 && m_server->m_fetches == 0; i++)
+			{
+				this_thread::sleep_for(chrono::milliseconds(10));
+			}
+			return m_server->m_fetches > 0;
+		}
+
+		FakeServer	*m_server;
+		NorthService	*m_service;
+};
+
+TEST_F(NorthServiceTest, AdvancedConfig)
+{
+	m_service->configChange(SERVICE "Advanced", "{ "
+		"\"blockSize\" : { \"description\" : \"\", \"type\" : \"integer\", \"default\" : \"500\", \"value\" : \"0\" }, "
+		"\"memoryBufferSize\" : { \"description\" : \"\", \"type\" : \"integer\", \"default\" : \"10\", \"value\" : \"4\" }, "
+		"\"checkpointInterval\" : { \"description\" : \"\", \"type\" : \"integer\", \"default\" : \"10\", \"value\" : \"30\" } }");
+	ASSERT_EQ(1UL, blockSize());
+	ASSERT_EQ(4UL, queueSize());
+	ASSERT_EQ(30U, checkpointInterval());
+}
+
+TEST_F(NorthServiceTest, Loads)
+{
+	startLoading();
+	ASSERT_TRUE(waitForFetch());
+	stopLoading();
+}
+
+/*
+ * A filter pipeline that fails to load stops the loading of readings,
+ * rather than sending them unfiltered, until a pipeline that loads
+ */
+TEST_F(NorthServiceTest, FailedFiltersStopLoading)
+{
+	m_server->setCategory(FAIL_PIPELINE);
+	m_service->configChange(SERVICE, FAIL_PIPELINE);
+	ASSERT_TRUE(filtersFailed());
+	startLoading();
+	this_thread::sleep_for(chrono::milliseconds(200));
+	ASSERT_EQ(0, m_server->m_fetches);
+	ASSERT_EQ(0U, queued());
+
+	m_server->setCategory(PASS_PIPELINE);
+	m_service->configChange(SERVICE, PASS_PIPELINE);
+	ASSERT_FALSE(filtersFailed());
+	ASSERT_TRUE(waitForFetch());
+	stopLoading();
+}
+
+/*
+ * The category of the plugin is described by its plugin item and a
+ * sub category by the item that defines it
+ */
+TEST_F(NorthServiceTest, CategoryDescriptions)
+{
+	DefaultConfigCategory config("plugin", "{ "
+		"\"plugin\" : { \"description\" : \"Test north plugin\", \"type\" : \"string\", \"default\" : \"test\" }, "
+		"\"sub\" : { \"description\" : \"Sub settings\", \"type\" : \"category\", "
+			"\"default\" : { \"x\" : { \"description\" : \"x\", \"type\" : \"string\", \"default\" : \"1\" } } } }");
+	ServiceSetup::createConfigCategories(mgtClient(), config, "North", "plugin");
+	vector<string> posted = m_server->posted();
+	int plugin = 0, sub = 0;
+	for (auto& payload : posted)
+	{
+		if (payload.find("\"key\" : \"plugin\", \"description\" : \"Test north plugin\"") != string::npos)
+			plugin++;
+		if (payload.find("\"key\" : \"sub\", \"description\" : \"Sub settings\"") != string::npos)
+			sub++;
+	}
+	ASSERT_EQ(1, plugin);
+	ASSERT_EQ(1, sub);
+}
+
+TEST(ServiceSetupTest, Address)
+{
+	ASSERT_EQ(string("127.0.0.1"), ServiceSetup::serviceAddress("localhost", 8081));
+}
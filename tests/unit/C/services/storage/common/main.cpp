@@ -0,0 +1,13 @@
+#include <gtest/gtest.h>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    testing::GTEST_FLAG(repeat) = 1000;
+    testing::GTEST_FLAG(shuffle) = true;
+    testing::GTEST_FLAG(break_on_failure) = true;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <append_coalescer.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(ReadingsArrayTest, Readings)
+{
+	string readings;
+	unsigned int count;
+	ASSERT_TRUE(AppendCoalescer::readingsArray("{ \"readings\" : [ { \"asset_code\" : \"a\" }, "
+				"{ \"asset_code\" : \"b\" } ] }", readings, count));
+	ASSERT_EQ(2, count);
+	ASSERT_EQ(" { \"asset_code\" : \"a\" }, { \"asset_code\" : \"b\" } ", readings);
+}
+
+TEST(ReadingsArrayTest, Nested)
+{
+	// Arrays and objects within a reading are not counted as readings
+	string readings;
+	unsigned int count;
+	ASSERT_TRUE(AppendCoalescer::readingsArray("{ \"other\" : [ 1, 2 ], \"readings\" : "
+				"[{\"reading\":{\"v\":[1,2,3],\"readings\":[4]}},[5],6]}", readings, count));
+	ASSERT_EQ(3, count);
+	ASSERT_EQ("{\"reading\":{\"v\":[1,2,3],\"readings\":[4]}},[5],6", readings);
+}
+
+TEST(ReadingsArrayTest, Empty)
+{
+	string readings;
+	unsigned int count;
+	ASSERT_TRUE(AppendCoalescer::readingsArray("{ \"readings\" : [] }", readings, count));
+	ASSERT_EQ(0, count);
+	ASSERT_EQ("", readings);
+}
+
+TEST(ReadingsArrayTest, NoReadings)
+{
+	string readings;
+	unsigned int count;
+	ASSERT_FALSE(AppendCoalescer::readingsArray("{ \"other\" : [ 1 ] }", readings, count));
+	ASSERT_FALSE(AppendCoalescer::readingsArray("{ \"other\" : { \"readings\" : [ 1 ] } }", readings, count));
+	ASSERT_FALSE(AppendCoalescer::readingsArray("[ 1 ]", readings, count));
+}
+
+TEST(ReadingsArrayTest, Invalid)
+{
+	string readings;
+	unsigned int count;
+	ASSERT_FALSE(AppendCoalescer::readingsArray("{ \"readings\" : [ 1, ] }", readings, count));
+	ASSERT_FALSE(AppendCoalescer::readingsArray("{ \"readings\" : [ 1 ]", readings, count));
+	ASSERT_FALSE(AppendCoalescer::readingsArray("", readings, count));
+}
+
+static vector<PendingAppend> makeAppends(const vector<string>& readings, const vector<unsigned int>& counts)
+{
+	vector<PendingAppend> appends;
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		appends.push_back(PendingAppend{nullptr, readings[i], counts[i]});
+	}
+	return appends;
+}
+
+TEST(MergeTest, Merged)
+{
+	vector<PendingAppend> appends = makeAppends({"1, 2", "", "3"}, {2, 0, 1});
+	vector<string> payloads;
+	vector<int> results;
+	AppendCoalescer::merge(appends,
+		[&payloads](string& payload) { payloads.push_back(payload); return 3; },
+		[&results](PendingAppend&, int rval) { results.push_back(rval); });
+	ASSERT_EQ(1, payloads.size());
+	ASSERT_EQ("{ \"readings\" : [ 1, 2, 3 ] }", payloads[0]);
+	ASSERT_EQ(vector<int>({2, 0, 1}), results);
+}
+
+TEST(MergeTest, Shortfall)
+{
+	// Readings the plugin skipped are reported against the last requests
+	vector<PendingAppend> appends = makeAppends({"1, 2", "3, 4"}, {2, 2});
+	vector<int> results;
+	AppendCoalescer::merge(appends,
+		[](string&) { return 3; },
+		[&results](PendingAppend&, int rval) { results.push_back(rval); });
+	ASSERT_EQ(vector<int>({2, 1}), results);
+}
+
+TEST(MergeTest, Single)
+{
+	vector<PendingAppend> appends = makeAppends({"1, 2"}, {2});
+	vector<string> payloads;
+	vector<int> results;
+	AppendCoalescer::merge(appends,
+		[&payloads](string& payload) { payloads.push_back(payload); return 2; },
+		[&results](PendingAppend&, int rval) { results.push_back(rval); });
+	ASSERT_EQ(vector<string>({"{ \"readings\" : [ 1, 2 ] }"}), payloads);
+	ASSERT_EQ(vector<int>({2}), results);
+}
+
+TEST(MergeTest, PerRequestFallback)
+{
+	// The merged append fails because of the second request, the others are still appended
+	vector<PendingAppend> appends = makeAppends({"1, 2", "bad", "3"}, {2, 1, 1});
+	vector<string> payloads;
+	vector<int> results;
+	AppendCoalescer::merge(appends,
+		[&payloads](string& payload) {
+			payloads.push_back(payload);
+			if (payload.find("bad") != string::npos)
+				return -1;
+			return payload.find(',') != string::npos ? 2 : 1;
+		},
+		[&results](PendingAppend&, int rval) { results.push_back(rval); });
+	ASSERT_EQ(vector<string>({"{ \"readings\" : [ 1, 2, bad, 3 ] }",
+				"{ \"readings\" : [ 1, 2 ] }",
+				"{ \"readings\" : [ bad ] }",
+				"{ \"readings\" : [ 3 ] }"}), payloads);
+	ASSERT_EQ(vector<int>({2, -1, 1}), results);
+}
+
+TEST(CoalescerTest, PendingLimits)
+{
+	vector<PendingAppend> flushed;
+	{
+		// The window does not close during the test, the appends are flushed on destruction
+		AppendCoalescer coalescer(60000, 1000, 2, 10, [&flushed](vector<PendingAppend>& appends) {
+				flushed.insert(flushed.end(), appends.begin(), appends.end());
+			});
+		string readings = "1";
+		ASSERT_TRUE(coalescer.append(nullptr, readings, 1));
+		readings = "2";
+		ASSERT_TRUE(coalescer.append(nullptr, readings, 1));
+		readings = "3";
+		ASSERT_FALSE(coalescer.append(nullptr, readings, 1));
+		ASSERT_EQ("3", readings);
+	}
+	ASSERT_EQ(2, flushed.size());
+	{
+		AppendCoalescer coalescer(60000, 1000, 10, 10, [&flushed](vector<PendingAppend>& appends) {
+				flushed.insert(flushed.end(), appends.begin(), appends.end());
+			});
+		string readings = "123456";
+		ASSERT_TRUE(coalescer.append(nullptr, readings, 1));
+		readings = "12345";
+		ASSERT_FALSE(coalescer.append(nullptr, readings, 1));
+		// An append larger than the limit is always accepted if none are waiting
+		AppendCoalescer empty(60000, 1000, 10, 10, [](vector<PendingAppend>&) {});
+		readings = "12345678901";
+		ASSERT_TRUE(empty.append(nullptr, readings, 1));
+	}
+	ASSERT_EQ(3, flushed.size());
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <reading_waiters.h>
+#include <client_http.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <atomic>
+
+using namespace std;
+
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
+
+/**
+ * A server that holds every request as a waiter, a request it can not
+ * hold is answered with 503 as the storage service does
+ */
+class WaitServer {
+	public:
+		WaitServer(unsigned int maxWaiters, unsigned long timeout) : m_waiters(maxWaiters), m_held(0)
+		{
+			m_server.config.address = "127.0.0.1";
+			m_server.config.port = 0;
+			m_server.resource["^/wait$"]["GET"] = [this, timeout](shared_ptr<HttpServer::Response> response,
+									      shared_ptr<HttpServer::Request>) {
+				if (m_waiters.wait(response, 1, m_waiters.appends(), timeout))
+				{
+					m_held++;
+				}
+				else
+				{
+					*response << "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+				}
+			};
+			// Listening before the constructor returns
+			m_server.io_service = make_shared<boost::asio::io_service>();
+			m_port = m_server.bind();
+			m_server.accept_and_run();
+			m_thread = thread([this]() { m_server.io_service->run(); });
+		}
+		~WaitServer()
+		{
+			m_server.stop();
+			m_server.io_service->stop();
+			m_thread.join();
+		}
+		string		url() { return "127.0.0.1:" + to_string(m_port); };
+
+		ReadingWaiters	m_waiters;
+		atomic<int>	m_held;
+
+	private:
+		HttpServer	m_server;
+		unsigned short	m_port;
+		thread		m_thread;
+};
+
+/*
+ * Requests past the limit are refused at once, those held are woken by
+ * the next append
+ */
+TEST(ReadingWaitersTest, Limit)
+{
+	WaitServer server(2, 5000);
+	vector<string> status(2);
+	vector<thread> clients;
+	for (int i = 0; i < 2; i++)
+	{
+		clients.emplace_back([i, &server, &status]() {
+			HttpClient client(server.url());
+			auto res = client.request("GET", "/wait");
+			status[i] = res->status_code + " " + res->content.string();
+		});
+	}
+	// Both requests are held before the third is made
+	for (int i = 0; i < 500 && server.m_held < 2; i++)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	ASSERT_EQ(2, server.m_held);
+	{
+		HttpClient client(server.url());
+		auto res = client.request("GET", "/wait");
+		ASSERT_EQ("503 Service Unavailable", res->status_code);
+	}
+
+	auto start = chrono::steady_clock::now();
+	server.m_waiters.notify();
+	for (auto& t : clients)
+	{
+		t.join();
+	}
+	ASSERT_LT(chrono::steady_clock::now() - start, chrono::seconds(2));
+	for (int i = 0; i < 2; i++)
+	{
+		ASSERT_EQ("200 OK { \"after\" : 1, \"available\" : true }", status[i]);
+	}
+}
+
+/*
+ * A request is held until its timeout if nothing is appended
+ */
+TEST(ReadingWaitersTest, Timeout)
+{
+	WaitServer server(1, 10);
+	auto start = chrono::steady_clock::now();
+	HttpClient client(server.url());
+	auto res = client.request("GET", "/wait");
+	ASSERT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(10));
+	ASSERT_EQ("200 OK", res->status_code);
+	ASSERT_EQ("{ \"after\" : 1, \"available\" : false }", res->content.string());
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <slot_queue.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+TEST(SlotQueueTest, Order)
+{
+	SlotQueue queue(4);
+	unsigned long slot;
+	ASSERT_FALSE(queue.tryPop(slot));
+	for (unsigned long i = 0; i < 4; i++)
+		queue.push(i);
+	for (unsigned long i = 0; i < 4; i++)
+	{
+		ASSERT_TRUE(queue.pop(slot));
+		ASSERT_EQ(i, slot);
+	}
+	ASSERT_FALSE(queue.tryPop(slot));
+}
+
+/*
+ * A consumer that sleeps on an empty queue is woken by the next push
+ */
+TEST(SlotQueueTest, Wake)
+{
+	SlotQueue queue(4);
+	atomic<bool> popped(false);
+	unsigned long slot = 0;
+	thread consumer([&]() {
+		if (queue.pop(slot))
+			popped = true;
+	});
+	this_thread::sleep_for(chrono::milliseconds(20));
+	ASSERT_FALSE(popped);
+	queue.push(3);
+	consumer.join();
+	ASSERT_TRUE(popped);
+	ASSERT_EQ(3UL, slot);
+}
+
+/*
+ * Every slot passed through a chain of stages, with each stage often
+ * sleeping, reaches the last stage once and in order
+ */
+TEST(SlotQueueTest, Pipeline)
+{
+	const unsigned long slots = 4, blocks = 10000;
+	SlotQueue free(slots), loaded(slots);
+	for (unsigned long i = 0; i < slots; i++)
+		free.push(i);
+	vector<unsigned long> received;
+	thread consumer([&]() {
+		unsigned long slot;
+		while (loaded.pop(slot))
+		{
+			received.push_back(slot);
+			free.push(slot);
+		}
+	});
+	for (unsigned long i = 0; i < blocks; i++)
+	{
+		unsigned long slot;
+		ASSERT_TRUE(free.pop(slot));
+		loaded.push(slot);
+	}
+	// All the slots are back once the consumer has taken every block
+	for (unsigned long i = 0; i < slots; i++)
+	{
+		unsigned long slot;
+		ASSERT_TRUE(free.pop(slot));
+	}
+	loaded.stop();
+	consumer.join();
+	ASSERT_EQ(blocks, received.size());
+	for (unsigned long i = 0; i < blocks; i++)
+		ASSERT_EQ(i % slots, received[i]);
+}
+
+/*
+ * Stopping the queue wakes a sleeping consumer and stops it waiting,
+ * slots already queued are still taken without waiting
+ */
+TEST(SlotQueueTest, Stop)
+{
+	SlotQueue queue(4);
+	atomic<bool> result(true);
+	thread consumer([&]() {
+		unsigned long slot;
+		result = queue.pop(slot);
+	});
+	this_thread::sleep_for(chrono::milliseconds(20));
+	queue.stop();
+	consumer.join();
+	ASSERT_FALSE(result);
+
+	unsigned long slot;
+	ASSERT_FALSE(queue.pop(slot));
+	queue.push(1);
+	ASSERT_TRUE(queue.tryPop(slot));
+	ASSERT_EQ(1UL, slot);
+}
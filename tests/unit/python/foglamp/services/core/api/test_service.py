@@ -141,9 +141,9 @@ class TestService:
         ('{"name": "test", "plugin": "dht11", "type": "south", "enabled": "0"}', 400,
          'Only "true", "false", true, false are allowed for value of enabled.'),
         ('{"name": "test", "plugin": "dht11"}', 400, "Missing type property in payload."),
-        ('{"name": "test", "plugin": "dht11", "type": "blah"}', 400, "Only south and notification type are supported."),
-        ('{"name": "test", "plugin": "dht11", "type": "North"}', 406, "north type is not supported for the time being."),
-        ('{"name": "test", "type": "south"}', 400, "Missing plugin property for type south in payload.")
+        ('{"name": "test", "plugin": "dht11", "type": "blah"}', 400, "Only south, north and notification type are supported."),
+        ('{"name": "test", "type": "south"}', 400, "Missing plugin property for type south in payload."),
+        ('{"name": "test", "type": "North"}', 400, "Missing plugin property for type north in payload.")
     ])
     async def test_add_service_with_bad_params(self, client, code, payload, message):
         resp = await client.post('/foglamp/service', data=payload)
@@ -379,6 +379,82 @@ class TestService:
                         assert {'name': 'south_c', 'script': '["services/south_c"]'} == p
                 patch_get_cat_info.assert_called_once_with(category_name='furnace4')
 
+    async def test_add_north_service(self, client):
+        data = {"name": "PI Server", "type": "north", "plugin": "omf", "enabled": True}
+
+        async def async_mock_get_schedule():
+            schedule = StartUpSchedule()
+            schedule.schedule_id = '2129cc95-c841-441a-ad39-6469a87dbc8b'
+            return schedule
+
+        @asyncio.coroutine
+        def q_result(*arg):
+            table = arg[0]
+            _payload = arg[1]
+
+            if table == 'scheduled_processes':
+                assert {'return': ['name'], 'where': {'column': 'name', 'condition': '=',
+                                                      'value': 'north_c'}} == json.loads(_payload)
+                return {'count': 0, 'rows': []}
+            if table == 'schedules':
+                assert {'return': ['schedule_name'], 'where': {'column': 'schedule_name', 'condition': '=',
+                                                               'value': 'PI Server'}} == json.loads(_payload)
+                return {'count': 0, 'rows': []}
+
+        expected_insert_resp = {'rows_affected': 1, "response": "inserted"}
+        plugin_config = {
+            'plugin': {
+                'description': "PI Server North C Plugin",
+                'type': 'string',
+                'default': 'omf'
+            }
+        }
+
+        server.Server.scheduler = Scheduler(None, None)
+        storage_client_mock = MagicMock(StorageClientAsync)
+        c_mgr = ConfigurationManager(storage_client_mock)
+        with patch.object(service, 'load_c_plugin', return_value=plugin_config) as patch_load_plugin:
+            with patch.object(connect, 'get_storage_async', return_value=storage_client_mock):
+                with patch.object(c_mgr, 'get_category_all_items', return_value=self.async_mock(None)):
+                    with patch.object(storage_client_mock, 'query_tbl_with_payload', side_effect=q_result):
+                        with patch.object(storage_client_mock, 'insert_into_tbl', return_value=self.async_mock(expected_insert_resp)) \
+                                as insert_table_patch:
+                            with patch.object(c_mgr, 'create_category', return_value=self.async_mock(None)) as patch_create_cat:
+                                with patch.object(c_mgr, 'create_child_category', return_value=self.async_mock(None)) \
+                                        as patch_create_child_cat:
+                                    with patch.object(server.Server.scheduler, 'save_schedule',
+                                                      return_value=self.async_mock("")) as patch_save_schedule:
+                                        with patch.object(server.Server.scheduler, 'get_schedule_by_name',
+                                                          return_value=async_mock_get_schedule()):
+                                            resp = await client.post('/foglamp/service', data=json.dumps(data))
+                                            server.Server.scheduler = None
+                                            assert 200 == resp.status
+                                            result = await resp.text()
+                                            json_response = json.loads(result)
+                                            assert {'id': '2129cc95-c841-441a-ad39-6469a87dbc8b',
+                                                    'name': 'PI Server'} == json_response
+                                        args, kwargs = patch_save_schedule.call_args
+                                        assert 'north_c' == args[0].process_name
+                                        assert args[1] is True
+                                patch_create_child_cat.assert_called_once_with('North', ['PI Server'])
+                            assert 2 == patch_create_cat.call_count
+                            patch_create_cat.assert_any_call(category_name='PI Server',
+                                                             category_description='PI Server North C Plugin',
+                                                             category_value=plugin_config,
+                                                             keep_original_items=True)
+                            patch_create_cat.assert_called_with('North', {}, 'North microservices', True)
+                        args, kwargs = insert_table_patch.call_args
+                        assert 'scheduled_processes' == args[0]
+                        assert {'name': 'north_c', 'script': '["services/north_c"]'} == json.loads(args[1])
+        patch_load_plugin.assert_called_once_with('omf', 'north')
+
+    async def test_add_north_service_plugin_not_found(self, client):
+        data = {"name": "PI Server", "type": "north", "plugin": "blah"}
+        with patch.object(service, 'load_c_plugin', return_value={}):
+            resp = await client.post('/foglamp/service', data=json.dumps(data))
+            assert 404 == resp.status
+            assert 'Plugin "blah" not found.' == resp.reason
+
     p1 = '{"name": "NotificationServer", "type": "notification"}'
     p2 = '{"name": "NotificationServer", "type": "notification", "enabled": false}'
     p3 = '{"name": "NotificationServer", "type": "notification", "enabled": true}'
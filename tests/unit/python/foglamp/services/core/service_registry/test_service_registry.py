@@ -37,6 +37,13 @@ class TestServiceRegistry:
         assert args[0].endswith(': <A name, type=Storage, protocol=http, address=127.0.0.1, service port=1234,'
                                 ' management port=4321, status=1>')
 
+    def test_register_with_socket(self):
+        with patch.object(ServiceRegistry._logger, 'info'):
+            s_id = ServiceRegistry.register("A name", "Storage", "127.0.0.1", 1234, 4321, 'http',
+                                            socket='/tmp/storage.sock')
+        services = ServiceRegistry.get(idx=s_id)
+        assert '/tmp/storage.sock' == services[0]._socket
+
     def test_register_with_service_port_none(self):
         with patch.object(ServiceRegistry._logger, 'info') as log_info:
             s_id = ServiceRegistry.register("A name", "Southbound", "127.0.0.1", None, 4321, 'http')
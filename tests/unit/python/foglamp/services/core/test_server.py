@@ -574,6 +574,34 @@ class TestServer:
         args, kwargs = patch_register.call_args
         assert (request_data['name'], request_data['type'], request_data['address'], request_data['service_port'], request_data['management_port'], 'http') == args
 
+    async def test_register_north_service(self, client):
+        async def async_mock(return_value):
+            return return_value
+
+        Server._storage_client = MagicMock(StorageClientAsync)
+        Server._storage_client_async = MagicMock(StorageClientAsync)
+        # The registration the C north service makes, it has no service port
+        request_data = {"name": "PI Server", "type": "Northbound", "protocol": "http", "address": "127.0.0.1",
+                        "management_port": 1091}
+        ServiceRegistry._registry = list()
+        try:
+            with patch.object(AuditLogger, '__init__', return_value=None):
+                with patch.object(AuditLogger, 'information', return_value=async_mock(None)):
+                    resp = await client.post('/foglamp/service', data=json.dumps(request_data))
+                    assert 200 == resp.status
+                    r = await resp.text()
+                    json_response = json.loads(r)
+                    assert 'Service registered successfully' == json_response['message']
+            resp = await client.get('/foglamp/service?type=Northbound')
+            assert 200 == resp.status
+            r = await resp.text()
+            json_response = json.loads(r)
+            assert {'services': [{'id': json_response['services'][0]['id'], 'name': 'PI Server',
+                                  'type': 'Northbound', 'address': '127.0.0.1', 'management_port': 1091,
+                                  'protocol': 'http', 'status': 'running'}]} == json_response
+        finally:
+            ServiceRegistry._registry = list()
+
     async def test_service_not_found_when_unregister(self, client):
         with patch.object(ServiceRegistry, 'get', side_effect=service_registry_exceptions.DoesNotExist) as patch_unregister:
             resp = await client.delete('/foglamp/service/blah')